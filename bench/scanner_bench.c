@@ -0,0 +1,91 @@
+// Scanner throughput benchmark.
+//
+// Usage: scanner_bench [file]
+//     without a file a synthetic script of CLOX_BENCH_SOURCE_MB megabytes is generated.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/common.c"
+#include "../src/scanner.c"
+
+#define CLOX_BENCH_SOURCE_MB 64
+#define CLOX_BENCH_RUNS 5
+
+static const char s_bench_snippet[] =
+    "// compute some numbers and print them\n"
+    "fun fibonacci(n) {\n"
+    "    if (n < 2) return n;\n"
+    "    return fibonacci(n - 2) + fibonacci(n - 1);\n"
+    "}\n"
+    "\n"
+    "var total_iterations = 0;\n"
+    "for (var index = 0; index < 1000; index = index + 1) {\n"
+    "        var message = \"iteration number\";\n"
+    "        total_iterations = total_iterations + 1.5;\n"
+    "        while (total_iterations >= 100 and !false) { total_iterations = total_iterations - 100; }\n"
+    "}\n"
+    "print fibonacci(20) * 3.14159; // the end of the snippet\n";
+
+static char* Clox_Bench_Generate_Source(size_t* length) {
+    size_t snippet_length = sizeof(s_bench_snippet) - 1;
+    size_t count = ((size_t)CLOX_BENCH_SOURCE_MB * 1024 * 1024) / snippet_length;
+    char* source = malloc(count * snippet_length);
+    for (size_t i = 0; i < count; ++i) {
+        memcpy(source + i * snippet_length, s_bench_snippet, snippet_length);
+    }
+    *length = count * snippet_length;
+    return source;
+}
+
+static char* Clox_Bench_Read_Source(const char* path, size_t* length) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    fseek(file, 0L, SEEK_END);
+    *length = (size_t)ftell(file);
+    rewind(file);
+    char* source = malloc(*length);
+    *length = fread(source, 1, *length, file);
+    fclose(file);
+    return source;
+}
+
+int main(int argc, char** argv) {
+    size_t length = 0;
+    char* source = argc > 1 ? Clox_Bench_Read_Source(argv[1], &length) : Clox_Bench_Generate_Source(&length);
+    if (source == NULL || length > UINT32_MAX) {
+        printf("[Error] Could not load the benchmark source.\n");
+        return 1;
+    }
+
+    double best_seconds = 0;
+    uint64_t tokens = 0;
+    for (int run = 0; run < CLOX_BENCH_RUNS; ++run) {
+        Clox_Scanner scanner = Clox_Scanner_New((s8){.string = source, .len = (uint32_t)length});
+        tokens = 0;
+
+        clock_t start = clock();
+        for (;;) {
+            Clox_Token token = Clox_Scanner_Get_Token(&scanner);
+            tokens++;
+            if (token.type == CLOX_TOKEN_EOF) {
+                break;
+            }
+        }
+        double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+        if (run == 0 || seconds < best_seconds) {
+            best_seconds = seconds;
+        }
+    }
+
+    double megabytes = (double)length / (1024.0 * 1024.0);
+    printf("scanned %.1f MB, %llu tokens\n", megabytes, (unsigned long long)tokens);
+    printf("best of %d: %.3f s, %.1f MB/s, %.1f Mtokens/s\n", CLOX_BENCH_RUNS, best_seconds, megabytes / best_seconds, (double)tokens / best_seconds / 1e6);
+
+    free(source);
+    return 0;
+}
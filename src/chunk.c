@@ -4,6 +4,15 @@
 #include "object.h"
 #include "memory.h"
 
+Clox_Intrinsic_Info const Clox_Intrinsics[CLOX_INTRINSIC_COUNT] = {
+    [CLOX_INTRINSIC_CLOCK] = {.name = "GetSystemTimeInSeconds", .arity = 0},
+    [CLOX_INTRINSIC_SQRT] = {.name = "Sqrt", .arity = 1},
+    [CLOX_INTRINSIC_FLOOR] = {.name = "Floor", .arity = 1},
+    [CLOX_INTRINSIC_STRING_LENGTH] = {.name = "StringLength", .arity = 1},
+    [CLOX_INTRINSIC_LIST_APPEND] = {.name = "ListAppend", .arity = 2},
+    [CLOX_INTRINSIC_LIST_LENGTH] = {.name = "ListLength", .arity = 1},
+};
+
 Clox_Chunk Clox_Chunk_New_Empty() {
     return (Clox_Chunk){0};
 }
@@ -198,22 +207,38 @@ uint32_t Clox_Chunk_Print_Op_Code(Clox_Chunk* const chunk, uint32_t const offset
             printf("%-16s %4d -> %04X\n", "OP_LOOP", offset, target);
             return offset + 3;
         } break;
+        case OP_FOR_LOOP: {
+            uint8_t slot = chunk->code[offset + 1];
+            uint16_t jump = (uint16_t)(chunk->code[offset + 2] << 8);
+            jump |= chunk->code[offset + 3];
+            uint32_t target = (uint32_t)((int32_t)(offset + 4) - jump);
+            printf("%-16s %4d -> %04X\n", "OP_FOR_LOOP", slot, target);
+            return offset + 4;
+        } break;
         case OP_CALL: {
             uint8_t argc = chunk->code[offset + 1];
             printf("%-16s argc: %4d\n", "OP_CALL", argc);
             return offset + 2;
         } break;
-            case OP_CLOSURE: {
+        case OP_CALL_0: /* fallthrough */
+        case OP_CALL_1: /* fallthrough */
+        case OP_CALL_2: /* fallthrough */
+        case OP_CALL_3: {
+            printf("OP_CALL_%d\n", opcode - OP_CALL_0);
+            return offset + 1;
+        } break;
+            case OP_CLOSURE: /* fallthrough */
+            case OP_STACK_CLOSURE: {
             uint8_t constant = chunk->code[offset + 1];
-            printf("%-16s %4d ", "OP_CLOSURE", constant);
+            printf("%-16s %4d ", opcode == OP_CLOSURE ? "OP_CLOSURE" : "OP_STACK_CLOSURE", constant);
             Clox_Value_Print(chunk->constants.values[constant]);
             printf("\n");
 
             Clox_Function* function = (Clox_Function*)(chunk->constants.values[constant].value.object);
             for (int j = 0; j < function->upvalue_count; j++) {
-                int isLocal = chunk->code[offset + (uint32_t)j*2];
-                int index = chunk->code[offset + (uint32_t)j*2 + 1];
-                printf("%04d    |                     %s %d\n", offset + (uint32_t)j , isLocal ? "local" : "upvalue", index);
+                int capture = chunk->code[offset + 2 + (uint32_t)j*2];
+                int index = chunk->code[offset + 2 + (uint32_t)j*2 + 1];
+                printf("%04X    |                     %s%s %d\n", offset + 2 + (uint32_t)j*2, (capture & CLOX_CAPTURE_FLAT) ? "flat " : "", (capture & CLOX_CAPTURE_LOCAL) ? "local" : "upvalue", index);
             }
 
             return offset + 2 + (uint32_t)(function->upvalue_count*2);
@@ -230,10 +255,108 @@ uint32_t Clox_Chunk_Print_Op_Code(Clox_Chunk* const chunk, uint32_t const offset
             printf("'\n");
             return offset + 2;
         } break;
+        case OP_GET_CAPTURE: {
+            printf("%-16s %4d\n", "OP_GET_CAPTURE", chunk->code[offset + 1]);
+            return offset + 2;
+        } break;
         case OP_CLOSE_UPVALUE: {
             printf("OP_CLOSE_UPVALUE\n");
             return offset + 1;
         } break;
+        case OP_DUP: {
+            printf("OP_DUP\n");
+            return offset + 1;
+        } break;
+        case OP_POP_STACK_CLOSURE: {
+            printf("OP_POP_STACK_CLOSURE\n");
+            return offset + 1;
+        } break;
+        case OP_LIST: {
+            uint8_t count = chunk->code[offset + 1];
+            printf("%-16s %4d\n", "OP_LIST", count);
+            return offset + 2;
+        } break;
+        case OP_MAP: {
+            uint8_t count = chunk->code[offset + 1];
+            printf("%-16s %4d\n", "OP_MAP", count);
+            return offset + 2;
+        } break;
+        case OP_INDEX_GET: {
+            printf("OP_INDEX_GET\n");
+            return offset + 1;
+        } break;
+        case OP_INDEX_SET: {
+            printf("OP_INDEX_SET\n");
+            return offset + 1;
+        } break;
+        case OP_CLASS: {
+            uint8_t name_idx = chunk->code[offset + 1];
+            printf("%-16s %4d '", "OP_CLASS", name_idx);
+            Clox_Value_Print(chunk->constants.values[name_idx]);
+            printf("'\n");
+            return offset + 2;
+        } break;
+        case OP_METHOD: {
+            uint8_t name_idx = chunk->code[offset + 1];
+            printf("%-16s %4d '", "OP_METHOD", name_idx);
+            Clox_Value_Print(chunk->constants.values[name_idx]);
+            printf("'\n");
+            return offset + 2;
+        } break;
+        case OP_GET_PROPERTY: {
+            uint8_t name_idx = chunk->code[offset + 1];
+            printf("%-16s %4d '", "OP_GET_PROPERTY", name_idx);
+            Clox_Value_Print(chunk->constants.values[name_idx]);
+            printf("'\n");
+            return offset + 2;
+        } break;
+        case OP_SET_PROPERTY: {
+            uint8_t name_idx = chunk->code[offset + 1];
+            printf("%-16s %4d '", "OP_SET_PROPERTY", name_idx);
+            Clox_Value_Print(chunk->constants.values[name_idx]);
+            printf("'\n");
+            return offset + 2;
+        } break;
+        case OP_GET_SUPER: {
+            uint8_t name_idx = chunk->code[offset + 1];
+            printf("%-16s %4d '", "OP_GET_SUPER", name_idx);
+            Clox_Value_Print(chunk->constants.values[name_idx]);
+            printf("'\n");
+            return offset + 2;
+        } break;
+        case OP_INVOKE: {
+            uint8_t name_idx = chunk->code[offset + 1];
+            uint8_t argc = chunk->code[offset + 2];
+            printf("%-16s (%d args) %4d '", "OP_INVOKE", argc, name_idx);
+            Clox_Value_Print(chunk->constants.values[name_idx]);
+            printf("'\n");
+            return offset + 3;
+        } break;
+        case OP_SUPER_INVOKE: {
+            uint8_t name_idx = chunk->code[offset + 1];
+            uint8_t argc = chunk->code[offset + 2];
+            printf("%-16s (%d args) %4d '", "OP_SUPER_INVOKE", argc, name_idx);
+            Clox_Value_Print(chunk->constants.values[name_idx]);
+            printf("'\n");
+            return offset + 3;
+        } break;
+        case OP_SWITCH: {
+            uint8_t table_idx = chunk->code[offset + 1];
+            uint8_t count = chunk->code[offset + 2];
+            printf("%-16s (%d entries) %4d '", "OP_SWITCH", count, table_idx);
+            Clox_Value_Print(chunk->constants.values[table_idx]);
+            printf("'\n");
+            return offset + 3;
+        } break;
+        case OP_INHERIT: {
+            printf("OP_INHERIT\n");
+            return offset + 1;
+        } break;
+        case OP_INTRINSIC: {
+            uint8_t intrinsic = chunk->code[offset + 1];
+            printf("%-16s %4d '%s'\n", "OP_INTRINSIC", intrinsic, intrinsic < CLOX_INTRINSIC_COUNT ? Clox_Intrinsics[intrinsic].name : "?");
+            return offset + 2;
+        } break;
         default: {
             printf("Unknown opcode %d\n", (uint32_t)opcode);
             return offset + 1;
@@ -242,3 +365,77 @@ uint32_t Clox_Chunk_Print_Op_Code(Clox_Chunk* const chunk, uint32_t const offset
 
     CLOX_UNREACHABLE();
 }
+
+uint32_t Clox_Chunk_Op_Code_Size(Clox_Chunk const* const chunk, uint32_t const offset) {
+    CLOX_DEV_ASSERT(chunk != NULL);
+    CLOX_DEV_ASSERT(offset < chunk->used);
+
+    Clox_Op_Code opcode = chunk->code[offset];
+    switch (opcode) {
+        case OP_RETURN: /* fallthrough */
+        case OP_NIL: /* fallthrough */
+        case OP_TRUE: /* fallthrough */
+        case OP_FALSE: /* fallthrough */
+        case OP_ARITHMETIC_NEGATION: /* fallthrough */
+        case OP_ADD: /* fallthrough */
+        case OP_SUB: /* fallthrough */
+        case OP_MUL: /* fallthrough */
+        case OP_DIV: /* fallthrough */
+        case OP_BOOLEAN_NEGATION: /* fallthrough */
+        case OP_EQUAL: /* fallthrough */
+        case OP_GREATER: /* fallthrough */
+        case OP_LESS: /* fallthrough */
+        case OP_PRINT: /* fallthrough */
+        case OP_POP: /* fallthrough */
+        case OP_CLOSE_UPVALUE: /* fallthrough */
+        case OP_DUP: /* fallthrough */
+        case OP_POP_STACK_CLOSURE: /* fallthrough */
+        case OP_CALL_0: /* fallthrough */
+        case OP_CALL_1: /* fallthrough */
+        case OP_CALL_2: /* fallthrough */
+        case OP_CALL_3: /* fallthrough */
+        case OP_INDEX_GET: /* fallthrough */
+        case OP_INDEX_SET: /* fallthrough */
+        case OP_INHERIT: {
+            return 1;
+        } break;
+        case OP_CONSTANT: /* fallthrough */
+        case OP_DEFINE_GLOBAL: /* fallthrough */
+        case OP_GET_GLOBAL: /* fallthrough */
+        case OP_SET_GLOBAL: /* fallthrough */
+        case OP_GET_LOCAL: /* fallthrough */
+        case OP_SET_LOCAL: /* fallthrough */
+        case OP_GET_UPVALUE: /* fallthrough */
+        case OP_SET_UPVALUE: /* fallthrough */
+        case OP_CALL: /* fallthrough */
+        case OP_INTRINSIC: /* fallthrough */
+        case OP_GET_CAPTURE: /* fallthrough */
+        case OP_LIST: /* fallthrough */
+        case OP_MAP: /* fallthrough */
+        case OP_CLASS: /* fallthrough */
+        case OP_METHOD: /* fallthrough */
+        case OP_GET_PROPERTY: /* fallthrough */
+        case OP_SET_PROPERTY: /* fallthrough */
+        case OP_GET_SUPER: {
+            return 2;
+        } break;
+        case OP_JUMP: /* fallthrough */
+        case OP_JUMP_IF_FALSE: /* fallthrough */
+        case OP_LOOP: /* fallthrough */
+        case OP_INVOKE: /* fallthrough */
+        case OP_SUPER_INVOKE: /* fallthrough */
+        case OP_SWITCH: {
+            return 3;
+        } break;
+        case OP_FOR_LOOP: {
+            return 4;
+        } break;
+        case OP_CLOSURE: /* fallthrough */
+        case OP_STACK_CLOSURE: {
+            Clox_Function* function = (Clox_Function*)(chunk->constants.values[chunk->code[offset + 1]].value.object);
+            return 2 + (uint32_t)(function->upvalue_count * 2);
+        } break;
+    }
+
+    return 0;
+}
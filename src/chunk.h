@@ -35,8 +35,60 @@ typedef enum {
     OP_CALL,
     OP_CLOSURE,
     OP_CLOSE_UPVALUE,
+    OP_DUP,
+    OP_INTRINSIC,
+    OP_GET_CAPTURE,
+    OP_STACK_CLOSURE,     // NOTE(Al-Andrew): OP_CLOSURE of a function that never escapes its local, see vm.h
+    OP_POP_STACK_CLOSURE,
+    OP_CALL_0,            // NOTE(Al-Andrew): OP_CALL without the operand, the argument count is opcode - OP_CALL_0
+    OP_CALL_1,
+    OP_CALL_2,
+    OP_CALL_3,
+    OP_LIST,              // NOTE(Al-Andrew): a list of the operand many values on top of the stack
+    OP_MAP,               // NOTE(Al-Andrew): a map of the operand many key, value pairs on top of the stack
+    OP_INDEX_GET,
+    OP_INDEX_SET,
+    OP_CLASS,
+    OP_INHERIT,           // NOTE(Al-Andrew): copies the methods of the superclass under the top into the class on top
+    OP_METHOD,            // NOTE(Al-Andrew): adds the closure on top to the class under it, the operand names it
+    OP_GET_PROPERTY,      // NOTE(Al-Andrew): the property ops keep an inline cache per site, see Clox_Property_Cache
+    OP_SET_PROPERTY,
+    OP_GET_SUPER,
+    OP_INVOKE,            // NOTE(Al-Andrew): `receiver.name(arguments)` without the bound method, the operands are the
+                          //                name and the argument count. Uses the property cache of its site.
+    OP_SUPER_INVOKE,      // NOTE(Al-Andrew): the same for `super.name(arguments)`, the superclass is on top of them
+    OP_SWITCH,            // NOTE(Al-Andrew): pops a value and skips to its entry in the table of `count` + 1 OP_JUMPs
+                          //                that follows, see Clox_VM_Switch_Entry. The operands are the table and count.
+    OP_FOR_LOOP,          // NOTE(Al-Andrew): the back edge of a counted `for`, the operands are a slot and the jump back.
+                          //                Adds the step in slot + 2 to the counter in slot and jumps back while it is
+                          //                below the bound in slot + 1. The compiler made sure all three are numbers.
 } Clox_Op_Code;
 
+#define CLOX_MAX_SHORT_CALL_ARGS 3
+
+// NOTE(Al-Andrew): flags in the first byte of every capture OP_CLOSURE lists after its function
+#define CLOX_CAPTURE_LOCAL 0x01 // the second byte is a slot of the enclosing frame, not one of its captures
+#define CLOX_CAPTURE_FLAT 0x02  // copied into the closure, the variable is never assigned after its declaration
+
+// NOTE(Al-Andrew): builtins the compiler calls straight through OP_INTRINSIC instead of looking up the global,
+//                  the operand of the opcode. The call only takes this path with exactly `arity` arguments.
+typedef enum {
+    CLOX_INTRINSIC_CLOCK = 0,
+    CLOX_INTRINSIC_SQRT,
+    CLOX_INTRINSIC_FLOOR,
+    CLOX_INTRINSIC_STRING_LENGTH,
+    CLOX_INTRINSIC_LIST_APPEND,
+    CLOX_INTRINSIC_LIST_LENGTH,
+    CLOX_INTRINSIC_COUNT,
+} Clox_Intrinsic;
+
+typedef struct {
+    char const* name;
+    uint8_t arity;
+} Clox_Intrinsic_Info;
+
+extern Clox_Intrinsic_Info const Clox_Intrinsics[CLOX_INTRINSIC_COUNT];
+
 typedef struct {
     uint32_t used;
     uint32_t allocated;
@@ -54,5 +106,7 @@ uint32_t Clox_Chunk_Push_Constant(Clox_Chunk* const chunk, Clox_Value const valu
 
 void Clox_Chunk_Print(Clox_Chunk* const chunk, char const* const name);
 uint32_t Clox_Chunk_Print_Op_Code(Clox_Chunk* const chunk, uint32_t const offset);
+// NOTE(Al-Andrew): size of the instruction at `offset` including its operands, 0 for unknown opcodes
+uint32_t Clox_Chunk_Op_Code_Size(Clox_Chunk const* const chunk, uint32_t const offset);
 
 #endif // CLOX_COMMON_H_INCLUDED
\ No newline at end of file
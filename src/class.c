@@ -0,0 +1,97 @@
+#include "class.h"
+#include "common.h"
+#include "memory.h"
+#include <string.h>
+
+static Clox_Shape* Clox_Shape_Create(Clox_VM* vm, Clox_Class* klass, Clox_Shape* parent, Clox_String* field) {
+    Clox_Shape* shape = (Clox_Shape*)Clox_Object_Allocate(vm, CLOX_OBJECT_TYPE_SHAPE, sizeof(Clox_Shape));
+    shape->klass = klass;
+    shape->parent = parent;
+    shape->field = field;
+    shape->field_count = parent == NULL ? 0 : parent->field_count + 1;
+    shape->transitions = NULL;
+    shape->transition_count = 0;
+    shape->transition_capacity = 0;
+    return shape;
+}
+
+Clox_Property_Cache* Clox_Property_Cache_At(Clox_Function* function, uint32_t offset) {
+    if (function->property_caches == NULL) {
+        function->property_caches = reallocate(NULL, 0, sizeof(Clox_Property_Cache) * function->chunk.used);
+        memset(function->property_caches, 0, sizeof(Clox_Property_Cache) * function->chunk.used);
+    }
+    return &function->property_caches[offset];
+}
+
+Clox_Class* Clox_Class_Create(Clox_VM* vm, Clox_String* name) {
+    Clox_Class* klass = (Clox_Class*)Clox_Object_Allocate(vm, CLOX_OBJECT_TYPE_CLASS, sizeof(Clox_Class));
+    klass->name = name;
+    klass->methods = Clox_Hash_Table_Create();
+    klass->initializer = NULL;
+    klass->root = Clox_Shape_Create(vm, klass, NULL, NULL);
+    return klass;
+}
+
+Clox_Instance* Clox_Instance_Create(Clox_VM* vm, Clox_Class* klass) {
+    Clox_Instance* instance = (Clox_Instance*)Clox_Object_Allocate(vm, CLOX_OBJECT_TYPE_INSTANCE, sizeof(Clox_Instance));
+    instance->shape = klass->root;
+    instance->capacity = 0;
+    instance->fields = NULL;
+    return instance;
+}
+
+Clox_Bound_Method* Clox_Bound_Method_Create(Clox_VM* vm, Clox_Value receiver, Clox_Closure* method) {
+    Clox_Bound_Method* bound = (Clox_Bound_Method*)Clox_Object_Allocate(vm, CLOX_OBJECT_TYPE_BOUND_METHOD, sizeof(Clox_Bound_Method));
+    bound->receiver = receiver;
+    bound->method = method;
+    return bound;
+}
+
+int32_t Clox_Shape_Find_Field(Clox_Shape const* shape, Clox_String const* field) {
+    // NOTE(Al-Andrew): names are interned, the walk goes from the newest field back to the root
+    for (; shape->field != NULL; shape = shape->parent) {
+        if (shape->field == field) {
+            return (int32_t)shape->field_count - 1;
+        }
+    }
+    return -1;
+}
+
+Clox_Shape* Clox_Shape_Add_Field(Clox_VM* vm, Clox_Shape* shape, Clox_String* field) {
+    for (uint32_t i = 0; i < shape->transition_count; i++) {
+        if (shape->transitions[i]->field == field) {
+            return shape->transitions[i];
+        }
+    }
+
+    if (shape->transition_count == shape->transition_capacity) {
+        uint32_t capacity = shape->transition_capacity < 4 ? 4 : shape->transition_capacity * 2;
+        shape->transitions = (Clox_Shape**)reallocate(
+            shape->transitions,
+            sizeof(Clox_Shape*) * shape->transition_capacity,
+            sizeof(Clox_Shape*) * capacity
+        );
+        shape->transition_capacity = capacity;
+    }
+
+    Clox_Shape* child = Clox_Shape_Create(vm, shape->klass, shape, field);
+    shape->transitions[shape->transition_count++] = child;
+    return child;
+}
+
+void Clox_Instance_Add_Field(Clox_Instance* instance, Clox_Shape* shape, Clox_Value value) {
+    CLOX_DEV_ASSERT(shape->parent == instance->shape);
+
+    uint32_t slot = shape->field_count - 1;
+    if (slot == instance->capacity) {
+        uint32_t capacity = instance->capacity < 4 ? 4 : instance->capacity * 2;
+        instance->fields = (Clox_Value*)reallocate(
+            instance->fields,
+            sizeof(Clox_Value) * instance->capacity,
+            sizeof(Clox_Value) * capacity
+        );
+        instance->capacity = capacity;
+    }
+    instance->fields[slot] = value;
+    instance->shape = shape;
+}
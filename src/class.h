@@ -0,0 +1,76 @@
+#ifndef CLOX_CLASS_H_INCLUDED
+#define CLOX_CLASS_H_INCLUDED
+
+#include <stdint.h>
+#include "hash_table.h"
+#include "object.h"
+
+// NOTE(Al-Andrew): classes live apart from object.h, hash_table.h needs Clox_String from there and a class embeds
+//                  its method table
+
+typedef struct Clox_Class Clox_Class;
+
+// NOTE(Al-Andrew): hidden class. Every instance points at the shape that lists its fields in the order they were
+//                  first assigned, a field's slot is its position in that order. Instances that got the same fields
+//                  in the same order share one shape, so a property site only has to compare one pointer to know
+//                  where the field sits. Each class has its own root, a shape always belongs to one class.
+typedef struct Clox_Shape Clox_Shape;
+struct Clox_Shape {
+    Clox_Object obj;
+    Clox_Class* klass;
+    Clox_Shape* parent;
+    Clox_String* field; // NOTE(Al-Andrew): the field this shape adds to its parent, NULL for the root
+    uint32_t field_count;
+    // NOTE(Al-Andrew): the shapes with one more field, searched linearly, there are rarely more than a couple
+    Clox_Shape** transitions;
+    uint32_t transition_count;
+    uint32_t transition_capacity;
+};
+
+struct Clox_Class {
+    Clox_Object obj;
+    Clox_String* name;
+    Clox_Hash_Table methods;
+    Clox_Closure* initializer; // NOTE(Al-Andrew): the `init` method, NULL when there is none
+    Clox_Shape* root;
+};
+
+typedef struct {
+    Clox_Object obj;
+    Clox_Shape* shape;
+    uint32_t capacity;
+    Clox_Value* fields; // NOTE(Al-Andrew): the first shape->field_count are set, indexed by the shape's slots
+} Clox_Instance;
+
+typedef struct {
+    Clox_Object obj;
+    Clox_Value receiver;
+    Clox_Closure* method;
+} Clox_Bound_Method;
+
+// NOTE(Al-Andrew): monomorphic inline cache of one OP_GET_PROPERTY/OP_SET_PROPERTY site, indexed by bytecode offset
+//                  like Clox_Call_Cache. Everything but `shape` only holds for receivers of exactly that shape.
+typedef struct Clox_Property_Cache Clox_Property_Cache;
+struct Clox_Property_Cache {
+    Clox_Shape* shape; // NOTE(Al-Andrew): NULL until the site ran once
+    Clox_Shape* transition; // NOTE(Al-Andrew): OP_SET_PROPERTY adding the field moves the instance to this shape
+    Clox_Closure* method; // NOTE(Al-Andrew): OP_GET_PROPERTY found no field but this method
+    uint32_t slot;
+};
+
+// NOTE(Al-Andrew): the cache of the property access at `offset`, a function gets all of them at once on first use.
+//                  They stay where they are from then on, the JIT bakes their addresses into its code.
+Clox_Property_Cache* Clox_Property_Cache_At(Clox_Function* function, uint32_t offset);
+
+Clox_Class* Clox_Class_Create(Clox_VM* vm, Clox_String* name);
+Clox_Instance* Clox_Instance_Create(Clox_VM* vm, Clox_Class* klass);
+Clox_Bound_Method* Clox_Bound_Method_Create(Clox_VM* vm, Clox_Value receiver, Clox_Closure* method);
+
+// NOTE(Al-Andrew): the slot of `field` in instances of `shape`, -1 when they don't have it
+int32_t Clox_Shape_Find_Field(Clox_Shape const* shape, Clox_String const* field);
+// NOTE(Al-Andrew): the child of `shape` with `field` added, the same one every time
+Clox_Shape* Clox_Shape_Add_Field(Clox_VM* vm, Clox_Shape* shape, Clox_String* field);
+// NOTE(Al-Andrew): `shape` has to be a child of the instance's shape, `value` goes into the new slot
+void Clox_Instance_Add_Field(Clox_Instance* instance, Clox_Shape* shape, Clox_Value value);
+
+#endif // CLOX_CLASS_H_INCLUDED
@@ -15,6 +15,13 @@
 #define CLOX_DEV_ASSERT(exp) { assert((exp)); }
 #define CLOX_UNREACHABLE() { assert(false); }
 
+// NOTE(Al-Andrew): for paths the dispatch loop rarely takes, kept out of line so they don't crowd the hot ones
+#if defined(__GNUC__)
+    #define CLOX_COLD __attribute__((noinline, cold))
+#else
+    #define CLOX_COLD
+#endif
+
 
 typedef struct {
     const char* string;
@@ -2,6 +2,8 @@
 #include "scanner.h"
 #include "chunk.h"
 #include "object.h"
+#include "optimizer.h"
+#include "vm.h"
 #include <stdint.h>
 #include <string.h>
 
@@ -12,16 +14,24 @@ typedef struct {
     Clox_Token name;
     int depth;
     bool is_captured;
+    bool is_reassigned; // NOTE(Al-Andrew): its name is assigned to somewhere, closures have to share it
+    // NOTE(Al-Andrew): a local function is only ever called while its scope is alive until proven otherwise.
+    //                  stack_closure is the offset of its OP_STACK_CLOSURE, or -1 once it escapes (see Escape_Local)
+    bool escapes;
+    int32_t stack_closure;
 } Clox_Local;
 
 typedef enum {
     CLOX_FUNCTION_TYPE_FUNCTION,
+    CLOX_FUNCTION_TYPE_METHOD,
+    CLOX_FUNCTION_TYPE_INITIALIZER, // NOTE(Al-Andrew): the `init` method, always returns `this`
     CLOX_FUNCTION_TYPE_SCRIPT
 } Clox_Function_Type;
 
 typedef struct {
     uint8_t index;
     bool isLocal;
+    bool is_flat;
 } Clox_Upvalue;
 
 typedef struct Clox_Compiler Clox_Compiler;
@@ -35,40 +45,69 @@ struct Clox_Compiler {
     int scopeDepth;
 };
 
+// NOTE(Al-Andrew): the classes the parser is inside of, innermost first. A lazily compiled function doesn't see
+//                  the ones around it, `this` and `super` just resolve like captured variables there.
+typedef struct Clox_Class_Compiler Clox_Class_Compiler;
+struct Clox_Class_Compiler {
+    Clox_Class_Compiler* enclosing;
+    bool has_superclass;
+};
+
 typedef struct {
     Clox_Token current;
     Clox_Token previous;
     Clox_Scanner* scanner;
     Clox_VM* vm;
     Clox_Compiler* compiler;
+    Clox_Class_Compiler* class_compiler;
     bool had_error;
     bool panic_mode;
+    // NOTE(Al-Andrew): the last OP_GET_GLOBAL, a call of it that follows right away might become an OP_INTRINSIC
+    Clox_Chunk* global_get_chunk;
+    uint32_t global_get_offset;
+    Clox_Hash_Table assigned_names; // NOTE(Al-Andrew): see Clox_Compiler_Collect_Assigned_Names
 } Clox_Parser;
 
-static void Clox_Compiler_Init(Clox_Parser* parser, Clox_Compiler* compiler, Clox_Function_Type type) {
+static void Clox_Compiler_Init_With_Function(Clox_Parser* parser, Clox_Compiler* compiler, Clox_Function_Type type, Clox_Function* function) {
     compiler->enclosing = parser->compiler;
-    compiler->function = NULL;
+    compiler->function = function;
     compiler->type = type;
     compiler->localCount = 0;
     compiler->scopeDepth = 0;
     memset(compiler->locals, 0, sizeof(compiler->locals));
-    compiler->function = Clox_Function_Create_Empty(parser->vm);
 
     parser->compiler = compiler;
-    if (type != CLOX_FUNCTION_TYPE_SCRIPT) {
-        parser->compiler->function->name = Clox_String_Create(parser->vm, parser->previous.start, (uint32_t)parser->previous.length);
-    }
     Clox_Local* local = &parser->compiler->locals[parser->compiler->localCount++];
     local->depth = 0;
     local->name.start = "";
     local->name.length = 0;
     local->is_captured = false;
+    local->is_reassigned = true;
+    if (type == CLOX_FUNCTION_TYPE_METHOD || type == CLOX_FUNCTION_TYPE_INITIALIZER) {
+        // NOTE(Al-Andrew): the receiver sits in slot 0, `this` can't be assigned so closures copy it
+        local->name.start = "this";
+        local->name.length = 4;
+        local->is_reassigned = false;
+    }
+    local->escapes = true;
+    local->stack_closure = -1;
+}
+
+static void Clox_Compiler_Init(Clox_Parser* parser, Clox_Compiler* compiler, Clox_Function_Type type) {
+    Clox_Compiler_Init_With_Function(parser, compiler, type, Clox_Function_Create_Empty(parser->vm));
+    if (type != CLOX_FUNCTION_TYPE_SCRIPT) {
+        compiler->function->name = Clox_String_Create(parser->vm, parser->previous.start, (uint32_t)parser->previous.length);
+    }
 }
+
 static inline void Clox_Compiler_Emit_Return(Clox_Parser* parser);
 static inline Clox_Function* Clox_Compiler_End(Clox_Parser* parser) {
     Clox_Compiler_Emit_Return(parser);
     Clox_Function* to_return = parser->compiler->function;
     parser->compiler = parser->compiler->enclosing;
+    if (parser->vm->config.optimize && !parser->had_error) {
+        Clox_Optimize_Function(parser->vm, to_return);
+    }
     return to_return;
 }
 
@@ -104,17 +143,26 @@ static void Clox_Compiler_Compile_Variable(Clox_Parser* parser, bool);
 static void Clox_Compiler_Compile_And_(Clox_Parser* parser, bool);
 static void Clox_Compiler_Compile_Or_(Clox_Parser* parser, bool);
 static void Clox_Compiler_Compile_Call(Clox_Parser* parser, bool);
+static void Clox_Compiler_Compile_List(Clox_Parser* parser, bool);
+static void Clox_Compiler_Compile_Index(Clox_Parser* parser, bool);
+static void Clox_Compiler_Compile_Map(Clox_Parser* parser, bool);
+static void Clox_Compiler_Compile_Dot(Clox_Parser* parser, bool);
+static void Clox_Compiler_Compile_This(Clox_Parser* parser, bool);
+static void Clox_Compiler_Compile_Super(Clox_Parser* parser, bool);
 
 static Clox_Parse_Rule parse_rules[] = {
   [CLOX_TOKEN_LEFT_PAREN]    = {Clox_Compiler_Compile_Grouping, Clox_Compiler_Compile_Call  , CLOX_PRECEDENCE_CALL  },
   [CLOX_TOKEN_RIGHT_PAREN]   = {NULL                          , NULL                        , CLOX_PRECEDENCE_NONE  },
-  [CLOX_TOKEN_LEFT_BRACE]    = {NULL                          , NULL                        , CLOX_PRECEDENCE_NONE  }, 
+  [CLOX_TOKEN_LEFT_BRACE]    = {Clox_Compiler_Compile_Map     , NULL                        , CLOX_PRECEDENCE_NONE  }, 
   [CLOX_TOKEN_RIGHT_BRACE]   = {NULL                          , NULL                        , CLOX_PRECEDENCE_NONE  },
+  [CLOX_TOKEN_LEFT_BRACKET]  = {Clox_Compiler_Compile_List    , Clox_Compiler_Compile_Index , CLOX_PRECEDENCE_CALL  },
+  [CLOX_TOKEN_RIGHT_BRACKET] = {NULL                          , NULL                        , CLOX_PRECEDENCE_NONE  },
   [CLOX_TOKEN_COMMA]         = {NULL                          , NULL                        , CLOX_PRECEDENCE_NONE  },
-  [CLOX_TOKEN_DOT]           = {NULL                          , NULL                        , CLOX_PRECEDENCE_NONE  },
+  [CLOX_TOKEN_DOT]           = {NULL                          , Clox_Compiler_Compile_Dot   , CLOX_PRECEDENCE_CALL  },
   [CLOX_TOKEN_MINUS]         = {Clox_Compiler_Compile_Unary   , Clox_Compiler_Compile_Binary, CLOX_PRECEDENCE_TERM  },
   [CLOX_TOKEN_PLUS]          = {NULL                          , Clox_Compiler_Compile_Binary, CLOX_PRECEDENCE_TERM  },
   [CLOX_TOKEN_SEMICOLON]     = {NULL                          , NULL                        , CLOX_PRECEDENCE_NONE  },
+  [CLOX_TOKEN_COLON]         = {NULL                          , NULL                        , CLOX_PRECEDENCE_NONE  },
   [CLOX_TOKEN_SLASH]         = {NULL                          , Clox_Compiler_Compile_Binary, CLOX_PRECEDENCE_FACTOR},
   [CLOX_TOKEN_STAR]          = {NULL                          , Clox_Compiler_Compile_Binary, CLOX_PRECEDENCE_FACTOR},
   [CLOX_TOKEN_BANG]          = {Clox_Compiler_Compile_Unary   , NULL                        , CLOX_PRECEDENCE_NONE  },
@@ -129,7 +177,9 @@ static Clox_Parse_Rule parse_rules[] = {
   [CLOX_TOKEN_STRING]        = {Clox_Compiler_Compile_String  , NULL                        , CLOX_PRECEDENCE_NONE  },
   [CLOX_TOKEN_NUMBER]        = {Clox_Compiler_Compile_Number  , NULL                        , CLOX_PRECEDENCE_NONE  },
   [CLOX_TOKEN_AND]           = {Clox_Compiler_Compile_And_    , NULL                        , CLOX_PRECEDENCE_AND  },
+  [CLOX_TOKEN_CASE]          = {NULL                          , NULL                        , CLOX_PRECEDENCE_NONE  },
   [CLOX_TOKEN_CLASS]         = {NULL                          , NULL                        , CLOX_PRECEDENCE_NONE  },
+  [CLOX_TOKEN_DEFAULT]       = {NULL                          , NULL                        , CLOX_PRECEDENCE_NONE  },
   [CLOX_TOKEN_ELSE]          = {NULL                          , NULL                        , CLOX_PRECEDENCE_NONE  },
   [CLOX_TOKEN_FALSE]         = {Clox_Compiler_Compile_Literal , NULL                        , CLOX_PRECEDENCE_NONE  },
   [CLOX_TOKEN_FOR]           = {NULL                          , NULL                        , CLOX_PRECEDENCE_NONE  },
@@ -139,8 +189,9 @@ static Clox_Parse_Rule parse_rules[] = {
   [CLOX_TOKEN_OR]            = {Clox_Compiler_Compile_Or_     , NULL                        , CLOX_PRECEDENCE_OR  },
   [CLOX_TOKEN_PRINT]         = {NULL                          , NULL                        , CLOX_PRECEDENCE_NONE  },
   [CLOX_TOKEN_RETURN]        = {NULL                          , NULL                        , CLOX_PRECEDENCE_NONE  },
-  [CLOX_TOKEN_SUPER]         = {NULL                          , NULL                        , CLOX_PRECEDENCE_NONE  },
-  [CLOX_TOKEN_THIS]          = {NULL                          , NULL                        , CLOX_PRECEDENCE_NONE  },
+  [CLOX_TOKEN_SUPER]         = {Clox_Compiler_Compile_Super   , NULL                        , CLOX_PRECEDENCE_NONE  },
+  [CLOX_TOKEN_SWITCH]        = {NULL                          , NULL                        , CLOX_PRECEDENCE_NONE  },
+  [CLOX_TOKEN_THIS]          = {Clox_Compiler_Compile_This    , NULL                        , CLOX_PRECEDENCE_NONE  },
   [CLOX_TOKEN_TRUE]          = {Clox_Compiler_Compile_Literal , NULL                        , CLOX_PRECEDENCE_NONE  },
   [CLOX_TOKEN_VAR]           = {NULL                          , NULL                        , CLOX_PRECEDENCE_NONE  },
   [CLOX_TOKEN_WHILE]         = {NULL                          , NULL                        , CLOX_PRECEDENCE_NONE  },
@@ -251,10 +302,34 @@ static inline void Clox_Compiler_Emit_Constant(Clox_Parser* parser, Clox_Value v
     Clox_Compiler_Emit_Bytes(parser, 2, OP_CONSTANT, Clox_Compiler_Make_Constant(parser, value));
 }
 
+// NOTE(Al-Andrew): the value of a number literal, usually the one just consumed
+static double Clox_Compiler_Number_Literal(Clox_Token const* token) {
+    // NOTE(Al-Andrew): the source isn't NUL terminated anymore, strtod needs a terminated copy of the literal. Only
+    //                  the odd literal longer than the buffer on the stack costs an allocation.
+    char buffer[64];
+    size_t length = (size_t)token->length;
+    char* literal = length < sizeof(buffer) ? buffer : reallocate(NULL, 0, length + 1);
+    memcpy(literal, token->start, length);
+    literal[length] = '\0';
+    double value = strtod(literal, NULL);
+    if (literal != buffer) {
+        deallocate(literal);
+    }
+    return value;
+}
+
+// NOTE(Al-Andrew): whole literals start out as integers for the interpreter. The JIT tiers take them too, their
+//                  guards turn an integer into a double on the way in.
+static Clox_Value Clox_Compiler_Number_Value(double value) {
+    if (value <= INT32_MAX && value == (double)(int32_t)value) {
+        return CLOX_VALUE_INTEGER((int32_t)value);
+    }
+    return CLOX_VALUE_NUMBER(value);
+}
+
 static inline void Clox_Compiler_Compile_Number(Clox_Parser* parser, bool can_assign) {
     (void)can_assign;
-    double value = strtod(parser->previous.start, NULL);
-    Clox_Compiler_Emit_Constant(parser, CLOX_VALUE_NUMBER(value));
+    Clox_Compiler_Emit_Constant(parser, Clox_Compiler_Number_Value(Clox_Compiler_Number_Literal(&parser->previous)));
 }
 
 static inline void Clox_Compiler_Compile_String(Clox_Parser* parser, bool can_assign) {
@@ -400,6 +475,8 @@ static void Clox_Compiler_End_Scope(Clox_Parser* parser) {
     while (have_what_to_pop && should_pop) {
         if (parser->compiler->locals[parser->compiler->localCount - 1].is_captured) {
             Clox_Compiler_Emit_Byte(parser, OP_CLOSE_UPVALUE);
+        } else if (parser->compiler->locals[parser->compiler->localCount - 1].stack_closure != -1) {
+            Clox_Compiler_Emit_Byte(parser, OP_POP_STACK_CLOSURE);
         } else {
             Clox_Compiler_Emit_Byte(parser, OP_POP);
         }
@@ -459,6 +536,198 @@ static void Clox_Compiler_Compile_If_Statement(Clox_Parser* parser) {
     Clox_Compiler_Patch_Jump(parser, elseJump);
 }
 
+#define CLOX_MAX_SWITCH_CASES UINT8_MAX
+
+// NOTE(Al-Andrew): case values are literals, the table is built at compile time
+static bool Clox_Compiler_Case_Value(Clox_Parser* parser, Clox_Value* value) {
+    if (Clox_Compiler_Match(parser, CLOX_TOKEN_NUMBER)) {
+        *value = CLOX_VALUE_NUMBER(Clox_Compiler_Number_Literal(&parser->previous));
+    } else if (Clox_Compiler_Match(parser, CLOX_TOKEN_MINUS)) {
+        Clox_Compiler_Consume(parser, CLOX_TOKEN_NUMBER, "Expect number after '-'.");
+        if (parser->previous.type != CLOX_TOKEN_NUMBER) {
+            return false;
+        }
+        *value = CLOX_VALUE_NUMBER(-Clox_Compiler_Number_Literal(&parser->previous));
+    } else if (Clox_Compiler_Match(parser, CLOX_TOKEN_STRING)) {
+        *value = CLOX_VALUE_OBJECT(Clox_String_Create(parser->vm, parser->previous.start + 1, (uint32_t)parser->previous.length - 2));
+    } else if (Clox_Compiler_Match(parser, CLOX_TOKEN_TRUE) || Clox_Compiler_Match(parser, CLOX_TOKEN_FALSE)) {
+        *value = CLOX_VALUE_BOOL(parser->previous.type == CLOX_TOKEN_TRUE);
+    } else if (Clox_Compiler_Match(parser, CLOX_TOKEN_NIL)) {
+        *value = CLOX_VALUE_NIL;
+    } else {
+        Clox_Compiler_Error_At_Token(parser, &parser->current, "Expect a literal as case value.");
+        return false;
+    }
+    return true;
+}
+
+// NOTE(Al-Andrew): case values never are integers, Clox_Compiler_Case_Value makes every number a double
+static bool Clox_Compiler_Same_Case(Clox_Value lhs, Clox_Value rhs) {
+    if (lhs.type != rhs.type) {
+        return false;
+    }
+    switch (lhs.type) {
+        case CLOX_VALUE_TYPE_NUMBER: {
+            return lhs.value.number == rhs.value.number;
+        } break;
+        case CLOX_VALUE_TYPE_BOOL: {
+            return lhs.value.boolean == rhs.value.boolean;
+        } break;
+        case CLOX_VALUE_TYPE_OBJECT: {
+            return lhs.value.object == rhs.value.object; // NOTE(Al-Andrew): strings are interned
+        } break;
+        case CLOX_VALUE_TYPE_NIL: /* fallthrough */
+        case CLOX_VALUE_TYPE_INTEGER: {
+            return true;
+        } break;
+    }
+    return false;
+}
+
+static bool Clox_Compiler_Is_Whole(Clox_Value value) {
+    if (!CLOX_VALUE_IS_NUMBER(value)) {
+        return false;
+    }
+    double number = value.value.number;
+    return number >= INT32_MIN && number <= INT32_MAX && number == (double)(int32_t)number;
+}
+
+// NOTE(Al-Andrew): `switch (value) { case 1, 2: ... default: ... }`, the arms don't fall through into each other.
+//                  OP_SWITCH is followed by a table of OP_JUMPs, one per entry plus a last one for no match, and skips
+//                  to the entry of the value. Whole numbers close enough together index the table directly, anything
+//                  else goes through a map from the case value to its entry. The arms are compiled first and then
+//                  moved down to make room for the table, their jumps are relative so they survive the move.
+static void Clox_Compiler_Compile_Switch_Statement(Clox_Parser* parser) {
+    Clox_Compiler_Consume(parser, CLOX_TOKEN_LEFT_PAREN, "Expect '(' after 'switch'.");
+    Clox_Compiler_Compile_Expression(parser);
+    Clox_Compiler_Consume(parser, CLOX_TOKEN_RIGHT_PAREN, "Expect ')' after value.");
+    Clox_Compiler_Consume(parser, CLOX_TOKEN_LEFT_BRACE, "Expect '{' before switch cases.");
+
+    Clox_Chunk* chunk = Clox_Compiler_Current_Chunk(parser);
+    Clox_Compiler_Emit_Bytes(parser, 3, OP_SWITCH, 0, 0);
+    uint32_t table_offset = chunk->used;
+    uint32_t line = chunk->source_lines[table_offset - 1];
+
+    Clox_Value keys[CLOX_MAX_SWITCH_CASES];
+    uint32_t key_arms[CLOX_MAX_SWITCH_CASES];
+    uint32_t key_count = 0;
+    uint32_t arm_starts[CLOX_MAX_SWITCH_CASES + 1];
+    int arm_ends[CLOX_MAX_SWITCH_CASES + 1];
+    uint32_t arm_count = 0;
+    int32_t default_arm = -1;
+
+    while (!Clox_Compiler_Check(parser, CLOX_TOKEN_RIGHT_BRACE) && !Clox_Compiler_Check(parser, CLOX_TOKEN_EOF)) {
+        if (arm_count == CLOX_MAX_SWITCH_CASES + 1) {
+            Clox_Compiler_Error_At_Token(parser, &parser->current, "Can't have more than 255 cases in a switch.");
+            break;
+        }
+        if (Clox_Compiler_Match(parser, CLOX_TOKEN_CASE)) {
+            do {
+                Clox_Value key = CLOX_VALUE_NIL;
+                if (!Clox_Compiler_Case_Value(parser, &key)) {
+                    break;
+                }
+                bool duplicate = false;
+                for (uint32_t i = 0; i < key_count; i++) {
+                    duplicate = duplicate || Clox_Compiler_Same_Case(keys[i], key);
+                }
+                if (duplicate) {
+                    Clox_Compiler_Error(parser, "Duplicate case value in switch.");
+                } else if (key_count == CLOX_MAX_SWITCH_CASES) {
+                    Clox_Compiler_Error(parser, "Can't have more than 255 cases in a switch.");
+                } else {
+                    keys[key_count] = key;
+                    key_arms[key_count++] = arm_count;
+                }
+            } while (Clox_Compiler_Match(parser, CLOX_TOKEN_COMMA));
+            Clox_Compiler_Consume(parser, CLOX_TOKEN_COLON, "Expect ':' after case value.");
+        } else if (Clox_Compiler_Match(parser, CLOX_TOKEN_DEFAULT)) {
+            Clox_Compiler_Consume(parser, CLOX_TOKEN_COLON, "Expect ':' after 'default'.");
+            if (default_arm != -1) {
+                Clox_Compiler_Error(parser, "Can't have more than one default in a switch.");
+            }
+            default_arm = (int32_t)arm_count;
+        } else {
+            Clox_Compiler_Error_At_Token(parser, &parser->current, "Expect 'case' or 'default'.");
+            break;
+        }
+
+        arm_starts[arm_count] = chunk->used;
+        Clox_Compiler_Begin_Scope(parser);
+        while (!Clox_Compiler_Check(parser, CLOX_TOKEN_CASE) && !Clox_Compiler_Check(parser, CLOX_TOKEN_DEFAULT)
+            && !Clox_Compiler_Check(parser, CLOX_TOKEN_RIGHT_BRACE) && !Clox_Compiler_Check(parser, CLOX_TOKEN_EOF)) {
+            Clox_Compiler_Compile_Declaration(parser);
+        }
+        Clox_Compiler_End_Scope(parser);
+        // NOTE(Al-Andrew): the last arm just runs into the end
+        arm_ends[arm_count++] = Clox_Compiler_Check(parser, CLOX_TOKEN_RIGHT_BRACE) ? -1 : Clox_Compiler_Emit_Jump(parser, OP_JUMP);
+    }
+    Clox_Compiler_Consume(parser, CLOX_TOKEN_RIGHT_BRACE, "Expect '}' after switch cases.");
+
+    // NOTE(Al-Andrew): direct when every case is a whole number and they fill at least half of the range between them
+    bool dense = key_count > 0;
+    double min = 0;
+    double max = 0;
+    for (uint32_t i = 0; dense && i < key_count; i++) {
+        dense = Clox_Compiler_Is_Whole(keys[i]);
+        min = i == 0 || keys[i].value.number < min ? keys[i].value.number : min;
+        max = i == 0 || keys[i].value.number > max ? keys[i].value.number : max;
+    }
+    dense = dense && max - min < CLOX_MAX_SWITCH_CASES && max - min < 2.0 * key_count;
+
+    // NOTE(Al-Andrew): which arm each entry goes to, arm_count stands for the end of the switch
+    uint32_t entry_arms[CLOX_MAX_SWITCH_CASES + 1];
+    uint32_t entry_count = dense ? (uint32_t)(max - min) + 1 : key_count;
+    uint32_t no_match = default_arm != -1 ? (uint32_t)default_arm : arm_count;
+    Clox_Value table = CLOX_VALUE_NUMBER(min);
+    if (dense) {
+        for (uint32_t i = 0; i < entry_count; i++) {
+            entry_arms[i] = no_match;
+        }
+        for (uint32_t i = 0; i < key_count; i++) {
+            entry_arms[(uint32_t)(keys[i].value.number - min)] = key_arms[i];
+        }
+    } else {
+        Clox_Map* map = Clox_Map_Create(parser->vm);
+        for (uint32_t i = 0; i < key_count; i++) {
+            Clox_Map_Set(map, keys[i], CLOX_VALUE_NUMBER((double)i));
+            entry_arms[i] = key_arms[i];
+        }
+        table = CLOX_VALUE_OBJECT(map);
+    }
+    entry_arms[entry_count] = no_match;
+
+    uint32_t shift = 3 * (entry_count + 1);
+    uint32_t moved = chunk->used - table_offset;
+    for (uint32_t i = 0; i < shift; i++) {
+        Clox_Chunk_Push(chunk, 0, line);
+    }
+    memmove(chunk->code + table_offset + shift, chunk->code + table_offset, moved);
+    memmove(chunk->source_lines + table_offset + shift, chunk->source_lines + table_offset, sizeof(uint32_t) * moved);
+    parser->global_get_chunk = NULL; // NOTE(Al-Andrew): the load it points at moved with the arms
+
+    for (uint32_t i = 0; i <= entry_count; i++) {
+        uint32_t entry = table_offset + 3 * i;
+        uint32_t target = entry_arms[i] == arm_count ? chunk->used : arm_starts[entry_arms[i]] + shift;
+        uint32_t jump = target - (entry + 3);
+        if (jump > UINT16_MAX) {
+            Clox_Compiler_Error(parser, "Too much code to jump over.");
+        }
+        chunk->code[entry] = OP_JUMP;
+        chunk->code[entry + 1] = (uint8_t)((jump >> 8) & 0xff);
+        chunk->code[entry + 2] = (uint8_t)(jump & 0xff);
+        chunk->source_lines[entry] = chunk->source_lines[entry + 1] = chunk->source_lines[entry + 2] = line;
+    }
+    for (uint32_t i = 0; i < arm_count; i++) {
+        if (arm_ends[i] != -1) {
+            Clox_Compiler_Patch_Jump(parser, arm_ends[i] + (int)shift);
+        }
+    }
+
+    chunk->code[table_offset - 2] = Clox_Compiler_Make_Constant(parser, table);
+    chunk->code[table_offset - 1] = (uint8_t)entry_count;
+}
+
 static void Clox_Copmiler_Compile_While_Statement(Clox_Parser* parser) {
     int loopStart = (int)Clox_Compiler_Current_Chunk(parser)->used;
     Clox_Compiler_Consume(parser, CLOX_TOKEN_LEFT_PAREN, "Expect '(' after 'if'.");
@@ -475,6 +744,135 @@ static void Clox_Copmiler_Compile_While_Statement(Clox_Parser* parser) {
 }
 
 static void Clox_Compiler_Compile_Variable_Declaration(Clox_Parser* parser);
+static bool Clox_Identifiers_Compare(Clox_Token* a, Clox_Token* b);
+static void Clox_Compiler_Add_Local(Clox_Parser* parser, Clox_Token token);
+static void Clox_Compiler_Mark_Local_Initialized(Clox_Parser* parser);
+static void Clox_Compiler_Compile_Named_Variable(Clox_Parser* parser, Clox_Token name_token, bool can_assign);
+static int Clox_Compiler_Resolve_Local(Clox_Parser* parser, Clox_Compiler* compiler, Clox_Token* name);
+static int Clox_Compiler_Resolve_Upvalue(Clox_Parser* parser, Clox_Compiler* compiler, Clox_Token* token);
+
+// NOTE(Al-Andrew): `current` gets assigned to, `a.name = ...` assigns a field and `var name = ...` declares one
+static inline bool Clox_Compiler_Is_Assignment(Clox_Token const* previous, Clox_Token const* current, Clox_Token const* next) {
+    return current->type == CLOX_TOKEN_IDENTIFIER && next->type == CLOX_TOKEN_EQUAL &&
+           previous->type != CLOX_TOKEN_VAR && previous->type != CLOX_TOKEN_DOT;
+}
+
+// NOTE(Al-Andrew): the same over-approximation as assigned_names, a shadowing local counts too
+static bool Clox_Compiler_Assigns_Name(s8 source, Clox_Token* name) {
+    Clox_Scanner scanner = Clox_Scanner_New(source);
+    Clox_Token previous = {.type = CLOX_TOKEN_EOF};
+    Clox_Token current = Clox_Scanner_Get_Token(&scanner);
+    while (current.type != CLOX_TOKEN_EOF) {
+        Clox_Token next = Clox_Scanner_Get_Token(&scanner);
+        if (Clox_Compiler_Is_Assignment(&previous, &current, &next) && Clox_Identifiers_Compare(&current, name) == 0) {
+            return true;
+        }
+        previous = current;
+        current = next;
+    }
+    return false;
+}
+
+// NOTE(Al-Andrew): the rest of a `for (var i = ...; i < bound; i = i + step)` header. The step is a number literal
+//                  and the bound can't change while the loop runs: a number literal, or a variable that is never
+//                  assigned. Only looks ahead, the parser still stands at the condition.
+typedef struct {
+    Clox_Token bound;
+    Clox_Token step;
+} Clox_Counted_Loop;
+
+static bool Clox_Compiler_Match_Counted_Loop(Clox_Parser* parser, Clox_Token* counter, Clox_Counted_Loop* loop) {
+    Clox_Token tokens[10];
+    Clox_Scanner lookahead = *parser->scanner;
+    tokens[0] = parser->current;
+    for (uint32_t i = 1; i < 10; i++) {
+        tokens[i] = Clox_Scanner_Get_Token(&lookahead);
+    }
+
+    bool is_counter[10] = {false};
+    for (uint32_t i = 0; i < 10; i++) {
+        is_counter[i] = tokens[i].type == CLOX_TOKEN_IDENTIFIER && Clox_Identifiers_Compare(&tokens[i], counter) == 0;
+    }
+    bool matches = is_counter[0] && tokens[1].type == CLOX_TOKEN_LESS &&
+                   (tokens[2].type == CLOX_TOKEN_NUMBER || (tokens[2].type == CLOX_TOKEN_IDENTIFIER && !is_counter[2])) &&
+                   tokens[3].type == CLOX_TOKEN_SEMICOLON &&
+                   is_counter[4] && tokens[5].type == CLOX_TOKEN_EQUAL && is_counter[6] && tokens[7].type == CLOX_TOKEN_PLUS &&
+                   tokens[8].type == CLOX_TOKEN_NUMBER && tokens[9].type == CLOX_TOKEN_RIGHT_PAREN;
+    if (!matches) {
+        return false;
+    }
+
+    loop->bound = tokens[2];
+    loop->step = tokens[8];
+    if (loop->bound.type == CLOX_TOKEN_IDENTIFIER) {
+        int local = Clox_Compiler_Resolve_Local(parser, parser->compiler, &loop->bound);
+        if (local != -1) {
+            return !parser->compiler->locals[local].is_reassigned;
+        }
+        int upvalue = Clox_Compiler_Resolve_Upvalue(parser, parser->compiler, &loop->bound);
+        return upvalue != -1 && parser->compiler->upvalues[upvalue].is_flat;
+    }
+    return true;
+}
+
+static void Clox_Compiler_Add_Hidden_Local(Clox_Parser* parser) {
+    Clox_Compiler_Add_Local(parser, (Clox_Token){.type = CLOX_TOKEN_IDENTIFIER, .start = "", .length = 0});
+    Clox_Compiler_Mark_Local_Initialized(parser);
+}
+
+// NOTE(Al-Andrew): the bound and the step get copied into unnamed locals right after the counter, where
+//                  OP_FOR_LOOP expects them. The condition at the top only runs once, to enter the loop, and proves
+//                  the counter and the bound are numbers. From then on the body jumps back to itself, unless it
+//                  assigns the counter: then the increment stays a plain one.
+static void Clox_Compiler_Compile_Counted_Loop(Clox_Parser* parser, Clox_Counted_Loop* loop) {
+    uint8_t counter = (uint8_t)(parser->compiler->localCount - 1);
+    Clox_Token counter_name = parser->compiler->locals[counter].name;
+    if (loop->bound.type == CLOX_TOKEN_NUMBER) {
+        Clox_Compiler_Emit_Constant(parser, Clox_Compiler_Number_Value(Clox_Compiler_Number_Literal(&loop->bound)));
+    } else {
+        Clox_Compiler_Compile_Named_Variable(parser, loop->bound, false);
+    }
+    Clox_Compiler_Add_Hidden_Local(parser);
+    Clox_Compiler_Emit_Constant(parser, Clox_Compiler_Number_Value(Clox_Compiler_Number_Literal(&loop->step)));
+    Clox_Compiler_Add_Hidden_Local(parser);
+
+    int loop_start = (int)Clox_Compiler_Current_Chunk(parser)->used;
+    Clox_Compiler_Compile_Expression(parser);
+    Clox_Compiler_Consume(parser, CLOX_TOKEN_SEMICOLON, "Expect ';' after loop condition.");
+    int exit_jump = Clox_Compiler_Emit_Jump(parser, OP_JUMP_IF_FALSE);
+    Clox_Compiler_Emit_Byte(parser, OP_POP); // Condition.
+    for (int i = 0; i < 6; i++) {
+        Clox_Compiler_Advance(parser); // NOTE(Al-Andrew): `i = i + step)`, already matched
+    }
+
+    int body_start = (int)Clox_Compiler_Current_Chunk(parser)->used;
+    char const* body_source = parser->current.start;
+    Clox_Compiler_Compile_Statement(parser);
+    s8 body = {.string = body_source, .len = (uint32_t)(parser->previous.start + parser->previous.length - body_source)};
+
+    if (Clox_Compiler_Assigns_Name(body, &counter_name)) {
+        Clox_Compiler_Emit_Bytes(parser, 2, OP_GET_LOCAL, counter);
+        Clox_Compiler_Emit_Bytes(parser, 2, OP_GET_LOCAL, counter + 2);
+        Clox_Compiler_Emit_Byte(parser, OP_ADD);
+        Clox_Compiler_Emit_Bytes(parser, 2, OP_SET_LOCAL, counter);
+        Clox_Compiler_Emit_Byte(parser, OP_POP);
+        Clox_Compiler_Emit_Loop(parser, loop_start);
+        Clox_Compiler_Patch_Jump(parser, exit_jump);
+        Clox_Compiler_Emit_Byte(parser, OP_POP); // Condition.
+        return;
+    }
+
+    Clox_Compiler_Emit_Bytes(parser, 2, OP_FOR_LOOP, counter);
+    int offset = (int)Clox_Compiler_Current_Chunk(parser)->used - body_start + 2;
+    if (offset > UINT16_MAX) {
+        Clox_Compiler_Error(parser, "Loop body too large.");
+    }
+    Clox_Compiler_Emit_Bytes(parser, 2, (offset >> 8) & 0xff, offset & 0xff);
+    int end_jump = Clox_Compiler_Emit_Jump(parser, OP_JUMP);
+    Clox_Compiler_Patch_Jump(parser, exit_jump);
+    Clox_Compiler_Emit_Byte(parser, OP_POP); // Condition.
+    Clox_Compiler_Patch_Jump(parser, end_jump);
+}
 
 static void Clox_Copmiler_Compile_For_Statement(Clox_Parser* parser) {
     Clox_Compiler_Begin_Scope(parser);
@@ -484,6 +882,14 @@ static void Clox_Copmiler_Compile_For_Statement(Clox_Parser* parser) {
         // No initializer.
     } else if (Clox_Compiler_Match(parser, CLOX_TOKEN_VAR)) {
         Clox_Compiler_Compile_Variable_Declaration(parser);
+        Clox_Counted_Loop loop = {0};
+        Clox_Compiler* compiler = parser->compiler;
+        if (compiler->localCount + 2 < UINT8_MAX &&
+            Clox_Compiler_Match_Counted_Loop(parser, &compiler->locals[compiler->localCount - 1].name, &loop)) {
+            Clox_Compiler_Compile_Counted_Loop(parser, &loop);
+            Clox_Compiler_End_Scope(parser);
+            return;
+        }
     } else {
         Clox_Compiler_Compile_Expression_Statement(parser);
     }
@@ -530,6 +936,9 @@ static void Clox_Copmiler_Compile_Return_Statement(Clox_Parser* parser) {
     if (Clox_Compiler_Match(parser, CLOX_TOKEN_SEMICOLON)) {
         Clox_Compiler_Emit_Return(parser);
     } else {
+        if (parser->compiler->type == CLOX_FUNCTION_TYPE_INITIALIZER) {
+            Clox_Compiler_Error(parser, "Can't return a value from an initializer.");
+        }
         Clox_Compiler_Compile_Expression(parser);
         Clox_Compiler_Consume(parser, CLOX_TOKEN_SEMICOLON, "Expect ';' after return value.");
         Clox_Compiler_Emit_Byte(parser, OP_RETURN);
@@ -545,6 +954,8 @@ static void Clox_Compiler_Compile_Statement(Clox_Parser* parser) {
         Clox_Compiler_End_Scope(parser);
     } else if (Clox_Compiler_Match(parser, CLOX_TOKEN_IF)) {
         Clox_Compiler_Compile_If_Statement(parser);
+    } else if (Clox_Compiler_Match(parser, CLOX_TOKEN_SWITCH)) {
+        Clox_Compiler_Compile_Switch_Statement(parser);
     } else if (Clox_Compiler_Match(parser, CLOX_TOKEN_WHILE)) {
         Clox_Copmiler_Compile_While_Statement(parser);
     } else if (Clox_Compiler_Match(parser, CLOX_TOKEN_FOR)) {
@@ -570,6 +981,7 @@ static void Clox_Compiler_Synchronize(Clox_Parser* parser) {
             case CLOX_TOKEN_VAR: /* fallthrough */
             case CLOX_TOKEN_FOR: /* fallthrough */
             case CLOX_TOKEN_IF: /* fallthrough */
+            case CLOX_TOKEN_SWITCH: /* fallthrough */
             case CLOX_TOKEN_WHILE: /* fallthrough */
             case CLOX_TOKEN_PRINT: /* fallthrough */
             case CLOX_TOKEN_RETURN: {
@@ -584,19 +996,23 @@ static void Clox_Compiler_Synchronize(Clox_Parser* parser) {
     }
 }
 
-static uint8_t Clox_Compiler_Emit_Identifier_Constant(Clox_Parser* parser) {
+static uint8_t Clox_Compiler_Identifier_Constant(Clox_Parser* parser, Clox_Token const* name) {
     return Clox_Compiler_Make_Constant(
         parser,
         CLOX_VALUE_OBJECT(
             Clox_String_Create(
                 parser->vm,
-                parser->previous.start,
-                (uint32_t)parser->previous.length
+                name->start,
+                (uint32_t)name->length
             )
         )
     );
 }
 
+static uint8_t Clox_Compiler_Emit_Identifier_Constant(Clox_Parser* parser) {
+    return Clox_Compiler_Identifier_Constant(parser, &parser->previous);
+}
+
 static void Clox_Compiler_Mark_Local_Initialized(Clox_Parser* parser) {
     if (parser->compiler->scopeDepth == 0) return;
     parser->compiler->locals[parser->compiler->localCount - 1].depth = parser->compiler->scopeDepth;
@@ -612,6 +1028,11 @@ static void Clox_Compiler_Add_Local(Clox_Parser* parser, Clox_Token token) {
     local->name = token;
     local->depth = -1;
     local->is_captured = false;
+    local->escapes = false;
+    local->stack_closure = -1;
+    Clox_Value unused = {0};
+    Clox_String* name = Clox_String_Create(parser->vm, token.start, (uint32_t)token.length);
+    local->is_reassigned = Clox_Hash_Table_Get(&parser->assigned_names, name, &unused);
 }
 
 static bool Clox_Identifiers_Compare(Clox_Token* a, Clox_Token* b) {
@@ -671,11 +1092,7 @@ static void Clox_Compiler_Compile_Variable_Declaration(Clox_Parser* parser) {
     Clox_Compiler_Emit_Define_Variable(parser, global);
 }
 
-static void Clox_Compiler_Emit_Fuction(Clox_Parser* parser, Clox_Function_Type type) {
-    Clox_Compiler compiler = { 0 };
-    Clox_Compiler_Init(parser ,&compiler, type);
-    Clox_Compiler_Begin_Scope(parser); 
-
+static void Clox_Compiler_Compile_Parameters(Clox_Parser* parser) {
     Clox_Compiler_Consume(parser, CLOX_TOKEN_LEFT_PAREN, "Expect '(' after function name.");
     if (!Clox_Compiler_Check(parser, CLOX_TOKEN_RIGHT_PAREN)) {
         do {
@@ -689,28 +1106,199 @@ static void Clox_Compiler_Emit_Fuction(Clox_Parser* parser, Clox_Function_Type t
     }
     Clox_Compiler_Consume(parser, CLOX_TOKEN_RIGHT_PAREN, "Expect ')' after parameters.");
     Clox_Compiler_Consume(parser, CLOX_TOKEN_LEFT_BRACE, "Expect '{' before function body.");
-    Clox_Compiler_Compile_Block(parser);
+}
 
-    Clox_Function* function = Clox_Compiler_End(parser);
-    #ifdef CLOX_DEBUG_PRINT_COMPILED_CHUNKS
-        Clox_Chunk_Print(&function->chunk, function->name != NULL ? function->name->characters : "<script>");
-    #endif // CLOX_DEBUG_PRINT_COMPILED_CHUNKS
+static Clox_Token Clox_Compiler_Synthetic_Token(char const* text) {
+    return (Clox_Token){.type = CLOX_TOKEN_IDENTIFIER, .start = text, .length = (int)strlen(text)};
+}
+
+// NOTE(Al-Andrew): captures `name` into the function being skimmed when an enclosing function has it
+static void Clox_Compiler_Skim_Capture(Clox_Parser* parser, Clox_Token* name) {
+    if (Clox_Compiler_Resolve_Local(parser, parser->compiler, name) != -1) {
+        return;
+    }
+    Clox_Function* function = parser->compiler->function;
+    int upvalue = Clox_Compiler_Resolve_Upvalue(parser, parser->compiler, name);
+    if (upvalue != -1 && (uint32_t)upvalue == function->upvalue_names.used) {
+        Clox_String* name_string = Clox_String_Create(parser->vm, name->start, (uint32_t)name->length);
+        Clox_Value_Array_Push_Back(&function->upvalue_names, CLOX_VALUE_OBJECT(name_string));
+    }
+}
+
+// NOTE(Al-Andrew): the pre-parser only matches braces and resolves every identifier it sees against the
+// enclosing scopes. That over-approximates the captures (a body local shadowing an outer one still gets captured),
+// which is harmless: the extra upvalue is just never read once the body gets compiled for real. It also keeps the
+// names the body assigns, so compiling the body later doesn't have to scan it for them again.
+static void Clox_Compiler_Skim_Function_Body(Clox_Parser* parser) {
+    Clox_Function* function = parser->compiler->function;
+    Clox_Token before_previous = {.type = CLOX_TOKEN_EOF};
+    int depth = 1;
+    while (depth > 0) {
+        switch (parser->current.type) {
+            case CLOX_TOKEN_EOF: {
+                Clox_Compiler_Error_At_Token(parser, &parser->current, "Expect '}' after block.");
+                return;
+            } break;
+            case CLOX_TOKEN_LEFT_BRACE: {
+                depth++;
+            } break;
+            case CLOX_TOKEN_RIGHT_BRACE: {
+                depth--;
+            } break;
+            case CLOX_TOKEN_SUPER: {
+                // NOTE(Al-Andrew): `super.name` loads `this` first, the receiver the method gets bound to
+                Clox_Token receiver = Clox_Compiler_Synthetic_Token("this");
+                Clox_Compiler_Skim_Capture(parser, &receiver);
+                Clox_Compiler_Skim_Capture(parser, &parser->current);
+            } break;
+            case CLOX_TOKEN_THIS: /* fallthrough */
+            case CLOX_TOKEN_IDENTIFIER: {
+                if (parser->previous.type == CLOX_TOKEN_DOT) {
+                    break;
+                }
+                Clox_Compiler_Skim_Capture(parser, &parser->current);
+            } break;
+            case CLOX_TOKEN_EQUAL: {
+                if (Clox_Compiler_Is_Assignment(&before_previous, &parser->previous, &parser->current)) {
+                    Clox_String* name = Clox_String_Create(parser->vm, parser->previous.start, (uint32_t)parser->previous.length);
+                    Clox_Value_Array_Push_Back(&function->lazy_assigned_names, CLOX_VALUE_OBJECT(name));
+                }
+            } break;
+            default: {
+                /* no-op */
+            } break;
+        }
+        before_previous = parser->previous;
+        Clox_Compiler_Advance(parser);
+    }
+}
+
+static void Clox_Compiler_Emit_Fuction(Clox_Parser* parser, Clox_Function_Type type) {
+    Clox_Compiler compiler = { 0 };
+    Clox_Compiler_Init(parser ,&compiler, type);
+    Clox_Compiler_Begin_Scope(parser); 
+
+    char const* parameters_start = parser->current.start;
+    int parameters_line = parser->current.line;
+    Clox_Compiler_Compile_Parameters(parser);
+
+    Clox_Function* function = NULL;
+    // NOTE(Al-Andrew): methods are always compiled right away, Clox_Compile_Lazy_Function starts every body over as
+    //                  a plain function and would lose `this` in slot 0 and the initializer's return
+    if (parser->vm->config.lazy_compile && type == CLOX_FUNCTION_TYPE_FUNCTION) {
+        compiler.function->lazy_line = parameters_line;
+        Clox_Compiler_Skim_Function_Body(parser);
+        if (compiler.function->upvalue_count > 0) {
+            compiler.function->lazy_flat_upvalues = reallocate(NULL, 0, sizeof(bool) * (size_t)compiler.function->upvalue_count);
+            for (int i = 0; i < compiler.function->upvalue_count; i++) {
+                compiler.function->lazy_flat_upvalues[i] = compiler.upvalues[i].is_flat;
+            }
+        }
+        compiler.function->lazy_source = (s8){
+            .string = parameters_start,
+            .len = (uint32_t)(parser->previous.start + parser->previous.length - parameters_start)
+        };
+        function = compiler.function;
+        parser->compiler = compiler.enclosing;
+    } else {
+        Clox_Compiler_Compile_Block(parser);
+        function = Clox_Compiler_End(parser);
+        #ifdef CLOX_DEBUG_PRINT_COMPILED_CHUNKS
+            Clox_Chunk_Print(&function->chunk, function->name != NULL ? function->name->characters : "<script>");
+        #endif // CLOX_DEBUG_PRINT_COMPILED_CHUNKS
+    }
     Clox_Compiler_Emit_Bytes(parser, 2, OP_CLOSURE, Clox_Compiler_Make_Constant(parser, CLOX_VALUE_OBJECT(function)));
 
     for (int i = 0; i < function->upvalue_count; i++) {
-        Clox_Compiler_Emit_Bytes(parser, 2, (compiler.upvalues[i].isLocal ? 1 : 0), (compiler.upvalues[i].index));
+        uint8_t capture = (uint8_t)((compiler.upvalues[i].isLocal ? CLOX_CAPTURE_LOCAL : 0) | (compiler.upvalues[i].is_flat ? CLOX_CAPTURE_FLAT : 0));
+        Clox_Compiler_Emit_Bytes(parser, 2, capture, (compiler.upvalues[i].index));
+    }
+}
+
+// NOTE(Al-Andrew): anything but calling a local function lets it outlive its scope, so it goes back to the heap
+static void Clox_Compiler_Escape_Local(Clox_Compiler* compiler, int local) {
+    Clox_Local* escaping = &compiler->locals[local];
+    escaping->escapes = true;
+    if (escaping->stack_closure != -1) {
+        compiler->function->chunk.code[escaping->stack_closure] = OP_CLOSURE;
+        escaping->stack_closure = -1;
     }
 }
 
 static void Clox_Compiler_Compile_Function_Declaration(Clox_Parser* parser) {
     uint8_t global = Clox_Compiler_Parse_Variable(parser, "Expect function name.");
     Clox_Compiler_Mark_Local_Initialized(parser);
+    uint32_t closure = Clox_Compiler_Current_Chunk(parser)->used;
     Clox_Compiler_Emit_Fuction(parser, CLOX_FUNCTION_TYPE_FUNCTION);
+    if (parser->compiler->scopeDepth > 0) {
+        Clox_Local* local = &parser->compiler->locals[parser->compiler->localCount - 1];
+        if (!local->escapes && !local->is_reassigned) {
+            Clox_Compiler_Current_Chunk(parser)->code[closure] = OP_STACK_CLOSURE;
+            local->stack_closure = (int32_t)closure;
+        }
+    }
     Clox_Compiler_Emit_Define_Variable(parser, global);
 }
 
+static void Clox_Compiler_Compile_Method(Clox_Parser* parser) {
+    Clox_Compiler_Consume(parser, CLOX_TOKEN_IDENTIFIER, "Expect method name.");
+    uint8_t name = Clox_Compiler_Emit_Identifier_Constant(parser);
+
+    Clox_Function_Type type = CLOX_FUNCTION_TYPE_METHOD;
+    if (parser->previous.length == 4 && memcmp(parser->previous.start, "init", 4) == 0) {
+        type = CLOX_FUNCTION_TYPE_INITIALIZER;
+    }
+    Clox_Compiler_Emit_Fuction(parser, type);
+    Clox_Compiler_Emit_Bytes(parser, 2, OP_METHOD, name);
+}
+
+static void Clox_Compiler_Compile_Class_Declaration(Clox_Parser* parser) {
+    Clox_Compiler_Consume(parser, CLOX_TOKEN_IDENTIFIER, "Expect class name.");
+    Clox_Token class_name = parser->previous;
+    uint8_t name = Clox_Compiler_Emit_Identifier_Constant(parser);
+    Clox_Compiler_Declare_Variable(parser);
+
+    Clox_Compiler_Emit_Bytes(parser, 2, OP_CLASS, name);
+    Clox_Compiler_Emit_Define_Variable(parser, name);
+
+    Clox_Class_Compiler class_compiler = {.enclosing = parser->class_compiler, .has_superclass = false};
+    parser->class_compiler = &class_compiler;
+
+    if (Clox_Compiler_Match(parser, CLOX_TOKEN_LESS)) {
+        Clox_Compiler_Consume(parser, CLOX_TOKEN_IDENTIFIER, "Expect superclass name.");
+        Clox_Compiler_Compile_Variable(parser, false);
+        if (Clox_Identifiers_Compare(&class_name, &parser->previous) == 0) {
+            Clox_Compiler_Error(parser, "A class can't inherit from itself.");
+        }
+
+        // NOTE(Al-Andrew): the superclass stays on the stack as a local called `super` for the methods to capture
+        Clox_Compiler_Begin_Scope(parser);
+        Clox_Compiler_Add_Local(parser, Clox_Compiler_Synthetic_Token("super"));
+        Clox_Compiler_Emit_Define_Variable(parser, 0);
+
+        Clox_Compiler_Compile_Named_Variable(parser, class_name, false);
+        Clox_Compiler_Emit_Byte(parser, OP_INHERIT);
+        class_compiler.has_superclass = true;
+    }
+
+    Clox_Compiler_Compile_Named_Variable(parser, class_name, false);
+    Clox_Compiler_Consume(parser, CLOX_TOKEN_LEFT_BRACE, "Expect '{' before class body.");
+    while (!Clox_Compiler_Check(parser, CLOX_TOKEN_RIGHT_BRACE) && !Clox_Compiler_Check(parser, CLOX_TOKEN_EOF)) {
+        Clox_Compiler_Compile_Method(parser);
+    }
+    Clox_Compiler_Consume(parser, CLOX_TOKEN_RIGHT_BRACE, "Expect '}' after class body.");
+    Clox_Compiler_Emit_Byte(parser, OP_POP);
+
+    if (class_compiler.has_superclass) {
+        Clox_Compiler_End_Scope(parser);
+    }
+    parser->class_compiler = class_compiler.enclosing;
+}
+
 void Clox_Compiler_Compile_Declaration(Clox_Parser* parser) {
-    if (Clox_Compiler_Match(parser, CLOX_TOKEN_VAR)) {
+    if (Clox_Compiler_Match(parser, CLOX_TOKEN_CLASS)) {
+        Clox_Compiler_Compile_Class_Declaration(parser);
+    } else if (Clox_Compiler_Match(parser, CLOX_TOKEN_VAR)) {
         Clox_Compiler_Compile_Variable_Declaration(parser);
     } else if (Clox_Compiler_Match(parser, CLOX_TOKEN_FUN)) {
         Clox_Compiler_Compile_Function_Declaration(parser);
@@ -738,7 +1326,7 @@ static int Clox_Compiler_Resolve_Local(Clox_Parser* parser, Clox_Compiler* compi
     return -1;
 }
 
-static int Clox_Compiler_Add_Upvalue(Clox_Parser* parser, Clox_Compiler* compiler, uint8_t index, bool isLocal) {
+static int Clox_Compiler_Add_Upvalue(Clox_Parser* parser, Clox_Compiler* compiler, uint8_t index, bool isLocal, bool is_flat) {
     int upvalueCount = compiler->function->upvalue_count;
 
     for (int i = 0; i < upvalueCount; i++) {
@@ -755,40 +1343,62 @@ static int Clox_Compiler_Add_Upvalue(Clox_Parser* parser, Clox_Compiler* compile
 
     compiler->upvalues[upvalueCount].isLocal = isLocal;
     compiler->upvalues[upvalueCount].index = index;
+    compiler->upvalues[upvalueCount].is_flat = is_flat;
     return compiler->function->upvalue_count++;
 }
 
+static int Clox_Compiler_Resolve_Lazy_Upvalue(Clox_Compiler* compiler, Clox_Token* token) {
+    Clox_Value_Array* names = &compiler->function->upvalue_names;
+    for (uint32_t i = 0; i < names->used; i++) {
+        Clox_String* name = (Clox_String*)names->values[i].value.object;
+        if ((int)name->length == token->length && memcmp(name->characters, token->start, name->length) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
 static int Clox_Compiler_Resolve_Upvalue(Clox_Parser* parser, Clox_Compiler* compiler, Clox_Token* token) {
-    if (compiler->enclosing == NULL) return -1;
+    if (compiler->enclosing == NULL) {
+        // NOTE(Al-Andrew): a lazily compiled function has no enclosing compiler anymore, only the names it captured
+        return Clox_Compiler_Resolve_Lazy_Upvalue(compiler, token);
+    }
 
     int local = Clox_Compiler_Resolve_Local(parser, compiler->enclosing, token);
     if (local != -1) {
-        compiler->enclosing->locals[local].is_captured = true;
-        return Clox_Compiler_Add_Upvalue(parser, compiler, (uint8_t)local, true);
+        // NOTE(Al-Andrew): only a shared variable needs OP_CLOSE_UPVALUE, a flat one is already in the closure
+        bool is_flat = !compiler->enclosing->locals[local].is_reassigned;
+        compiler->enclosing->locals[local].is_captured |= !is_flat;
+        Clox_Compiler_Escape_Local(compiler->enclosing, local);
+        return Clox_Compiler_Add_Upvalue(parser, compiler, (uint8_t)local, true, is_flat);
     }
 
     int upvalue = Clox_Compiler_Resolve_Upvalue(parser, compiler->enclosing, token);
     if (upvalue != -1) {
-        return Clox_Compiler_Add_Upvalue(parser, compiler, (uint8_t)upvalue, false);
+        return Clox_Compiler_Add_Upvalue(parser, compiler, (uint8_t)upvalue, false, compiler->enclosing->upvalues[upvalue].is_flat);
     }
 
     return -1;
 }
 
 
-static inline void Clox_Compiler_Compile_Named_Variable(Clox_Parser* parser, bool can_assign) {
+static void Clox_Compiler_Compile_Named_Variable(Clox_Parser* parser, Clox_Token name_token, bool can_assign) {
     uint8_t getOp, setOp;
-    Clox_Token* name = &parser->previous; 
+    Clox_Token* name = &name_token;
     int arg = Clox_Compiler_Resolve_Local(parser, parser->compiler, name);
     if (arg != -1) {
         getOp = OP_GET_LOCAL;
         setOp = OP_SET_LOCAL;
+        if (parser->current.type != CLOX_TOKEN_LEFT_PAREN) {
+            Clox_Compiler_Escape_Local(parser->compiler, arg);
+        }
     } else if ((arg = Clox_Compiler_Resolve_Upvalue(parser, parser->compiler, name)) != -1) {
-        getOp = OP_GET_UPVALUE;
+        // NOTE(Al-Andrew): a flat capture is never assigned, the name would be in assigned_names otherwise
+        getOp = parser->compiler->upvalues[arg].is_flat ? OP_GET_CAPTURE : OP_GET_UPVALUE;
         setOp = OP_SET_UPVALUE;
 
     } else {
-        arg = Clox_Compiler_Emit_Identifier_Constant(parser);
+        arg = Clox_Compiler_Identifier_Constant(parser, name);
         getOp = OP_GET_GLOBAL;
         setOp = OP_SET_GLOBAL;
     }
@@ -799,12 +1409,88 @@ static inline void Clox_Compiler_Compile_Named_Variable(Clox_Parser* parser, boo
         Clox_Compiler_Compile_Expression(parser);
         Clox_Compiler_Emit_Bytes(parser, 2, setOp, (uint8_t)arg);
     } else {
+        if (getOp == OP_GET_GLOBAL) {
+            parser->global_get_chunk = &parser->compiler->function->chunk;
+            parser->global_get_offset = parser->global_get_chunk->used;
+        }
         Clox_Compiler_Emit_Bytes(parser, 2, getOp, (uint8_t)arg);
     }
 }
 
 static inline void Clox_Compiler_Compile_Variable(Clox_Parser* parser, bool can_assign) {
-    Clox_Compiler_Compile_Named_Variable(parser, can_assign);
+    Clox_Compiler_Compile_Named_Variable(parser, parser->previous, can_assign);
+}
+
+// NOTE(Al-Andrew): `this` and `super` are locals of the method, a function inside it captures them like any other
+static bool Clox_Compiler_Resolves(Clox_Parser* parser, Clox_Token* name) {
+    return Clox_Compiler_Resolve_Local(parser, parser->compiler, name) != -1 ||
+           Clox_Compiler_Resolve_Upvalue(parser, parser->compiler, name) != -1;
+}
+
+static void Clox_Compiler_Compile_This(Clox_Parser* parser, bool can_assign) {
+    (void)can_assign;
+    if (!Clox_Compiler_Resolves(parser, &parser->previous)) {
+        Clox_Compiler_Error(parser, "Can't use 'this' outside of a class.");
+        return;
+    }
+    Clox_Compiler_Compile_Variable(parser, false);
+}
+
+static uint8_t Clox_Compiler_Compile_Argument_List(Clox_Parser* parser) {
+    uint8_t argCount = 0;
+    if (!Clox_Compiler_Check(parser, CLOX_TOKEN_RIGHT_PAREN)) {
+        do {
+            Clox_Compiler_Compile_Expression(parser);
+            argCount++;
+        } while (Clox_Compiler_Match(parser, CLOX_TOKEN_COMMA));
+    }
+    Clox_Compiler_Consume(parser, CLOX_TOKEN_RIGHT_PAREN, "Expect ')' after arguments.");
+    return argCount;
+}
+
+static void Clox_Compiler_Compile_Super(Clox_Parser* parser, bool can_assign) {
+    (void)can_assign;
+    Clox_Token super = parser->previous;
+    if (parser->class_compiler != NULL && !parser->class_compiler->has_superclass) {
+        Clox_Compiler_Error(parser, "Can't use 'super' in a class with no superclass.");
+    } else if (!Clox_Compiler_Resolves(parser, &super)) {
+        Clox_Compiler_Error(parser, "Can't use 'super' outside of a class.");
+    }
+
+    Clox_Compiler_Consume(parser, CLOX_TOKEN_DOT, "Expect '.' after 'super'.");
+    Clox_Compiler_Consume(parser, CLOX_TOKEN_IDENTIFIER, "Expect superclass method name.");
+    uint8_t name = Clox_Compiler_Emit_Identifier_Constant(parser);
+
+    Clox_Compiler_Compile_Named_Variable(parser, Clox_Compiler_Synthetic_Token("this"), false);
+    if (Clox_Compiler_Match(parser, CLOX_TOKEN_LEFT_PAREN)) {
+        uint8_t argCount = Clox_Compiler_Compile_Argument_List(parser);
+        if (argCount == 255) {
+            Clox_Compiler_Error(parser, "Can't have more than 255 arguments.");
+        }
+        Clox_Compiler_Compile_Named_Variable(parser, super, false);
+        Clox_Compiler_Emit_Bytes(parser, 3, OP_SUPER_INVOKE, name, argCount);
+    } else {
+        Clox_Compiler_Compile_Named_Variable(parser, super, false);
+        Clox_Compiler_Emit_Bytes(parser, 2, OP_GET_SUPER, name);
+    }
+}
+
+static void Clox_Compiler_Compile_Dot(Clox_Parser* parser, bool can_assign) {
+    Clox_Compiler_Consume(parser, CLOX_TOKEN_IDENTIFIER, "Expect property name after '.'.");
+    uint8_t name = Clox_Compiler_Emit_Identifier_Constant(parser);
+
+    if (can_assign && Clox_Compiler_Match(parser, CLOX_TOKEN_EQUAL)) {
+        Clox_Compiler_Compile_Expression(parser);
+        Clox_Compiler_Emit_Bytes(parser, 2, OP_SET_PROPERTY, name);
+    } else if (Clox_Compiler_Match(parser, CLOX_TOKEN_LEFT_PAREN)) {
+        uint8_t argCount = Clox_Compiler_Compile_Argument_List(parser);
+        if (argCount == 255) {
+            Clox_Compiler_Error(parser, "Can't have more than 255 arguments.");
+        }
+        Clox_Compiler_Emit_Bytes(parser, 3, OP_INVOKE, name, argCount);
+    } else {
+        Clox_Compiler_Emit_Bytes(parser, 2, OP_GET_PROPERTY, name);
+    }
 }
 
 static void Clox_Compiler_Compile_And_(Clox_Parser* parser, bool can_assign) {
@@ -830,41 +1516,120 @@ static void Clox_Compiler_Compile_Or_(Clox_Parser* parser, bool can_assign) {
 }
 
 static inline void Clox_Compiler_Emit_Return(Clox_Parser* parser) {
-    Clox_Compiler_Emit_Bytes(parser, 2, OP_NIL, OP_RETURN);
+    if (parser->compiler->type == CLOX_FUNCTION_TYPE_INITIALIZER) {
+        Clox_Compiler_Emit_Bytes(parser, 3, OP_GET_LOCAL, 0, OP_RETURN);
+    } else {
+        Clox_Compiler_Emit_Bytes(parser, 2, OP_NIL, OP_RETURN);
+    }
 }
 
-static uint8_t Clox_Compiler_Compile_Argument_List(Clox_Parser* parser) {
-    uint8_t argCount = 0;
-    if (!Clox_Compiler_Check(parser, CLOX_TOKEN_RIGHT_PAREN)) {
+static void Clox_Compiler_Compile_List(Clox_Parser* parser, bool can_assign) {
+    (void)can_assign;
+    uint32_t count = 0;
+    if (!Clox_Compiler_Check(parser, CLOX_TOKEN_RIGHT_BRACKET)) {
         do {
             Clox_Compiler_Compile_Expression(parser);
-            argCount++;
+            if (count == UINT8_MAX) {
+                Clox_Compiler_Error(parser, "Can't have more than 255 elements in a list literal.");
+            }
+            count++;
         } while (Clox_Compiler_Match(parser, CLOX_TOKEN_COMMA));
     }
-    Clox_Compiler_Consume(parser, CLOX_TOKEN_RIGHT_PAREN, "Expect ')' after arguments.");
-    return argCount;
+    Clox_Compiler_Consume(parser, CLOX_TOKEN_RIGHT_BRACKET, "Expect ']' after list elements.");
+    Clox_Compiler_Emit_Bytes(parser, 2, OP_LIST, (uint8_t)count);
+}
+
+// NOTE(Al-Andrew): only reached in expression position, a statement starting with '{' is still a block
+static void Clox_Compiler_Compile_Map(Clox_Parser* parser, bool can_assign) {
+    (void)can_assign;
+    uint32_t count = 0;
+    if (!Clox_Compiler_Check(parser, CLOX_TOKEN_RIGHT_BRACE)) {
+        do {
+            Clox_Compiler_Compile_Expression(parser);
+            Clox_Compiler_Consume(parser, CLOX_TOKEN_COLON, "Expect ':' after map key.");
+            Clox_Compiler_Compile_Expression(parser);
+            if (count == UINT8_MAX) {
+                Clox_Compiler_Error(parser, "Can't have more than 255 entries in a map literal.");
+            }
+            count++;
+        } while (Clox_Compiler_Match(parser, CLOX_TOKEN_COMMA));
+    }
+    Clox_Compiler_Consume(parser, CLOX_TOKEN_RIGHT_BRACE, "Expect '}' after map entries.");
+    Clox_Compiler_Emit_Bytes(parser, 2, OP_MAP, (uint8_t)count);
+}
+
+static void Clox_Compiler_Compile_Index(Clox_Parser* parser, bool can_assign) {
+    Clox_Compiler_Compile_Expression(parser);
+    Clox_Compiler_Consume(parser, CLOX_TOKEN_RIGHT_BRACKET, "Expect ']' after index.");
+    if (can_assign && Clox_Compiler_Match(parser, CLOX_TOKEN_EQUAL)) {
+        Clox_Compiler_Compile_Expression(parser);
+        Clox_Compiler_Emit_Byte(parser, OP_INDEX_SET);
+    } else {
+        Clox_Compiler_Emit_Byte(parser, OP_INDEX_GET);
+    }
 }
 
 static void Clox_Compiler_Compile_Call(Clox_Parser* parser, bool can_assign) {
     (void)can_assign;
 
+    Clox_Chunk* chunk = &parser->compiler->function->chunk;
+    uint32_t callee = parser->global_get_offset;
+    Clox_Intrinsic intrinsic = CLOX_INTRINSIC_COUNT;
+    if (parser->global_get_chunk == chunk && callee + 2 == chunk->used) {
+        intrinsic = Clox_VM_Find_Intrinsic(parser->vm, (Clox_String*)chunk->constants.values[chunk->code[callee + 1]].value.object);
+    }
+
     uint8_t argCount = Clox_Compiler_Compile_Argument_List(parser);
 
     if (argCount == 255) {
         Clox_Compiler_Error(parser, "Can't have more than 255 arguments.");
     }
 
-    Clox_Compiler_Emit_Bytes(parser, 2, OP_CALL, argCount);
+    if (intrinsic != CLOX_INTRINSIC_COUNT && argCount == Clox_Intrinsics[intrinsic].arity) {
+        // NOTE(Al-Andrew): the builtin isn't looked up anymore, its arguments move down over the OP_GET_GLOBAL.
+        //                  Jumps inside them are relative, so they survive the move.
+        uint32_t arguments = callee + 2;
+        memmove(chunk->code + callee, chunk->code + arguments, chunk->used - arguments);
+        memmove(chunk->source_lines + callee, chunk->source_lines + arguments, sizeof(uint32_t) * (chunk->used - arguments));
+        chunk->used -= 2;
+        Clox_Compiler_Emit_Bytes(parser, 2, OP_INTRINSIC, (uint8_t)intrinsic);
+        return;
+    }
+
+    if (argCount <= CLOX_MAX_SHORT_CALL_ARGS) {
+        Clox_Compiler_Emit_Byte(parser, (uint8_t)(OP_CALL_0 + argCount));
+    } else {
+        Clox_Compiler_Emit_Bytes(parser, 2, OP_CALL, argCount);
+    }
 }
 
 
 
-Clox_Function* Clox_Compile_Source_To_Function(Clox_VM* vm, const char* source) {
+// NOTE(Al-Andrew): every name that appears as `name = ...` anywhere in the source, no matter the scope. A local
+//                  whose name isn't in here keeps the value it was declared with, so closures can copy it.
+static void Clox_Compiler_Collect_Assigned_Names(Clox_Parser* parser, s8 source) {
+    parser->assigned_names = Clox_Hash_Table_Create();
+    Clox_Scanner scanner = Clox_Scanner_New(source);
+    Clox_Token previous = {.type = CLOX_TOKEN_EOF};
+    Clox_Token current = Clox_Scanner_Get_Token(&scanner);
+    while (current.type != CLOX_TOKEN_EOF) {
+        Clox_Token next = Clox_Scanner_Get_Token(&scanner);
+        if (Clox_Compiler_Is_Assignment(&previous, &current, &next)) {
+            Clox_String* name = Clox_String_Create(parser->vm, current.start, (uint32_t)current.length);
+            Clox_Hash_Table_Set(&parser->assigned_names, name, CLOX_VALUE_NIL);
+        }
+        previous = current;
+        current = next;
+    }
+}
+
+Clox_Function* Clox_Compile_Source_To_Function(Clox_VM* vm, s8 source) {
     Clox_Parser parser = {0};
     Clox_Scanner scanner = Clox_Scanner_New(source);
     Clox_Compiler compiler = {0};
     parser.vm = vm;
     parser.scanner = &scanner;
+    Clox_Compiler_Collect_Assigned_Names(&parser, source);
     Clox_Compiler_Init(&parser, &compiler, CLOX_FUNCTION_TYPE_SCRIPT);
     parser.compiler = &compiler;
     // compiling_chunk = chunk;
@@ -876,6 +1641,10 @@ Clox_Function* Clox_Compile_Source_To_Function(Clox_VM* vm, const char* source)
     }
 
     Clox_Function* fn = Clox_Compiler_End(&parser);
+    Clox_Hash_Table_Destory(&parser.assigned_names);
+    if (vm->config.inline_functions && !vm->config.lazy_compile && !parser.had_error) {
+        Clox_Inline_Functions(vm, fn);
+    }
 
 #ifdef CLOX_DEBUG_PRINT_COMPILED_CHUNKS
     if (!parser.had_error) {
@@ -883,4 +1652,45 @@ Clox_Function* Clox_Compile_Source_To_Function(Clox_VM* vm, const char* source)
     }
 #endif
     return parser.had_error?NULL: fn;
+}
+
+bool Clox_Compile_Lazy_Function(Clox_VM* vm, Clox_Function* function) {
+    CLOX_DEV_ASSERT(function->lazy_source.string != NULL);
+
+    Clox_Parser parser = {0};
+    Clox_Scanner scanner = Clox_Scanner_New(function->lazy_source);
+    scanner.line = function->lazy_line;
+    Clox_Compiler compiler = {0};
+    parser.vm = vm;
+    parser.scanner = &scanner;
+    // NOTE(Al-Andrew): the body's own names are enough, nothing outside it can assign its locals
+    parser.assigned_names = Clox_Hash_Table_Create();
+    for (uint32_t i = 0; i < function->lazy_assigned_names.used; i++) {
+        Clox_Hash_Table_Set(&parser.assigned_names, (Clox_String*)function->lazy_assigned_names.values[i].value.object, CLOX_VALUE_NIL);
+    }
+    Clox_Compiler_Init_With_Function(&parser, &compiler, CLOX_FUNCTION_TYPE_FUNCTION, function);
+    Clox_Compiler_Begin_Scope(&parser);
+    for (int i = 0; i < function->upvalue_count; i++) {
+        compiler.upvalues[i].is_flat = function->lazy_flat_upvalues[i];
+    }
+
+    Clox_Compiler_Advance(&parser);
+    function->arity = 0;
+    Clox_Compiler_Compile_Parameters(&parser);
+    Clox_Compiler_Compile_Block(&parser);
+    Clox_Compiler_End(&parser);
+    Clox_Hash_Table_Destory(&parser.assigned_names);
+
+    if (parser.had_error) {
+        // NOTE(Al-Andrew): stay lazy so every later call reports the error again instead of running half a body
+        Clox_Chunk_Delete(&function->chunk);
+        return false;
+    }
+    function->lazy_source = (s8){0};
+    Clox_Value_Array_Delete(&function->lazy_assigned_names);
+
+#ifdef CLOX_DEBUG_PRINT_COMPILED_CHUNKS
+    Clox_Chunk_Print(&function->chunk, function->name->characters);
+#endif
+    return true;
 }
\ No newline at end of file
@@ -5,6 +5,8 @@
 #include "value.h"
 #include "object.h"
 
-Clox_Function* Clox_Compile_Source_To_Function(Clox_VM* vm, const char* source);
+Clox_Function* Clox_Compile_Source_To_Function(Clox_VM* vm, s8 source);
+// NOTE(Al-Andrew): compiles the body of a function that was only pre-parsed because of `lazy_compile`
+bool Clox_Compile_Lazy_Function(Clox_VM* vm, Clox_Function* function);
 
 #endif // CLOX_COMPILER_H_INCLUDED
\ No newline at end of file
@@ -19,7 +19,7 @@ void Clox_Hash_Table_Destory(Clox_Hash_Table* table) {
 
 
 static Clox_Hash_Table_Entry* Clox_Hash_Table_Find_Entry(Clox_Hash_Table* table, Clox_String* key) {
-    uint32_t index = key->hash % table->allocated;
+    uint32_t index = key->hash & (table->allocated - 1);
 
     // NOTE(Al-Andrew): possible infinite loop if our invariant is broken
     for (;;) {
@@ -41,12 +41,12 @@ static Clox_Hash_Table_Entry* Clox_Hash_Table_Find_Entry(Clox_Hash_Table* table,
             return entry;
         }
 
-        index = (index + 1) % table->allocated;
+        index = (index + 1) & (table->allocated - 1);
     }
 }
 
 static Clox_Hash_Table_Entry* Clox_Hash_Table_Find_Entry_In_List(Clox_Hash_Table_Entry* entries, uint32_t count, Clox_String* key) {
-    uint32_t index = key->hash % count;
+    uint32_t index = key->hash & (count - 1);
 
     // NOTE(Al-Andrew): possible infinite loop if our invariant is broken
     for (;;) {
@@ -68,7 +68,7 @@ static Clox_Hash_Table_Entry* Clox_Hash_Table_Find_Entry_In_List(Clox_Hash_Table
             return entry;
         }
 
-        index = (index + 1) % count;
+        index = (index + 1) & (count - 1);
     }
 }
 
@@ -150,10 +150,19 @@ bool Clox_Hash_Table_Get(Clox_Hash_Table* table, Clox_String* key, Clox_Value* v
     return true;
 }
 
+Clox_Hash_Table_Entry* Clox_Hash_Table_Get_Entry(Clox_Hash_Table* table, Clox_String* key) {
+    if (table->used == 0) {
+        return NULL;
+    }
+
+    Clox_Hash_Table_Entry* entry = Clox_Hash_Table_Find_Entry(table, key);
+    return entry->key == NULL ? NULL : entry;
+}
+
 Clox_Hash_Table_Entry* Clox_Hash_Table_Get_Raw(Clox_Hash_Table* table, char const*const string, uint32_t const len, uint32_t const hash) {
     if (table->used == 0) return NULL;
 
-    uint32_t index = hash % table->allocated;
+    uint32_t index = hash & (table->allocated - 1);
     // NOTE(Al-Andrew): possible infinite loop if our invariant is broken
     for (;;) {
         Clox_Hash_Table_Entry* entry = &table->entries[index];
@@ -171,7 +180,7 @@ Clox_Hash_Table_Entry* Clox_Hash_Table_Get_Raw(Clox_Hash_Table* table, char cons
             }
         }
 
-        index = (index + 1) % table->allocated;
+        index = (index + 1) & (table->allocated - 1);
     }
 }
 
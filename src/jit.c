@@ -0,0 +1,1862 @@
+#include "jit.h"
+#include "chunk.h"
+#include "class.h"
+#include "common.h"
+#include "hash_table.h"
+#include "memory.h"
+#include "object.h"
+#include "value.h"
+#include "vm.h"
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifdef CLOX_JIT_X64
+    #include <sys/mman.h>
+    #include <unistd.h>
+    #ifndef MAP_ANONYMOUS
+        #define MAP_ANONYMOUS MAP_ANON
+    #endif
+#endif // CLOX_JIT_X64
+
+#define CLOX_JIT_NO_ENTRY UINT32_MAX
+
+#define CLOX_JIT_HOT_LOOP            64  // NOTE(Al-Andrew): backward jumps before a loop header gets recorded
+#define CLOX_JIT_TRACE_BACKOFF       256 // NOTE(Al-Andrew): and before trying again when recording was given up
+#define CLOX_JIT_TRACE_MAX_ABORTS    3
+#define CLOX_JIT_TRACE_MAX_STEPS     256
+#define CLOX_JIT_TRACE_MAX_VARIABLES 16
+#define CLOX_JIT_TRACE_MAX_PROMOTED  8   // NOTE(Al-Andrew): xmm8 - xmm15
+#define CLOX_JIT_TRACE_MAX_DEPTH     8   // NOTE(Al-Andrew): xmm0 - xmm7, one per expression stack slot
+#define CLOX_JIT_TRACE_MAX_STEP_EXITS 4  // NOTE(Al-Andrew): guards a single step can leave through, OP_FOR_LOOP has the most
+
+// NOTE(Al-Andrew): uncomment to print every trace that gets compiled
+// #define CLOX_DEBUG_PRINT_TRACES
+
+typedef struct {
+    int32_t hotness; // NOTE(Al-Andrew): counted down by both tiers, a loop with a trace stays at or below 0
+    uint8_t aborts;
+} Clox_Jit_Loop_Counter;
+
+typedef enum {
+    CLOX_JIT_VARIABLE_LOCAL,
+    CLOX_JIT_VARIABLE_UPVALUE,
+    CLOX_JIT_VARIABLE_CAPTURE,
+    CLOX_JIT_VARIABLE_GLOBAL,
+} Clox_Jit_Variable_Kind;
+
+// NOTE(Al-Andrew): a value living outside the expression stack that the trace reads or writes, its address gets
+//                  resolved every time the trace is entered
+typedef struct {
+    Clox_Jit_Variable_Kind kind;
+    uint8_t index;
+    Clox_String* name;
+    Clox_Value_Type entry_type; // NOTE(Al-Andrew): type when the recorder first touched it
+    bool stores_number_only;
+    int8_t promoted;            // NOTE(Al-Andrew): xmm8 + promoted holds it unboxed for the whole trace, -1 if it's not
+} Clox_Jit_Variable;
+
+typedef struct Clox_Jit_Trace Clox_Jit_Trace;
+struct Clox_Jit_Trace {
+    Clox_Jit_Trace* next;
+    uint32_t header;
+    uint32_t base;              // NOTE(Al-Andrew): frame slots in use at the loop header
+    uint8_t* code;
+    size_t mapping_size;
+    uint32_t entry;
+    Clox_Jit_Variable variables[CLOX_JIT_TRACE_MAX_VARIABLES];
+    uint32_t variable_count;
+    uint32_t runs;
+    uint64_t iterations;
+    uint32_t intrinsics;        // NOTE(Al-Andrew): bit per Clox_Intrinsic compiled inline, the trace is off once one is rebound
+};
+
+struct Clox_Jit_Code {
+    uint8_t* code;      // NOTE(Al-Andrew): NULL when the function couldn't be compiled, it just stays interpreted
+    size_t mapping_size;
+    uint32_t* entries;  // native offset for every bytecode offset native code can be resumed at
+    Clox_Jit_Loop_Counter* loops; // indexed by the bytecode offset of the loop header
+    Clox_Jit_Trace* traces;
+};
+
+static void Clox_Jit_Free_Trace(Clox_Jit_Trace* trace) {
+#ifdef CLOX_JIT_X64
+    if (trace->code != NULL) {
+        munmap(trace->code, trace->mapping_size);
+    }
+#endif // CLOX_JIT_X64
+    deallocate(trace);
+}
+
+void Clox_Jit_Free(Clox_Function* function) {
+    Clox_Jit_Code* jit = function->jit;
+    if (jit == NULL) {
+        return;
+    }
+#ifdef CLOX_JIT_X64
+    if (jit->code != NULL) {
+        munmap(jit->code, jit->mapping_size);
+    }
+#endif // CLOX_JIT_X64
+    if (jit->entries != NULL) {
+        deallocate(jit->entries);
+    }
+    if (jit->loops != NULL) {
+        deallocate(jit->loops);
+    }
+    while (jit->traces != NULL) {
+        Clox_Jit_Trace* next = jit->traces->next;
+        Clox_Jit_Free_Trace(jit->traces);
+        jit->traces = next;
+    }
+    deallocate(jit);
+    function->jit = NULL;
+}
+
+#ifdef CLOX_JIT_X64
+
+// NOTE(Al-Andrew): the templates address values as 16 bytes, type in the first 4 and payload at +8
+typedef char Clox_Jit_Value_Layout_Check[(sizeof(Clox_Value) == 16 && offsetof(Clox_Value, value) == 8) ? 1 : -1];
+
+// NOTE(Al-Andrew): registers while native code runs, all callee saved so helpers can be called freely
+//                  rbx - Clox_VM*
+//                  r12 - vm->stack_top
+//                  r13 - frame->slots
+//                  r14 - Clox_Call_Frame*
+typedef void (*Clox_Jit_Entry)(Clox_VM* vm, Clox_Call_Frame* frame, uint8_t const* target);
+
+typedef bool (*Clox_Jit_Helper)(Clox_VM* vm, Clox_String* name);
+typedef bool (*Clox_Jit_Property_Helper)(Clox_VM* vm, Clox_Property_Cache* cache);
+
+typedef enum {
+    CLOX_JIT_FIXUP_JUMP, // NOTE(Al-Andrew): rel32 to the native code of a bytecode offset
+    CLOX_JIT_FIXUP_EXIT, // NOTE(Al-Andrew): rel32 to the stub handing a bytecode offset back to the interpreter
+} Clox_Jit_Fixup_Kind;
+
+typedef struct {
+    Clox_Jit_Fixup_Kind kind;
+    uint32_t at;
+    uint32_t bytecode_offset;
+} Clox_Jit_Fixup;
+
+typedef struct {
+    uint8_t* code;
+    uint32_t used;
+    uint32_t allocated;
+    Clox_Jit_Fixup* fixups;
+    uint32_t fixup_count;
+    uint32_t fixup_allocated;
+    uint32_t common_exit;
+} Clox_Jit_Assembler;
+
+static void Clox_Jit_Emit_Bytes(Clox_Jit_Assembler* as, uint8_t const* bytes, uint32_t count) {
+    if (as->used + count > as->allocated) {
+        uint32_t allocated = as->allocated < 256 ? 256 : as->allocated;
+        while (as->used + count > allocated) {
+            allocated *= 2;
+        }
+        as->code = reallocate(as->code, as->allocated, allocated);
+        as->allocated = allocated;
+    }
+    memcpy(as->code + as->used, bytes, count);
+    as->used += count;
+}
+
+#define CLOX_JIT_EMIT(as, ...) \
+    Clox_Jit_Emit_Bytes((as), (uint8_t const[]){__VA_ARGS__}, (uint32_t)sizeof((uint8_t const[]){__VA_ARGS__}))
+
+static void Clox_Jit_Emit_32(Clox_Jit_Assembler* as, uint32_t value) {
+    uint8_t bytes[4];
+    memcpy(bytes, &value, sizeof(bytes)); // NOTE(Al-Andrew): x86 is little endian, so is everything running this
+    Clox_Jit_Emit_Bytes(as, bytes, sizeof(bytes));
+}
+
+static void Clox_Jit_Emit_64(Clox_Jit_Assembler* as, uint64_t value) {
+    uint8_t bytes[8];
+    memcpy(bytes, &value, sizeof(bytes));
+    Clox_Jit_Emit_Bytes(as, bytes, sizeof(bytes));
+}
+
+static void Clox_Jit_Add_Fixup(Clox_Jit_Assembler* as, Clox_Jit_Fixup_Kind kind, uint32_t bytecode_offset) {
+    if (as->fixup_count == as->fixup_allocated) {
+        uint32_t allocated = as->fixup_allocated < 32 ? 32 : as->fixup_allocated * 2;
+        as->fixups = reallocate(as->fixups, sizeof(Clox_Jit_Fixup) * as->fixup_allocated, sizeof(Clox_Jit_Fixup) * allocated);
+        as->fixup_allocated = allocated;
+    }
+    as->fixups[as->fixup_count++] = (Clox_Jit_Fixup){.kind = kind, .at = as->used - 4, .bytecode_offset = bytecode_offset};
+}
+
+static void Clox_Jit_Patch_32(Clox_Jit_Assembler* as, uint32_t at, uint32_t target) {
+    int32_t relative = (int32_t)target - (int32_t)(at + 4);
+    memcpy(as->code + at, &relative, sizeof(relative));
+}
+
+// NOTE(Al-Andrew): jcc rel32 to the exit stub of the current instruction, `condition` is the second opcode byte
+static void Clox_Jit_Emit_Exit_If(Clox_Jit_Assembler* as, uint8_t condition, uint32_t bytecode_offset) {
+    CLOX_JIT_EMIT(as, 0x0F, condition, 0, 0, 0, 0);
+    Clox_Jit_Add_Fixup(as, CLOX_JIT_FIXUP_EXIT, bytecode_offset);
+}
+
+#define CLOX_JIT_JE  0x84
+#define CLOX_JIT_JNE 0x85
+#define CLOX_JIT_JLE 0x8E
+#define CLOX_JIT_JA  0x87
+#define CLOX_JIT_JBE 0x86
+
+typedef enum {
+    CLOX_JIT_RAX = 0,
+    CLOX_JIT_RCX = 1,
+    CLOX_JIT_RDX = 2,
+    CLOX_JIT_R12 = 12,
+    CLOX_JIT_R13 = 13,
+    CLOX_JIT_R15 = 15,
+} Clox_Jit_Register;
+
+typedef struct {
+    uint8_t prefix; // NOTE(Al-Andrew): 0x66 / 0xF2 for the SSE ones, 0 for none
+    bool wide;      // NOTE(Al-Andrew): REX.W
+    uint8_t escape; // NOTE(Al-Andrew): 0x0F for two byte opcodes, 0 for none
+    uint8_t opcode;
+} Clox_Jit_Encoding;
+
+#define CLOX_JIT_MOVSD_LOAD  ((Clox_Jit_Encoding){0xF2, false, 0x0F, 0x10})
+#define CLOX_JIT_MOVSD_STORE ((Clox_Jit_Encoding){0xF2, false, 0x0F, 0x11})
+#define CLOX_JIT_ADDSD       ((Clox_Jit_Encoding){0xF2, false, 0x0F, 0x58})
+#define CLOX_JIT_SUBSD       ((Clox_Jit_Encoding){0xF2, false, 0x0F, 0x5C})
+#define CLOX_JIT_MULSD       ((Clox_Jit_Encoding){0xF2, false, 0x0F, 0x59})
+#define CLOX_JIT_DIVSD       ((Clox_Jit_Encoding){0xF2, false, 0x0F, 0x5E})
+#define CLOX_JIT_UCOMISD     ((Clox_Jit_Encoding){0x66, false, 0x0F, 0x2E})
+#define CLOX_JIT_CVTSI2SD    ((Clox_Jit_Encoding){0xF2, false, 0x0F, 0x2A}) // NOTE(Al-Andrew): from a dword, what an integer holds
+#define CLOX_JIT_MOVQ_TO     ((Clox_Jit_Encoding){0x66, true, 0x0F, 0x6E})
+#define CLOX_JIT_MOVQ_FROM   ((Clox_Jit_Encoding){0x66, true, 0x0F, 0x7E})
+#define CLOX_JIT_MOV_LOAD    ((Clox_Jit_Encoding){0, true, 0, 0x8B})
+#define CLOX_JIT_MOV_STORE   ((Clox_Jit_Encoding){0, true, 0, 0x89})
+#define CLOX_JIT_MOV_IMM32   ((Clox_Jit_Encoding){0, false, 0, 0xC7})
+#define CLOX_JIT_GROUP_IMM8  ((Clox_Jit_Encoding){0, false, 0, 0x83}) // NOTE(Al-Andrew): dword op with imm8, /7 is cmp
+#define CLOX_JIT_BYTE_IMM8   ((Clox_Jit_Encoding){0, false, 0, 0x80}) // NOTE(Al-Andrew): byte op with imm8, /6 xor /7 cmp
+#define CLOX_JIT_LEA         ((Clox_Jit_Encoding){0, true, 0, 0x8D})
+#define CLOX_JIT_CMP_STORE   ((Clox_Jit_Encoding){0, true, 0, 0x39}) // NOTE(Al-Andrew): cmp [rm + displacement], reg
+
+// NOTE(Al-Andrew): `rm` is a register, or the base of [rm + displacement] when `memory` is set
+static void Clox_Jit_Emit_Encoded(Clox_Jit_Assembler* as, Clox_Jit_Encoding encoding, uint8_t reg, uint8_t rm, bool memory, int32_t displacement) {
+    if (encoding.prefix != 0) {
+        CLOX_JIT_EMIT(as, encoding.prefix);
+    }
+    uint8_t rex = (uint8_t)(0x40 | (encoding.wide ? 0x08 : 0) | ((reg & 8) ? 0x04 : 0) | ((rm & 8) ? 0x01 : 0));
+    if (rex != 0x40) {
+        CLOX_JIT_EMIT(as, rex);
+    }
+    if (encoding.escape != 0) {
+        CLOX_JIT_EMIT(as, encoding.escape);
+    }
+    CLOX_JIT_EMIT(as, encoding.opcode);
+    if (!memory) {
+        CLOX_JIT_EMIT(as, (uint8_t)(0xC0 | ((reg & 7) << 3) | (rm & 7)));
+        return;
+    }
+    CLOX_JIT_EMIT(as, (uint8_t)(0x80 | ((reg & 7) << 3) | (rm & 7)));
+    if ((rm & 7) == 4) {
+        CLOX_JIT_EMIT(as, 0x24); // NOTE(Al-Andrew): rsp and r12 as a base need a SIB byte
+    }
+    Clox_Jit_Emit_32(as, (uint32_t)displacement);
+}
+
+static void Clox_Jit_Emit_Store_Type(Clox_Jit_Assembler* as, uint8_t base, int32_t displacement, Clox_Value_Type type) {
+    Clox_Jit_Emit_Encoded(as, CLOX_JIT_MOV_IMM32, 0, base, true, displacement);
+    Clox_Jit_Emit_32(as, (uint32_t)type);
+}
+
+// NOTE(Al-Andrew): both tiers only do double arithmetic, an integer the interpreter made is the same number as a
+//                  double. These guards take either and leave a double, anything else still leaves native code.
+
+// NOTE(Al-Andrew): for the templates, an integer at [base + displacement] is turned into a number in place. xmm0
+//                  is scratch.
+static void Clox_Jit_Emit_Number_Guard(Clox_Jit_Assembler* as, uint8_t base, int32_t displacement, uint32_t bytecode_offset) {
+    Clox_Jit_Emit_Encoded(as, CLOX_JIT_GROUP_IMM8, 7, base, true, displacement);          // cmp dword [base + displacement], NUMBER
+    CLOX_JIT_EMIT(as, CLOX_VALUE_TYPE_NUMBER,
+                      0x74, 0x00);                                                          // je .done
+    uint32_t done = as->used - 1;
+    Clox_Jit_Emit_Encoded(as, CLOX_JIT_GROUP_IMM8, 7, base, true, displacement);          // cmp dword [base + displacement], INTEGER
+    CLOX_JIT_EMIT(as, CLOX_VALUE_TYPE_INTEGER);
+    Clox_Jit_Emit_Exit_If(as, CLOX_JIT_JNE, bytecode_offset);
+    Clox_Jit_Emit_Encoded(as, CLOX_JIT_CVTSI2SD, 0, base, true, displacement + 8);
+    Clox_Jit_Emit_Encoded(as, CLOX_JIT_MOVSD_STORE, 0, base, true, displacement + 8);
+    Clox_Jit_Emit_Store_Type(as, base, displacement, CLOX_VALUE_TYPE_NUMBER);
+    as->code[done] = (uint8_t)(as->used - done - 1);                                        // .done:
+}
+
+// NOTE(Al-Andrew): for the traces, loads [base + displacement] into `xmm` as a double and leaves the value itself
+//                  alone. Returns where the rel32 of the jne taken for anything else has to be patched.
+static uint32_t Clox_Jit_Emit_Number_Load(Clox_Jit_Assembler* as, uint8_t xmm, uint8_t base, int32_t displacement) {
+    Clox_Jit_Emit_Encoded(as, CLOX_JIT_GROUP_IMM8, 7, base, true, displacement);          // cmp dword [base + displacement], NUMBER
+    CLOX_JIT_EMIT(as, CLOX_VALUE_TYPE_NUMBER,
+                      0x75, 0x00);                                                          // jne .not_number
+    uint32_t not_number = as->used - 1;
+    Clox_Jit_Emit_Encoded(as, CLOX_JIT_MOVSD_LOAD, xmm, base, true, displacement + 8);
+    CLOX_JIT_EMIT(as, 0xEB, 0x00);                                                          // jmp .done
+    uint32_t done = as->used - 1;
+    as->code[not_number] = (uint8_t)(as->used - not_number - 1);                            // .not_number:
+    Clox_Jit_Emit_Encoded(as, CLOX_JIT_GROUP_IMM8, 7, base, true, displacement);          // cmp dword [base + displacement], INTEGER
+    CLOX_JIT_EMIT(as, CLOX_VALUE_TYPE_INTEGER,
+                      0x0F, CLOX_JIT_JNE, 0, 0, 0, 0);                                      // jne exit
+    uint32_t exit = as->used - 4;
+    Clox_Jit_Emit_Encoded(as, CLOX_JIT_CVTSI2SD, xmm, base, true, displacement + 8);
+    as->code[done] = (uint8_t)(as->used - done - 1);                                        // .done:
+    return exit;
+}
+
+// NOTE(Al-Andrew): mov rax, ip; jmp common_exit
+static void Clox_Jit_Emit_Exit(Clox_Jit_Assembler* as, uint8_t const* instruction_pointer) {
+    CLOX_JIT_EMIT(as, 0x48, 0xB8);
+    Clox_Jit_Emit_64(as, (uint64_t)(uintptr_t)instruction_pointer);
+    CLOX_JIT_EMIT(as, 0xE9);
+    Clox_Jit_Emit_32(as, 0);
+    Clox_Jit_Patch_32(as, as->used - 4, as->common_exit);
+}
+
+// NOTE(Al-Andrew): cmp dword [r12 + displacement], type; jne exit
+static void Clox_Jit_Emit_Type_Guard(Clox_Jit_Assembler* as, int8_t displacement, Clox_Value_Type type, uint32_t bytecode_offset) {
+    CLOX_JIT_EMIT(as, 0x41, 0x83, 0x7C, 0x24, (uint8_t)displacement, (uint8_t)type);
+    Clox_Jit_Emit_Exit_If(as, CLOX_JIT_JNE, bytecode_offset);
+}
+
+// NOTE(Al-Andrew): the 8 payload bytes of `value` the way the interpreter would store them
+static uint64_t Clox_Jit_Payload(Clox_Value value) {
+    uint64_t payload = 0;
+    if (value.type == CLOX_VALUE_TYPE_BOOL) {
+        payload = value.value.boolean ? 1 : 0;
+    } else if (value.type != CLOX_VALUE_TYPE_NIL) {
+        memcpy(&payload, &value.value, sizeof(payload));
+    }
+    return payload;
+}
+
+static void Clox_Jit_Emit_Push_Immediate(Clox_Jit_Assembler* as, Clox_Value value) {
+    if (CLOX_VALUE_IS_INTEGER(value)) {
+        value = CLOX_VALUE_NUMBER(Clox_Value_As_Number(value)); // NOTE(Al-Andrew): spares the guards their slow path
+    }
+    CLOX_JIT_EMIT(as, 0x41, 0xC7, 0x04, 0x24);      // mov dword [r12], type
+    Clox_Jit_Emit_32(as, (uint32_t)value.type);
+    CLOX_JIT_EMIT(as, 0x48, 0xB8);                  // mov rax, payload
+    Clox_Jit_Emit_64(as, Clox_Jit_Payload(value));
+    CLOX_JIT_EMIT(as, 0x49, 0x89, 0x44, 0x24, 0x08, // mov [r12 + 8], rax
+                      0x49, 0x83, 0xC4, 0x10);      // add r12, 16
+}
+
+// NOTE(Al-Andrew): both operands have to be numbers, anything else is left to the interpreter
+static void Clox_Jit_Emit_Number_Operands(Clox_Jit_Assembler* as, uint32_t bytecode_offset) {
+    Clox_Jit_Emit_Number_Guard(as, CLOX_JIT_R12, -32, bytecode_offset);
+    Clox_Jit_Emit_Number_Guard(as, CLOX_JIT_R12, -16, bytecode_offset);
+}
+
+// NOTE(Al-Andrew): stores al as a bool in place of the lhs and pops the rhs
+static void Clox_Jit_Emit_Bool_Result(Clox_Jit_Assembler* as) {
+    CLOX_JIT_EMIT(as, 0x0F, 0xB6, 0xC0,                                   // movzx eax, al
+                      0x49, 0x89, 0x44, 0x24, 0xE8,                       // mov [r12 - 24], rax
+                      0x41, 0xC7, 0x44, 0x24, 0xE0);                      // mov dword [r12 - 32], BOOL
+    Clox_Jit_Emit_32(as, CLOX_VALUE_TYPE_BOOL);
+    CLOX_JIT_EMIT(as, 0x49, 0x83, 0xEC, 0x10);                            // sub r12, 16
+}
+
+// NOTE(Al-Andrew): helper(vm, argument) with the stack top handed over and back, the result is left in rax
+static void Clox_Jit_Emit_Raw_Call(Clox_Jit_Assembler* as, uint64_t helper, uint64_t argument) {
+    CLOX_JIT_EMIT(as, 0x4C, 0x89, 0xA3);                                  // mov [rbx + stack_top], r12
+    Clox_Jit_Emit_32(as, (uint32_t)offsetof(Clox_VM, stack_top));
+    CLOX_JIT_EMIT(as, 0x48, 0x89, 0xDF,                                   // mov rdi, rbx
+                      0x48, 0xBE);                                        // mov rsi, argument
+    Clox_Jit_Emit_64(as, argument);
+    CLOX_JIT_EMIT(as, 0x48, 0xB8);                                        // mov rax, helper
+    Clox_Jit_Emit_64(as, helper);
+    CLOX_JIT_EMIT(as, 0xFF, 0xD0,                                         // call rax
+                      0x4C, 0x8B, 0xA3);                                  // mov r12, [rbx + stack_top]
+    Clox_Jit_Emit_32(as, (uint32_t)offsetof(Clox_VM, stack_top));
+}
+
+static void Clox_Jit_Emit_Call(Clox_Jit_Assembler* as, uint64_t helper, uint64_t argument, uint32_t bytecode_offset) {
+    Clox_Jit_Emit_Raw_Call(as, helper, argument);
+    CLOX_JIT_EMIT(as, 0x84, 0xC0);                                        // test al, al
+    Clox_Jit_Emit_Exit_If(as, CLOX_JIT_JE, bytecode_offset);
+}
+
+static void Clox_Jit_Emit_Helper_Call(Clox_Jit_Assembler* as, Clox_Jit_Helper helper, Clox_String* name, uint32_t bytecode_offset) {
+    Clox_Jit_Emit_Call(as, (uint64_t)(uintptr_t)helper, (uint64_t)(uintptr_t)name, bytecode_offset);
+}
+
+static void Clox_Jit_Emit_Property_Call(Clox_Jit_Assembler* as, Clox_Jit_Property_Helper helper, Clox_Property_Cache* cache, uint32_t bytecode_offset) {
+    Clox_Jit_Emit_Call(as, (uint64_t)(uintptr_t)helper, (uint64_t)(uintptr_t)cache, bytecode_offset);
+}
+
+// NOTE(Al-Andrew): mov rax, frame->closure->upvalues[slot].upvalue->location
+static void Clox_Jit_Emit_Upvalue_Location(Clox_Jit_Assembler* as, uint8_t slot) {
+    CLOX_JIT_EMIT(as, 0x49, 0x8B, 0x86);
+    Clox_Jit_Emit_32(as, (uint32_t)offsetof(Clox_Call_Frame, closure));
+    CLOX_JIT_EMIT(as, 0x48, 0x8B, 0x80);
+    Clox_Jit_Emit_32(as, (uint32_t)(offsetof(Clox_Closure, upvalues) + sizeof(Clox_Capture) * slot));
+    CLOX_JIT_EMIT(as, 0x48, 0x8B, 0x80);
+    Clox_Jit_Emit_32(as, (uint32_t)offsetof(Clox_UpvalueObj, location));
+}
+
+// NOTE(Al-Andrew): helpers for the opcodes that need the hash table or stdio, false hands the instruction back
+static bool Clox_Jit_Get_Global(Clox_VM* vm, Clox_String* name) {
+    Clox_Value value = {0};
+    if (!Clox_Hash_Table_Get(&vm->globals, name, &value)) {
+        return false;
+    }
+    *(vm->stack_top++) = value;
+    return true;
+}
+
+static bool Clox_Jit_Set_Global(Clox_VM* vm, Clox_String* name) {
+    Clox_Value value = {0};
+    if (!Clox_Hash_Table_Get(&vm->globals, name, &value)) {
+        return false;
+    }
+    Clox_Hash_Table_Set(&vm->globals, name, vm->stack_top[-1]);
+    Clox_VM_Note_Global_Write(vm, name);
+    return true;
+}
+
+static bool Clox_Jit_Define_Global(Clox_VM* vm, Clox_String* name) {
+    Clox_Hash_Table_Set(&vm->globals, name, *(--vm->stack_top));
+    Clox_VM_Note_Global_Write(vm, name);
+    return true;
+}
+
+static bool Clox_Jit_Print(Clox_VM* vm, Clox_String* name) {
+    (void)name;
+    Clox_Value_Print(*(--vm->stack_top));
+    printf("\n");
+    return true;
+}
+
+// NOTE(Al-Andrew): only the inline cache hits, a miss goes back to the interpreter to look the property up and
+//                  refill the cache
+static inline Clox_Instance* Clox_Jit_Cached_Instance(Clox_Value value, Clox_Property_Cache const* cache) {
+    if (!CLOX_VALUE_IS_OBJECT(value) || value.value.object->type != CLOX_OBJECT_TYPE_INSTANCE) {
+        return NULL;
+    }
+    Clox_Instance* instance = (Clox_Instance*)value.value.object;
+    return instance->shape == cache->shape ? instance : NULL;
+}
+
+static bool Clox_Jit_Get_Property(Clox_VM* vm, Clox_Property_Cache* cache) {
+    Clox_Instance* instance = Clox_Jit_Cached_Instance(vm->stack_top[-1], cache);
+    if (instance == NULL) {
+        return false;
+    }
+    if (cache->method != NULL) {
+        vm->stack_top[-1] = CLOX_VALUE_OBJECT(Clox_Bound_Method_Create(vm, vm->stack_top[-1], cache->method));
+    } else {
+        vm->stack_top[-1] = instance->fields[cache->slot];
+    }
+    return true;
+}
+
+static bool Clox_Jit_Set_Property(Clox_VM* vm, Clox_Property_Cache* cache) {
+    Clox_Instance* instance = Clox_Jit_Cached_Instance(vm->stack_top[-2], cache);
+    if (instance == NULL) {
+        return false;
+    }
+    Clox_Value value = *(--vm->stack_top);
+    if (cache->transition != NULL) {
+        Clox_Instance_Add_Field(instance, cache->transition, value);
+    } else {
+        instance->fields[cache->slot] = value;
+    }
+    vm->stack_top[-1] = value;
+    return true;
+}
+
+// NOTE(Al-Andrew): pops the value of the OP_SWITCH at `offset` in the running function, returns the entry it takes
+static uint32_t Clox_Jit_Switch(Clox_VM* vm, uint64_t offset) {
+    Clox_Chunk* chunk = &vm->frames[vm->call_frame_count - 1].closure->function->chunk;
+    Clox_Value value = *(--vm->stack_top);
+    return Clox_VM_Switch_Entry(chunk->constants.values[chunk->code[offset + 1]], chunk->code[offset + 2], value);
+}
+
+static bool Clox_Jit_Assemble(Clox_Jit_Assembler* as, Clox_Function* function, Clox_Jit_Loop_Counter* loops, uint32_t* labels, bool* resumable) {
+    Clox_Chunk* chunk = &function->chunk;
+    // NOTE(Al-Andrew): entry, called as Clox_Jit_Entry with the native address to start at
+    CLOX_JIT_EMIT(as, 0x53, 0x55, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57,    // push rbx, rbp, r12 - r15
+                      0x48, 0x83, 0xEC, 0x08,                                        // sub rsp, 8
+                      0x48, 0x89, 0xFB,                                              // mov rbx, rdi
+                      0x49, 0x89, 0xF6,                                              // mov r14, rsi
+                      0x4D, 0x8B, 0xAE);                                             // mov r13, [r14 + slots]
+    Clox_Jit_Emit_32(as, (uint32_t)offsetof(Clox_Call_Frame, slots));
+    CLOX_JIT_EMIT(as, 0x4C, 0x8B, 0xA3);                                             // mov r12, [rbx + stack_top]
+    Clox_Jit_Emit_32(as, (uint32_t)offsetof(Clox_VM, stack_top));
+    CLOX_JIT_EMIT(as, 0xFF, 0xE2);                                                   // jmp rdx
+
+    // NOTE(Al-Andrew): common exit, rax holds the instruction pointer the interpreter continues at
+    as->common_exit = as->used;
+    CLOX_JIT_EMIT(as, 0x49, 0x89, 0x86);                                             // mov [r14 + ip], rax
+    Clox_Jit_Emit_32(as, (uint32_t)offsetof(Clox_Call_Frame, instruction_pointer));
+    CLOX_JIT_EMIT(as, 0x4C, 0x89, 0xA3);                                             // mov [rbx + stack_top], r12
+    Clox_Jit_Emit_32(as, (uint32_t)offsetof(Clox_VM, stack_top));
+    CLOX_JIT_EMIT(as, 0x48, 0x83, 0xC4, 0x08,                                        // add rsp, 8
+                      0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5D, 0x5B,    // pop r15 - r12, rbp, rbx
+                      0xC3);                                                         // ret
+
+    for (uint32_t offset = 0; offset < chunk->used;) {
+        uint32_t size = Clox_Chunk_Op_Code_Size(chunk, offset);
+        if (size == 0) {
+            return false;
+        }
+        labels[offset] = as->used;
+        resumable[offset] = true;
+
+        uint8_t operand = size > 1 ? chunk->code[offset + 1] : 0;
+        uint16_t jump = size > 2 ? (uint16_t)((chunk->code[offset + 1] << 8) | chunk->code[offset + 2]) : 0;
+
+        switch ((Clox_Op_Code)chunk->code[offset]) {
+            case OP_CONSTANT: {
+                Clox_Jit_Emit_Push_Immediate(as, chunk->constants.values[operand]);
+            } break;
+            case OP_NIL: {
+                Clox_Jit_Emit_Push_Immediate(as, CLOX_VALUE_NIL);
+            } break;
+            case OP_TRUE: {
+                Clox_Jit_Emit_Push_Immediate(as, CLOX_VALUE_BOOL(true));
+            } break;
+            case OP_FALSE: {
+                Clox_Jit_Emit_Push_Immediate(as, CLOX_VALUE_BOOL(false));
+            } break;
+            case OP_GET_LOCAL: {
+                CLOX_JIT_EMIT(as, 0x41, 0x0F, 0x10, 0x85);                           // movups xmm0, [r13 + slot]
+                Clox_Jit_Emit_32(as, (uint32_t)operand * (uint32_t)sizeof(Clox_Value));
+                CLOX_JIT_EMIT(as, 0x41, 0x0F, 0x11, 0x04, 0x24,                      // movups [r12], xmm0
+                                  0x49, 0x83, 0xC4, 0x10);                           // add r12, 16
+            } break;
+            case OP_SET_LOCAL: {
+                CLOX_JIT_EMIT(as, 0x41, 0x0F, 0x10, 0x44, 0x24, 0xF0,                // movups xmm0, [r12 - 16]
+                                  0x41, 0x0F, 0x11, 0x85);                           // movups [r13 + slot], xmm0
+                Clox_Jit_Emit_32(as, (uint32_t)operand * (uint32_t)sizeof(Clox_Value));
+            } break;
+            case OP_POP: {
+                CLOX_JIT_EMIT(as, 0x49, 0x83, 0xEC, 0x10);                           // sub r12, 16
+            } break;
+            case OP_DUP: {
+                CLOX_JIT_EMIT(as, 0x41, 0x0F, 0x10, 0x44, 0x24, 0xF0,                // movups xmm0, [r12 - 16]
+                                  0x41, 0x0F, 0x11, 0x04, 0x24,                      // movups [r12], xmm0
+                                  0x49, 0x83, 0xC4, 0x10);                           // add r12, 16
+            } break;
+            case OP_GET_UPVALUE: {
+                Clox_Jit_Emit_Upvalue_Location(as, operand);
+                CLOX_JIT_EMIT(as, 0x0F, 0x10, 0x00,                                  // movups xmm0, [rax]
+                                  0x41, 0x0F, 0x11, 0x04, 0x24,                      // movups [r12], xmm0
+                                  0x49, 0x83, 0xC4, 0x10);                           // add r12, 16
+            } break;
+            case OP_GET_CAPTURE: {
+                CLOX_JIT_EMIT(as, 0x49, 0x8B, 0x86);                                 // mov rax, [r14 + closure]
+                Clox_Jit_Emit_32(as, (uint32_t)offsetof(Clox_Call_Frame, closure));
+                CLOX_JIT_EMIT(as, 0x0F, 0x10, 0x80);                                 // movups xmm0, [rax + capture]
+                Clox_Jit_Emit_32(as, (uint32_t)(offsetof(Clox_Closure, upvalues) + sizeof(Clox_Capture) * operand));
+                CLOX_JIT_EMIT(as, 0x41, 0x0F, 0x11, 0x04, 0x24,                      // movups [r12], xmm0
+                                  0x49, 0x83, 0xC4, 0x10);                           // add r12, 16
+            } break;
+            case OP_SET_UPVALUE: {
+                Clox_Jit_Emit_Upvalue_Location(as, operand);
+                CLOX_JIT_EMIT(as, 0x41, 0x0F, 0x10, 0x44, 0x24, 0xF0,                // movups xmm0, [r12 - 16]
+                                  0x0F, 0x11, 0x00);                                 // movups [rax], xmm0
+            } break;
+            case OP_ADD: /* fallthrough */
+            case OP_SUB: /* fallthrough */
+            case OP_MUL: /* fallthrough */
+            case OP_DIV: {
+                Clox_Op_Code op = (Clox_Op_Code)chunk->code[offset];
+                uint8_t instruction = op == OP_ADD ? 0x58 : op == OP_SUB ? 0x5C : op == OP_MUL ? 0x59 : 0x5E;
+                Clox_Jit_Emit_Number_Operands(as, offset);
+                CLOX_JIT_EMIT(as, 0xF2, 0x41, 0x0F, 0x10, 0x44, 0x24, 0xE8,          // movsd xmm0, [r12 - 24]
+                                  0xF2, 0x41, 0x0F, instruction, 0x44, 0x24, 0xF8,   // op xmm0, [r12 - 8]
+                                  0xF2, 0x41, 0x0F, 0x11, 0x44, 0x24, 0xE8,          // movsd [r12 - 24], xmm0
+                                  0x49, 0x83, 0xEC, 0x10);                           // sub r12, 16
+            } break;
+            case OP_GREATER: {
+                Clox_Jit_Emit_Number_Operands(as, offset);
+                CLOX_JIT_EMIT(as, 0xF2, 0x41, 0x0F, 0x10, 0x44, 0x24, 0xE8,          // movsd xmm0, [r12 - 24]
+                                  0x66, 0x41, 0x0F, 0x2E, 0x44, 0x24, 0xF8);         // ucomisd xmm0, [r12 - 8]
+                CLOX_JIT_EMIT(as, 0x0F, 0x97, 0xC0);                                 // seta al, false for NaN
+                Clox_Jit_Emit_Bool_Result(as);
+            } break;
+            case OP_LESS: {
+                Clox_Jit_Emit_Number_Operands(as, offset);
+                CLOX_JIT_EMIT(as, 0xF2, 0x41, 0x0F, 0x10, 0x44, 0x24, 0xF8,          // movsd xmm0, [r12 - 8]
+                                  0x66, 0x41, 0x0F, 0x2E, 0x44, 0x24, 0xE8);         // ucomisd xmm0, [r12 - 24]
+                CLOX_JIT_EMIT(as, 0x0F, 0x97, 0xC0);                                 // seta al, rhs > lhs
+                Clox_Jit_Emit_Bool_Result(as);
+            } break;
+            case OP_EQUAL: {
+                Clox_Jit_Emit_Number_Operands(as, offset);
+                CLOX_JIT_EMIT(as, 0xF2, 0x41, 0x0F, 0x10, 0x44, 0x24, 0xE8,          // movsd xmm0, [r12 - 24]
+                                  0x66, 0x41, 0x0F, 0x2E, 0x44, 0x24, 0xF8,          // ucomisd xmm0, [r12 - 8]
+                                  0x0F, 0x9B, 0xC1);                                 // setnp cl
+                CLOX_JIT_EMIT(as, 0x0F, 0x94, 0xC0,                                  // sete al
+                                  0x20, 0xC8);                                       // and al, cl
+                Clox_Jit_Emit_Bool_Result(as);
+            } break;
+            case OP_ARITHMETIC_NEGATION: {
+                Clox_Jit_Emit_Number_Guard(as, CLOX_JIT_R12, -16, offset);
+                CLOX_JIT_EMIT(as, 0x48, 0xB8);                                       // mov rax, sign bit
+                Clox_Jit_Emit_64(as, UINT64_C(0x8000000000000000));
+                CLOX_JIT_EMIT(as, 0x49, 0x31, 0x44, 0x24, 0xF8);                     // xor [r12 - 8], rax
+            } break;
+            case OP_BOOLEAN_NEGATION: {
+                CLOX_JIT_EMIT(as, 0x41, 0x83, 0x7C, 0x24, 0xF0, CLOX_VALUE_TYPE_BOOL, // cmp dword [r12 - 16], BOOL
+                                  0x75, 0x08,                                        // jne .not_bool
+                                  0x41, 0x80, 0x74, 0x24, 0xF8, 0x01,                // xor byte [r12 - 8], 1
+                                  0xEB, 0x1B);                                       // jmp .done
+                Clox_Jit_Emit_Type_Guard(as, -16, CLOX_VALUE_TYPE_NIL, offset);      // .not_bool:
+                CLOX_JIT_EMIT(as, 0x41, 0xC7, 0x44, 0x24, 0xF0);                     // mov dword [r12 - 16], BOOL
+                Clox_Jit_Emit_32(as, CLOX_VALUE_TYPE_BOOL);
+                CLOX_JIT_EMIT(as, 0x41, 0xC6, 0x44, 0x24, 0xF8, 0x01);               // mov byte [r12 - 8], 1
+            } break;                                                                 // .done:
+            case OP_JUMP: {
+                CLOX_JIT_EMIT(as, 0xE9, 0, 0, 0, 0);
+                Clox_Jit_Add_Fixup(as, CLOX_JIT_FIXUP_JUMP, offset + 3 + jump);
+            } break;
+            case OP_SWITCH: {
+                // NOTE(Al-Andrew): the table follows right after, each of its OP_JUMPs is a 5 byte jmp rel32
+                Clox_Jit_Emit_Raw_Call(as, (uint64_t)(uintptr_t)Clox_Jit_Switch, offset);
+                CLOX_JIT_EMIT(as, 0x8D, 0x04, 0x80,                                  // lea eax, [rax + rax * 4]
+                                  0x48, 0x8D, 0x15, 0x05, 0x00, 0x00, 0x00,          // lea rdx, [rip + 5]
+                                  0x48, 0x01, 0xC2,                                  // add rdx, rax
+                                  0xFF, 0xE2);                                       // jmp rdx
+            } break;
+            case OP_LOOP: {
+                // NOTE(Al-Andrew): once the header is hot the interpreter takes the jump, it records and runs traces
+                CLOX_JIT_EMIT(as, 0x48, 0xB8);                                       // mov rax, &hotness
+                Clox_Jit_Emit_64(as, (uint64_t)(uintptr_t)&loops[offset + 3 - jump].hotness);
+                CLOX_JIT_EMIT(as, 0x83, 0x28, 0x01);                                 // sub dword [rax], 1
+                Clox_Jit_Emit_Exit_If(as, CLOX_JIT_JLE, offset);
+                CLOX_JIT_EMIT(as, 0xE9, 0, 0, 0, 0);
+                Clox_Jit_Add_Fixup(as, CLOX_JIT_FIXUP_JUMP, offset + 3 - jump);
+                resumable[offset] = false;
+            } break;
+            case OP_FOR_LOOP: {
+                // NOTE(Al-Andrew): the compiler only proved the three slots numbers for the interpreter, the
+                //                  guards are cheap next to the loads and keep the template honest on its own. A
+                //                  counter that started out an integer is a double from the first pass on.
+                uint16_t back = (uint16_t)((chunk->code[offset + 2] << 8) | chunk->code[offset + 3]);
+                uint32_t header = offset + 4 - back;
+                uint32_t counter = (uint32_t)operand * (uint32_t)sizeof(Clox_Value);
+                CLOX_JIT_EMIT(as, 0x48, 0xB8);                                       // mov rax, &hotness
+                Clox_Jit_Emit_64(as, (uint64_t)(uintptr_t)&loops[header].hotness);
+                CLOX_JIT_EMIT(as, 0x83, 0x28, 0x01);                                 // sub dword [rax], 1
+                Clox_Jit_Emit_Exit_If(as, CLOX_JIT_JLE, offset);
+                for (uint32_t i = 0; i < 3; ++i) {
+                    Clox_Jit_Emit_Number_Guard(as, CLOX_JIT_R13, (int32_t)(counter + i * (uint32_t)sizeof(Clox_Value)), offset);
+                }
+                CLOX_JIT_EMIT(as, 0xF2, 0x41, 0x0F, 0x10, 0x85);                     // movsd xmm0, [r13 + counter]
+                Clox_Jit_Emit_32(as, counter + 8);
+                CLOX_JIT_EMIT(as, 0xF2, 0x41, 0x0F, 0x58, 0x85);                     // addsd xmm0, [r13 + step]
+                Clox_Jit_Emit_32(as, counter + 2 * (uint32_t)sizeof(Clox_Value) + 8);
+                CLOX_JIT_EMIT(as, 0xF2, 0x41, 0x0F, 0x11, 0x85);                     // movsd [r13 + counter], xmm0
+                Clox_Jit_Emit_32(as, counter + 8);
+                CLOX_JIT_EMIT(as, 0xF2, 0x41, 0x0F, 0x10, 0x8D);                     // movsd xmm1, [r13 + bound]
+                Clox_Jit_Emit_32(as, counter + (uint32_t)sizeof(Clox_Value) + 8);
+                CLOX_JIT_EMIT(as, 0x66, 0x0F, 0x2E, 0xC8,                            // ucomisd xmm1, xmm0
+                                  0x0F, 0x87, 0, 0, 0, 0);                           // ja header, false for NaN
+                Clox_Jit_Add_Fixup(as, CLOX_JIT_FIXUP_JUMP, header);
+                resumable[offset] = false;
+            } break;
+            case OP_JUMP_IF_FALSE: {
+                CLOX_JIT_EMIT(as, 0x41, 0x8B, 0x44, 0x24, 0xF0,                      // mov eax, [r12 - 16]
+                                  0x85, 0xC0,                                        // test eax, eax (NIL)
+                                  0x0F, 0x84, 0, 0, 0, 0);                           // je target
+                Clox_Jit_Add_Fixup(as, CLOX_JIT_FIXUP_JUMP, offset + 3 + jump);
+                CLOX_JIT_EMIT(as, 0x83, 0xF8, CLOX_VALUE_TYPE_BOOL,                  // cmp eax, BOOL
+                                  0x75, 0x0C,                                        // jne .truthy
+                                  0x41, 0x80, 0x7C, 0x24, 0xF8, 0x00,                // cmp byte [r12 - 8], 0
+                                  0x0F, 0x84, 0, 0, 0, 0);                           // je target
+                Clox_Jit_Add_Fixup(as, CLOX_JIT_FIXUP_JUMP, offset + 3 + jump);
+            } break;                                                                 // .truthy:
+            case OP_GET_GLOBAL: {
+                Clox_Jit_Emit_Helper_Call(as, Clox_Jit_Get_Global, (Clox_String*)chunk->constants.values[operand].value.object, offset);
+            } break;
+            case OP_SET_GLOBAL: {
+                Clox_Jit_Emit_Helper_Call(as, Clox_Jit_Set_Global, (Clox_String*)chunk->constants.values[operand].value.object, offset);
+            } break;
+            case OP_DEFINE_GLOBAL: {
+                Clox_Jit_Emit_Helper_Call(as, Clox_Jit_Define_Global, (Clox_String*)chunk->constants.values[operand].value.object, offset);
+            } break;
+            case OP_PRINT: {
+                Clox_Jit_Emit_Helper_Call(as, Clox_Jit_Print, NULL, offset);
+            } break;
+            case OP_GET_PROPERTY: {
+                Clox_Jit_Emit_Property_Call(as, Clox_Jit_Get_Property, Clox_Property_Cache_At(function, offset), offset);
+            } break;
+            case OP_SET_PROPERTY: {
+                Clox_Jit_Emit_Property_Call(as, Clox_Jit_Set_Property, Clox_Property_Cache_At(function, offset), offset);
+            } break;
+            case OP_CALL: /* fallthrough */
+            case OP_CALL_0: /* fallthrough */
+            case OP_CALL_1: /* fallthrough */
+            case OP_CALL_2: /* fallthrough */
+            case OP_CALL_3: /* fallthrough */
+            case OP_LIST: /* fallthrough */
+            case OP_MAP: /* fallthrough */
+            case OP_INDEX_GET: /* fallthrough */
+            case OP_INDEX_SET: /* fallthrough */
+            case OP_CLASS: /* fallthrough */
+            case OP_INHERIT: /* fallthrough */
+            case OP_METHOD: /* fallthrough */
+            case OP_GET_SUPER: /* fallthrough */
+            case OP_INVOKE: /* fallthrough */
+            case OP_SUPER_INVOKE: /* fallthrough */
+            case OP_INTRINSIC: /* fallthrough */
+            case OP_RETURN: /* fallthrough */
+            case OP_CLOSURE: /* fallthrough */
+            case OP_STACK_CLOSURE: /* fallthrough */
+            case OP_POP_STACK_CLOSURE: /* fallthrough */
+            case OP_CLOSE_UPVALUE: {
+                // NOTE(Al-Andrew): these switch frames, allocate or reach into objects and their caches, the interpreter does them
+                Clox_Jit_Emit_Exit(as, chunk->code + offset);
+                resumable[offset] = false;
+            } break;
+        }
+        offset += size;
+    }
+
+    uint32_t* exit_stubs = reallocate(NULL, 0, sizeof(uint32_t) * chunk->used);
+    for (uint32_t i = 0; i < chunk->used; ++i) {
+        exit_stubs[i] = CLOX_JIT_NO_ENTRY;
+    }
+
+    bool assembled = true;
+    for (uint32_t i = 0; i < as->fixup_count; ++i) {
+        Clox_Jit_Fixup fixup = as->fixups[i];
+        if (fixup.bytecode_offset >= chunk->used || labels[fixup.bytecode_offset] == CLOX_JIT_NO_ENTRY) {
+            assembled = false;
+            break;
+        }
+
+        if (fixup.kind == CLOX_JIT_FIXUP_JUMP) {
+            Clox_Jit_Patch_32(as, fixup.at, labels[fixup.bytecode_offset]);
+            continue;
+        }
+        if (exit_stubs[fixup.bytecode_offset] == CLOX_JIT_NO_ENTRY) {
+            exit_stubs[fixup.bytecode_offset] = as->used;
+            Clox_Jit_Emit_Exit(as, chunk->code + fixup.bytecode_offset);
+        }
+        Clox_Jit_Patch_32(as, fixup.at, exit_stubs[fixup.bytecode_offset]);
+    }
+
+    deallocate(exit_stubs);
+    return assembled;
+}
+
+// NOTE(Al-Andrew): copies the assembled code into its own pages, written while writable then flipped to
+//                  executable, never both at once
+static uint8_t* Clox_Jit_Map(Clox_Jit_Assembler* as, size_t* mapping_size) {
+    long page_size = sysconf(_SC_PAGESIZE);
+    size_t page = page_size > 0 ? (size_t)page_size : 4096;
+    size_t size = ((size_t)as->used + page - 1) / page * page;
+
+    void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        return NULL;
+    }
+    memcpy(mapping, as->code, as->used);
+    if (mprotect(mapping, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(mapping, size);
+        return NULL;
+    }
+    *mapping_size = size;
+    return mapping;
+}
+
+static void Clox_Jit_Assembler_Free(Clox_Jit_Assembler* as) {
+    if (as->code != NULL) {
+        deallocate(as->code);
+    }
+    if (as->fixups != NULL) {
+        deallocate(as->fixups);
+    }
+}
+
+static Clox_Jit_Code* Clox_Jit_Compile(Clox_Function* function) {
+    Clox_Jit_Code* jit = reallocate(NULL, 0, sizeof(Clox_Jit_Code));
+    *jit = (Clox_Jit_Code){0};
+
+    Clox_Chunk* chunk = &function->chunk;
+    jit->loops = reallocate(NULL, 0, sizeof(Clox_Jit_Loop_Counter) * (chunk->used + 1));
+    for (uint32_t i = 0; i <= chunk->used; ++i) {
+        jit->loops[i] = (Clox_Jit_Loop_Counter){.hotness = CLOX_JIT_HOT_LOOP};
+    }
+
+    Clox_Jit_Assembler as = {0};
+    uint32_t* labels = reallocate(NULL, 0, sizeof(uint32_t) * (chunk->used + 1));
+    bool* resumable = reallocate(NULL, 0, sizeof(bool) * (chunk->used + 1));
+    for (uint32_t i = 0; i <= chunk->used; ++i) {
+        labels[i] = CLOX_JIT_NO_ENTRY;
+        resumable[i] = false;
+    }
+
+    if (Clox_Jit_Assemble(&as, function, jit->loops, labels, resumable)) {
+        jit->code = Clox_Jit_Map(&as, &jit->mapping_size);
+    }
+
+    if (jit->code != NULL) {
+        jit->entries = labels;
+        for (uint32_t i = 0; i < chunk->used; ++i) {
+            jit->entries[i] = resumable[i] ? labels[i] : CLOX_JIT_NO_ENTRY;
+        }
+    } else {
+        deallocate(labels);
+    }
+
+    deallocate(resumable);
+    Clox_Jit_Assembler_Free(&as);
+    return jit;
+}
+
+void Clox_Jit_Enter(Clox_VM* vm, Clox_Call_Frame* frame) {
+    Clox_Function* function = frame->closure->function;
+    if (function->jit == NULL) {
+        function->jit = Clox_Jit_Compile(function);
+    }
+
+    Clox_Jit_Code* jit = function->jit;
+    uint32_t offset = (uint32_t)(frame->instruction_pointer - function->chunk.code);
+    if (jit->code == NULL || offset >= function->chunk.used || jit->entries[offset] == CLOX_JIT_NO_ENTRY) {
+        return;
+    }
+
+    // NOTE(Al-Andrew): ISO C has no cast from object to function pointers, copying the bits is the portable spelling
+    Clox_Jit_Entry entry;
+    void* code = jit->code;
+    memcpy(&entry, &code, sizeof(entry));
+    entry(vm, frame, jit->code + jit->entries[offset]);
+}
+
+// NOTE(Al-Andrew): tracing tier ------------------------------------------------------------------------------------
+
+typedef uint32_t (*Clox_Jit_Trace_Entry)(Clox_VM* vm, Clox_Call_Frame* frame, Clox_Value** variables);
+
+typedef struct {
+    uint32_t offset;
+    Clox_Op_Code op;
+    uint8_t operand;
+    uint8_t variable;     // NOTE(Al-Andrew): index into the variables for the opcodes touching one
+    Clox_Value_Type type; // NOTE(Al-Andrew): observed type of the value read or stored
+    bool truthy;          // NOTE(Al-Andrew): observed condition of OP_JUMP_IF_FALSE
+    Clox_Shape* shape;    // NOTE(Al-Andrew): observed receiver shape of the property opcodes
+    uint32_t slot;        // NOTE(Al-Andrew): where instances of that shape keep the field
+    uint8_t bound;        // NOTE(Al-Andrew): variables of OP_FOR_LOOP's bound and step, `variable` is its counter
+    uint8_t increment;
+} Clox_Jit_Step;
+
+struct Clox_Jit_Recorder {
+    Clox_Call_Frame* frame;
+    Clox_Closure* closure;
+    uint32_t header;
+    uint32_t base;
+    Clox_Jit_Step steps[CLOX_JIT_TRACE_MAX_STEPS];
+    uint32_t step_count;
+    Clox_Jit_Variable variables[CLOX_JIT_TRACE_MAX_VARIABLES];
+    uint32_t variable_count;
+    uint32_t intrinsics;
+};
+
+typedef enum {
+    CLOX_JIT_SLOT_CONSTANT,
+    CLOX_JIT_SLOT_NUMBER,   // NOTE(Al-Andrew): unboxed, slot i lives in xmm i
+    CLOX_JIT_SLOT_BOXED,    // NOTE(Al-Andrew): already stored on the value stack, its type guarded
+    CLOX_JIT_SLOT_FLAGS,    // NOTE(Al-Andrew): result of a comparison still in the cpu flags, only ever on top
+} Clox_Jit_Slot_Kind;
+
+typedef struct {
+    Clox_Jit_Slot_Kind kind;
+    Clox_Value_Type type;
+    Clox_Value constant;
+    uint8_t condition; // NOTE(Al-Andrew): jcc byte taken when a FLAGS slot is true
+} Clox_Jit_Slot;
+
+#define CLOX_JIT_SLOT(index) ((int32_t)((index) * sizeof(Clox_Value)))
+
+// NOTE(Al-Andrew): everything needed to rebuild the interpreter's stack when a guard fails
+typedef struct {
+    uint32_t at;
+    uint32_t offset;
+    uint32_t depth;
+    Clox_Jit_Slot stack[CLOX_JIT_TRACE_MAX_DEPTH];
+} Clox_Jit_Exit;
+
+typedef struct {
+    Clox_Jit_Assembler as;
+    Clox_Jit_Trace* trace;
+    Clox_Jit_Slot stack[CLOX_JIT_TRACE_MAX_DEPTH];
+    uint32_t depth;
+    Clox_Jit_Exit* exits;
+    uint32_t exit_count;
+} Clox_Jit_Trace_Compiler;
+
+static bool Clox_Jit_Trace_Push(Clox_Jit_Trace_Compiler* compiler, Clox_Jit_Slot slot) {
+    if (compiler->depth == CLOX_JIT_TRACE_MAX_DEPTH) {
+        return false;
+    }
+    compiler->stack[compiler->depth++] = slot;
+    return true;
+}
+
+static Clox_Jit_Slot Clox_Jit_Trace_Constant(Clox_Value value) {
+    return (Clox_Jit_Slot){.kind = CLOX_JIT_SLOT_CONSTANT, .type = value.type, .constant = value};
+}
+
+// NOTE(Al-Andrew): `at` is the rel32 of a jump already emitted
+static void Clox_Jit_Trace_Exit_At(Clox_Jit_Trace_Compiler* compiler, uint32_t at, uint32_t offset) {
+    Clox_Jit_Exit* exit = &compiler->exits[compiler->exit_count++];
+    exit->at = at;
+    exit->offset = offset;
+    exit->depth = compiler->depth;
+    memcpy(exit->stack, compiler->stack, sizeof(exit->stack));
+}
+
+static void Clox_Jit_Trace_Exit_If(Clox_Jit_Trace_Compiler* compiler, uint8_t condition, uint32_t offset) {
+    Clox_Jit_Assembler* as = &compiler->as;
+    CLOX_JIT_EMIT(as, 0x0F, condition, 0, 0, 0, 0);
+    Clox_Jit_Trace_Exit_At(compiler, as->used - 4, offset);
+}
+
+// NOTE(Al-Andrew): boxes slot `index` into [base + displacement], rcx and rdx are scratch
+static void Clox_Jit_Trace_Store(Clox_Jit_Trace_Compiler* compiler, uint32_t index, uint8_t base, int32_t displacement) {
+    Clox_Jit_Assembler* as = &compiler->as;
+    Clox_Jit_Slot slot = compiler->stack[index];
+    switch (slot.kind) {
+        case CLOX_JIT_SLOT_CONSTANT: {
+            Clox_Jit_Emit_Store_Type(as, base, displacement, slot.type);
+            CLOX_JIT_EMIT(as, 0x48, 0xB9);                                                   // mov rcx, payload
+            Clox_Jit_Emit_64(as, Clox_Jit_Payload(slot.constant));
+            Clox_Jit_Emit_Encoded(as, CLOX_JIT_MOV_STORE, CLOX_JIT_RCX, base, true, displacement + 8);
+        } break;
+        case CLOX_JIT_SLOT_NUMBER: {
+            Clox_Jit_Emit_Store_Type(as, base, displacement, CLOX_VALUE_TYPE_NUMBER);
+            Clox_Jit_Emit_Encoded(as, CLOX_JIT_MOVSD_STORE, (uint8_t)index, base, true, displacement + 8);
+        } break;
+        case CLOX_JIT_SLOT_BOXED: {
+            if (base == CLOX_JIT_R12 && displacement == CLOX_JIT_SLOT(index)) {
+                break;
+            }
+            Clox_Jit_Emit_Encoded(as, CLOX_JIT_MOV_LOAD, CLOX_JIT_RCX, CLOX_JIT_R12, true, CLOX_JIT_SLOT(index));
+            Clox_Jit_Emit_Encoded(as, CLOX_JIT_MOV_LOAD, CLOX_JIT_RDX, CLOX_JIT_R12, true, CLOX_JIT_SLOT(index) + 8);
+            Clox_Jit_Emit_Encoded(as, CLOX_JIT_MOV_STORE, CLOX_JIT_RCX, base, true, displacement);
+            Clox_Jit_Emit_Encoded(as, CLOX_JIT_MOV_STORE, CLOX_JIT_RDX, base, true, displacement + 8);
+        } break;
+        case CLOX_JIT_SLOT_FLAGS: {
+            CLOX_UNREACHABLE(); // NOTE(Al-Andrew): settled before anything but a jump or a not sees them
+        } break;
+    }
+}
+
+static void Clox_Jit_Trace_Load_Number(Clox_Jit_Trace_Compiler* compiler, uint8_t xmm, uint32_t index) {
+    Clox_Jit_Assembler* as = &compiler->as;
+    Clox_Jit_Slot slot = compiler->stack[index];
+    switch (slot.kind) {
+        case CLOX_JIT_SLOT_CONSTANT: {
+            CLOX_JIT_EMIT(as, 0x48, 0xB8);                                                   // mov rax, bits
+            Clox_Jit_Emit_64(as, Clox_Jit_Payload(slot.constant));
+            Clox_Jit_Emit_Encoded(as, CLOX_JIT_MOVQ_TO, xmm, CLOX_JIT_RAX, false, 0);
+        } break;
+        case CLOX_JIT_SLOT_NUMBER: {
+            if (xmm != index) {
+                Clox_Jit_Emit_Encoded(as, CLOX_JIT_MOVSD_LOAD, xmm, (uint8_t)index, false, 0);
+            }
+        } break;
+        case CLOX_JIT_SLOT_BOXED: {
+            Clox_Jit_Emit_Encoded(as, CLOX_JIT_MOVSD_LOAD, xmm, CLOX_JIT_R12, true, CLOX_JIT_SLOT(index) + 8);
+        } break;
+        case CLOX_JIT_SLOT_FLAGS: {
+            CLOX_UNREACHABLE();
+        } break;
+    }
+}
+
+static void Clox_Jit_Trace_Copy(Clox_Jit_Trace_Compiler* compiler, uint32_t from, uint32_t to) {
+    if (from == to) {
+        return;
+    }
+    Clox_Jit_Slot slot = compiler->stack[from];
+    if (slot.kind == CLOX_JIT_SLOT_NUMBER) {
+        Clox_Jit_Emit_Encoded(&compiler->as, CLOX_JIT_MOVSD_LOAD, (uint8_t)to, (uint8_t)from, false, 0);
+    } else if (slot.kind == CLOX_JIT_SLOT_BOXED) {
+        Clox_Jit_Trace_Store(compiler, from, CLOX_JIT_R12, CLOX_JIT_SLOT(to));
+    }
+    compiler->stack[to] = slot;
+}
+
+// NOTE(Al-Andrew): stores a pending comparison as a real bool, anything but a jump or a not clobbers the flags
+static void Clox_Jit_Trace_Settle_Flags(Clox_Jit_Trace_Compiler* compiler) {
+    if (compiler->depth == 0 || compiler->stack[compiler->depth - 1].kind != CLOX_JIT_SLOT_FLAGS) {
+        return;
+    }
+    Clox_Jit_Assembler* as = &compiler->as;
+    uint32_t top = compiler->depth - 1;
+    CLOX_JIT_EMIT(as, 0x0F, (uint8_t)(compiler->stack[top].condition + 0x10), 0xC0,        // setcc al
+                      0x0F, 0xB6, 0xC0);                                                     // movzx eax, al
+    Clox_Jit_Emit_Store_Type(as, CLOX_JIT_R12, CLOX_JIT_SLOT(top), CLOX_VALUE_TYPE_BOOL);
+    Clox_Jit_Emit_Encoded(as, CLOX_JIT_MOV_STORE, CLOX_JIT_RAX, CLOX_JIT_R12, true, CLOX_JIT_SLOT(top) + 8);
+    compiler->stack[top] = (Clox_Jit_Slot){.kind = CLOX_JIT_SLOT_BOXED, .type = CLOX_VALUE_TYPE_BOOL};
+}
+
+// NOTE(Al-Andrew): mov rax, variables[variable]
+static void Clox_Jit_Trace_Variable_Address(Clox_Jit_Trace_Compiler* compiler, uint8_t variable) {
+    Clox_Jit_Emit_Encoded(&compiler->as, CLOX_JIT_MOV_LOAD, CLOX_JIT_RAX, CLOX_JIT_R15, true, (int32_t)(sizeof(Clox_Value*) * variable));
+}
+
+static bool Clox_Jit_Trace_Get_Variable(Clox_Jit_Trace_Compiler* compiler, Clox_Jit_Step const* step) {
+    Clox_Jit_Assembler* as = &compiler->as;
+    Clox_Jit_Variable const* variable = &compiler->trace->variables[step->variable];
+    uint8_t top = (uint8_t)compiler->depth;
+    if (variable->promoted >= 0) {
+        if (!Clox_Jit_Trace_Push(compiler, (Clox_Jit_Slot){.kind = CLOX_JIT_SLOT_NUMBER, .type = CLOX_VALUE_TYPE_NUMBER})) {
+            return false;
+        }
+        Clox_Jit_Emit_Encoded(as, CLOX_JIT_MOVSD_LOAD, top, (uint8_t)(8 + variable->promoted), false, 0);
+        return true;
+    }
+
+    Clox_Jit_Trace_Variable_Address(compiler, step->variable);
+    if (step->type == CLOX_VALUE_TYPE_NUMBER) {
+        if (top == CLOX_JIT_TRACE_MAX_DEPTH) {
+            return false;
+        }
+        Clox_Jit_Trace_Exit_At(compiler, Clox_Jit_Emit_Number_Load(as, top, CLOX_JIT_RAX, 0), step->offset);
+        return Clox_Jit_Trace_Push(compiler, (Clox_Jit_Slot){.kind = CLOX_JIT_SLOT_NUMBER, .type = CLOX_VALUE_TYPE_NUMBER});
+    }
+    Clox_Jit_Emit_Encoded(as, CLOX_JIT_GROUP_IMM8, 7, CLOX_JIT_RAX, true, 0);              // cmp dword [rax], type
+    CLOX_JIT_EMIT(as, (uint8_t)step->type);
+    Clox_Jit_Trace_Exit_If(compiler, CLOX_JIT_JNE, step->offset);
+    if (!Clox_Jit_Trace_Push(compiler, (Clox_Jit_Slot){.kind = CLOX_JIT_SLOT_BOXED, .type = step->type})) {
+        return false;
+    }
+    Clox_Jit_Emit_Encoded(as, CLOX_JIT_MOV_LOAD, CLOX_JIT_RCX, CLOX_JIT_RAX, true, 0);
+    Clox_Jit_Emit_Encoded(as, CLOX_JIT_MOV_LOAD, CLOX_JIT_RDX, CLOX_JIT_RAX, true, 8);
+    Clox_Jit_Emit_Encoded(as, CLOX_JIT_MOV_STORE, CLOX_JIT_RCX, CLOX_JIT_R12, true, CLOX_JIT_SLOT(top));
+    Clox_Jit_Emit_Encoded(as, CLOX_JIT_MOV_STORE, CLOX_JIT_RDX, CLOX_JIT_R12, true, CLOX_JIT_SLOT(top) + 8);
+    return true;
+}
+
+static bool Clox_Jit_Trace_Set_Variable(Clox_Jit_Trace_Compiler* compiler, Clox_Jit_Step const* step) {
+    Clox_Jit_Variable const* variable = &compiler->trace->variables[step->variable];
+    if (compiler->depth == 0) {
+        return false;
+    }
+    uint32_t top = compiler->depth - 1;
+    if (variable->promoted >= 0) {
+        if (compiler->stack[top].type != CLOX_VALUE_TYPE_NUMBER) {
+            return false;
+        }
+        Clox_Jit_Trace_Load_Number(compiler, (uint8_t)(8 + variable->promoted), top);
+        return true;
+    }
+    Clox_Jit_Trace_Variable_Address(compiler, step->variable);
+    Clox_Jit_Trace_Store(compiler, top, CLOX_JIT_RAX, 0);
+    return true;
+}
+
+static bool Clox_Jit_Trace_Arithmetic(Clox_Jit_Trace_Compiler* compiler, Clox_Op_Code op) {
+    if (compiler->depth < 2) {
+        return false;
+    }
+    uint32_t lhs = compiler->depth - 2;
+    uint32_t rhs = compiler->depth - 1;
+    Clox_Jit_Slot a = compiler->stack[lhs];
+    Clox_Jit_Slot b = compiler->stack[rhs];
+    if (a.type != CLOX_VALUE_TYPE_NUMBER || b.type != CLOX_VALUE_TYPE_NUMBER) {
+        return false;
+    }
+    compiler->depth--;
+
+    if (a.kind == CLOX_JIT_SLOT_CONSTANT && b.kind == CLOX_JIT_SLOT_CONSTANT) {
+        double x = a.constant.value.number;
+        double y = b.constant.value.number;
+        double result = op == OP_ADD ? x + y : op == OP_SUB ? x - y : op == OP_MUL ? x * y : x / y;
+        compiler->stack[lhs] = Clox_Jit_Trace_Constant(CLOX_VALUE_NUMBER(result));
+        return true;
+    }
+
+    Clox_Jit_Encoding encoding = op == OP_ADD ? CLOX_JIT_ADDSD : op == OP_SUB ? CLOX_JIT_SUBSD : op == OP_MUL ? CLOX_JIT_MULSD : CLOX_JIT_DIVSD;
+    Clox_Jit_Trace_Load_Number(compiler, (uint8_t)lhs, lhs);
+    Clox_Jit_Trace_Load_Number(compiler, (uint8_t)rhs, rhs);
+    Clox_Jit_Emit_Encoded(&compiler->as, encoding, (uint8_t)lhs, (uint8_t)rhs, false, 0);
+    compiler->stack[lhs] = (Clox_Jit_Slot){.kind = CLOX_JIT_SLOT_NUMBER, .type = CLOX_VALUE_TYPE_NUMBER};
+    return true;
+}
+
+static bool Clox_Jit_Trace_Compare(Clox_Jit_Trace_Compiler* compiler, Clox_Op_Code op) {
+    if (compiler->depth < 2) {
+        return false;
+    }
+    Clox_Jit_Assembler* as = &compiler->as;
+    uint32_t lhs = compiler->depth - 2;
+    uint32_t rhs = compiler->depth - 1;
+    Clox_Jit_Slot a = compiler->stack[lhs];
+    Clox_Jit_Slot b = compiler->stack[rhs];
+    if (a.type != CLOX_VALUE_TYPE_NUMBER || b.type != CLOX_VALUE_TYPE_NUMBER) {
+        return false;
+    }
+    compiler->depth--;
+
+    if (a.kind == CLOX_JIT_SLOT_CONSTANT && b.kind == CLOX_JIT_SLOT_CONSTANT) {
+        double x = a.constant.value.number;
+        double y = b.constant.value.number;
+        bool result = op == OP_LESS ? x < y : op == OP_GREATER ? x > y : x == y;
+        compiler->stack[lhs] = Clox_Jit_Trace_Constant(CLOX_VALUE_BOOL(result));
+        return true;
+    }
+
+    Clox_Jit_Trace_Load_Number(compiler, (uint8_t)lhs, lhs);
+    Clox_Jit_Trace_Load_Number(compiler, (uint8_t)rhs, rhs);
+    uint8_t condition = CLOX_JIT_JA; // NOTE(Al-Andrew): unordered sets CF, so NaN compares false like in C
+    if (op == OP_LESS) {
+        Clox_Jit_Emit_Encoded(as, CLOX_JIT_UCOMISD, (uint8_t)rhs, (uint8_t)lhs, false, 0);
+    } else {
+        Clox_Jit_Emit_Encoded(as, CLOX_JIT_UCOMISD, (uint8_t)lhs, (uint8_t)rhs, false, 0);
+    }
+    if (op == OP_EQUAL) {
+        CLOX_JIT_EMIT(as, 0x0F, 0x9B, 0xC1,                                                  // setnp cl
+                          0x0F, 0x94, 0xC0,                                                  // sete al
+                          0x20, 0xC8,                                                        // and al, cl
+                          0x84, 0xC0);                                                       // test al, al
+        condition = CLOX_JIT_JNE;
+    }
+    compiler->stack[lhs] = (Clox_Jit_Slot){.kind = CLOX_JIT_SLOT_FLAGS, .type = CLOX_VALUE_TYPE_BOOL, .condition = condition};
+    return true;
+}
+
+static bool Clox_Jit_Trace_Not(Clox_Jit_Trace_Compiler* compiler) {
+    if (compiler->depth == 0) {
+        return false;
+    }
+    uint32_t top = compiler->depth - 1;
+    Clox_Jit_Slot* slot = &compiler->stack[top];
+    if (slot->kind == CLOX_JIT_SLOT_FLAGS) {
+        slot->condition ^= 1;
+        return true;
+    }
+    if (slot->type == CLOX_VALUE_TYPE_NIL) {
+        *slot = Clox_Jit_Trace_Constant(CLOX_VALUE_BOOL(true));
+        return true;
+    }
+    if (slot->type != CLOX_VALUE_TYPE_BOOL) {
+        return false;
+    }
+    if (slot->kind == CLOX_JIT_SLOT_CONSTANT) {
+        *slot = Clox_Jit_Trace_Constant(CLOX_VALUE_BOOL(!slot->constant.value.boolean));
+        return true;
+    }
+    Clox_Jit_Emit_Encoded(&compiler->as, CLOX_JIT_BYTE_IMM8, 6, CLOX_JIT_R12, true, CLOX_JIT_SLOT(top) + 8);
+    CLOX_JIT_EMIT(&compiler->as, 0x01);                                                      // xor byte [slot + 8], 1
+    return true;
+}
+
+// NOTE(Al-Andrew): the trace only carries on the way the recorded iteration went, the other way is an exit
+static bool Clox_Jit_Trace_Jump_If_False(Clox_Jit_Trace_Compiler* compiler, Clox_Jit_Step const* step) {
+    if (compiler->depth == 0) {
+        return false;
+    }
+    uint32_t top = compiler->depth - 1;
+    Clox_Jit_Slot slot = compiler->stack[top];
+    switch (slot.kind) {
+        case CLOX_JIT_SLOT_FLAGS: {
+            compiler->stack[top] = Clox_Jit_Trace_Constant(CLOX_VALUE_BOOL(!step->truthy));
+            Clox_Jit_Trace_Exit_If(compiler, step->truthy ? (uint8_t)(slot.condition ^ 1) : slot.condition, step->offset);
+            compiler->stack[top] = Clox_Jit_Trace_Constant(CLOX_VALUE_BOOL(step->truthy));
+        } break;
+        case CLOX_JIT_SLOT_CONSTANT: {
+            if (Clox_Value_Is_Falsy(slot.constant) == step->truthy) {
+                return false;
+            }
+        } break;
+        case CLOX_JIT_SLOT_NUMBER: /* fallthrough */
+        case CLOX_JIT_SLOT_BOXED: {
+            if (slot.type != CLOX_VALUE_TYPE_BOOL) {
+                return (slot.type != CLOX_VALUE_TYPE_NIL) == step->truthy;
+            }
+            Clox_Jit_Emit_Encoded(&compiler->as, CLOX_JIT_BYTE_IMM8, 7, CLOX_JIT_R12, true, CLOX_JIT_SLOT(top) + 8);
+            CLOX_JIT_EMIT(&compiler->as, 0x00);                                              // cmp byte [slot + 8], 0
+            Clox_Jit_Trace_Exit_If(compiler, step->truthy ? CLOX_JIT_JE : CLOX_JIT_JNE, step->offset);
+            compiler->stack[top] = Clox_Jit_Trace_Constant(CLOX_VALUE_BOOL(step->truthy));
+        } break;
+    }
+    return true;
+}
+
+// NOTE(Al-Andrew): only the ones a single SSE instruction does, recording made sure the operand was a number
+static bool Clox_Jit_Trace_Intrinsic(Clox_Jit_Trace_Compiler* compiler, Clox_Jit_Step const* step) {
+    if (compiler->depth == 0 || compiler->stack[compiler->depth - 1].type != CLOX_VALUE_TYPE_NUMBER) {
+        return false;
+    }
+    uint32_t top = compiler->depth - 1;
+    bool is_sqrt = step->operand == CLOX_INTRINSIC_SQRT;
+    if (compiler->stack[top].kind == CLOX_JIT_SLOT_CONSTANT) {
+        double number = compiler->stack[top].constant.value.number;
+        compiler->stack[top] = Clox_Jit_Trace_Constant(CLOX_VALUE_NUMBER(is_sqrt ? sqrt(number) : floor(number)));
+        return true;
+    }
+    Clox_Jit_Trace_Load_Number(compiler, (uint8_t)top, top);
+    uint8_t registers = (uint8_t)(0xC0 | top << 3 | top);
+    if (is_sqrt) {
+        CLOX_JIT_EMIT(&compiler->as, 0xF2, 0x0F, 0x51, registers);                           // sqrtsd xmm, xmm
+    } else {
+        CLOX_JIT_EMIT(&compiler->as, 0x66, 0x0F, 0x3A, 0x0B, registers, 0x09);               // roundsd xmm, xmm, floor
+    }
+    compiler->stack[top] = (Clox_Jit_Slot){.kind = CLOX_JIT_SLOT_NUMBER, .type = CLOX_VALUE_TYPE_NUMBER};
+    return true;
+}
+
+// NOTE(Al-Andrew): guards that slot `receiver` is an instance of the recorded shape and leaves its fields in rax
+static bool Clox_Jit_Trace_Instance_Fields(Clox_Jit_Trace_Compiler* compiler, Clox_Jit_Step const* step, uint32_t receiver) {
+    Clox_Jit_Assembler* as = &compiler->as;
+    Clox_Jit_Slot slot = compiler->stack[receiver];
+    if (slot.kind != CLOX_JIT_SLOT_BOXED || slot.type != CLOX_VALUE_TYPE_OBJECT) {
+        return false;
+    }
+    Clox_Jit_Emit_Encoded(as, CLOX_JIT_MOV_LOAD, CLOX_JIT_RAX, CLOX_JIT_R12, true, CLOX_JIT_SLOT(receiver) + 8);
+    Clox_Jit_Emit_Encoded(as, CLOX_JIT_GROUP_IMM8, 7, CLOX_JIT_RAX, true, (int32_t)offsetof(Clox_Object, type));  // cmp dword [rax + type], INSTANCE
+    CLOX_JIT_EMIT(as, (uint8_t)CLOX_OBJECT_TYPE_INSTANCE);
+    Clox_Jit_Trace_Exit_If(compiler, CLOX_JIT_JNE, step->offset);
+    CLOX_JIT_EMIT(as, 0x48, 0xB9);                                                               // mov rcx, shape
+    Clox_Jit_Emit_64(as, (uint64_t)(uintptr_t)step->shape);
+    Clox_Jit_Emit_Encoded(as, CLOX_JIT_CMP_STORE, CLOX_JIT_RCX, CLOX_JIT_RAX, true, (int32_t)offsetof(Clox_Instance, shape));
+    Clox_Jit_Trace_Exit_If(compiler, CLOX_JIT_JNE, step->offset);
+    Clox_Jit_Emit_Encoded(as, CLOX_JIT_MOV_LOAD, CLOX_JIT_RAX, CLOX_JIT_RAX, true, (int32_t)offsetof(Clox_Instance, fields));
+    return true;
+}
+
+static bool Clox_Jit_Trace_Get_Property(Clox_Jit_Trace_Compiler* compiler, Clox_Jit_Step const* step) {
+    Clox_Jit_Assembler* as = &compiler->as;
+    if (compiler->depth == 0) {
+        return false;
+    }
+    uint8_t top = (uint8_t)(compiler->depth - 1);
+    if (!Clox_Jit_Trace_Instance_Fields(compiler, step, top)) {
+        return false;
+    }
+    int32_t field = (int32_t)(step->slot * sizeof(Clox_Value));
+    if (step->type == CLOX_VALUE_TYPE_NUMBER) {
+        Clox_Jit_Trace_Exit_At(compiler, Clox_Jit_Emit_Number_Load(as, top, CLOX_JIT_RAX, field), step->offset);
+        compiler->stack[top] = (Clox_Jit_Slot){.kind = CLOX_JIT_SLOT_NUMBER, .type = CLOX_VALUE_TYPE_NUMBER};
+        return true;
+    }
+    Clox_Jit_Emit_Encoded(as, CLOX_JIT_GROUP_IMM8, 7, CLOX_JIT_RAX, true, field);           // cmp dword [rax + field], type
+    CLOX_JIT_EMIT(as, (uint8_t)step->type);
+    Clox_Jit_Trace_Exit_If(compiler, CLOX_JIT_JNE, step->offset);
+    compiler->stack[top] = (Clox_Jit_Slot){.kind = CLOX_JIT_SLOT_BOXED, .type = step->type};
+    Clox_Jit_Emit_Encoded(as, CLOX_JIT_MOV_LOAD, CLOX_JIT_RCX, CLOX_JIT_RAX, true, field);
+    Clox_Jit_Emit_Encoded(as, CLOX_JIT_MOV_LOAD, CLOX_JIT_RDX, CLOX_JIT_RAX, true, field + 8);
+    Clox_Jit_Emit_Encoded(as, CLOX_JIT_MOV_STORE, CLOX_JIT_RCX, CLOX_JIT_R12, true, CLOX_JIT_SLOT(top));
+    Clox_Jit_Emit_Encoded(as, CLOX_JIT_MOV_STORE, CLOX_JIT_RDX, CLOX_JIT_R12, true, CLOX_JIT_SLOT(top) + 8);
+    return true;
+}
+
+static bool Clox_Jit_Trace_Set_Property(Clox_Jit_Trace_Compiler* compiler, Clox_Jit_Step const* step) {
+    if (compiler->depth < 2) {
+        return false;
+    }
+    uint32_t receiver = compiler->depth - 2;
+    uint32_t value = compiler->depth - 1;
+    if (!Clox_Jit_Trace_Instance_Fields(compiler, step, receiver)) {
+        return false;
+    }
+    Clox_Jit_Trace_Store(compiler, value, CLOX_JIT_RAX, (int32_t)(step->slot * sizeof(Clox_Value)));
+    Clox_Jit_Trace_Copy(compiler, value, receiver);
+    compiler->depth--;
+    return true;
+}
+
+// NOTE(Al-Andrew): the three variables are loaded above the stack before anything is written, a failing guard leaves
+//                  the interpreter to run the whole instruction again
+static bool Clox_Jit_Trace_For_Loop(Clox_Jit_Trace_Compiler* compiler, Clox_Chunk const* chunk, Clox_Jit_Step const* step) {
+    Clox_Jit_Assembler* as = &compiler->as;
+    uint32_t depth = compiler->depth;
+    if (depth + 3 > CLOX_JIT_TRACE_MAX_DEPTH) {
+        return false;
+    }
+    uint8_t variables[3] = {step->variable, step->bound, step->increment};
+    for (uint8_t i = 0; i < 3; ++i) {
+        Clox_Jit_Variable const* variable = &compiler->trace->variables[variables[i]];
+        uint8_t xmm = (uint8_t)(depth + i);
+        if (variable->promoted >= 0) {
+            Clox_Jit_Emit_Encoded(as, CLOX_JIT_MOVSD_LOAD, xmm, (uint8_t)(8 + variable->promoted), false, 0);
+            continue;
+        }
+        Clox_Jit_Trace_Variable_Address(compiler, variables[i]);
+        Clox_Jit_Trace_Exit_At(compiler, Clox_Jit_Emit_Number_Load(as, xmm, CLOX_JIT_RAX, 0), step->offset);
+    }
+
+    uint8_t counter = (uint8_t)depth;
+    Clox_Jit_Emit_Encoded(as, CLOX_JIT_ADDSD, counter, (uint8_t)(depth + 2), false, 0);
+    Clox_Jit_Variable const* variable = &compiler->trace->variables[step->variable];
+    if (variable->promoted >= 0) {
+        Clox_Jit_Emit_Encoded(as, CLOX_JIT_MOVSD_LOAD, (uint8_t)(8 + variable->promoted), counter, false, 0);
+    } else {
+        Clox_Jit_Trace_Variable_Address(compiler, step->variable);
+        Clox_Jit_Emit_Store_Type(as, CLOX_JIT_RAX, 0, CLOX_VALUE_TYPE_NUMBER);
+        Clox_Jit_Emit_Encoded(as, CLOX_JIT_MOVSD_STORE, counter, CLOX_JIT_RAX, true, 8);
+    }
+
+    // NOTE(Al-Andrew): bound > counter is the back edge, unordered sets CF so a NaN leaves the loop like in C
+    uint16_t jump = (uint16_t)((chunk->code[step->offset + 2] << 8) | chunk->code[step->offset + 3]);
+    Clox_Jit_Emit_Encoded(as, CLOX_JIT_UCOMISD, (uint8_t)(depth + 1), counter, false, 0);
+    if (step->truthy) {
+        Clox_Jit_Trace_Exit_If(compiler, CLOX_JIT_JBE, step->offset + 4);
+    } else {
+        Clox_Jit_Trace_Exit_If(compiler, CLOX_JIT_JA, step->offset + 4 - jump);
+    }
+    return true;
+}
+
+static bool Clox_Jit_Trace_Step(Clox_Jit_Trace_Compiler* compiler, Clox_Chunk* chunk, uint32_t base, Clox_Jit_Step const* step) {
+    if (step->op != OP_BOOLEAN_NEGATION && step->op != OP_JUMP_IF_FALSE) {
+        Clox_Jit_Trace_Settle_Flags(compiler);
+    }
+
+    switch (step->op) {
+        case OP_CONSTANT: {
+            Clox_Value value = chunk->constants.values[step->operand];
+            if (CLOX_VALUE_IS_INTEGER(value)) {
+                value = CLOX_VALUE_NUMBER(Clox_Value_As_Number(value));
+            }
+            return Clox_Jit_Trace_Push(compiler, Clox_Jit_Trace_Constant(value));
+        } break;
+        case OP_NIL: {
+            return Clox_Jit_Trace_Push(compiler, Clox_Jit_Trace_Constant(CLOX_VALUE_NIL));
+        } break;
+        case OP_TRUE: {
+            return Clox_Jit_Trace_Push(compiler, Clox_Jit_Trace_Constant(CLOX_VALUE_BOOL(true)));
+        } break;
+        case OP_FALSE: {
+            return Clox_Jit_Trace_Push(compiler, Clox_Jit_Trace_Constant(CLOX_VALUE_BOOL(false)));
+        } break;
+        case OP_GET_LOCAL: {
+            if (step->operand < base) {
+                return Clox_Jit_Trace_Get_Variable(compiler, step);
+            }
+            // NOTE(Al-Andrew): locals declared inside the loop body are just expression stack slots to the trace
+            uint32_t from = step->operand - base;
+            if (from >= compiler->depth || !Clox_Jit_Trace_Push(compiler, compiler->stack[from])) {
+                return false;
+            }
+            compiler->depth--;
+            Clox_Jit_Trace_Copy(compiler, from, compiler->depth++);
+        } break;
+        case OP_SET_LOCAL: {
+            if (step->operand < base) {
+                return Clox_Jit_Trace_Set_Variable(compiler, step);
+            }
+            uint32_t to = step->operand - base;
+            if (to >= compiler->depth) {
+                return false;
+            }
+            Clox_Jit_Trace_Copy(compiler, compiler->depth - 1, to);
+        } break;
+        case OP_GET_UPVALUE: /* fallthrough */
+        case OP_GET_CAPTURE: /* fallthrough */
+        case OP_GET_GLOBAL: {
+            return Clox_Jit_Trace_Get_Variable(compiler, step);
+        } break;
+        case OP_SET_UPVALUE: /* fallthrough */
+        case OP_SET_GLOBAL: {
+            return Clox_Jit_Trace_Set_Variable(compiler, step);
+        } break;
+        case OP_POP: {
+            if (compiler->depth == 0) {
+                return false;
+            }
+            compiler->depth--;
+        } break;
+        case OP_DUP: {
+            if (compiler->depth == 0 || !Clox_Jit_Trace_Push(compiler, compiler->stack[compiler->depth - 1])) {
+                return false;
+            }
+            compiler->depth--;
+            Clox_Jit_Trace_Copy(compiler, compiler->depth - 1, compiler->depth);
+            compiler->depth++;
+        } break;
+        case OP_ADD: /* fallthrough */
+        case OP_SUB: /* fallthrough */
+        case OP_MUL: /* fallthrough */
+        case OP_DIV: {
+            return Clox_Jit_Trace_Arithmetic(compiler, step->op);
+        } break;
+        case OP_ARITHMETIC_NEGATION: {
+            if (compiler->depth == 0 || compiler->stack[compiler->depth - 1].type != CLOX_VALUE_TYPE_NUMBER) {
+                return false;
+            }
+            uint32_t top = compiler->depth - 1;
+            if (compiler->stack[top].kind == CLOX_JIT_SLOT_CONSTANT) {
+                compiler->stack[top] = Clox_Jit_Trace_Constant(CLOX_VALUE_NUMBER(-compiler->stack[top].constant.value.number));
+                break;
+            }
+            Clox_Jit_Trace_Load_Number(compiler, (uint8_t)top, top);
+            Clox_Jit_Emit_Encoded(&compiler->as, CLOX_JIT_MOVQ_FROM, (uint8_t)top, CLOX_JIT_RAX, false, 0);
+            CLOX_JIT_EMIT(&compiler->as, 0x48, 0x0F, 0xBA, 0xF8, 0x3F);                      // btc rax, 63
+            Clox_Jit_Emit_Encoded(&compiler->as, CLOX_JIT_MOVQ_TO, (uint8_t)top, CLOX_JIT_RAX, false, 0);
+            compiler->stack[top] = (Clox_Jit_Slot){.kind = CLOX_JIT_SLOT_NUMBER, .type = CLOX_VALUE_TYPE_NUMBER};
+        } break;
+        case OP_LESS: /* fallthrough */
+        case OP_GREATER: /* fallthrough */
+        case OP_EQUAL: {
+            return Clox_Jit_Trace_Compare(compiler, step->op);
+        } break;
+        case OP_BOOLEAN_NEGATION: {
+            return Clox_Jit_Trace_Not(compiler);
+        } break;
+        case OP_JUMP_IF_FALSE: {
+            return Clox_Jit_Trace_Jump_If_False(compiler, step);
+        } break;
+        case OP_INTRINSIC: {
+            return Clox_Jit_Trace_Intrinsic(compiler, step);
+        } break;
+        case OP_GET_PROPERTY: {
+            return Clox_Jit_Trace_Get_Property(compiler, step);
+        } break;
+        case OP_SET_PROPERTY: {
+            return Clox_Jit_Trace_Set_Property(compiler, step);
+        } break;
+        case OP_JUMP: /* fallthrough */
+        case OP_LOOP: {
+            // NOTE(Al-Andrew): the recording already followed them
+        } break;
+        case OP_FOR_LOOP: {
+            return Clox_Jit_Trace_For_Loop(compiler, chunk, step);
+        } break;
+        default: {
+            return false;
+        } break;
+    }
+    return true;
+}
+
+static Clox_Jit_Trace* Clox_Jit_Compile_Trace(Clox_Jit_Recorder* recorder, Clox_Chunk* chunk) {
+    Clox_Jit_Trace* trace = reallocate(NULL, 0, sizeof(Clox_Jit_Trace));
+    *trace = (Clox_Jit_Trace){.header = recorder->header, .base = recorder->base, .variable_count = recorder->variable_count, .intrinsics = recorder->intrinsics};
+    memcpy(trace->variables, recorder->variables, sizeof(trace->variables));
+
+    // NOTE(Al-Andrew): variables that start out and stay numbers live unboxed in xmm8 - xmm15 for the whole trace
+    int8_t promoted = 0;
+    for (uint32_t i = 0; i < trace->variable_count; ++i) {
+        Clox_Jit_Variable* variable = &trace->variables[i];
+        variable->promoted = -1;
+        if (variable->entry_type == CLOX_VALUE_TYPE_NUMBER && variable->stores_number_only && promoted < CLOX_JIT_TRACE_MAX_PROMOTED) {
+            variable->promoted = promoted++;
+        }
+    }
+
+    Clox_Jit_Trace_Compiler compiler = {.trace = trace};
+    compiler.exits = reallocate(NULL, 0, sizeof(Clox_Jit_Exit) * recorder->step_count * CLOX_JIT_TRACE_MAX_STEP_EXITS);
+    Clox_Jit_Assembler* as = &compiler.as;
+
+    // NOTE(Al-Andrew): common exit first, so the stubs can use Clox_Jit_Emit_Exit. Returns the finished iterations.
+    as->common_exit = as->used;
+    CLOX_JIT_EMIT(as, 0x49, 0x89, 0x86);                                                     // mov [r14 + ip], rax
+    Clox_Jit_Emit_32(as, (uint32_t)offsetof(Clox_Call_Frame, instruction_pointer));
+    CLOX_JIT_EMIT(as, 0x4C, 0x89, 0xA3);                                                     // mov [rbx + stack_top], r12
+    Clox_Jit_Emit_32(as, (uint32_t)offsetof(Clox_VM, stack_top));
+    CLOX_JIT_EMIT(as, 0x89, 0xE8,                                                            // mov eax, ebp
+                      0x48, 0x83, 0xC4, 0x08,                                                // add rsp, 8
+                      0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5D, 0x5B,            // pop r15 - r12, rbp, rbx
+                      0xC3);                                                                 // ret
+
+    // NOTE(Al-Andrew): entry, called as Clox_Jit_Trace_Entry
+    uint32_t entry = as->used;
+    CLOX_JIT_EMIT(as, 0x53, 0x55, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57,            // push rbx, rbp, r12 - r15
+                      0x48, 0x83, 0xEC, 0x08,                                                // sub rsp, 8
+                      0x48, 0x89, 0xFB,                                                      // mov rbx, rdi
+                      0x49, 0x89, 0xF6,                                                      // mov r14, rsi
+                      0x49, 0x89, 0xD7,                                                      // mov r15, rdx
+                      0x31, 0xED,                                                            // xor ebp, ebp
+                      0x4C, 0x8B, 0xA3);                                                     // mov r12, [rbx + stack_top]
+    Clox_Jit_Emit_32(as, (uint32_t)offsetof(Clox_VM, stack_top));
+
+    uint32_t entry_guards[CLOX_JIT_TRACE_MAX_PROMOTED];
+    uint32_t entry_guard_count = 0;
+    for (uint8_t i = 0; i < trace->variable_count; ++i) {
+        Clox_Jit_Variable const* variable = &trace->variables[i];
+        if (variable->promoted < 0) {
+            continue;
+        }
+        Clox_Jit_Trace_Variable_Address(&compiler, i);
+        entry_guards[entry_guard_count++] = Clox_Jit_Emit_Number_Load(as, (uint8_t)(8 + variable->promoted), CLOX_JIT_RAX, 0);
+    }
+
+    uint32_t loop = as->used;
+    bool compiled = true;
+    for (uint32_t i = 0; i < recorder->step_count && compiled; ++i) {
+        compiled = Clox_Jit_Trace_Step(&compiler, chunk, recorder->base, &recorder->steps[i]);
+    }
+    compiled = compiled && compiler.depth == 0;
+
+    if (compiled) {
+        CLOX_JIT_EMIT(as, 0xFF, 0xC5,                                                        // inc ebp
+                          0xE9);                                                             // jmp loop
+        Clox_Jit_Emit_32(as, 0);
+        Clox_Jit_Patch_32(as, as->used - 4, loop);
+
+        for (uint32_t i = 0; i < compiler.exit_count; ++i) {
+            Clox_Jit_Exit const* exit = &compiler.exits[i];
+            Clox_Jit_Patch_32(as, exit->at, as->used);
+            memcpy(compiler.stack, exit->stack, sizeof(compiler.stack));
+            for (uint32_t slot = 0; slot < exit->depth; ++slot) {
+                Clox_Jit_Trace_Store(&compiler, slot, CLOX_JIT_R12, CLOX_JIT_SLOT(slot));
+            }
+            for (uint8_t v = 0; v < trace->variable_count; ++v) {
+                if (trace->variables[v].promoted < 0) {
+                    continue;
+                }
+                Clox_Jit_Trace_Variable_Address(&compiler, v);
+                Clox_Jit_Emit_Store_Type(as, CLOX_JIT_RAX, 0, CLOX_VALUE_TYPE_NUMBER);
+                Clox_Jit_Emit_Encoded(as, CLOX_JIT_MOVSD_STORE, (uint8_t)(8 + trace->variables[v].promoted), CLOX_JIT_RAX, true, 8);
+            }
+            if (exit->depth > 0) {
+                Clox_Jit_Emit_Encoded(as, CLOX_JIT_LEA, CLOX_JIT_R12, CLOX_JIT_R12, true, CLOX_JIT_SLOT(exit->depth));
+            }
+            Clox_Jit_Emit_Exit(as, chunk->code + exit->offset);
+        }
+
+        // NOTE(Al-Andrew): a promoted variable isn't a number anymore, nothing ran yet so nothing gets written back
+        for (uint32_t i = 0; i < entry_guard_count; ++i) {
+            Clox_Jit_Patch_32(as, entry_guards[i], as->used);
+        }
+        Clox_Jit_Emit_Exit(as, chunk->code + trace->header);
+
+        trace->code = Clox_Jit_Map(as, &trace->mapping_size);
+        compiled = trace->code != NULL;
+    }
+
+#ifdef CLOX_DEBUG_PRINT_TRACES
+    printf("== trace at %u%s ==\n", recorder->header, compiled ? "" : " (failed)");
+    for (uint32_t i = 0; i < recorder->step_count; ++i) {
+        Clox_Chunk_Print_Op_Code(chunk, recorder->steps[i].offset);
+    }
+#endif // CLOX_DEBUG_PRINT_TRACES
+
+    deallocate(compiler.exits);
+    Clox_Jit_Assembler_Free(as);
+    if (!compiled) {
+        Clox_Jit_Free_Trace(trace);
+        return NULL;
+    }
+    trace->entry = entry;
+    return trace;
+}
+
+void Clox_Jit_Stop_Recording(Clox_VM* vm) {
+    if (vm->jit_recorder != NULL) {
+        deallocate(vm->jit_recorder);
+        vm->jit_recorder = NULL;
+    }
+}
+
+// NOTE(Al-Andrew): the loop runs on the templates for a while before it gets another go, and for good after a few
+static bool Clox_Jit_Abort_Recording(Clox_VM* vm) {
+    Clox_Jit_Recorder* recorder = vm->jit_recorder;
+    Clox_Jit_Loop_Counter* counter = &recorder->closure->function->jit->loops[recorder->header];
+    counter->aborts++;
+    counter->hotness = counter->aborts >= CLOX_JIT_TRACE_MAX_ABORTS ? INT32_MAX : CLOX_JIT_TRACE_BACKOFF;
+    Clox_Jit_Stop_Recording(vm);
+    return false;
+}
+
+// NOTE(Al-Andrew): the guards load an integer as a double, to a trace the two are one type
+static Clox_Value_Type Clox_Jit_Trace_Type(Clox_Value_Type type) {
+    return type == CLOX_VALUE_TYPE_INTEGER ? CLOX_VALUE_TYPE_NUMBER : type;
+}
+
+static bool Clox_Jit_Record_Variable(Clox_Jit_Recorder* recorder, Clox_Jit_Step* step, Clox_Jit_Variable_Kind kind, uint8_t index, Clox_String* name, Clox_Value_Type current_type) {
+    for (uint32_t i = 0; i < recorder->variable_count; ++i) {
+        Clox_Jit_Variable const* variable = &recorder->variables[i];
+        if (variable->kind == kind && variable->index == index && variable->name == name) {
+            step->variable = (uint8_t)i;
+            return true;
+        }
+    }
+    if (recorder->variable_count == CLOX_JIT_TRACE_MAX_VARIABLES) {
+        return false;
+    }
+    step->variable = (uint8_t)recorder->variable_count;
+    recorder->variables[recorder->variable_count++] = (Clox_Jit_Variable){
+        .kind = kind,
+        .index = index,
+        .name = name,
+        .entry_type = Clox_Jit_Trace_Type(current_type),
+        .stores_number_only = true,
+    };
+    return true;
+}
+
+bool Clox_Jit_Record(Clox_VM* vm, Clox_Call_Frame* frame) {
+    Clox_Jit_Recorder* recorder = vm->jit_recorder;
+    if (recorder == NULL) {
+        return false;
+    }
+    if (frame != recorder->frame || frame->closure != recorder->closure) {
+        return Clox_Jit_Abort_Recording(vm);
+    }
+
+    Clox_Function* function = frame->closure->function;
+    Clox_Chunk* chunk = &function->chunk;
+    uint32_t offset = (uint32_t)(frame->instruction_pointer - chunk->code);
+    if (offset == recorder->header && recorder->step_count > 0) {
+        Clox_Jit_Trace* trace = Clox_Jit_Compile_Trace(recorder, chunk);
+        if (trace == NULL) {
+            return Clox_Jit_Abort_Recording(vm);
+        }
+        trace->next = function->jit->traces;
+        function->jit->traces = trace;
+        Clox_Jit_Stop_Recording(vm);
+        return false;
+    }
+    if (recorder->step_count == CLOX_JIT_TRACE_MAX_STEPS || Clox_Chunk_Op_Code_Size(chunk, offset) == 0) {
+        return Clox_Jit_Abort_Recording(vm);
+    }
+
+    Clox_Jit_Step* step = &recorder->steps[recorder->step_count++];
+    *step = (Clox_Jit_Step){.offset = offset, .op = (Clox_Op_Code)chunk->code[offset]};
+    if (Clox_Chunk_Op_Code_Size(chunk, offset) > 1) {
+        step->operand = chunk->code[offset + 1];
+    }
+
+    Clox_Value const* top = vm->stack_top - 1;
+    bool recorded = true;
+    switch (step->op) {
+        case OP_CONSTANT: /* fallthrough */
+        case OP_NIL: /* fallthrough */
+        case OP_TRUE: /* fallthrough */
+        case OP_FALSE: /* fallthrough */
+        case OP_POP: /* fallthrough */
+        case OP_DUP: /* fallthrough */
+        case OP_JUMP: {
+        } break;
+        case OP_LOOP: {
+            // NOTE(Al-Andrew): an inner loop would get unrolled until the trace is too long, its own trace handles it
+            uint32_t target = offset + 3 - (uint32_t)((chunk->code[offset + 1] << 8) | chunk->code[offset + 2]);
+            for (uint32_t i = 0; i < recorder->step_count && target != recorder->header; ++i) {
+                recorded = recorded && recorder->steps[i].offset != target;
+            }
+        } break;
+        case OP_FOR_LOOP: {
+            uint32_t target = offset + 4 - (uint32_t)((chunk->code[offset + 2] << 8) | chunk->code[offset + 3]);
+            for (uint32_t i = 0; i < recorder->step_count && target != recorder->header; ++i) {
+                recorded = recorded && recorder->steps[i].offset != target;
+            }
+            Clox_Value const* slots = frame->slots + step->operand;
+            if (!recorded || (uint32_t)step->operand + 2 >= recorder->base ||
+                !CLOX_VALUE_IS_NUMERIC(slots[0]) || !CLOX_VALUE_IS_NUMERIC(slots[1]) || !CLOX_VALUE_IS_NUMERIC(slots[2])) {
+                recorded = false;
+                break;
+            }
+            // NOTE(Al-Andrew): Clox_Jit_Record_Variable fills in `variable`, the counter goes last so it stays there
+            recorded = Clox_Jit_Record_Variable(recorder, step, CLOX_JIT_VARIABLE_LOCAL, (uint8_t)(step->operand + 1), NULL, slots[1].type);
+            step->bound = step->variable;
+            recorded = recorded && Clox_Jit_Record_Variable(recorder, step, CLOX_JIT_VARIABLE_LOCAL, (uint8_t)(step->operand + 2), NULL, slots[2].type);
+            step->increment = step->variable;
+            recorded = recorded && Clox_Jit_Record_Variable(recorder, step, CLOX_JIT_VARIABLE_LOCAL, step->operand, NULL, slots[0].type);
+            step->type = CLOX_VALUE_TYPE_NUMBER;
+            step->truthy = Clox_Value_As_Number(slots[0]) + Clox_Value_As_Number(slots[2]) < Clox_Value_As_Number(slots[1]);
+        } break;
+        case OP_GET_LOCAL: {
+            step->type = frame->slots[step->operand].type;
+            if (step->operand < recorder->base) {
+                recorded = Clox_Jit_Record_Variable(recorder, step, CLOX_JIT_VARIABLE_LOCAL, step->operand, NULL, step->type);
+            }
+        } break;
+        case OP_SET_LOCAL: {
+            step->type = top->type;
+            if (step->operand < recorder->base) {
+                recorded = Clox_Jit_Record_Variable(recorder, step, CLOX_JIT_VARIABLE_LOCAL, step->operand, NULL, frame->slots[step->operand].type);
+            }
+        } break;
+        case OP_GET_UPVALUE: {
+            step->type = frame->closure->upvalues[step->operand].upvalue->location->type;
+            recorded = Clox_Jit_Record_Variable(recorder, step, CLOX_JIT_VARIABLE_UPVALUE, step->operand, NULL, step->type);
+        } break;
+        case OP_GET_CAPTURE: {
+            step->type = frame->closure->upvalues[step->operand].value.type;
+            recorded = Clox_Jit_Record_Variable(recorder, step, CLOX_JIT_VARIABLE_CAPTURE, step->operand, NULL, step->type);
+        } break;
+        case OP_SET_UPVALUE: {
+            step->type = top->type;
+            recorded = Clox_Jit_Record_Variable(recorder, step, CLOX_JIT_VARIABLE_UPVALUE, step->operand, NULL, frame->closure->upvalues[step->operand].upvalue->location->type);
+        } break;
+        case OP_GET_GLOBAL: /* fallthrough */
+        case OP_SET_GLOBAL: {
+            Clox_String* name = (Clox_String*)chunk->constants.values[step->operand].value.object;
+            Clox_Hash_Table_Entry* entry = Clox_Hash_Table_Get_Entry(&vm->globals, name);
+            if (entry == NULL) {
+                recorded = false; // NOTE(Al-Andrew): the interpreter is about to report it
+                break;
+            }
+            if (step->op == OP_SET_GLOBAL && name->names_intrinsic) {
+                recorded = false; // NOTE(Al-Andrew): the interpreter has to see the rebinding, see Clox_VM_Note_Global_Write
+                break;
+            }
+            step->type = step->op == OP_GET_GLOBAL ? entry->value.type : top->type;
+            recorded = Clox_Jit_Record_Variable(recorder, step, CLOX_JIT_VARIABLE_GLOBAL, 0, name, entry->value.type);
+        } break;
+        case OP_ADD: /* fallthrough */
+        case OP_SUB: /* fallthrough */
+        case OP_MUL: /* fallthrough */
+        case OP_DIV: /* fallthrough */
+        case OP_LESS: /* fallthrough */
+        case OP_GREATER: /* fallthrough */
+        case OP_EQUAL: {
+            recorded = CLOX_VALUE_IS_NUMERIC(top[0]) && CLOX_VALUE_IS_NUMERIC(top[-1]);
+        } break;
+        case OP_ARITHMETIC_NEGATION: {
+            recorded = CLOX_VALUE_IS_NUMERIC(top[0]);
+        } break;
+        case OP_BOOLEAN_NEGATION: {
+            recorded = CLOX_VALUE_IS_BOOL(top[0]) || CLOX_VALUE_IS_NIL(top[0]);
+        } break;
+        case OP_JUMP_IF_FALSE: {
+            step->truthy = !Clox_Value_Is_Falsy(top[0]);
+        } break;
+        case OP_INTRINSIC: {
+            // NOTE(Al-Andrew): roundsd is SSE4.1, every x86-64 has the SSE2 sqrtsd
+            bool inlined = step->operand == CLOX_INTRINSIC_SQRT || (step->operand == CLOX_INTRINSIC_FLOOR && __builtin_cpu_supports("sse4.1"));
+            recorded = inlined && !(vm->intrinsics_rebound & (1u << step->operand)) && CLOX_VALUE_IS_NUMERIC(top[0]);
+            recorder->intrinsics |= 1u << step->operand;
+        } break;
+        case OP_GET_PROPERTY: /* fallthrough */
+        case OP_SET_PROPERTY: {
+            // NOTE(Al-Andrew): only fields that are already there, binding a method allocates and adding a field
+            //                  can move the instance's fields
+            Clox_Value receiver = step->op == OP_GET_PROPERTY ? top[0] : top[-1];
+            if (!CLOX_VALUE_IS_OBJECT(receiver) || receiver.value.object->type != CLOX_OBJECT_TYPE_INSTANCE) {
+                recorded = false;
+                break;
+            }
+            Clox_Instance* instance = (Clox_Instance*)receiver.value.object;
+            int32_t slot = Clox_Shape_Find_Field(instance->shape, (Clox_String*)chunk->constants.values[step->operand].value.object);
+            recorded = slot != -1;
+            step->shape = instance->shape;
+            step->slot = (uint32_t)slot;
+            step->type = recorded && step->op == OP_GET_PROPERTY ? instance->fields[slot].type : top->type;
+        } break;
+        default: {
+            // NOTE(Al-Andrew): calls, returns, closures and printing stay with the interpreter
+            recorded = false;
+        } break;
+    }
+
+    step->type = Clox_Jit_Trace_Type(step->type);
+    if (recorded && (step->op == OP_SET_LOCAL || step->op == OP_SET_UPVALUE || step->op == OP_SET_GLOBAL) &&
+        (step->op != OP_SET_LOCAL || step->operand < recorder->base) && step->type != CLOX_VALUE_TYPE_NUMBER) {
+        recorder->variables[step->variable].stores_number_only = false;
+    }
+    return recorded ? true : Clox_Jit_Abort_Recording(vm);
+}
+
+static void Clox_Jit_Run_Trace(Clox_VM* vm, Clox_Call_Frame* frame, Clox_Jit_Code* jit, Clox_Jit_Trace* trace) {
+    if ((uint32_t)(vm->stack_top - frame->slots) != trace->base || (trace->intrinsics & vm->intrinsics_rebound) != 0) {
+        return;
+    }
+
+    // NOTE(Al-Andrew): nothing inside a trace can grow the globals table or close an upvalue, the addresses hold
+    Clox_Value* variables[CLOX_JIT_TRACE_MAX_VARIABLES];
+    for (uint32_t i = 0; i < trace->variable_count; ++i) {
+        Clox_Jit_Variable const* variable = &trace->variables[i];
+        switch (variable->kind) {
+            case CLOX_JIT_VARIABLE_LOCAL: {
+                variables[i] = frame->slots + variable->index;
+            } break;
+            case CLOX_JIT_VARIABLE_UPVALUE: {
+                variables[i] = frame->closure->upvalues[variable->index].upvalue->location;
+            } break;
+            case CLOX_JIT_VARIABLE_CAPTURE: {
+                variables[i] = &frame->closure->upvalues[variable->index].value;
+            } break;
+            case CLOX_JIT_VARIABLE_GLOBAL: {
+                Clox_Hash_Table_Entry* entry = Clox_Hash_Table_Get_Entry(&vm->globals, variable->name);
+                if (entry == NULL) {
+                    return;
+                }
+                variables[i] = &entry->value;
+            } break;
+        }
+    }
+
+    Clox_Jit_Trace_Entry entry;
+    void* code = trace->code + trace->entry;
+    memcpy(&entry, &code, sizeof(entry));
+    uint32_t iterations = entry(vm, frame, variables);
+
+    // NOTE(Al-Andrew): a trace that keeps leaving in its first iterations costs more than it saves,
+    //                  the loop goes back to the templates for good
+    trace->runs++;
+    trace->iterations += iterations;
+    if (trace->runs >= 16 && trace->iterations < (uint64_t)trace->runs * 2) {
+        Clox_Jit_Trace** it = &jit->traces;
+        while (*it != trace) {
+            it = &(*it)->next;
+        }
+        *it = trace->next;
+        jit->loops[trace->header] = (Clox_Jit_Loop_Counter){.hotness = INT32_MAX, .aborts = CLOX_JIT_TRACE_MAX_ABORTS};
+        Clox_Jit_Free_Trace(trace);
+    }
+}
+
+bool Clox_Jit_Loop(Clox_VM* vm, Clox_Call_Frame* frame, uint8_t const* header) {
+    Clox_Function* function = frame->closure->function;
+    Clox_Jit_Code* jit = function->jit;
+    if (jit == NULL) {
+        return false;
+    }
+
+    uint32_t offset = (uint32_t)(header - function->chunk.code);
+    for (Clox_Jit_Trace* trace = jit->traces; trace != NULL; trace = trace->next) {
+        if (trace->header == offset) {
+            Clox_Jit_Run_Trace(vm, frame, jit, trace);
+            return false;
+        }
+    }
+
+    Clox_Jit_Loop_Counter* counter = &jit->loops[offset];
+    if (counter->aborts >= CLOX_JIT_TRACE_MAX_ABORTS) {
+        counter->hotness = INT32_MAX;
+        return false;
+    }
+    if (--counter->hotness > 0) {
+        return false;
+    }
+
+    Clox_Jit_Stop_Recording(vm); // NOTE(Al-Andrew): left over when a runtime error ended the last recording
+    Clox_Jit_Recorder* recorder = reallocate(NULL, 0, sizeof(Clox_Jit_Recorder));
+    recorder->frame = frame;
+    recorder->closure = frame->closure;
+    recorder->header = offset;
+    recorder->base = (uint32_t)(vm->stack_top - frame->slots);
+    recorder->step_count = 0;
+    recorder->variable_count = 0;
+    recorder->intrinsics = 0;
+    vm->jit_recorder = recorder;
+    return true;
+}
+
+#else
+
+void Clox_Jit_Enter(Clox_VM* vm, Clox_Call_Frame* frame) {
+    (void)vm;
+    (void)frame;
+}
+
+bool Clox_Jit_Loop(Clox_VM* vm, Clox_Call_Frame* frame, uint8_t const* header) {
+    (void)vm;
+    (void)frame;
+    (void)header;
+    return false;
+}
+
+bool Clox_Jit_Record(Clox_VM* vm, Clox_Call_Frame* frame) {
+    (void)vm;
+    (void)frame;
+    return false;
+}
+
+void Clox_Jit_Stop_Recording(Clox_VM* vm) {
+    (void)vm;
+}
+
+#endif // CLOX_JIT_X64
@@ -0,0 +1,35 @@
+#ifndef CLOX_JIT_H_INCLUDED
+#define CLOX_JIT_H_INCLUDED
+
+#include "object.h"
+#include "vm.h"
+
+#if defined(__x86_64__) && defined(__GNUC__) && (defined(__unix__) || defined(__APPLE__))
+    #define CLOX_JIT_X64
+#endif
+
+// NOTE(Al-Andrew): baseline template JIT. Every opcode of a function is stitched together from a fixed native
+//                  template working on the same frame and value stack as the interpreter. Whatever a template
+//                  can't handle (calls, returns, closures, operands of the wrong type) exits back to the
+//                  interpreter right before that instruction, so the interpreter also owns every error message.
+typedef struct Clox_Jit_Code Clox_Jit_Code;
+
+// NOTE(Al-Andrew): runs native code for `frame` starting at its current instruction, compiling the function on
+//                  first use. Returns with the frame pointing at the next instruction the interpreter has to run.
+void Clox_Jit_Enter(Clox_VM* vm, Clox_Call_Frame* frame);
+void Clox_Jit_Free(Clox_Function* function);
+
+// NOTE(Al-Andrew): tracing tier on top of the templates. Every backward jump counts down its loop header, once the
+//                  loop is hot the interpreter runs one iteration with Clox_Jit_Record in front of each instruction.
+//                  The recorded path gets compiled with the observed types guarded and numbers kept unboxed in xmm
+//                  registers, any guard that fails writes the values back and exits to the interpreter.
+typedef struct Clox_Jit_Recorder Clox_Jit_Recorder;
+
+// NOTE(Al-Andrew): called after OP_LOOP jumped back to `header`, runs the loop's trace if it has one.
+//                  Returns true when the interpreter should start recording the loop.
+bool Clox_Jit_Loop(Clox_VM* vm, Clox_Call_Frame* frame, uint8_t const* header);
+// NOTE(Al-Andrew): called before every instruction while recording, false once the trace is done or was given up
+bool Clox_Jit_Record(Clox_VM* vm, Clox_Call_Frame* frame);
+void Clox_Jit_Stop_Recording(Clox_VM* vm);
+
+#endif // CLOX_JIT_H_INCLUDED
@@ -1,3 +1,14 @@
+#if defined(__unix__) || defined(__APPLE__)
+    #define _POSIX_C_SOURCE 200112L
+    #define _DEFAULT_SOURCE  // NOTE(Al-Andrew): MAP_ANONYMOUS for the JIT isn't POSIX, glibc and macOS hide it otherwise
+    #define _DARWIN_C_SOURCE
+    #define CLOX_HAS_MMAP
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
 #include "common.h"
 #include "chunk.h"
 #include "vm.h"
@@ -8,11 +19,15 @@
 #include "memory.h"
 
 #include "chunk.c"
+#include "class.c"
 #include "common.c"
 #include "compiler.c"
 #include "hash_table.c"
+#include "jit.c"
 #include "memory.c"
 #include "object.c"
+#include "optimizer.c"
+#include "persistent.c"
 #include "scanner.c"
 #include "value.c"
 #include "vm.c"
@@ -20,15 +35,22 @@
 int Clox_Print_Help() {
 
     printf("clox - interpeter for the lox programming language, written in C\n");
-    printf("\nUsage: clox [file]\n");
+    printf("\nUsage: clox [options] [file]\n");
     printf("WHERE:\n");
     printf("    [file] - one file containing lox source code for the interpreter to run.\n");
+    printf("OPTIONS:\n");
+    printf("    --lazy - only pre-parse function bodies, compile them on their first call.\n");
+    printf("    --jit  - compile functions to native code and trace hot loops, x86-64 only, elsewhere it's ignored.\n");
+    printf("    -O     - optimize the bytecode of every function after it is compiled and inline small functions.\n");
 
     return 1;
 }
 
-int Clox_Repl() {
+int Clox_Repl(Clox_VM_Config config) {
     Clox_VM vm = Clox_VM_New_Empty();
+    vm.config = config;
+    vm.config.lazy_compile = false; // NOTE(Al-Andrew): the line buffer gets reused, lazy bodies would point into garbage
+    vm.config.inline_functions = false; // NOTE(Al-Andrew): a later line could still reassign what got inlined
     char line[1024];
     for (;;) {
         printf("> ");
@@ -42,61 +64,143 @@ int Clox_Repl() {
             break;
         }
 
-        Clox_VM_Interpret_Source(&vm, line);
+        Clox_VM_Interpret_Source(&vm, (s8){.len = (uint32_t)strlen(line), .string = line});
     }
     Clox_VM_Delete(&vm);
     return 0;
 }
 
-char* Clox_Read_File(const char* path_to_file) {
-    
-    FILE* file = fopen(path_to_file, "rb");
-    if(file == NULL) {
+typedef struct {
+    s8 source;
+    void* mapping;
+    size_t mapping_size;
+} Clox_Source_File;
+
+#ifdef CLOX_HAS_MMAP
+
+// NOTE(Al-Andrew): the scanner works on the mapped pages directly, no copy and no NUL terminator needed
+bool Clox_Open_Source_File(const char* path_to_file, Clox_Source_File* file) {
+    *file = (Clox_Source_File){0};
+
+    int descriptor = open(path_to_file, O_RDONLY);
+    if (descriptor == -1) {
         printf("[Error] Could not get descriptor for file %s.\n", path_to_file);
-        return NULL;
+        return false;
     }
 
-    fseek(file, 0L, SEEK_END);
-    size_t fileSize = (size_t)ftell(file);
-    rewind(file);
+    struct stat file_stat;
+    if (fstat(descriptor, &file_stat) == -1) {
+        printf("[Error] Could not stat file %s.\n", path_to_file);
+        close(descriptor);
+        return false;
+    }
 
-    char* buffer = (char*)reallocate(NULL, 0, fileSize + 1);
+    size_t file_size = (size_t)file_stat.st_size;
+    if (file_size > UINT32_MAX) {
+        printf("[Error] File %s is too large.\n", path_to_file);
+        close(descriptor);
+        return false;
+    }
+
+    if (file_size == 0) {
+        // NOTE(Al-Andrew): mmap refuses empty mappings
+        close(descriptor);
+        file->source = (s8){.string = "", .len = 0};
+        return true;
+    }
+
+    void* mapping = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor);
+    if (mapping == MAP_FAILED) {
+        printf("[Error] Could not map file %s.\n", path_to_file);
+        return false;
+    }
+    posix_madvise(mapping, file_size, POSIX_MADV_SEQUENTIAL);
+
+    file->mapping = mapping;
+    file->mapping_size = file_size;
+    file->source = (s8){.string = (const char*)mapping, .len = (uint32_t)file_size};
+    return true;
+}
+
+void Clox_Close_Source_File(Clox_Source_File* file) {
+    if (file->mapping != NULL) {
+        munmap(file->mapping, file->mapping_size);
+    }
+    *file = (Clox_Source_File){0};
+}
+
+#else
+
+bool Clox_Open_Source_File(const char* path_to_file, Clox_Source_File* file) {
+    *file = (Clox_Source_File){0};
 
-    if(buffer == NULL) {
-        return NULL;
+    FILE* handle = fopen(path_to_file, "rb");
+    if(handle == NULL) {
+        printf("[Error] Could not get descriptor for file %s.\n", path_to_file);
+        return false;
     }
 
+    fseek(handle, 0L, SEEK_END);
+    size_t fileSize = (size_t)ftell(handle);
+    rewind(handle);
+
+    char* buffer = (char*)reallocate(NULL, 0, fileSize + 1);
+    size_t bytesRead = fread(buffer, sizeof(char), fileSize, handle);
+    fclose(handle);
 
-    size_t bytesRead = fread(buffer, sizeof(char), fileSize, file);
-    buffer[bytesRead] = '\0';
+    file->mapping = buffer;
+    file->mapping_size = fileSize + 1;
+    file->source = (s8){.string = buffer, .len = (uint32_t)bytesRead};
+    return true;
+}
 
-    fclose(file);
-    return buffer;
+void Clox_Close_Source_File(Clox_Source_File* file) {
+    if (file->mapping != NULL) {
+        deallocate(file->mapping);
+    }
+    *file = (Clox_Source_File){0};
 }
 
-int Clox_Run_File(const char* path_to_file) {
-    char* source = Clox_Read_File(path_to_file);
+#endif // CLOX_HAS_MMAP
+
+int Clox_Run_File(const char* path_to_file, Clox_VM_Config config) {
+    Clox_Source_File file;
+    if (!Clox_Open_Source_File(path_to_file, &file)) {
+        return 1;
+    }
     Clox_VM vm = Clox_VM_New_Empty();
+    vm.config = config;
 
-    Clox_Interpret_Result result = Clox_VM_Interpret_Source(&vm, source);
-    deallocate(source);
-    source = NULL;
+    Clox_Interpret_Result result = Clox_VM_Interpret_Source(&vm, file.source);
     Clox_VM_Delete(&vm);
+    Clox_Close_Source_File(&file); // NOTE(Al-Andrew): lazily compiled functions point into the source until the VM is gone
     return result.status;
 }
 
 
 int main(int argc, char** argv)
 {
-    // TODO(Al-Andrew, Args): make/use a proper command line argumnets parser
-    if(argc == 1) {
-        return Clox_Repl();
-    } else if (argc == 2) {
-        return Clox_Run_File(argv[1]);
-    } else {
-        return Clox_Print_Help();
+    Clox_VM_Config config = {0};
+    char const* path_to_file = NULL;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--lazy") == 0) {
+            config.lazy_compile = true;
+        } else if (strcmp(argv[i], "--jit") == 0) {
+            config.jit = true;
+        } else if (strcmp(argv[i], "-O") == 0) {
+            config.optimize = true;
+            config.inline_functions = true;
+        } else if (argv[i][0] != '-' && path_to_file == NULL) {
+            path_to_file = argv[i];
+        } else {
+            return Clox_Print_Help();
+        }
     }
-    CLOX_UNREACHABLE();
 
-    return 0;
+    if (path_to_file == NULL) {
+        return Clox_Repl(config);
+    }
+    return Clox_Run_File(path_to_file, config);
 }
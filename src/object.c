@@ -2,9 +2,16 @@
 #include "common.h"
 #include <stdlib.h>
 #include <string.h>
+#include "class.h"
 #include "hash_table.h"
+#include "jit.h"
 #include "vm.h"
 #include "memory.h"
+#include "persistent.h"
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
 
 Clox_Object* Clox_Object_Allocate(Clox_VM* vm, Clox_Object_Type type, uint32_t size) {
     CLOX_DEV_ASSERT(size >= sizeof(Clox_Object));
@@ -24,12 +31,60 @@ void Clox_Object_Deallocate(Clox_VM* vm, Clox_Object* object) {
         case CLOX_OBJECT_TYPE_STRING: /* fallthrough */
         case CLOX_OBJECT_TYPE_NATIVE: /* fallthrough */
         case CLOX_OBJECT_TYPE_CLOSURE: /* fallthrough */
-        case CLOX_OBJECT_TYPE_UPVALUE: {
+        case CLOX_OBJECT_TYPE_UPVALUE: /* fallthrough */
+        case CLOX_OBJECT_TYPE_FLOAT_ARRAY: /* fallthrough */
+        case CLOX_OBJECT_TYPE_BOUND_METHOD: /* fallthrough */
+        case CLOX_OBJECT_TYPE_HAMT_NODE: /* fallthrough */
+        case CLOX_OBJECT_TYPE_PERSISTENT_MAP: /* fallthrough */
+        case CLOX_OBJECT_TYPE_VECTOR_NODE: /* fallthrough */
+        case CLOX_OBJECT_TYPE_PERSISTENT_VECTOR: {
+            deallocate(object);
+        } break;
+        case CLOX_OBJECT_TYPE_SHAPE: {
+            Clox_Shape* shape = (Clox_Shape*)object;
+            if (shape->transitions != NULL) {
+                deallocate(shape->transitions);
+            }
+            deallocate(object);
+        } break;
+        case CLOX_OBJECT_TYPE_CLASS: {
+            Clox_Hash_Table_Destory(&((Clox_Class*)object)->methods);
+            deallocate(object);
+        } break;
+        case CLOX_OBJECT_TYPE_INSTANCE: {
+            Clox_Instance* instance = (Clox_Instance*)object;
+            if (instance->fields != NULL) {
+                deallocate(instance->fields);
+            }
+            deallocate(object);
+        } break;
+        case CLOX_OBJECT_TYPE_LIST: {
+            Clox_Value_Array_Delete(&((Clox_List*)object)->items);
+            deallocate(object);
+        } break;
+        case CLOX_OBJECT_TYPE_MAP: {
+            Clox_Map* map = (Clox_Map*)object;
+            if (map->entries != NULL) {
+                deallocate(map->entries);
+                deallocate(map->slots);
+            }
             deallocate(object);
         } break;
         case CLOX_OBJECT_TYPE_FUNCTION: {
             Clox_Function* function = (Clox_Function*)object;
             Clox_Chunk_Delete(&function->chunk);
+            Clox_Value_Array_Delete(&function->upvalue_names);
+            Clox_Value_Array_Delete(&function->lazy_assigned_names);
+            if (function->lazy_flat_upvalues != NULL) {
+                deallocate(function->lazy_flat_upvalues);
+            }
+            Clox_Jit_Free(function);
+            if (function->call_caches != NULL) {
+                deallocate(function->call_caches);
+            }
+            if (function->property_caches != NULL) {
+                deallocate(function->property_caches);
+            }
             deallocate(object);
         } break;
     }
@@ -56,6 +111,10 @@ Clox_String* Clox_String_Create(Clox_VM* vm, const char* string, uint32_t len) {
     Clox_String* retval = (Clox_String*)Clox_Object_Allocate(vm, CLOX_OBJECT_TYPE_STRING, sizeof(Clox_String) + len + 1);
     retval->hash = hash;
     retval->length = len;
+    retval->names_intrinsic = false;
+    retval->is_hashed = true;
+    retval->parent = NULL;
+    retval->offset = 0;
     memcpy(retval->characters, string, len);
     retval->characters[len] = '\0';
     Clox_Hash_Table_Set(&vm->strings, retval, CLOX_VALUE_NIL);
@@ -63,11 +122,119 @@ Clox_String* Clox_String_Create(Clox_VM* vm, const char* string, uint32_t len) {
     return retval;
 }
 
+Clox_String* Clox_String_Slice(Clox_VM* vm, Clox_String* string, uint32_t start, uint32_t length) {
+    CLOX_DEV_ASSERT(start <= string->length && length <= string->length - start);
+    if (length == string->length) {
+        return string;
+    }
+    if (length == 0) {
+        return Clox_String_Create(vm, "", 0);
+    }
+
+    // NOTE(Al-Andrew): a slice of a slice points at the same parent, no chains to walk
+    if (string->parent != NULL) {
+        start += string->offset;
+        string = string->parent;
+    }
+    Clox_String* retval = (Clox_String*)Clox_Object_Allocate(vm, CLOX_OBJECT_TYPE_STRING, sizeof(Clox_String));
+    retval->hash = 0;
+    retval->length = length;
+    retval->names_intrinsic = false;
+    retval->is_hashed = false;
+    retval->parent = string;
+    retval->offset = start;
+    retval->characters[0] = '\0';
+    return retval;
+}
+
+uint32_t Clox_String_Hash(Clox_String* string) {
+    if (!string->is_hashed) {
+        string->hash = fnv_1a(Clox_String_Characters(string), string->length);
+        string->is_hashed = true;
+    }
+    return string->hash;
+}
+
+bool Clox_String_Equal(Clox_String* lhs, Clox_String* rhs) {
+    if (lhs == rhs) {
+        return true;
+    }
+    // NOTE(Al-Andrew): two interned strings are only ever the same string
+    if ((lhs->parent == NULL && rhs->parent == NULL) || lhs->length != rhs->length) {
+        return false;
+    }
+    if (Clox_String_Hash(lhs) != Clox_String_Hash(rhs)) {
+        return false;
+    }
+    return memcmp(Clox_String_Characters(lhs), Clox_String_Characters(rhs), lhs->length) == 0;
+}
+
+// NOTE(Al-Andrew): 16 starting positions at a time, a position is a candidate when both the needle's first and last
+//                  byte are where they should be. That rules out nearly everything in real text, only the candidates
+//                  get compared in full.
+bool Clox_String_Find(char const* haystack, uint32_t length, char const* needle, uint32_t needle_length, uint32_t from, uint32_t* at) {
+    if (from > length || needle_length > length - from) {
+        return false;
+    }
+    if (needle_length == 0) {
+        *at = from;
+        return true;
+    }
+
+    uint32_t last = length - needle_length; // NOTE(Al-Andrew): the last position the needle still fits at
+    uint32_t i = from;
+#if defined(__SSE2__) && defined(__GNUC__)
+    __m128i first = _mm_set1_epi8(needle[0]);
+    __m128i tail = _mm_set1_epi8(needle[needle_length - 1]);
+    for (; i <= last && last - i >= 15; i += 16) {
+        __m128i starts = _mm_loadu_si128((__m128i const*)(void const*)(haystack + i));
+        __m128i ends = _mm_loadu_si128((__m128i const*)(void const*)(haystack + i + needle_length - 1));
+        uint32_t candidates = (uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(starts, first), _mm_cmpeq_epi8(ends, tail)));
+        while (candidates != 0) {
+            uint32_t position = i + (uint32_t)__builtin_ctz(candidates);
+            if (memcmp(haystack + position + 1, needle + 1, needle_length - 1) == 0) {
+                *at = position;
+                return true;
+            }
+            candidates &= candidates - 1;
+        }
+    }
+#endif
+    for (; i <= last; i++) {
+        if (haystack[i] == needle[0] && memcmp(haystack + i + 1, needle + 1, needle_length - 1) == 0) {
+            *at = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Clox_String_Fold_Case(char* out, char const* characters, uint32_t length, bool upper) {
+    char low = upper ? 'a' : 'A';
+    char high = upper ? 'z' : 'Z';
+    uint32_t i = 0;
+#if defined(__SSE2__)
+    // NOTE(Al-Andrew): the compares are signed, bytes from 0x80 up are negative and never in range
+    __m128i below = _mm_set1_epi8((char)(low - 1));
+    __m128i above = _mm_set1_epi8((char)(high + 1));
+    __m128i flip = _mm_set1_epi8(0x20);
+    for (; i + 16 <= length; i += 16) {
+        __m128i chars = _mm_loadu_si128((__m128i const*)(void const*)(characters + i));
+        __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(chars, below), _mm_cmplt_epi8(chars, above));
+        _mm_storeu_si128((__m128i*)(void*)(out + i), _mm_xor_si128(chars, _mm_and_si128(letters, flip)));
+    }
+#endif
+    for (; i < length; i++) {
+        char c = characters[i];
+        out[i] = c >= low && c <= high ? (char)(c ^ 0x20) : c;
+    }
+}
+
 void Clox_Object_Print(Clox_Object const* const object) {
     switch (object->type) {
         case CLOX_OBJECT_TYPE_STRING: {
             Clox_String* string = (Clox_String*)object;
-            printf("\"%.*s\"", string->length, string->characters);
+            printf("\"%.*s\"", string->length, Clox_String_Characters(string));
         } break;
         case CLOX_OBJECT_TYPE_FUNCTION: {
             Clox_Function* fn = (Clox_Function*)object;
@@ -79,7 +246,11 @@ void Clox_Object_Print(Clox_Object const* const object) {
         } break;
         case CLOX_OBJECT_TYPE_NATIVE: {
             Clox_Native* native = (Clox_Native*)object;
-            printf("<native 0x%lX>", (uintptr_t)native->function);
+            if (native->name == NULL) {
+                printf("<native>");
+                return;
+            }
+            printf("<native %.*s>", native->name->length, native->name->characters);
         } break;
         case CLOX_OBJECT_TYPE_CLOSURE: {
             Clox_Closure* fn = (Clox_Closure*)object;
@@ -92,6 +263,93 @@ void Clox_Object_Print(Clox_Object const* const object) {
         case CLOX_OBJECT_TYPE_UPVALUE: {
             printf("upvalue");
         } break;
+        case CLOX_OBJECT_TYPE_LIST: {
+            Clox_List* list = (Clox_List*)object;
+            printf("[");
+            for (uint32_t i = 0; i < list->items.used; i++) {
+                if (i > 0) {
+                    printf(", ");
+                }
+                Clox_Value_Print(list->items.values[i]);
+            }
+            printf("]");
+        } break;
+        case CLOX_OBJECT_TYPE_MAP: {
+            Clox_Map* map = (Clox_Map*)object;
+            printf("{");
+            bool first = true;
+            for (uint32_t i = 0; i < map->used; i++) {
+                if (map->entries[i].removed) {
+                    continue;
+                }
+                if (!first) {
+                    printf(", ");
+                }
+                first = false;
+                Clox_Value_Print(map->entries[i].key);
+                printf(": ");
+                Clox_Value_Print(map->entries[i].value);
+            }
+            printf("}");
+        } break;
+        case CLOX_OBJECT_TYPE_FLOAT_ARRAY: {
+            Clox_Float_Array* array = (Clox_Float_Array*)object;
+            printf("Float64Array[");
+            for (uint32_t i = 0; i < array->count; i++) {
+                printf(i > 0 ? ", %g" : "%g", array->values[i]);
+            }
+            printf("]");
+        } break;
+        case CLOX_OBJECT_TYPE_SHAPE: {
+            printf("shape");
+        } break;
+        case CLOX_OBJECT_TYPE_CLASS: {
+            Clox_Class* klass = (Clox_Class*)object;
+            printf("<class %.*s>", klass->name->length, klass->name->characters);
+        } break;
+        case CLOX_OBJECT_TYPE_INSTANCE: {
+            Clox_Class* klass = ((Clox_Instance*)object)->shape->klass;
+            printf("<%.*s instance>", klass->name->length, klass->name->characters);
+        } break;
+        case CLOX_OBJECT_TYPE_BOUND_METHOD: {
+            Clox_Function* fn = ((Clox_Bound_Method*)object)->method->function;
+            printf("<closure %.*s>", fn->name->length, fn->name->characters);
+        } break;
+        case CLOX_OBJECT_TYPE_HAMT_NODE: {
+            printf("hamt node");
+        } break;
+        case CLOX_OBJECT_TYPE_PERSISTENT_MAP: {
+            Clox_Persistent_Map const* map = (Clox_Persistent_Map const*)object;
+            printf("PersistentMap{");
+            if (map->count > 0) {
+                Clox_Value* entries = reallocate(NULL, 0, sizeof(Clox_Value) * 2 * map->count);
+                Clox_Persistent_Map_Entries(map, entries);
+                for (uint32_t i = 0; i < map->count; i++) {
+                    if (i > 0) {
+                        printf(", ");
+                    }
+                    Clox_Value_Print(entries[2 * i]);
+                    printf(": ");
+                    Clox_Value_Print(entries[2 * i + 1]);
+                }
+                deallocate(entries);
+            }
+            printf("}");
+        } break;
+        case CLOX_OBJECT_TYPE_VECTOR_NODE: {
+            printf("vector node");
+        } break;
+        case CLOX_OBJECT_TYPE_PERSISTENT_VECTOR: {
+            Clox_Persistent_Vector const* vector = (Clox_Persistent_Vector const*)object;
+            printf("PersistentVector[");
+            for (uint32_t i = 0; i < vector->count; i++) {
+                if (i > 0) {
+                    printf(", ");
+                }
+                Clox_Value_Print(Clox_Persistent_Vector_Get(vector, i));
+            }
+            printf("]");
+        } break;
         }
 }
 
@@ -101,12 +359,25 @@ Clox_Function* Clox_Function_Create_Empty(Clox_VM* vm) {
     function->upvalue_count = 0;
     function->name = NULL;
     function->chunk = Clox_Chunk_New_Empty();
+    function->lazy_source = (s8){0};
+    function->lazy_line = 0;
+    function->upvalue_names = Clox_Value_Array_New_Empty();
+    function->lazy_flat_upvalues = NULL;
+    function->lazy_assigned_names = Clox_Value_Array_New_Empty();
+    function->jit = NULL;
+    function->call_caches = NULL;
+    function->property_caches = NULL;
+    function->closure = NULL;
     return function;
 }
 
 Clox_Native* Clox_Native_Create(Clox_VM* vm, Clox_Native_Fn lambda) {
     Clox_Native* native = (Clox_Native*)Clox_Object_Allocate(vm, CLOX_OBJECT_TYPE_NATIVE, sizeof(Clox_Native));
     native->function = lambda;
+    native->call = NULL;
+    native->arity = CLOX_NATIVE_VARIADIC;
+    native->flags = 0;
+    native->name = NULL;
 
     return native;
 }
@@ -116,15 +387,22 @@ Clox_Closure* Clox_Closure_Create(Clox_VM* vm, Clox_Function* function) {
     Clox_Closure* closure = (Clox_Closure*)Clox_Object_Allocate(
         vm,
         CLOX_OBJECT_TYPE_CLOSURE,
-        (uint32_t)(sizeof(Clox_Closure) + sizeof(Clox_UpvalueObj*) * (uint64_t)function->upvalue_count)
+        (uint32_t)(sizeof(Clox_Closure) + sizeof(Clox_Capture) * (uint64_t)function->upvalue_count)
     );
     closure->function = function;
     closure->upvalue_count = function->upvalue_count;
+    // NOTE(Al-Andrew): the captures are left as they are, OP_CLOSURE fills every one of them right away
+    return closure;
+}
 
-    for (int i = 0; i < function->upvalue_count; i++) {
-        closure->upvalues[i] = NULL;
+Clox_Closure* Clox_Closure_Of(Clox_VM* vm, Clox_Function* function) {
+    if (function->upvalue_count > 0) {
+        return Clox_Closure_Create(vm, function);
     }
-    return closure;
+    if (function->closure == NULL) {
+        function->closure = Clox_Closure_Create(vm, function);
+    }
+    return function->closure;
 }
 
 Clox_UpvalueObj* Clox_UpvalueObj_Create(Clox_VM* vm, Clox_Value* slot) {
@@ -159,3 +437,391 @@ Clox_UpvalueObj* Clox_Closure_Capture_Upvalue(Clox_VM* vm, Clox_Value* value) {
     Clox_UpvalueObj* captured = Clox_UpvalueObj_Create(vm, value);
     return captured;
 }
+
+Clox_List* Clox_List_Create(Clox_VM* vm, Clox_Value const* items, uint32_t count) {
+    Clox_List* list = (Clox_List*)Clox_Object_Allocate(vm, CLOX_OBJECT_TYPE_LIST, sizeof(Clox_List));
+    list->items = Clox_Value_Array_New_Empty();
+    if (count > 0) {
+        list->items.values = reallocate(NULL, 0, sizeof(Clox_Value) * count);
+        list->items.allocated = count;
+        list->items.used = count;
+        memcpy(list->items.values, items, sizeof(Clox_Value) * count);
+    }
+    return list;
+}
+
+Clox_Map* Clox_Map_Create(Clox_VM* vm) {
+    Clox_Map* map = (Clox_Map*)Clox_Object_Allocate(vm, CLOX_OBJECT_TYPE_MAP, sizeof(Clox_Map));
+    map->count = 0;
+    map->used = 0;
+    map->allocated = 0;
+    map->entries = NULL;
+    map->slots = NULL;
+    return map;
+}
+
+bool Clox_Map_Is_Key(Clox_Value key) {
+    switch (key.type) {
+        case CLOX_VALUE_TYPE_NUMBER: {
+            return key.value.number == key.value.number;
+        } break;
+        case CLOX_VALUE_TYPE_OBJECT: {
+            return key.value.object->type == CLOX_OBJECT_TYPE_STRING;
+        } break;
+        case CLOX_VALUE_TYPE_BOOL: /* fallthrough */
+        case CLOX_VALUE_TYPE_NIL: /* fallthrough */
+        case CLOX_VALUE_TYPE_INTEGER: {
+            return true;
+        } break;
+    }
+    return false;
+}
+
+// NOTE(Al-Andrew): numbers hash their double bits run through the murmur3 finalizer, the raw bits of small whole
+//                  numbers only differ in the high mantissa and exponent bits and would all land in a few slots
+uint32_t Clox_Map_Hash(Clox_Value key) {
+    switch (key.type) {
+        case CLOX_VALUE_TYPE_NUMBER: /* fallthrough */
+        case CLOX_VALUE_TYPE_INTEGER: {
+            double number = Clox_Value_As_Number(key) + 0.0; // NOTE(Al-Andrew): -0.0 + 0.0 is 0.0, both are one key
+            uint64_t bits = 0;
+            memcpy(&bits, &number, sizeof(bits));
+            bits ^= bits >> 33;
+            bits *= 0xff51afd7ed558ccdull;
+            bits ^= bits >> 33;
+            bits *= 0xc4ceb9fe1a85ec53ull;
+            bits ^= bits >> 33;
+            return (uint32_t)bits;
+        } break;
+        case CLOX_VALUE_TYPE_OBJECT: {
+            return Clox_String_Hash((Clox_String*)key.value.object);
+        } break;
+        case CLOX_VALUE_TYPE_BOOL: {
+            return key.value.boolean ? 0x9e3779b9u : 0x7f4a7c15u;
+        } break;
+        case CLOX_VALUE_TYPE_NIL: {
+            return 0x85ebca6bu;
+        } break;
+    }
+    CLOX_UNREACHABLE();
+    return 0;
+}
+
+bool Clox_Map_Keys_Equal(Clox_Value lhs, Clox_Value rhs) {
+    if (CLOX_VALUE_IS_NUMERIC(lhs) && CLOX_VALUE_IS_NUMERIC(rhs)) {
+        return Clox_Value_As_Number(lhs) == Clox_Value_As_Number(rhs);
+    }
+    if (lhs.type != rhs.type) {
+        return false;
+    }
+    switch (lhs.type) {
+        case CLOX_VALUE_TYPE_BOOL: {
+            return lhs.value.boolean == rhs.value.boolean;
+        } break;
+        case CLOX_VALUE_TYPE_OBJECT: {
+            return Clox_String_Equal((Clox_String*)lhs.value.object, (Clox_String*)rhs.value.object);
+        } break;
+        case CLOX_VALUE_TYPE_NIL: {
+            return true;
+        } break;
+        case CLOX_VALUE_TYPE_NUMBER: /* fallthrough */
+        case CLOX_VALUE_TYPE_INTEGER: {
+        } break;
+    }
+    return false;
+}
+
+static uint32_t* Clox_Map_Find_Slot(Clox_Map* map, Clox_Value key, uint32_t hash) {
+    uint32_t mask = map->allocated * 2 - 1;
+    for (uint32_t index = hash & mask;; index = (index + 1) & mask) {
+        uint32_t slot = map->slots[index];
+        if (slot == 0) {
+            return &map->slots[index];
+        }
+        Clox_Map_Entry* entry = &map->entries[slot - 1];
+        if (entry->hash == hash && !entry->removed && Clox_Map_Keys_Equal(entry->key, key)) {
+            return &map->slots[index];
+        }
+    }
+}
+
+// NOTE(Al-Andrew): drops the removed entries and sizes the arrays for twice the live ones
+static void Clox_Map_Rebuild(Clox_Map* map) {
+    // NOTE(Al-Andrew): a power of two, Clox_Map_Find_Slot masks its probes and would skip slots otherwise
+    uint32_t allocated = 8;
+    while (allocated < map->count * 2) {
+        allocated *= 2;
+    }
+    Clox_Map_Entry* entries = (Clox_Map_Entry*)reallocate(NULL, 0, sizeof(Clox_Map_Entry) * allocated);
+    uint32_t used = 0;
+    for (uint32_t i = 0; i < map->used; i++) {
+        if (!map->entries[i].removed) {
+            entries[used++] = map->entries[i];
+        }
+    }
+    if (map->entries != NULL) {
+        deallocate(map->entries);
+        deallocate(map->slots);
+    }
+    map->entries = entries;
+    map->used = used;
+    map->allocated = allocated;
+    map->slots = (uint32_t*)reallocate(NULL, 0, sizeof(uint32_t) * allocated * 2);
+    memset(map->slots, 0, sizeof(uint32_t) * allocated * 2);
+    for (uint32_t i = 0; i < used; i++) {
+        *Clox_Map_Find_Slot(map, entries[i].key, entries[i].hash) = i + 1;
+    }
+}
+
+bool Clox_Map_Get(Clox_Map* map, Clox_Value key, Clox_Value* value) {
+    if (map->count == 0) {
+        return false;
+    }
+    uint32_t slot = *Clox_Map_Find_Slot(map, key, Clox_Map_Hash(key));
+    if (slot == 0) {
+        return false;
+    }
+    *value = map->entries[slot - 1].value;
+    return true;
+}
+
+void Clox_Map_Set(Clox_Map* map, Clox_Value key, Clox_Value value) {
+    uint32_t hash = Clox_Map_Hash(key);
+    if (map->used == map->allocated) {
+        Clox_Map_Rebuild(map);
+    }
+    uint32_t* slot = Clox_Map_Find_Slot(map, key, hash);
+    if (*slot != 0) {
+        map->entries[*slot - 1].value = value;
+        return;
+    }
+    map->entries[map->used] = (Clox_Map_Entry){.key = key, .value = value, .hash = hash, .removed = false};
+    map->used++;
+    map->count++;
+    *slot = map->used;
+}
+
+bool Clox_Map_Remove(Clox_Map* map, Clox_Value key) {
+    if (map->count == 0) {
+        return false;
+    }
+    uint32_t slot = *Clox_Map_Find_Slot(map, key, Clox_Map_Hash(key));
+    if (slot == 0) {
+        return false;
+    }
+    Clox_Map_Entry* entry = &map->entries[slot - 1];
+    entry->removed = true;
+    entry->key = CLOX_VALUE_NIL;
+    entry->value = CLOX_VALUE_NIL;
+    map->count--;
+    return true;
+}
+
+Clox_Float_Array* Clox_Float_Array_Create(Clox_VM* vm, uint32_t count) {
+    Clox_Float_Array* array = (Clox_Float_Array*)Clox_Object_Allocate(vm, CLOX_OBJECT_TYPE_FLOAT_ARRAY, (uint32_t)(sizeof(Clox_Float_Array) + sizeof(double) * count));
+    array->count = count;
+    memset(array->values, 0, sizeof(double) * count);
+    return array;
+}
+
+// NOTE(Al-Andrew): the kernels keep four lanes going so the adds don't wait on each other, on x86 that's two
+//                  SSE2 registers. Reductions add up in a different order than a plain loop would, so the last
+//                  bits of a sum can differ from one.
+double Clox_Float_Array_Sum(double const* values, uint32_t count) {
+    uint32_t i = 0;
+#if defined(__SSE2__)
+    __m128d lo = _mm_setzero_pd();
+    __m128d hi = _mm_setzero_pd();
+    for (; i + 4 <= count; i += 4) {
+        lo = _mm_add_pd(lo, _mm_loadu_pd(values + i));
+        hi = _mm_add_pd(hi, _mm_loadu_pd(values + i + 2));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(lo, hi));
+    double sum = lanes[0] + lanes[1];
+#else
+    double lanes[4] = {0};
+    for (; i + 4 <= count; i += 4) {
+        lanes[0] += values[i];
+        lanes[1] += values[i + 1];
+        lanes[2] += values[i + 2];
+        lanes[3] += values[i + 3];
+    }
+    double sum = (lanes[0] + lanes[2]) + (lanes[1] + lanes[3]);
+#endif
+    for (; i < count; i++) {
+        sum += values[i];
+    }
+    return sum;
+}
+
+double Clox_Float_Array_Dot(double const* lhs, double const* rhs, uint32_t count) {
+    uint32_t i = 0;
+#if defined(__SSE2__)
+    __m128d lo = _mm_setzero_pd();
+    __m128d hi = _mm_setzero_pd();
+    for (; i + 4 <= count; i += 4) {
+        lo = _mm_add_pd(lo, _mm_mul_pd(_mm_loadu_pd(lhs + i), _mm_loadu_pd(rhs + i)));
+        hi = _mm_add_pd(hi, _mm_mul_pd(_mm_loadu_pd(lhs + i + 2), _mm_loadu_pd(rhs + i + 2)));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(lo, hi));
+    double sum = lanes[0] + lanes[1];
+#else
+    double lanes[4] = {0};
+    for (; i + 4 <= count; i += 4) {
+        lanes[0] += lhs[i] * rhs[i];
+        lanes[1] += lhs[i + 1] * rhs[i + 1];
+        lanes[2] += lhs[i + 2] * rhs[i + 2];
+        lanes[3] += lhs[i + 3] * rhs[i + 3];
+    }
+    double sum = (lanes[0] + lanes[2]) + (lanes[1] + lanes[3]);
+#endif
+    for (; i < count; i++) {
+        sum += lhs[i] * rhs[i];
+    }
+    return sum;
+}
+
+void Clox_Float_Array_Scale(double* out, double const* values, double factor, uint32_t count) {
+    uint32_t i = 0;
+#if defined(__SSE2__)
+    __m128d scale = _mm_set1_pd(factor);
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(values + i), scale));
+        _mm_storeu_pd(out + i + 2, _mm_mul_pd(_mm_loadu_pd(values + i + 2), scale));
+    }
+#endif
+    for (; i < count; i++) {
+        out[i] = values[i] * factor;
+    }
+}
+
+void Clox_Float_Array_Add(double* out, double const* lhs, double const* rhs, uint32_t count) {
+    uint32_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_pd(out + i, _mm_add_pd(_mm_loadu_pd(lhs + i), _mm_loadu_pd(rhs + i)));
+        _mm_storeu_pd(out + i + 2, _mm_add_pd(_mm_loadu_pd(lhs + i + 2), _mm_loadu_pd(rhs + i + 2)));
+    }
+#endif
+    for (; i < count; i++) {
+        out[i] = lhs[i] + rhs[i];
+    }
+}
+
+// NOTE(Al-Andrew): every lane starts at values[0] and keeps `value < lane ? value : lane`, which is what
+//                  _mm_min_pd does, so a NaN only survives when it's the first value
+double Clox_Float_Array_Min(double const* values, uint32_t count) {
+    CLOX_DEV_ASSERT(count > 0);
+    uint32_t i = 0;
+    double min = values[0];
+#if defined(__SSE2__)
+    __m128d lo = _mm_set1_pd(values[0]);
+    __m128d hi = lo;
+    for (; i + 4 <= count; i += 4) {
+        lo = _mm_min_pd(_mm_loadu_pd(values + i), lo);
+        hi = _mm_min_pd(_mm_loadu_pd(values + i + 2), hi);
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_min_pd(lo, hi));
+    min = lanes[1] < lanes[0] ? lanes[1] : lanes[0];
+#endif
+    for (; i < count; i++) {
+        min = values[i] < min ? values[i] : min;
+    }
+    return min;
+}
+
+double Clox_Float_Array_Max(double const* values, uint32_t count) {
+    CLOX_DEV_ASSERT(count > 0);
+    uint32_t i = 0;
+    double max = values[0];
+#if defined(__SSE2__)
+    __m128d lo = _mm_set1_pd(values[0]);
+    __m128d hi = lo;
+    for (; i + 4 <= count; i += 4) {
+        lo = _mm_max_pd(_mm_loadu_pd(values + i), lo);
+        hi = _mm_max_pd(_mm_loadu_pd(values + i + 2), hi);
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_max_pd(lo, hi));
+    max = lanes[1] > lanes[0] ? lanes[1] : lanes[0];
+#endif
+    for (; i < count; i++) {
+        max = values[i] > max ? values[i] : max;
+    }
+    return max;
+}
+
+static inline void Clox_Float_Array_Swap(double* lhs, double* rhs) {
+    double swap = *lhs;
+    *lhs = *rhs;
+    *rhs = swap;
+}
+
+static void Clox_Float_Array_Quick_Sort(double* values, uint32_t count) {
+    // NOTE(Al-Andrew): recurses on the smaller side and loops on the bigger one, so the depth stays logarithmic
+    while (count > 16) {
+        // NOTE(Al-Andrew): median of three, sorted in place so the ends stop both scans and the split is never empty
+        double* first = &values[0];
+        double* middle = &values[count / 2];
+        double* last = &values[count - 1];
+        if (*middle < *first) {
+            Clox_Float_Array_Swap(first, middle);
+        }
+        if (*last < *middle) {
+            Clox_Float_Array_Swap(middle, last);
+        }
+        if (*middle < *first) {
+            Clox_Float_Array_Swap(first, middle);
+        }
+        double pivot = *middle;
+        uint32_t lo = 0;
+        uint32_t hi = count - 1;
+        for (;;) {
+            while (values[lo] < pivot) {
+                lo++;
+            }
+            while (pivot < values[hi]) {
+                hi--;
+            }
+            if (lo >= hi) {
+                break;
+            }
+            Clox_Float_Array_Swap(&values[lo], &values[hi]);
+            lo++;
+            hi--;
+        }
+        uint32_t left = hi + 1;
+        if (left < count - left) {
+            Clox_Float_Array_Quick_Sort(values, left);
+            values += left;
+            count -= left;
+        } else {
+            Clox_Float_Array_Quick_Sort(values + left, count - left);
+            count = left;
+        }
+    }
+    for (uint32_t i = 1; i < count; i++) {
+        double value = values[i];
+        uint32_t j = i;
+        for (; j > 0 && value < values[j - 1]; j--) {
+            values[j] = values[j - 1];
+        }
+        values[j] = value;
+    }
+}
+
+// NOTE(Al-Andrew): a sort of its own instead of qsort, comparing doubles inline instead of through a callback
+void Clox_Float_Array_Sort(double* values, uint32_t count) {
+    // NOTE(Al-Andrew): NaNs don't compare, move them out of the way first so the partitioning never sees one
+    uint32_t numbers = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (values[i] == values[i]) {
+            Clox_Float_Array_Swap(&values[numbers], &values[i]);
+            numbers++;
+        }
+    }
+    Clox_Float_Array_Quick_Sort(values, numbers);
+}
@@ -14,6 +14,17 @@ typedef enum {
     CLOX_OBJECT_TYPE_NATIVE,
     CLOX_OBJECT_TYPE_CLOSURE,
     CLOX_OBJECT_TYPE_UPVALUE,
+    CLOX_OBJECT_TYPE_LIST,
+    CLOX_OBJECT_TYPE_FLOAT_ARRAY,
+    CLOX_OBJECT_TYPE_MAP,
+    CLOX_OBJECT_TYPE_SHAPE, // NOTE(Al-Andrew): these four are in class.h
+    CLOX_OBJECT_TYPE_CLASS,
+    CLOX_OBJECT_TYPE_INSTANCE,
+    CLOX_OBJECT_TYPE_BOUND_METHOD,
+    CLOX_OBJECT_TYPE_HAMT_NODE, // NOTE(Al-Andrew): these four are in persistent.h
+    CLOX_OBJECT_TYPE_PERSISTENT_MAP,
+    CLOX_OBJECT_TYPE_VECTOR_NODE,
+    CLOX_OBJECT_TYPE_PERSISTENT_VECTOR,
 } Clox_Object_Type;
 
 typedef struct Clox_Object Clox_Object;
@@ -30,23 +41,81 @@ void Clox_Object_Print(Clox_Object const* const object);
 
 typedef Clox_Value (*Clox_Native_Fn)(int argCount, Clox_Value* args);
 
+typedef enum {
+    CLOX_NATIVE_OK,
+    CLOX_NATIVE_ERROR, // NOTE(Al-Andrew): the message is set with Clox_VM_Native_Error
+} Clox_Native_Status;
+
+// NOTE(Al-Andrew): the arguments stay on the VM stack until the native returns, so it can allocate through `vm`
+//                  without losing them. Only writes `result` when it returns CLOX_NATIVE_OK.
+typedef Clox_Native_Status (*Clox_Native_Call)(Clox_VM* vm, int arg_count, Clox_Value* args, Clox_Value* result);
+
+#define CLOX_NATIVE_VARIADIC -1
+
+// NOTE(Al-Andrew): an intrinsic with both flags gets called by the optimizer when all its arguments are constants,
+//                  its result replaces the call (Clox_Ir_Fold_Intrinsic)
+typedef enum {
+    CLOX_NATIVE_FLAG_PURE     = 1 << 0, // NOTE(Al-Andrew): same arguments give the same result, no side effects
+    CLOX_NATIVE_FLAG_NO_ALLOC = 1 << 1, // NOTE(Al-Andrew): never allocates an object
+} Clox_Native_Flags;
+
+typedef struct {
+    char const* name;
+    Clox_Native_Call call;
+    int arity; // NOTE(Al-Andrew): checked by the VM before the call, CLOX_NATIVE_VARIADIC to take any count
+    uint32_t flags;
+} Clox_Native_Definition;
+
+typedef struct Clox_String Clox_String;
+
 typedef struct {
     Clox_Object obj;
-    Clox_Native_Fn function;
+    Clox_Native_Fn function; // NOTE(Al-Andrew): natives registered with the old signature, NULL for the others
+    Clox_Native_Call call;
+    int arity;
+    uint32_t flags;
+    Clox_String* name;
 } Clox_Native;
 
 Clox_Native* Clox_Native_Create(Clox_VM* vm, Clox_Native_Fn lambda);
 
-typedef struct Clox_String Clox_String;
+// NOTE(Al-Andrew): a slice shares `length` characters of `parent` starting at `offset` and has none of its own.
+//                  Slices are not interned, the ones that need to tell strings apart go through Clox_String_Equal.
+//                  Everything that only gets names from the compiler can keep reading `characters`.
 struct Clox_String {
     Clox_Object obj;
     uint32_t hash;
     uint32_t length;
+    bool names_intrinsic; // NOTE(Al-Andrew): some Clox_Intrinsics entry is called this, writes to the global get checked
+    bool is_hashed;       // NOTE(Al-Andrew): slices hash on first use, every other string when it's created
+    Clox_String* parent;  // NOTE(Al-Andrew): NULL unless this is a slice, never a slice itself
+    uint32_t offset;
     char characters[1];
 };
 
 Clox_String* Clox_String_Create(Clox_VM* vm, const char* string, uint32_t len);
+// NOTE(Al-Andrew): `length` characters of `string` from `start` on, without copying them
+Clox_String* Clox_String_Slice(Clox_VM* vm, Clox_String* string, uint32_t start, uint32_t length);
+uint32_t Clox_String_Hash(Clox_String* string);
+bool Clox_String_Equal(Clox_String* lhs, Clox_String* rhs);
+
+// NOTE(Al-Andrew): where `needle` first starts in `haystack` at or after `from`, false when it doesn't
+bool Clox_String_Find(char const* haystack, uint32_t length, char const* needle, uint32_t needle_length, uint32_t from, uint32_t* at);
+// NOTE(Al-Andrew): ASCII letters only, every other byte is copied as it is
+void Clox_String_Fold_Case(char* out, char const* characters, uint32_t length, bool upper);
+
+// NOTE(Al-Andrew): the characters of any string, a slice's are not '\0' terminated
+static inline char const* Clox_String_Characters(Clox_String const* string) {
+    return string->parent == NULL ? string->characters : string->parent->characters + string->offset;
+}
+
+// NOTE(Al-Andrew): monomorphic inline cache of one OP_CALL site, the last closure or native it called
+typedef struct {
+    Clox_Object* callee;
+    Clox_Object_Type kind;
+} Clox_Call_Cache;
 
+typedef struct Clox_Closure Clox_Closure;
 typedef struct Clox_Function Clox_Function;
 struct Clox_Function {
     Clox_Object obj;
@@ -54,6 +123,16 @@ struct Clox_Function {
     int upvalue_count;
     Clox_Chunk chunk;
     Clox_String* name;
+    // NOTE(Al-Andrew): only set while the body is pre-parsed but not compiled, see Clox_Compile_Lazy_Function
+    s8 lazy_source;
+    int lazy_line;
+    Clox_Value_Array upvalue_names;
+    bool* lazy_flat_upvalues; // NOTE(Al-Andrew): which of upvalue_names were captured by value, see CLOX_CAPTURE_FLAT
+    Clox_Value_Array lazy_assigned_names; // NOTE(Al-Andrew): the body's share of assigned_names, found while skimming it
+    struct Clox_Jit_Code* jit; // NOTE(Al-Andrew): native code, compiled on first use when the JIT is on
+    Clox_Call_Cache* call_caches; // NOTE(Al-Andrew): indexed by bytecode offset, allocated on the first call made
+    struct Clox_Property_Cache* property_caches; // NOTE(Al-Andrew): the same for property accesses
+    Clox_Closure* closure; // NOTE(Al-Andrew): the one closure every OP_CLOSURE shares when there's nothing to capture
 };
 
 
@@ -70,15 +149,83 @@ struct Clox_UpvalueObj {
 
 Clox_UpvalueObj* Clox_UpvalueObj_Create(Clox_VM* vm, Clox_Value* slot);
 
-typedef struct {
+// NOTE(Al-Andrew): a captured variable that's assigned somewhere is shared through an upvalue, every other one
+//                  is copied into the closure when it's made and read with OP_GET_CAPTURE
+typedef union {
+    Clox_UpvalueObj* upvalue;
+    Clox_Value value;
+} Clox_Capture;
+
+struct Clox_Closure {
     Clox_Object obj;
     Clox_Function* function;
     int upvalue_count;
-    Clox_UpvalueObj* upvalues[];
-} Clox_Closure;
+    Clox_Capture upvalues[];
+};
 
 Clox_Closure* Clox_Closure_Create(Clox_VM* vm, Clox_Function* function);
+// NOTE(Al-Andrew): Clox_Closure_Create, except a function without upvalues always gets the same closure back
+Clox_Closure* Clox_Closure_Of(Clox_VM* vm, Clox_Function* function);
 Clox_UpvalueObj* Clox_Closure_Capture_Upvalue(Clox_VM* vm, Clox_Value* value);
 
+// NOTE(Al-Andrew): `[a, b, c]`, indexed with OP_INDEX_GET/OP_INDEX_SET and grown with ListAppend
+typedef struct {
+    Clox_Object obj;
+    Clox_Value_Array items;
+} Clox_List;
+
+// NOTE(Al-Andrew): takes `count` values from `items`, the buffer is sized for them exactly
+Clox_List* Clox_List_Create(Clox_VM* vm, Clox_Value const* items, uint32_t count);
+
+typedef struct {
+    Clox_Value key;
+    Clox_Value value;
+    uint32_t hash;
+    bool removed;
+} Clox_Map_Entry;
+
+// NOTE(Al-Andrew): `{k: v}`, keyed by numbers, strings, booleans and nil. The entries sit in an array in insertion
+//                  order, `slots` is the open addressed index into it (0 is empty, otherwise entry + 1). A removed
+//                  entry keeps its slot as a tombstone until the next rebuild compacts both.
+typedef struct {
+    Clox_Object obj;
+    uint32_t count; // NOTE(Al-Andrew): live entries, `used` also counts the removed ones
+    uint32_t used;
+    uint32_t allocated;
+    Clox_Map_Entry* entries;
+    uint32_t* slots; // NOTE(Al-Andrew): twice `allocated` and a power of two, so it's never more than half full
+} Clox_Map;
+
+Clox_Map* Clox_Map_Create(Clox_VM* vm);
+bool Clox_Map_Is_Key(Clox_Value key);
+// NOTE(Al-Andrew): what maps hash and compare keys with, persistent maps share them
+uint32_t Clox_Map_Hash(Clox_Value key);
+bool Clox_Map_Keys_Equal(Clox_Value lhs, Clox_Value rhs);
+// NOTE(Al-Andrew): `key` has to pass Clox_Map_Is_Key, 1 and 1.0 are the same key
+bool Clox_Map_Get(Clox_Map* map, Clox_Value key, Clox_Value* value);
+void Clox_Map_Set(Clox_Map* map, Clox_Value key, Clox_Value value);
+bool Clox_Map_Remove(Clox_Map* map, Clox_Value key);
+
+// NOTE(Al-Andrew): fixed size array of unboxed doubles, made with Float64Array and indexed like a list. The bulk
+//                  natives run the kernels below over the whole thing in one call.
+typedef struct {
+    Clox_Object obj;
+    uint32_t count;
+    double values[];
+} Clox_Float_Array;
+
+// NOTE(Al-Andrew): the values start out zeroed
+Clox_Float_Array* Clox_Float_Array_Create(Clox_VM* vm, uint32_t count);
+
+double Clox_Float_Array_Sum(double const* values, uint32_t count);
+double Clox_Float_Array_Dot(double const* lhs, double const* rhs, uint32_t count);
+void Clox_Float_Array_Scale(double* out, double const* values, double factor, uint32_t count);
+void Clox_Float_Array_Add(double* out, double const* lhs, double const* rhs, uint32_t count);
+// NOTE(Al-Andrew): `count` has to be at least 1, NaNs are skipped unless they come first
+double Clox_Float_Array_Min(double const* values, uint32_t count);
+double Clox_Float_Array_Max(double const* values, uint32_t count);
+// NOTE(Al-Andrew): ascending, NaNs go last
+void Clox_Float_Array_Sort(double* values, uint32_t count);
+
 
 #endif // CLOX_OBJECT_H_INCLUDED
\ No newline at end of file
@@ -0,0 +1,1638 @@
+#include "optimizer.h"
+#include "chunk.h"
+#include "common.h"
+#include "memory.h"
+#include "object.h"
+#include "vm.h"
+#include <string.h>
+
+// #define CLOX_DEBUG_PRINT_OPTIMIZED_CHUNKS
+
+#define CLOX_IR_MAX_STACK 512
+#define CLOX_IR_MAX_EXPRESSIONS 256
+#define CLOX_IR_UNREACHABLE -1
+
+typedef struct {
+    Clox_Op_Code op;
+    uint8_t operand;
+    uint8_t count;      // second operand, the argument count of OP_INVOKE and OP_SUPER_INVOKE or the table size of OP_SWITCH
+    int32_t target;     // index of the target instruction for OP_JUMP, OP_JUMP_IF_FALSE, OP_LOOP and OP_FOR_LOOP
+    int32_t height;     // number of stack slots in the frame before the instruction runs
+    uint32_t line;
+    uint32_t offset;    // offset in the original chunk, OP_CLOSURE copies its upvalue pairs from there
+    bool is_leader;
+    bool removed;
+    bool in_table;      // one of the OP_JUMPs after an OP_SWITCH, they have to stay exactly where they are
+} Clox_Ir_Instruction;
+
+typedef struct {
+    Clox_VM* vm;
+    Clox_Function* function;
+    uint8_t* original_code;
+    Clox_Ir_Instruction* instructions;
+    uint32_t count;
+    bool captured[UINT8_MAX + 1]; // NOTE(Al-Andrew): slots closures can see, nothing about them is known
+    // NOTE(Al-Andrew): the natives behind the intrinsics that are pure, don't allocate and whose globals the program
+    //                  never rebinds, calls to them with constant arguments get folded. NULL for all the others.
+    Clox_Native* pure_intrinsics[CLOX_INTRINSIC_COUNT];
+} Clox_Ir;
+
+typedef enum {
+    CLOX_IR_VALUE_UNKNOWN,
+    CLOX_IR_VALUE_CONSTANT,
+    CLOX_IR_VALUE_COPY,
+} Clox_Ir_Value_Kind;
+
+// NOTE(Al-Andrew): what the forward pass knows about one stack slot
+typedef struct {
+    Clox_Ir_Value_Kind kind;
+    Clox_Value constant;    // CLOX_IR_VALUE_CONSTANT, rematerialized by `op` and `operand`
+    Clox_Op_Code op;
+    uint8_t operand;
+    uint8_t slot;           // CLOX_IR_VALUE_COPY, holds the same value as this slot
+    int32_t producer;       // instruction that pushed the value if dropping it has no side effects, -1 otherwise
+} Clox_Ir_Value;
+
+// NOTE(Al-Andrew): a pure operation value numbering has seen in the current block, `lhs` and `rhs` are the numbers
+//                  of its operands or the constant it pushes
+typedef struct {
+    Clox_Op_Code op;
+    uint32_t lhs;
+    uint32_t rhs;
+    uint32_t number;
+} Clox_Ir_Expression;
+
+typedef struct {
+    Clox_Ir_Expression expressions[CLOX_IR_MAX_EXPRESSIONS];
+    uint32_t count;
+    uint32_t next;
+} Clox_Ir_Numbering;
+
+// NOTE(Al-Andrew): what value numbering knows about one stack slot. `first` to `last` are the instructions that
+//                  computed it without side effects, `first` is -1 when there is anything else in between.
+typedef struct {
+    uint32_t number;
+    int32_t first;
+    int32_t last;
+} Clox_Ir_Numbered;
+
+static inline bool Clox_Ir_Is_Jump(Clox_Op_Code op) {
+    return op == OP_JUMP || op == OP_JUMP_IF_FALSE || op == OP_LOOP || op == OP_FOR_LOOP;
+}
+
+static inline bool Clox_Ir_Jumps_Back(Clox_Op_Code op) {
+    return op == OP_LOOP || op == OP_FOR_LOOP;
+}
+
+// NOTE(Al-Andrew): OP_FOR_LOOP has its slot before the jump
+static inline uint32_t Clox_Ir_Jump_Size(Clox_Op_Code op) {
+    return op == OP_FOR_LOOP ? 4 : 3;
+}
+
+static inline bool Clox_Ir_Is_Closure(Clox_Op_Code op) {
+    return op == OP_CLOSURE || op == OP_STACK_CLOSURE;
+}
+
+// NOTE(Al-Andrew): an OP_SWITCH falls through into the first entry of its table and jumps to the others
+static inline bool Clox_Ir_Ends_Block(Clox_Op_Code op) {
+    return Clox_Ir_Is_Jump(op) || op == OP_RETURN || op == OP_SWITCH;
+}
+
+static inline bool Clox_Ir_Falls_Through(Clox_Op_Code op) {
+    return op != OP_JUMP && op != OP_LOOP && op != OP_RETURN;
+}
+
+static int32_t Clox_Ir_Stack_Effect(Clox_Ir_Instruction const* instruction) {
+    switch (instruction->op) {
+        case OP_CONSTANT: /* fallthrough */
+        case OP_NIL: /* fallthrough */
+        case OP_TRUE: /* fallthrough */
+        case OP_FALSE: /* fallthrough */
+        case OP_GET_GLOBAL: /* fallthrough */
+        case OP_GET_LOCAL: /* fallthrough */
+        case OP_GET_UPVALUE: /* fallthrough */
+        case OP_GET_CAPTURE: /* fallthrough */
+        case OP_CLOSURE: /* fallthrough */
+        case OP_STACK_CLOSURE: /* fallthrough */
+        case OP_DUP: /* fallthrough */
+        case OP_CLASS: {
+            return 1;
+        } break;
+        case OP_ARITHMETIC_NEGATION: /* fallthrough */
+        case OP_BOOLEAN_NEGATION: /* fallthrough */
+        case OP_GET_PROPERTY: /* fallthrough */
+        case OP_SET_GLOBAL: /* fallthrough */
+        case OP_SET_LOCAL: /* fallthrough */
+        case OP_SET_UPVALUE: /* fallthrough */
+        case OP_JUMP: /* fallthrough */
+        case OP_JUMP_IF_FALSE: /* fallthrough */
+        case OP_LOOP: /* fallthrough */
+        case OP_FOR_LOOP: {
+            return 0;
+        } break;
+        case OP_RETURN: /* fallthrough */
+        case OP_ADD: /* fallthrough */
+        case OP_SUB: /* fallthrough */
+        case OP_MUL: /* fallthrough */
+        case OP_DIV: /* fallthrough */
+        case OP_EQUAL: /* fallthrough */
+        case OP_GREATER: /* fallthrough */
+        case OP_LESS: /* fallthrough */
+        case OP_PRINT: /* fallthrough */
+        case OP_POP: /* fallthrough */
+        case OP_DEFINE_GLOBAL: /* fallthrough */
+        case OP_CLOSE_UPVALUE: /* fallthrough */
+        case OP_POP_STACK_CLOSURE: /* fallthrough */
+        case OP_INHERIT: /* fallthrough */
+        case OP_METHOD: /* fallthrough */
+        case OP_SET_PROPERTY: /* fallthrough */
+        case OP_GET_SUPER: {
+            return -1;
+        } break;
+        case OP_CALL: {
+            return -(int32_t)instruction->operand;
+        } break;
+        case OP_INVOKE: {
+            return -(int32_t)instruction->count;
+        } break;
+        case OP_SUPER_INVOKE: {
+            return -(int32_t)instruction->count - 1;
+        } break;
+        case OP_CALL_0: /* fallthrough */
+        case OP_CALL_1: /* fallthrough */
+        case OP_CALL_2: /* fallthrough */
+        case OP_CALL_3: {
+            /* no-op */ // NOTE(Al-Andrew): lifted as OP_CALL
+        } break;
+        case OP_LIST: {
+            return 1 - (int32_t)instruction->operand;
+        } break;
+        case OP_MAP: {
+            return 1 - 2 * (int32_t)instruction->operand;
+        } break;
+        case OP_INDEX_GET: /* fallthrough */
+        case OP_SWITCH: {
+            return -1;
+        } break;
+        case OP_INDEX_SET: {
+            return -2;
+        } break;
+        case OP_INTRINSIC: {
+            return 1 - (int32_t)Clox_Intrinsics[instruction->operand].arity;
+        } break;
+    }
+
+    CLOX_UNREACHABLE();
+    return 0;
+}
+
+// NOTE(Al-Andrew): how many values from the top of the stack the instruction looks at
+static int32_t Clox_Ir_Stack_Reads(Clox_Ir_Instruction const* instruction) {
+    switch (instruction->op) {
+        case OP_ADD: /* fallthrough */
+        case OP_SUB: /* fallthrough */
+        case OP_MUL: /* fallthrough */
+        case OP_DIV: /* fallthrough */
+        case OP_EQUAL: /* fallthrough */
+        case OP_GREATER: /* fallthrough */
+        case OP_LESS: {
+            return 2;
+        } break;
+        case OP_ARITHMETIC_NEGATION: /* fallthrough */
+        case OP_BOOLEAN_NEGATION: /* fallthrough */
+        case OP_PRINT: /* fallthrough */
+        case OP_DEFINE_GLOBAL: /* fallthrough */
+        case OP_SET_GLOBAL: /* fallthrough */
+        case OP_SET_LOCAL: /* fallthrough */
+        case OP_SET_UPVALUE: /* fallthrough */
+        case OP_JUMP_IF_FALSE: /* fallthrough */
+        case OP_RETURN: /* fallthrough */
+        case OP_DUP: /* fallthrough */
+        case OP_POP_STACK_CLOSURE: /* fallthrough */
+        case OP_GET_PROPERTY: /* fallthrough */
+        case OP_SWITCH: {
+            return 1;
+        } break;
+        case OP_INHERIT: /* fallthrough */
+        case OP_METHOD: /* fallthrough */
+        case OP_SET_PROPERTY: /* fallthrough */
+        case OP_GET_SUPER: {
+            return 2;
+        } break;
+        case OP_CALL: {
+            return (int32_t)instruction->operand + 1;
+        } break;
+        case OP_INVOKE: {
+            return (int32_t)instruction->count + 1;
+        } break;
+        case OP_SUPER_INVOKE: {
+            return (int32_t)instruction->count + 2;
+        } break;
+        case OP_INTRINSIC: {
+            return (int32_t)Clox_Intrinsics[instruction->operand].arity;
+        } break;
+        case OP_LIST: {
+            return (int32_t)instruction->operand;
+        } break;
+        case OP_MAP: {
+            return 2 * (int32_t)instruction->operand;
+        } break;
+        case OP_INDEX_GET: {
+            return 2;
+        } break;
+        case OP_INDEX_SET: {
+            return 3;
+        } break;
+        default: break;
+    }
+    return 0;
+}
+
+static void Clox_Ir_Delete(Clox_Ir* ir) {
+    if (ir->instructions != NULL) {
+        deallocate(ir->instructions);
+    }
+    *ir = (Clox_Ir){0};
+}
+
+static bool Clox_Ir_Lift(Clox_Ir* ir) {
+    Clox_Chunk* chunk = &ir->function->chunk;
+    ir->original_code = chunk->code;
+    ir->instructions = reallocate(NULL, 0, sizeof(Clox_Ir_Instruction) * (chunk->used + 1));
+    ir->count = 0;
+
+    int32_t* index_of_offset = reallocate(NULL, 0, sizeof(int32_t) * (chunk->used + 1));
+    bool lifted = true;
+
+    for (uint32_t offset = 0; offset < chunk->used;) {
+        uint32_t size = Clox_Chunk_Op_Code_Size(chunk, offset);
+        if (size == 0 || offset + size > chunk->used) {
+            lifted = false;
+            break;
+        }
+
+        index_of_offset[offset] = (int32_t)ir->count;
+        for (uint32_t i = 1; i < size; ++i) {
+            index_of_offset[offset + i] = -1;
+        }
+
+        Clox_Ir_Instruction* instruction = &ir->instructions[ir->count++];
+        *instruction = (Clox_Ir_Instruction){
+            .op = (Clox_Op_Code)chunk->code[offset],
+            .operand = size > 1 ? chunk->code[offset + 1] : 0,
+            .target = -1,
+            .height = CLOX_IR_UNREACHABLE,
+            .line = chunk->source_lines[offset],
+            .offset = offset,
+        };
+        // NOTE(Al-Andrew): the IR only knows OP_CALL, lowering picks the short form again
+        if (instruction->op >= OP_CALL_0 && instruction->op <= OP_CALL_3) {
+            instruction->operand = (uint8_t)(instruction->op - OP_CALL_0);
+            instruction->op = OP_CALL;
+        }
+        if (instruction->op == OP_INVOKE || instruction->op == OP_SUPER_INVOKE || instruction->op == OP_SWITCH) {
+            instruction->count = chunk->code[offset + 2];
+        }
+        offset += size;
+    }
+    index_of_offset[chunk->used] = -1;
+
+    for (uint32_t i = 0; lifted && i < ir->count; ++i) {
+        Clox_Ir_Instruction* instruction = &ir->instructions[i];
+
+        if (Clox_Ir_Is_Jump(instruction->op)) {
+            uint32_t size = Clox_Ir_Jump_Size(instruction->op);
+            uint16_t jump = (uint16_t)((chunk->code[instruction->offset + size - 2] << 8) | chunk->code[instruction->offset + size - 1]);
+            int64_t target = (int64_t)instruction->offset + size + (Clox_Ir_Jumps_Back(instruction->op) ? -(int64_t)jump : (int64_t)jump);
+            if (target < 0 || target >= chunk->used || index_of_offset[target] == -1) {
+                lifted = false;
+                break;
+            }
+            instruction->target = index_of_offset[target];
+        } else if (instruction->op == OP_SWITCH) {
+            for (uint32_t entry = i + 1; lifted && entry <= i + 1 + instruction->count; ++entry) {
+                lifted = entry < ir->count && ir->instructions[entry].op == OP_JUMP;
+                if (lifted) {
+                    ir->instructions[entry].in_table = true;
+                }
+            }
+        } else if (Clox_Ir_Is_Closure(instruction->op)) {
+            Clox_Function* function = (Clox_Function*)chunk->constants.values[instruction->operand].value.object;
+            for (int j = 0; j < function->upvalue_count; j++) {
+                uint8_t capture = chunk->code[instruction->offset + 2 + (uint32_t)j * 2];
+                uint8_t index = chunk->code[instruction->offset + 2 + (uint32_t)j * 2 + 1];
+                if (capture & CLOX_CAPTURE_LOCAL) {
+                    ir->captured[index] = true;
+                }
+            }
+        }
+    }
+
+    deallocate(index_of_offset);
+    return lifted;
+}
+
+static bool Clox_Ir_Reach(Clox_Ir* ir, uint32_t* worklist, uint32_t* pending, uint32_t index, int32_t height) {
+    Clox_Ir_Instruction* successor = &ir->instructions[index];
+    if (successor->height == CLOX_IR_UNREACHABLE) {
+        successor->height = height;
+        worklist[(*pending)++] = index;
+        return true;
+    }
+    return successor->height == height;
+}
+
+// NOTE(Al-Andrew): also (re)discovers the basic blocks. Removed instructions are treated as no-ops.
+static bool Clox_Ir_Compute_Heights(Clox_Ir* ir) {
+    for (uint32_t i = 0; i < ir->count; ++i) {
+        ir->instructions[i].height = CLOX_IR_UNREACHABLE;
+        ir->instructions[i].is_leader = (i == 0);
+    }
+
+    uint32_t* worklist = reallocate(NULL, 0, sizeof(uint32_t) * (ir->count + 1));
+    uint32_t pending = 0;
+    bool consistent = true;
+
+    ir->instructions[0].height = 1 + ir->function->arity; // NOTE(Al-Andrew): the closure being run, then the arguments
+    worklist[pending++] = 0;
+
+    while (consistent && pending > 0) {
+        uint32_t index = worklist[--pending];
+        Clox_Ir_Instruction* instruction = &ir->instructions[index];
+
+        bool is_local = !instruction->removed && (instruction->op == OP_GET_LOCAL || instruction->op == OP_SET_LOCAL);
+        bool is_counted = !instruction->removed && instruction->op == OP_FOR_LOOP;
+        int32_t height = instruction->height + (instruction->removed ? 0 : Clox_Ir_Stack_Effect(instruction));
+        if (height < 0 || height > CLOX_IR_MAX_STACK || (is_local && instruction->operand >= instruction->height) ||
+            (is_counted && instruction->operand + 2 >= instruction->height)) {
+            consistent = false;
+            break;
+        }
+
+        int32_t successors[2] = {-1, -1};
+        if (instruction->removed || Clox_Ir_Falls_Through(instruction->op)) {
+            if (index + 1 >= ir->count) {
+                consistent = false;
+                break;
+            }
+            successors[0] = (int32_t)index + 1;
+        }
+        if (!instruction->removed && Clox_Ir_Is_Jump(instruction->op)) {
+            successors[1] = instruction->target;
+        }
+
+        for (int i = 0; i < 2; ++i) {
+            if (successors[i] != -1 && !Clox_Ir_Reach(ir, worklist, &pending, (uint32_t)successors[i], height)) {
+                consistent = false;
+            }
+        }
+        // NOTE(Al-Andrew): the first entry of the table is where an OP_SWITCH falls through to
+        if (!instruction->removed && instruction->op == OP_SWITCH) {
+            for (uint32_t entry = index + 2; entry <= index + 1 + instruction->count; ++entry) {
+                if (!Clox_Ir_Reach(ir, worklist, &pending, entry, height)) {
+                    consistent = false;
+                }
+            }
+        }
+    }
+
+    for (uint32_t i = 0; consistent && i < ir->count; ++i) {
+        Clox_Ir_Instruction* instruction = &ir->instructions[i];
+        if (instruction->removed) {
+            continue;
+        }
+        if (Clox_Ir_Is_Jump(instruction->op)) {
+            ir->instructions[instruction->target].is_leader = true;
+        }
+        if (Clox_Ir_Ends_Block(instruction->op) && i + 1 < ir->count) {
+            ir->instructions[i + 1].is_leader = true;
+        }
+    }
+
+    deallocate(worklist);
+    return consistent;
+}
+
+// NOTE(Al-Andrew): the last instruction before `index` that is still there, -1 if there is a block boundary in between
+static int32_t Clox_Ir_Previous(Clox_Ir* ir, uint32_t index) {
+    if (ir->instructions[index].is_leader) {
+        return -1;
+    }
+    for (int32_t i = (int32_t)index - 1; i >= 0; --i) {
+        if (!ir->instructions[i].removed) {
+            return i;
+        }
+        if (ir->instructions[i].is_leader) {
+            return -1;
+        }
+    }
+    return -1;
+}
+
+static int32_t Clox_Ir_Next(Clox_Ir* ir, uint32_t index) {
+    for (uint32_t i = index + 1; i < ir->count; ++i) {
+        if (!ir->instructions[i].removed) {
+            return (int32_t)i;
+        }
+    }
+    return -1;
+}
+
+static bool Clox_Ir_Make_Constant(Clox_Ir* ir, Clox_Value value, Clox_Op_Code* op, uint8_t* operand) {
+    switch (value.type) {
+        case CLOX_VALUE_TYPE_NIL: {
+            *op = OP_NIL;
+            return true;
+        } break;
+        case CLOX_VALUE_TYPE_BOOL: {
+            *op = value.value.boolean ? OP_TRUE : OP_FALSE;
+            return true;
+        } break;
+        default: break;
+    }
+
+    Clox_Value_Array* constants = &ir->function->chunk.constants;
+    for (uint32_t i = 0; i < constants->used; ++i) {
+        Clox_Value candidate = constants->values[i];
+        if (candidate.type != value.type) {
+            continue;
+        }
+        bool same = false;
+        switch (value.type) {
+            case CLOX_VALUE_TYPE_NUMBER: {
+                same = memcmp(&candidate.value.number, &value.value.number, sizeof(double)) == 0;
+            } break;
+            case CLOX_VALUE_TYPE_INTEGER: {
+                same = candidate.value.integer == value.value.integer;
+            } break;
+            default: {
+                same = candidate.value.object == value.value.object;
+            } break;
+        }
+        if (same && i <= UINT8_MAX) {
+            *op = OP_CONSTANT;
+            *operand = (uint8_t)i;
+            return true;
+        }
+    }
+
+    if (constants->used > UINT8_MAX) {
+        return false;
+    }
+    *op = OP_CONSTANT;
+    *operand = (uint8_t)Clox_Chunk_Push_Constant(&ir->function->chunk, value);
+    return true;
+}
+
+static inline bool Clox_Ir_Is_String(Clox_Value value) {
+    return value.type == CLOX_VALUE_TYPE_OBJECT && value.value.object->type == CLOX_OBJECT_TYPE_STRING;
+}
+
+// NOTE(Al-Andrew): mirrors what the VM does, refuses whenever the VM would raise an error
+static bool Clox_Ir_Fold(Clox_Ir* ir, Clox_Op_Code op, Clox_Value lhs, Clox_Value rhs, Clox_Value* result) {
+    bool numbers = CLOX_VALUE_IS_NUMERIC(lhs) && CLOX_VALUE_IS_NUMERIC(rhs);
+    bool integers = CLOX_VALUE_IS_INTEGER(lhs) && CLOX_VALUE_IS_INTEGER(rhs);
+    double x = numbers ? Clox_Value_As_Number(lhs) : 0.0;
+    double y = numbers ? Clox_Value_As_Number(rhs) : 0.0;
+    switch (op) {
+        case OP_ADD: {
+            if (numbers) {
+                *result = integers ? Clox_Value_Integer_Add(lhs.value.integer, rhs.value.integer) : CLOX_VALUE_NUMBER(x + y);
+                return true;
+            }
+            if (Clox_Ir_Is_String(lhs) && Clox_Ir_Is_String(rhs)) {
+                Clox_String* lhs_string = (Clox_String*)lhs.value.object;
+                Clox_String* rhs_string = (Clox_String*)rhs.value.object;
+                uint32_t length = lhs_string->length + rhs_string->length;
+                char* concat = reallocate(NULL, 0, length + 1);
+                memcpy(concat, lhs_string->characters, lhs_string->length);
+                memcpy(concat + lhs_string->length, rhs_string->characters, rhs_string->length);
+                *result = CLOX_VALUE_OBJECT(Clox_String_Create(ir->vm, concat, length));
+                deallocate(concat);
+                return true;
+            }
+            return false;
+        } break;
+        case OP_SUB: {
+            *result = integers ? Clox_Value_Integer_Sub(lhs.value.integer, rhs.value.integer) : CLOX_VALUE_NUMBER(x - y);
+            return numbers;
+        } break;
+        case OP_MUL: {
+            *result = integers ? Clox_Value_Integer_Mul(lhs.value.integer, rhs.value.integer) : CLOX_VALUE_NUMBER(x * y);
+            return numbers;
+        } break;
+        case OP_DIV: {
+            *result = integers ? Clox_Value_Integer_Div(lhs.value.integer, rhs.value.integer) : CLOX_VALUE_NUMBER(x / y);
+            return numbers;
+        } break;
+        case OP_GREATER: {
+            *result = CLOX_VALUE_BOOL(x > y);
+            return numbers;
+        } break;
+        case OP_LESS: {
+            *result = CLOX_VALUE_BOOL(x < y);
+            return numbers;
+        } break;
+        case OP_EQUAL: {
+            if (numbers) {
+                *result = CLOX_VALUE_BOOL(x == y);
+                return true;
+            }
+            if (lhs.type != rhs.type) {
+                *result = CLOX_VALUE_BOOL(false);
+                return true;
+            }
+            switch (lhs.type) {
+                case CLOX_VALUE_TYPE_NIL: *result = CLOX_VALUE_BOOL(true); return true;
+                case CLOX_VALUE_TYPE_BOOL: *result = CLOX_VALUE_BOOL(lhs.value.boolean == rhs.value.boolean); return true;
+                case CLOX_VALUE_TYPE_NUMBER: /* fallthrough */
+                case CLOX_VALUE_TYPE_INTEGER: return false; // NOTE(Al-Andrew): compared above
+                case CLOX_VALUE_TYPE_OBJECT: {
+                    // NOTE(Al-Andrew): compile time strings are all interned
+                    if (Clox_Ir_Is_String(lhs) && Clox_Ir_Is_String(rhs)) {
+                        *result = CLOX_VALUE_BOOL(lhs.value.object == rhs.value.object);
+                        return true;
+                    }
+                    return false;
+                } break;
+            }
+            return false;
+        } break;
+        default: break;
+    }
+    return false;
+}
+
+static void Clox_Ir_Forget_Slot(Clox_Ir_Value* stack, int32_t height, uint8_t slot) {
+    for (int32_t i = 0; i < height; ++i) {
+        if (stack[i].kind == CLOX_IR_VALUE_COPY && stack[i].slot == slot) {
+            stack[i] = (Clox_Ir_Value){.kind = CLOX_IR_VALUE_UNKNOWN, .producer = -1};
+        }
+    }
+}
+
+static inline bool Clox_Ir_Is_Adjacent(Clox_Ir* ir, uint32_t index, int32_t producer) {
+    return producer >= 0 && Clox_Ir_Previous(ir, index) == producer;
+}
+
+// NOTE(Al-Andrew): runs the intrinsic at `index` on its arguments now, when they are all constants pushed right
+//                  before it. Refuses whenever the native would raise an error, the call stays to report it.
+static bool Clox_Ir_Fold_Intrinsic(Clox_Ir* ir, uint32_t index, Clox_Ir_Value const* arguments, Clox_Value* result) {
+    Clox_Intrinsic intrinsic = (Clox_Intrinsic)ir->instructions[index].operand;
+    Clox_Native* native = ir->pure_intrinsics[intrinsic];
+    uint8_t arity = Clox_Intrinsics[intrinsic].arity;
+    Clox_Value values[UINT8_MAX];
+    if (native == NULL) {
+        return false;
+    }
+
+    uint32_t next = index;
+    for (int32_t i = arity - 1; i >= 0; --i) {
+        if (arguments[i].kind != CLOX_IR_VALUE_CONSTANT || !Clox_Ir_Is_Adjacent(ir, next, arguments[i].producer)) {
+            return false;
+        }
+        values[i] = arguments[i].constant;
+        next = (uint32_t)arguments[i].producer;
+    }
+    return native->call(ir->vm, arity, values, result) == CLOX_NATIVE_OK;
+}
+
+// NOTE(Al-Andrew): constant propagation, copy propagation and constant folding, one basic block at a time
+static void Clox_Ir_Propagate(Clox_Ir* ir) {
+    Clox_Ir_Value* stack = reallocate(NULL, 0, sizeof(Clox_Ir_Value) * (CLOX_IR_MAX_STACK + 1));
+    int32_t height = 0;
+    const Clox_Ir_Value unknown = {.kind = CLOX_IR_VALUE_UNKNOWN, .producer = -1};
+
+    #define CLOX_IR_PUSH(value) (stack[height++] = (value))
+    #define CLOX_IR_POP() (Clox_Ir_Forget_Slot(stack, height - 1, (uint8_t)(height - 1)), stack[--height])
+
+    for (uint32_t index = 0; index < ir->count; ++index) {
+        Clox_Ir_Instruction* instruction = &ir->instructions[index];
+        if (instruction->removed || instruction->height == CLOX_IR_UNREACHABLE) {
+            continue;
+        }
+        if (instruction->is_leader) {
+            height = instruction->height;
+            for (int32_t i = 0; i < height; ++i) {
+                stack[i] = unknown;
+            }
+        }
+        CLOX_DEV_ASSERT(height == instruction->height);
+
+        switch (instruction->op) {
+            case OP_CONSTANT: {
+                Clox_Value constant = ir->function->chunk.constants.values[instruction->operand];
+                CLOX_IR_PUSH(((Clox_Ir_Value){.kind = CLOX_IR_VALUE_CONSTANT, .constant = constant, .op = OP_CONSTANT, .operand = instruction->operand, .producer = (int32_t)index}));
+            } break;
+            case OP_NIL: {
+                CLOX_IR_PUSH(((Clox_Ir_Value){.kind = CLOX_IR_VALUE_CONSTANT, .constant = CLOX_VALUE_NIL, .op = OP_NIL, .producer = (int32_t)index}));
+            } break;
+            case OP_TRUE: /* fallthrough */
+            case OP_FALSE: {
+                Clox_Value constant = CLOX_VALUE_BOOL(instruction->op == OP_TRUE);
+                CLOX_IR_PUSH(((Clox_Ir_Value){.kind = CLOX_IR_VALUE_CONSTANT, .constant = constant, .op = instruction->op, .producer = (int32_t)index}));
+            } break;
+            case OP_GET_LOCAL: {
+                uint8_t slot = instruction->operand;
+                Clox_Ir_Value value = ir->captured[slot] ? unknown : stack[slot];
+                if (value.kind == CLOX_IR_VALUE_CONSTANT) {
+                    instruction->op = value.op;
+                    instruction->operand = value.operand;
+                } else if (value.kind == CLOX_IR_VALUE_COPY) {
+                    instruction->operand = value.slot;
+                } else if (!ir->captured[slot]) {
+                    value = (Clox_Ir_Value){.kind = CLOX_IR_VALUE_COPY, .slot = slot};
+                }
+                value.producer = (int32_t)index;
+                CLOX_IR_PUSH(value);
+            } break;
+            case OP_SET_LOCAL: {
+                uint8_t slot = instruction->operand;
+                stack[height - 1].producer = -1;
+                Clox_Ir_Value value = stack[height - 1];
+                if (value.kind == CLOX_IR_VALUE_COPY && value.slot == slot) {
+                    break; // NOTE(Al-Andrew): `a = a;`
+                }
+                Clox_Ir_Forget_Slot(stack, height, slot);
+                stack[slot] = ir->captured[slot] ? unknown : value;
+            } break;
+            case OP_GET_UPVALUE: /* fallthrough */
+            case OP_GET_CAPTURE: {
+                CLOX_IR_PUSH(((Clox_Ir_Value){.kind = CLOX_IR_VALUE_UNKNOWN, .producer = (int32_t)index}));
+            } break;
+            case OP_DUP: {
+                Clox_Ir_Value value = stack[height - 1];
+                value.producer = (int32_t)index;
+                CLOX_IR_PUSH(value);
+            } break;
+            case OP_GET_GLOBAL: /* fallthrough */
+            case OP_CLOSURE: /* fallthrough */
+            case OP_STACK_CLOSURE: {
+                CLOX_IR_PUSH(unknown);
+            } break;
+            case OP_SET_GLOBAL: /* fallthrough */
+            case OP_SET_UPVALUE: {
+                stack[height - 1].producer = -1;
+            } break;
+            case OP_POP: {
+                Clox_Ir_Value value = CLOX_IR_POP();
+                if (Clox_Ir_Is_Adjacent(ir, index, value.producer)) {
+                    ir->instructions[value.producer].removed = true;
+                    instruction->removed = true;
+                }
+            } break;
+            case OP_ARITHMETIC_NEGATION: /* fallthrough */
+            case OP_BOOLEAN_NEGATION: {
+                Clox_Ir_Value operand = CLOX_IR_POP();
+                Clox_Ir_Value result = unknown;
+                bool foldable = operand.kind == CLOX_IR_VALUE_CONSTANT && Clox_Ir_Is_Adjacent(ir, index, operand.producer);
+                if (foldable) {
+                    Clox_Value folded = {0};
+                    if (instruction->op == OP_ARITHMETIC_NEGATION && CLOX_VALUE_IS_NUMBER(operand.constant)) {
+                        folded = CLOX_VALUE_NUMBER(-operand.constant.value.number);
+                    } else if (instruction->op == OP_ARITHMETIC_NEGATION && CLOX_VALUE_IS_INTEGER(operand.constant)) {
+                        folded = Clox_Value_Integer_Negate(operand.constant.value.integer);
+                    } else if (instruction->op == OP_BOOLEAN_NEGATION && CLOX_VALUE_IS_BOOL(operand.constant)) {
+                        folded = CLOX_VALUE_BOOL(!operand.constant.value.boolean);
+                    } else if (instruction->op == OP_BOOLEAN_NEGATION && CLOX_VALUE_IS_NIL(operand.constant)) {
+                        folded = CLOX_VALUE_BOOL(true);
+                    } else {
+                        foldable = false;
+                    }
+
+                    Clox_Op_Code op = OP_CONSTANT;
+                    uint8_t constant = 0;
+                    if (foldable && Clox_Ir_Make_Constant(ir, folded, &op, &constant)) {
+                        ir->instructions[operand.producer].removed = true;
+                        instruction->op = op;
+                        instruction->operand = constant;
+                        result = (Clox_Ir_Value){.kind = CLOX_IR_VALUE_CONSTANT, .constant = folded, .op = op, .operand = constant, .producer = (int32_t)index};
+                    }
+                }
+                CLOX_IR_PUSH(result);
+            } break;
+            case OP_ADD: /* fallthrough */
+            case OP_SUB: /* fallthrough */
+            case OP_MUL: /* fallthrough */
+            case OP_DIV: /* fallthrough */
+            case OP_EQUAL: /* fallthrough */
+            case OP_GREATER: /* fallthrough */
+            case OP_LESS: {
+                Clox_Ir_Value rhs = CLOX_IR_POP();
+                Clox_Ir_Value lhs = CLOX_IR_POP();
+                Clox_Ir_Value result = unknown;
+
+                bool foldable = lhs.kind == CLOX_IR_VALUE_CONSTANT && rhs.kind == CLOX_IR_VALUE_CONSTANT
+                    && Clox_Ir_Is_Adjacent(ir, index, rhs.producer)
+                    && Clox_Ir_Is_Adjacent(ir, (uint32_t)rhs.producer, lhs.producer);
+                Clox_Value folded = {0};
+                Clox_Op_Code op = OP_CONSTANT;
+                uint8_t constant = 0;
+                if (foldable && Clox_Ir_Fold(ir, instruction->op, lhs.constant, rhs.constant, &folded) && Clox_Ir_Make_Constant(ir, folded, &op, &constant)) {
+                    ir->instructions[lhs.producer].removed = true;
+                    ir->instructions[rhs.producer].removed = true;
+                    instruction->op = op;
+                    instruction->operand = constant;
+                    result = (Clox_Ir_Value){.kind = CLOX_IR_VALUE_CONSTANT, .constant = folded, .op = op, .operand = constant, .producer = (int32_t)index};
+                }
+                CLOX_IR_PUSH(result);
+            } break;
+            case OP_JUMP_IF_FALSE: {
+                Clox_Ir_Value condition = stack[height - 1];
+                if (condition.kind == CLOX_IR_VALUE_CONSTANT) {
+                    if (Clox_Value_Is_Falsy(condition.constant)) {
+                        instruction->op = OP_JUMP;
+                    } else {
+                        instruction->removed = true;
+                    }
+                }
+                stack[height - 1].producer = instruction->removed ? condition.producer : -1;
+            } break;
+            case OP_CALL: {
+                for (int32_t i = 0; i <= (int32_t)instruction->operand; ++i) {
+                    CLOX_IR_POP();
+                }
+                CLOX_IR_PUSH(unknown);
+            } break;
+            case OP_CALL_0: /* fallthrough */
+            case OP_CALL_1: /* fallthrough */
+            case OP_CALL_2: /* fallthrough */
+            case OP_CALL_3: {
+                CLOX_UNREACHABLE(); // NOTE(Al-Andrew): lifted as OP_CALL
+            } break;
+            case OP_LIST: /* fallthrough */
+            case OP_MAP: /* fallthrough */
+            case OP_INDEX_GET: /* fallthrough */
+            case OP_INDEX_SET: /* fallthrough */
+            case OP_CLASS: /* fallthrough */
+            case OP_INHERIT: /* fallthrough */
+            case OP_METHOD: /* fallthrough */
+            case OP_GET_PROPERTY: /* fallthrough */
+            case OP_SET_PROPERTY: /* fallthrough */
+            case OP_GET_SUPER: /* fallthrough */
+            case OP_INVOKE: /* fallthrough */
+            case OP_SUPER_INVOKE: {
+                for (int32_t i = 0; i < Clox_Ir_Stack_Reads(instruction); ++i) {
+                    CLOX_IR_POP();
+                }
+                CLOX_IR_PUSH(unknown);
+            } break;
+            case OP_INTRINSIC: {
+                int32_t arity = (int32_t)Clox_Intrinsics[instruction->operand].arity;
+                Clox_Ir_Value result = unknown;
+                Clox_Value folded = {0};
+                Clox_Op_Code op = OP_CONSTANT;
+                uint8_t constant = 0;
+                if (Clox_Ir_Fold_Intrinsic(ir, index, stack + height - arity, &folded) && Clox_Ir_Make_Constant(ir, folded, &op, &constant)) {
+                    for (int32_t i = height - arity; i < height; ++i) {
+                        ir->instructions[stack[i].producer].removed = true;
+                    }
+                    instruction->op = op;
+                    instruction->operand = constant;
+                    result = (Clox_Ir_Value){.kind = CLOX_IR_VALUE_CONSTANT, .constant = folded, .op = op, .operand = constant, .producer = (int32_t)index};
+                }
+                for (int32_t i = 0; i < arity; ++i) {
+                    CLOX_IR_POP();
+                }
+                CLOX_IR_PUSH(result);
+            } break;
+            case OP_RETURN: /* fallthrough */
+            case OP_PRINT: /* fallthrough */
+            case OP_DEFINE_GLOBAL: /* fallthrough */
+            case OP_CLOSE_UPVALUE: /* fallthrough */
+            case OP_POP_STACK_CLOSURE: /* fallthrough */
+            case OP_SWITCH: {
+                CLOX_IR_POP();
+            } break;
+            case OP_JUMP: /* fallthrough */
+            case OP_LOOP: {
+                /* no-op */
+            } break;
+            case OP_FOR_LOOP: {
+                Clox_Ir_Forget_Slot(stack, height, instruction->operand);
+                stack[instruction->operand] = unknown;
+            } break;
+        }
+    }
+
+    #undef CLOX_IR_PUSH
+    #undef CLOX_IR_POP
+    deallocate(stack);
+}
+
+// NOTE(Al-Andrew): the number of `op` on `lhs` and `rhs`, `known` says whether the block already computed it. Once
+//                  the table is full every new expression just gets a number of its own.
+static uint32_t Clox_Ir_Number(Clox_Ir_Numbering* numbering, Clox_Op_Code op, uint32_t lhs, uint32_t rhs, bool* known) {
+    for (uint32_t i = 0; i < numbering->count; ++i) {
+        Clox_Ir_Expression const* expression = &numbering->expressions[i];
+        if (expression->op == op && expression->lhs == lhs && expression->rhs == rhs) {
+            *known = true;
+            return expression->number;
+        }
+    }
+    *known = false;
+    uint32_t number = numbering->next++;
+    if (numbering->count < CLOX_IR_MAX_EXPRESSIONS) {
+        numbering->expressions[numbering->count++] = (Clox_Ir_Expression){.op = op, .lhs = lhs, .rhs = rhs, .number = number};
+    }
+    return number;
+}
+
+// NOTE(Al-Andrew): block-local value numbering. Two stack slots with the same number hold the same value: the same
+//                  constant, reads of a local with no store in between, or the same pure operation on equal operands.
+//                  An operation whose result is still in a slot of the frame becomes a read of that slot, the pushes of
+//                  its operands go with it. The block already ran the operation once without an error, so dropping the
+//                  second one can't hide one.
+static void Clox_Ir_Number_Values(Clox_Ir* ir) {
+    Clox_Ir_Numbering* numbering = reallocate(NULL, 0, sizeof(Clox_Ir_Numbering));
+    Clox_Ir_Numbered* stack = reallocate(NULL, 0, sizeof(Clox_Ir_Numbered) * (CLOX_IR_MAX_STACK + 1));
+    numbering->count = 0;
+    numbering->next = 0;
+    int32_t height = 0;
+    bool block_start = false;
+
+    for (uint32_t index = 0; index < ir->count; ++index) {
+        Clox_Ir_Instruction* instruction = &ir->instructions[index];
+        // NOTE(Al-Andrew): the leader itself might be gone, the block still starts there
+        block_start = block_start || instruction->is_leader;
+        if (instruction->removed || instruction->height == CLOX_IR_UNREACHABLE) {
+            continue;
+        }
+        if (block_start) {
+            block_start = false;
+            height = instruction->height;
+            numbering->count = 0;
+            for (int32_t i = 0; i < height; ++i) {
+                stack[i] = (Clox_Ir_Numbered){.number = numbering->next++, .first = -1, .last = -1};
+            }
+        }
+        CLOX_DEV_ASSERT(height == instruction->height);
+
+        switch (instruction->op) {
+            case OP_CONSTANT: /* fallthrough */
+            case OP_NIL: /* fallthrough */
+            case OP_TRUE: /* fallthrough */
+            case OP_FALSE: {
+                // NOTE(Al-Andrew): the compiler adds the same constant again for every mention, the first one
+                //                  stands for all of them
+                Clox_Op_Code op = instruction->op;
+                uint8_t constant = 0;
+                if (op == OP_CONSTANT) {
+                    Clox_Ir_Make_Constant(ir, ir->function->chunk.constants.values[instruction->operand], &op, &constant);
+                }
+                bool known = false;
+                uint32_t number = Clox_Ir_Number(numbering, op, constant, 0, &known);
+                stack[height++] = (Clox_Ir_Numbered){.number = number, .first = (int32_t)index, .last = (int32_t)index};
+            } break;
+            case OP_GET_LOCAL: {
+                // NOTE(Al-Andrew): any call can change a slot a closure sees
+                uint8_t slot = instruction->operand;
+                uint32_t number = ir->captured[slot] ? numbering->next++ : stack[slot].number;
+                stack[height++] = (Clox_Ir_Numbered){.number = number, .first = (int32_t)index, .last = (int32_t)index};
+            } break;
+            case OP_DUP: {
+                uint32_t number = stack[height - 1].number;
+                stack[height++] = (Clox_Ir_Numbered){.number = number, .first = (int32_t)index, .last = (int32_t)index};
+            } break;
+            case OP_SET_LOCAL: {
+                uint8_t slot = instruction->operand;
+                stack[slot].number = ir->captured[slot] ? numbering->next++ : stack[height - 1].number;
+                stack[height - 1].first = -1;
+            } break;
+            case OP_FOR_LOOP: {
+                stack[instruction->operand].number = numbering->next++;
+            } break;
+            case OP_ARITHMETIC_NEGATION: /* fallthrough */
+            case OP_BOOLEAN_NEGATION: /* fallthrough */
+            case OP_ADD: /* fallthrough */
+            case OP_SUB: /* fallthrough */
+            case OP_MUL: /* fallthrough */
+            case OP_DIV: /* fallthrough */
+            case OP_EQUAL: /* fallthrough */
+            case OP_GREATER: /* fallthrough */
+            case OP_LESS: {
+                int32_t reads = Clox_Ir_Stack_Reads(instruction);
+                Clox_Ir_Numbered const* operands = stack + height - reads;
+                uint32_t lhs = operands[0].number;
+                uint32_t rhs = reads == 2 ? operands[1].number : 0;
+                if ((instruction->op == OP_MUL || instruction->op == OP_EQUAL) && lhs > rhs) {
+                    uint32_t swap = lhs;
+                    lhs = rhs;
+                    rhs = swap;
+                }
+                bool known = false;
+                uint32_t number = Clox_Ir_Number(numbering, instruction->op, lhs, rhs, &known);
+
+                bool contiguous = true;
+                uint32_t after = index;
+                for (int32_t i = reads - 1; i >= 0 && contiguous; --i) {
+                    contiguous = operands[i].first != -1 && Clox_Ir_Previous(ir, after) == operands[i].last;
+                    after = (uint32_t)operands[i].first;
+                }
+                int32_t first = contiguous ? operands[0].first : -1;
+                height -= reads;
+
+                int32_t holder = -1;
+                for (int32_t slot = 0; known && contiguous && slot < height && slot <= UINT8_MAX && holder == -1; ++slot) {
+                    if (stack[slot].number == number && !ir->captured[slot]) {
+                        holder = slot;
+                    }
+                }
+                if (holder != -1) {
+                    for (int32_t i = first; i < (int32_t)index; ++i) {
+                        ir->instructions[i].removed = true;
+                    }
+                    instruction->op = OP_GET_LOCAL;
+                    instruction->operand = (uint8_t)holder;
+                    first = (int32_t)index;
+                }
+                stack[height++] = (Clox_Ir_Numbered){.number = number, .first = first, .last = (int32_t)index};
+            } break;
+            default: {
+                int32_t effect = Clox_Ir_Stack_Effect(instruction);
+                int32_t reads = Clox_Ir_Stack_Reads(instruction);
+                if (reads < -effect) {
+                    reads = -effect;
+                }
+                height -= reads;
+                for (int32_t i = 0; i < reads + effect; ++i) {
+                    stack[height++] = (Clox_Ir_Numbered){.number = numbering->next++, .first = -1, .last = -1};
+                }
+            } break;
+        }
+    }
+
+    deallocate(stack);
+    deallocate(numbering);
+}
+
+// NOTE(Al-Andrew): the compiler adds a new constant for every mention of a global, so compare the names instead
+static bool Clox_Ir_Same_Variable(Clox_Ir* ir, Clox_Ir_Instruction const* lhs, Clox_Ir_Instruction const* rhs) {
+    if (lhs->operand == rhs->operand) {
+        return true;
+    }
+    if (lhs->op != OP_GET_GLOBAL && lhs->op != OP_SET_GLOBAL) {
+        return false;
+    }
+    Clox_Value_Array* constants = &ir->function->chunk.constants;
+    return constants->values[lhs->operand].value.object == constants->values[rhs->operand].value.object;
+}
+
+// NOTE(Al-Andrew): redundant loads inside a block. A load of what is already on top of the stack becomes an OP_DUP,
+//                  a load right after a store of the same variable just keeps the stored value instead of popping it.
+static void Clox_Ir_Eliminate_Common_Loads(Clox_Ir* ir) {
+    for (uint32_t index = 0; index < ir->count; ++index) {
+        Clox_Ir_Instruction* instruction = &ir->instructions[index];
+        if (instruction->removed || instruction->height == CLOX_IR_UNREACHABLE) {
+            continue;
+        }
+
+        bool is_load = instruction->op == OP_GET_LOCAL || instruction->op == OP_GET_GLOBAL || instruction->op == OP_GET_UPVALUE;
+        if (!is_load) {
+            continue;
+        }
+
+        int32_t previous = Clox_Ir_Previous(ir, index);
+        if (previous == -1) {
+            continue;
+        }
+        Clox_Ir_Instruction* before = &ir->instructions[previous];
+
+        if (before->op == instruction->op && Clox_Ir_Same_Variable(ir, before, instruction)) {
+            instruction->op = OP_DUP;
+            instruction->operand = 0;
+            continue;
+        }
+
+        Clox_Op_Code store = instruction->op == OP_GET_LOCAL ? OP_SET_LOCAL : instruction->op == OP_GET_GLOBAL ? OP_SET_GLOBAL : OP_SET_UPVALUE;
+        if (before->op != OP_POP) {
+            continue;
+        }
+        int32_t stored = Clox_Ir_Previous(ir, (uint32_t)previous);
+        if (stored != -1 && ir->instructions[stored].op == store && Clox_Ir_Same_Variable(ir, &ir->instructions[stored], instruction)) {
+            before->removed = true;
+            instruction->removed = true;
+        }
+    }
+}
+
+// NOTE(Al-Andrew): stores to locals nobody reads before the slot is overwritten, popped or the function returns
+static void Clox_Ir_Eliminate_Dead_Stores(Clox_Ir* ir) {
+    bool live[UINT8_MAX + 1];
+
+    uint32_t block_end = ir->count;
+    for (int32_t index = (int32_t)ir->count - 1; index >= 0; --index) {
+        Clox_Ir_Instruction* instruction = &ir->instructions[index];
+
+        if ((uint32_t)index + 1 == block_end) {
+            // NOTE(Al-Andrew): only a return tells us nothing is read anymore, any other block end might be
+            bool returns = !instruction->removed && instruction->op == OP_RETURN;
+            memset(live, returns ? 0 : 1, sizeof(live));
+        }
+        if (instruction->is_leader) {
+            block_end = (uint32_t)index;
+        }
+        if (instruction->removed || instruction->height == CLOX_IR_UNREACHABLE) {
+            continue;
+        }
+
+        int32_t height_after = instruction->height + Clox_Ir_Stack_Effect(instruction);
+        for (int32_t slot = height_after < 0 ? 0 : height_after; slot <= UINT8_MAX; ++slot) {
+            live[slot] = false;
+        }
+        // NOTE(Al-Andrew): stack operands are reads of their slots too, an inlined return stores its result that way
+        for (int32_t slot = instruction->height - Clox_Ir_Stack_Reads(instruction); slot < instruction->height; ++slot) {
+            if (slot >= 0 && slot <= UINT8_MAX) {
+                live[slot] = true;
+            }
+        }
+
+        uint8_t slot = instruction->operand;
+        if (instruction->op == OP_GET_LOCAL) {
+            live[slot] = true;
+        } else if (instruction->op == OP_FOR_LOOP) {
+            live[slot] = live[slot + 1] = live[slot + 2] = true;
+        } else if (instruction->op == OP_SET_LOCAL) {
+            if (!live[slot] && !ir->captured[slot]) {
+                instruction->removed = true; // NOTE(Al-Andrew): the store only peeks, the value stays on the stack
+            }
+            live[slot] = ir->captured[slot];
+        }
+    }
+}
+
+// NOTE(Al-Andrew): values pushed only to be popped again, and jumps to the very next instruction
+static void Clox_Ir_Peephole(Clox_Ir* ir) {
+    for (uint32_t index = 0; index < ir->count; ++index) {
+        Clox_Ir_Instruction* instruction = &ir->instructions[index];
+        if (instruction->removed || instruction->height == CLOX_IR_UNREACHABLE) {
+            continue;
+        }
+
+        if (instruction->op == OP_POP) {
+            int32_t previous = Clox_Ir_Previous(ir, index);
+            if (previous == -1) {
+                continue;
+            }
+            switch (ir->instructions[previous].op) {
+                case OP_CONSTANT: /* fallthrough */
+                case OP_NIL: /* fallthrough */
+                case OP_TRUE: /* fallthrough */
+                case OP_FALSE: /* fallthrough */
+                case OP_GET_LOCAL: /* fallthrough */
+                case OP_GET_UPVALUE: /* fallthrough */
+                case OP_GET_CAPTURE: /* fallthrough */
+                case OP_DUP: {
+                    ir->instructions[previous].removed = true;
+                    instruction->removed = true;
+                } break;
+                default: break;
+            }
+        } else if (instruction->op == OP_JUMP && !instruction->in_table) {
+            int32_t next = Clox_Ir_Next(ir, index);
+            int32_t target = instruction->target;
+            while (target != -1 && ir->instructions[target].removed) {
+                target = Clox_Ir_Next(ir, (uint32_t)target);
+            }
+            if (next != -1 && next == target) {
+                instruction->removed = true;
+            }
+        }
+    }
+}
+
+static void Clox_Ir_Remove_Unreachable(Clox_Ir* ir) {
+    for (uint32_t i = 0; i < ir->count; ++i) {
+        if (ir->instructions[i].height == CLOX_IR_UNREACHABLE) {
+            ir->instructions[i].removed = true;
+        }
+    }
+}
+
+static bool Clox_Ir_Lower(Clox_Ir* ir) {
+    uint32_t* new_offset = reallocate(NULL, 0, sizeof(uint32_t) * (ir->count + 1));
+    Clox_Chunk* chunk = &ir->function->chunk;
+
+    Clox_Chunk lowered = Clox_Chunk_New_Empty();
+    lowered.constants = chunk->constants;
+    bool ok = true;
+
+    for (uint32_t i = 0; i < ir->count; ++i) {
+        new_offset[i] = lowered.used;
+        Clox_Ir_Instruction* instruction = &ir->instructions[i];
+        if (instruction->removed) {
+            continue;
+        }
+
+        if (instruction->op == OP_CALL && instruction->operand <= CLOX_MAX_SHORT_CALL_ARGS) {
+            Clox_Chunk_Push(&lowered, (uint8_t)(OP_CALL_0 + instruction->operand), instruction->line);
+            continue;
+        }
+        Clox_Chunk_Push(&lowered, (uint8_t)instruction->op, instruction->line);
+        switch (instruction->op) {
+            case OP_CONSTANT: /* fallthrough */
+            case OP_DEFINE_GLOBAL: /* fallthrough */
+            case OP_GET_GLOBAL: /* fallthrough */
+            case OP_SET_GLOBAL: /* fallthrough */
+            case OP_GET_LOCAL: /* fallthrough */
+            case OP_SET_LOCAL: /* fallthrough */
+            case OP_GET_UPVALUE: /* fallthrough */
+            case OP_GET_CAPTURE: /* fallthrough */
+            case OP_SET_UPVALUE: /* fallthrough */
+            case OP_CALL: /* fallthrough */
+            case OP_INTRINSIC: /* fallthrough */
+            case OP_LIST: /* fallthrough */
+            case OP_MAP: /* fallthrough */
+            case OP_CLASS: /* fallthrough */
+            case OP_METHOD: /* fallthrough */
+            case OP_GET_PROPERTY: /* fallthrough */
+            case OP_SET_PROPERTY: /* fallthrough */
+            case OP_GET_SUPER: {
+                Clox_Chunk_Push(&lowered, instruction->operand, instruction->line);
+            } break;
+            case OP_INVOKE: /* fallthrough */
+            case OP_SUPER_INVOKE: /* fallthrough */
+            case OP_SWITCH: {
+                Clox_Chunk_Push(&lowered, instruction->operand, instruction->line);
+                Clox_Chunk_Push(&lowered, instruction->count, instruction->line);
+            } break;
+            case OP_FOR_LOOP: {
+                Clox_Chunk_Push(&lowered, instruction->operand, instruction->line);
+            } /* fallthrough */
+            case OP_JUMP: /* fallthrough */
+            case OP_JUMP_IF_FALSE: /* fallthrough */
+            case OP_LOOP: {
+                // NOTE(Al-Andrew): patched below, once every offset is known
+                Clox_Chunk_Push(&lowered, 0xff, instruction->line);
+                Clox_Chunk_Push(&lowered, 0xff, instruction->line);
+            } break;
+            case OP_CLOSURE: /* fallthrough */
+            case OP_STACK_CLOSURE: {
+                Clox_Chunk_Push(&lowered, instruction->operand, instruction->line);
+                Clox_Function* function = (Clox_Function*)chunk->constants.values[instruction->operand].value.object;
+                for (uint32_t j = 0; j < (uint32_t)function->upvalue_count * 2; ++j) {
+                    Clox_Chunk_Push(&lowered, ir->original_code[instruction->offset + 2 + j], instruction->line);
+                }
+            } break;
+            default: break;
+        }
+    }
+    new_offset[ir->count] = lowered.used;
+
+    for (uint32_t i = 0; i < ir->count; ++i) {
+        Clox_Ir_Instruction* instruction = &ir->instructions[i];
+        if (instruction->removed || !Clox_Ir_Is_Jump(instruction->op)) {
+            continue;
+        }
+
+        uint32_t target = new_offset[instruction->target]; // NOTE(Al-Andrew): removed targets fall through to the next one
+        uint32_t after_jump = new_offset[i] + Clox_Ir_Jump_Size(instruction->op);
+        int64_t jump = Clox_Ir_Jumps_Back(instruction->op) ? (int64_t)after_jump - (int64_t)target : (int64_t)target - (int64_t)after_jump;
+        if (jump < 0 || jump > UINT16_MAX) {
+            ok = false;
+            break;
+        }
+        lowered.code[after_jump - 2] = (uint8_t)((jump >> 8) & 0xff);
+        lowered.code[after_jump - 1] = (uint8_t)(jump & 0xff);
+    }
+
+    deallocate(new_offset);
+
+    if (!ok) {
+        lowered.constants = (Clox_Value_Array){0};
+        Clox_Chunk_Delete(&lowered);
+        return false;
+    }
+
+    chunk->constants = (Clox_Value_Array){0};
+    Clox_Chunk_Delete(chunk);
+    *chunk = lowered;
+    return true;
+}
+
+static bool Clox_Ir_Optimize(Clox_Ir* ir) {
+    Clox_Function* function = ir->function;
+    bool optimized = function->chunk.used > 0
+        && Clox_Ir_Lift(ir)
+        && Clox_Ir_Compute_Heights(ir);
+
+    if (optimized) {
+        Clox_Ir_Propagate(ir);
+        Clox_Ir_Eliminate_Common_Loads(ir);
+        optimized = Clox_Ir_Compute_Heights(ir);
+    }
+    if (optimized) {
+        Clox_Ir_Remove_Unreachable(ir);
+        Clox_Ir_Number_Values(ir);
+        Clox_Ir_Eliminate_Dead_Stores(ir);
+        Clox_Ir_Peephole(ir);
+        optimized = Clox_Ir_Compute_Heights(ir);
+    }
+    if (optimized) {
+        Clox_Ir_Remove_Unreachable(ir);
+        optimized = Clox_Ir_Lower(ir);
+    }
+
+#ifdef CLOX_DEBUG_PRINT_OPTIMIZED_CHUNKS
+    if (optimized) {
+        Clox_Chunk_Print(&function->chunk, function->name != NULL ? function->name->characters : "<script>");
+    }
+#endif // CLOX_DEBUG_PRINT_OPTIMIZED_CHUNKS
+
+    Clox_Ir_Delete(ir);
+    return optimized;
+}
+
+bool Clox_Optimize_Function(Clox_VM* vm, Clox_Function* function) {
+    Clox_Ir ir = {.vm = vm, .function = function};
+    return Clox_Ir_Optimize(&ir);
+}
+
+// NOTE(Al-Andrew): callees bigger than this many bytes of bytecode are always called, and no caller grows by more
+//                  than CLOX_INLINE_CALLER_BUDGET bytes
+#define CLOX_INLINE_CALLEE_BUDGET 48
+#define CLOX_INLINE_CALLER_BUDGET 1024
+#define CLOX_IR_SPLICED UINT32_MAX // NOTE(Al-Andrew): offset of instructions copied from a callee, their jumps are already final
+
+typedef struct {
+    Clox_String* name;
+    Clox_Function* function;    // NULL if the global isn't bound to a top level `fun` exactly once
+    uint32_t defined_at;        // offset of the OP_DEFINE_GLOBAL in the script
+} Clox_Inline_Candidate;
+
+typedef struct {
+    Clox_VM* vm;
+    Clox_Inline_Candidate* candidates;
+    uint32_t count;
+    uint32_t allocated;
+    bool has_lazy_functions;
+    Clox_Native* pure_intrinsics[CLOX_INTRINSIC_COUNT]; // NOTE(Al-Andrew): handed to the optimizer, see Clox_Ir
+} Clox_Inliner;
+
+static Clox_Inline_Candidate* Clox_Inliner_Find(Clox_Inliner* inliner, Clox_String* name) {
+    for (uint32_t i = 0; i < inliner->count; ++i) {
+        if (inliner->candidates[i].name == name) {
+            return &inliner->candidates[i];
+        }
+    }
+    return NULL;
+}
+
+static void Clox_Inliner_Bind(Clox_Inliner* inliner, Clox_String* name, Clox_Function* function, uint32_t defined_at) {
+    Clox_Inline_Candidate* candidate = Clox_Inliner_Find(inliner, name);
+    if (candidate != NULL) {
+        candidate->function = NULL; // NOTE(Al-Andrew): bound twice, the binding isn't stable
+        return;
+    }
+
+    if (inliner->count == inliner->allocated) {
+        uint32_t allocated = inliner->allocated < 8 ? 8 : inliner->allocated * 2;
+        inliner->candidates = reallocate(inliner->candidates, sizeof(Clox_Inline_Candidate) * inliner->allocated, sizeof(Clox_Inline_Candidate) * allocated);
+        inliner->allocated = allocated;
+    }
+    inliner->candidates[inliner->count++] = (Clox_Inline_Candidate){.name = name, .function = function, .defined_at = defined_at};
+}
+
+static inline Clox_Function* Clox_Inliner_Closure_Function(Clox_Chunk* chunk, uint32_t offset) {
+    return (Clox_Function*)chunk->constants.values[chunk->code[offset + 1]].value.object;
+}
+
+static inline Clox_String* Clox_Inliner_Global_Name(Clox_Chunk* chunk, uint8_t constant) {
+    return (Clox_String*)chunk->constants.values[constant].value.object;
+}
+
+// NOTE(Al-Andrew): any assignment to a global anywhere in the program makes it unstable
+static void Clox_Inliner_Find_Assignments(Clox_Inliner* inliner, Clox_Function* function) {
+    Clox_Chunk* chunk = &function->chunk;
+    if (chunk->used == 0 && function->lazy_source.string != NULL) {
+        inliner->has_lazy_functions = true;
+        return;
+    }
+
+    for (uint32_t offset = 0; offset < chunk->used;) {
+        uint32_t size = Clox_Chunk_Op_Code_Size(chunk, offset);
+        if (size == 0) {
+            inliner->has_lazy_functions = true; // NOTE(Al-Andrew): can't see what it does, treat it like a lazy one
+            return;
+        }
+
+        if (chunk->code[offset] == OP_SET_GLOBAL) {
+            Clox_Inliner_Bind(inliner, Clox_Inliner_Global_Name(chunk, chunk->code[offset + 1]), NULL, 0);
+        } else if (Clox_Ir_Is_Closure((Clox_Op_Code)chunk->code[offset])) {
+            Clox_Inliner_Find_Assignments(inliner, Clox_Inliner_Closure_Function(chunk, offset));
+        }
+        offset += size;
+    }
+}
+
+// NOTE(Al-Andrew): the callee has to be small, a plain top level function that doesn't capture anything and doesn't
+//                  create closures itself, since those would capture slots of the caller's frame
+static bool Clox_Inliner_Is_Inlinable(Clox_Function* callee) {
+    Clox_Chunk* chunk = &callee->chunk;
+    if (callee->upvalue_count != 0 || chunk->used == 0 || chunk->used > CLOX_INLINE_CALLEE_BUDGET) {
+        return false;
+    }
+
+    for (uint32_t offset = 0; offset < chunk->used;) {
+        uint32_t size = Clox_Chunk_Op_Code_Size(chunk, offset);
+        switch (size == 0 ? OP_CLOSURE : (Clox_Op_Code)chunk->code[offset]) {
+            case OP_CLOSURE: /* fallthrough */
+            case OP_STACK_CLOSURE: /* fallthrough */
+            case OP_POP_STACK_CLOSURE: /* fallthrough */
+            case OP_CLOSE_UPVALUE: /* fallthrough */
+            case OP_GET_UPVALUE: /* fallthrough */
+            case OP_GET_CAPTURE: /* fallthrough */
+            case OP_SET_UPVALUE: /* fallthrough */
+            case OP_CLASS: /* fallthrough */
+            case OP_INHERIT: /* fallthrough */
+            case OP_GET_SUPER: /* fallthrough */
+            case OP_SUPER_INVOKE: /* fallthrough */
+            case OP_SWITCH: {
+                return false;
+            } break;
+            default: break;
+        }
+        offset += size;
+    }
+    return true;
+}
+
+typedef struct {
+    Clox_Ir_Instruction* instructions;
+    uint32_t count;
+    uint32_t allocated;
+} Clox_Ir_Builder;
+
+static uint32_t Clox_Ir_Builder_Push(Clox_Ir_Builder* builder, Clox_Ir_Instruction instruction) {
+    if (builder->count == builder->allocated) {
+        uint32_t allocated = builder->allocated < 64 ? 64 : builder->allocated * 2;
+        builder->instructions = reallocate(builder->instructions, sizeof(Clox_Ir_Instruction) * builder->allocated, sizeof(Clox_Ir_Instruction) * allocated);
+        builder->allocated = allocated;
+    }
+    instruction.removed = false;
+    builder->instructions[builder->count] = instruction;
+    return builder->count++;
+}
+
+// NOTE(Al-Andrew): copies the callee's body in place of the OP_CALL. Its slot 0 is the placeholder that replaced the
+//                  callee on the stack (slot `base` of the caller), a return stores the result there and pops the rest.
+static bool Clox_Inliner_Splice(Clox_Ir* caller, Clox_Ir_Builder* builder, Clox_Function* callee, uint8_t base, uint32_t line) {
+    Clox_Ir ir = {.vm = caller->vm, .function = callee};
+    bool spliced = Clox_Ir_Lift(&ir) && Clox_Ir_Compute_Heights(&ir);
+
+    int32_t max_height = 0;
+    int32_t last_reachable = -1;
+    for (uint32_t i = 0; spliced && i < ir.count; ++i) {
+        Clox_Ir_Instruction* instruction = &ir.instructions[i];
+        if (instruction->height == CLOX_IR_UNREACHABLE) {
+            continue;
+        }
+        int32_t effect = Clox_Ir_Stack_Effect(instruction);
+        int32_t height = instruction->height + (effect > 0 ? effect : 0);
+        max_height = height > max_height ? height : max_height;
+        last_reachable = (int32_t)i;
+    }
+    spliced = spliced && base + max_height <= UINT8_MAX + 1;
+
+    int32_t* new_index = spliced ? reallocate(NULL, 0, sizeof(int32_t) * ir.count) : NULL;
+    uint32_t first = builder->count;
+
+    for (uint32_t i = 0; spliced && i < ir.count; ++i) {
+        Clox_Ir_Instruction instruction = ir.instructions[i];
+        new_index[i] = -1;
+        if (instruction.height == CLOX_IR_UNREACHABLE) {
+            continue;
+        }
+        new_index[i] = (int32_t)builder->count;
+        instruction.line = line;
+        instruction.offset = CLOX_IR_SPLICED;
+
+        switch (instruction.op) {
+            case OP_GET_LOCAL: /* fallthrough */
+            case OP_SET_LOCAL: /* fallthrough */
+            case OP_FOR_LOOP: {
+                instruction.operand = (uint8_t)(instruction.operand + base);
+            } break;
+            case OP_CONSTANT: /* fallthrough */
+            case OP_GET_GLOBAL: /* fallthrough */
+            case OP_SET_GLOBAL: /* fallthrough */
+            case OP_GET_PROPERTY: /* fallthrough */
+            case OP_SET_PROPERTY: /* fallthrough */
+            case OP_INVOKE: {
+                Clox_Op_Code op = OP_CONSTANT;
+                Clox_Value constant = callee->chunk.constants.values[instruction.operand];
+                spliced = Clox_Ir_Make_Constant(caller, constant, &op, &instruction.operand);
+                if (instruction.op == OP_CONSTANT) {
+                    instruction.op = op;
+                }
+            } break;
+            case OP_RETURN: {
+                Clox_Ir_Builder_Push(builder, (Clox_Ir_Instruction){.op = OP_SET_LOCAL, .operand = base, .line = line, .offset = CLOX_IR_SPLICED, .target = -1});
+                for (int32_t j = 1; j < instruction.height; ++j) {
+                    Clox_Ir_Builder_Push(builder, (Clox_Ir_Instruction){.op = OP_POP, .line = line, .offset = CLOX_IR_SPLICED, .target = -1});
+                }
+                if ((int32_t)i != last_reachable) {
+                    Clox_Ir_Builder_Push(builder, (Clox_Ir_Instruction){.op = OP_JUMP, .line = line, .offset = CLOX_IR_SPLICED, .target = -2});
+                }
+                continue;
+            } break;
+            default: break;
+        }
+        Clox_Ir_Builder_Push(builder, instruction);
+    }
+
+    uint32_t end = builder->count;
+    for (uint32_t i = first; spliced && i < end; ++i) {
+        Clox_Ir_Instruction* instruction = &builder->instructions[i];
+        if (Clox_Ir_Is_Jump(instruction->op)) {
+            // NOTE(Al-Andrew): -2 marks the jumps out of a return, they land on whatever follows the call
+            instruction->target = instruction->target == -2 ? (int32_t)end : new_index[instruction->target];
+        }
+    }
+
+    if (new_index != NULL) {
+        deallocate(new_index);
+    }
+    builder->count = spliced ? builder->count : first;
+    Clox_Ir_Delete(&ir);
+    return spliced;
+}
+
+// NOTE(Al-Andrew): `position` is where in the script the caller came to be, call sites in the script itself pass
+//                  UINT32_MAX and use their own offset. A callee is only known once its OP_DEFINE_GLOBAL ran.
+static void Clox_Inliner_Inline_Calls(Clox_Inliner* inliner, Clox_Function* caller, uint32_t position) {
+    Clox_Ir ir = {.vm = inliner->vm, .function = caller};
+    memcpy(ir.pure_intrinsics, inliner->pure_intrinsics, sizeof(ir.pure_intrinsics));
+    if (caller->chunk.used == 0 || !Clox_Ir_Lift(&ir) || !Clox_Ir_Compute_Heights(&ir)) {
+        Clox_Ir_Delete(&ir);
+        return;
+    }
+
+    Clox_Function** callees = reallocate(NULL, 0, sizeof(Clox_Function*) * ir.count);
+    int32_t* callee_load = reallocate(NULL, 0, sizeof(int32_t) * ir.count);
+    uint32_t spliced_size = 0;
+    bool found = false;
+
+    for (uint32_t i = 0; i < ir.count; ++i) {
+        callees[i] = NULL;
+        callee_load[i] = -1;
+    }
+
+    for (uint32_t i = 0; i < ir.count; ++i) {
+        Clox_Ir_Instruction* call = &ir.instructions[i];
+        if (call->op != OP_CALL || call->height == CLOX_IR_UNREACHABLE) {
+            continue;
+        }
+
+        // NOTE(Al-Andrew): the callee was pushed by the last instruction in the block that ran at its height
+        int32_t callee_slot = call->height - call->operand - 1;
+        int32_t load = -1;
+        for (int32_t j = (int32_t)i - 1; j >= 0 && !ir.instructions[j + 1].is_leader; --j) {
+            if (ir.instructions[j].height == callee_slot) {
+                load = j;
+                break;
+            }
+        }
+        if (load == -1 || ir.instructions[load].op != OP_GET_GLOBAL || callee_slot > UINT8_MAX) {
+            continue;
+        }
+        // NOTE(Al-Andrew): the load turns into a placeholder, nothing else may look at it (an OP_DUP for `f(f(x))`)
+        bool is_read = false;
+        for (uint32_t j = (uint32_t)load + 1; j < i; ++j) {
+            Clox_Ir_Instruction* between = &ir.instructions[j];
+            is_read |= between->height - Clox_Ir_Stack_Reads(between) <= callee_slot;
+            is_read |= between->op == OP_GET_LOCAL && between->operand == callee_slot;
+        }
+        if (is_read) {
+            continue;
+        }
+
+        Clox_Inline_Candidate* candidate = Clox_Inliner_Find(inliner, Clox_Inliner_Global_Name(&caller->chunk, ir.instructions[load].operand));
+        uint32_t site = position == UINT32_MAX ? ir.instructions[load].offset : position;
+        if (candidate == NULL || candidate->function == NULL || candidate->function == caller
+            || candidate->defined_at >= site || candidate->function->arity != call->operand
+            || !Clox_Inliner_Is_Inlinable(candidate->function)) {
+            continue;
+        }
+        if (spliced_size + candidate->function->chunk.used > CLOX_INLINE_CALLER_BUDGET) {
+            break;
+        }
+        spliced_size += candidate->function->chunk.used;
+        callees[i] = candidate->function;
+        callee_load[i] = load;
+        found = true;
+    }
+
+    // NOTE(Al-Andrew): a call to a pure intrinsic can only be folded now, the function's own optimizer run didn't
+    //                  know yet whether the program rebinds it
+    bool folds = false;
+    for (uint32_t i = 0; i < ir.count; ++i) {
+        folds |= ir.instructions[i].op == OP_INTRINSIC && ir.pure_intrinsics[ir.instructions[i].operand] != NULL;
+    }
+
+    Clox_Ir_Builder builder = {0};
+    int32_t* new_index = reallocate(NULL, 0, sizeof(int32_t) * ir.count);
+    bool inlined = false;
+
+    for (uint32_t i = 0; found && i < ir.count; ++i) {
+        Clox_Ir_Instruction instruction = ir.instructions[i];
+        new_index[i] = (int32_t)builder.count;
+
+        if (callees[i] != NULL) {
+            uint8_t base = (uint8_t)(instruction.height - instruction.operand - 1);
+            int32_t load = new_index[callee_load[i]];
+            builder.instructions[load].op = OP_NIL; // NOTE(Al-Andrew): holds the callee's slot 0, the result ends up there
+            if (Clox_Inliner_Splice(&ir, &builder, callees[i], base, instruction.line)) {
+                inlined = true;
+                continue;
+            }
+            builder.instructions[load].op = OP_GET_GLOBAL;
+        }
+        Clox_Ir_Builder_Push(&builder, instruction);
+    }
+
+    if (inlined) {
+        for (uint32_t i = 0; i < builder.count; ++i) {
+            Clox_Ir_Instruction* instruction = &builder.instructions[i];
+            if (Clox_Ir_Is_Jump(instruction->op) && instruction->offset != CLOX_IR_SPLICED) {
+                instruction->target = new_index[instruction->target];
+            }
+        }
+
+        deallocate(ir.instructions);
+        ir.instructions = builder.instructions;
+        ir.count = builder.count;
+        builder.instructions = NULL;
+
+        folds |= Clox_Ir_Compute_Heights(&ir) && Clox_Ir_Lower(&ir);
+    }
+    if (folds && inliner->vm->config.optimize) {
+        Clox_Ir optimized = {.vm = inliner->vm, .function = caller};
+        memcpy(optimized.pure_intrinsics, inliner->pure_intrinsics, sizeof(optimized.pure_intrinsics));
+        Clox_Ir_Optimize(&optimized);
+    }
+
+    if (builder.instructions != NULL) {
+        deallocate(builder.instructions);
+    }
+    deallocate(new_index);
+    deallocate(callee_load);
+    deallocate(callees);
+    Clox_Ir_Delete(&ir);
+}
+
+// NOTE(Al-Andrew): functions are visited in the order the script creates them, so a callee has already had its own
+//                  calls inlined by the time it gets inlined somewhere else
+static void Clox_Inliner_Visit(Clox_Inliner* inliner, Clox_Function* function, uint32_t position) {
+    Clox_Chunk* chunk = &function->chunk;
+    for (uint32_t offset = 0; offset < chunk->used;) {
+        uint32_t size = Clox_Chunk_Op_Code_Size(chunk, offset);
+        if (size == 0) {
+            return;
+        }
+        if (Clox_Ir_Is_Closure((Clox_Op_Code)chunk->code[offset])) {
+            Clox_Inliner_Visit(inliner, Clox_Inliner_Closure_Function(chunk, offset), position == UINT32_MAX ? offset : position);
+        }
+        offset += size;
+    }
+    Clox_Inliner_Inline_Calls(inliner, function, position);
+}
+
+void Clox_Inline_Functions(Clox_VM* vm, Clox_Function* script) {
+    Clox_Inliner inliner = {.vm = vm};
+    Clox_Chunk* chunk = &script->chunk;
+
+    for (uint32_t offset = 0, previous = 0; offset < chunk->used;) {
+        uint32_t size = Clox_Chunk_Op_Code_Size(chunk, offset);
+        if (size == 0) {
+            inliner.has_lazy_functions = true;
+            break;
+        }
+        if (chunk->code[offset] == OP_DEFINE_GLOBAL) {
+            bool is_fun = offset > 0 && chunk->code[previous] == OP_CLOSURE;
+            Clox_Inliner_Bind(&inliner, Clox_Inliner_Global_Name(chunk, chunk->code[offset + 1]), is_fun ? Clox_Inliner_Closure_Function(chunk, previous) : NULL, offset);
+        }
+        previous = offset;
+        offset += size;
+    }
+    Clox_Inliner_Find_Assignments(&inliner, script);
+
+    for (uint32_t i = 0; i < CLOX_INTRINSIC_COUNT; ++i) {
+        Clox_String* name = vm->intrinsic_names[i];
+        Clox_Value native = CLOX_VALUE_NIL;
+        uint32_t flags = CLOX_NATIVE_FLAG_PURE | CLOX_NATIVE_FLAG_NO_ALLOC;
+        if (!(vm->intrinsics_rebound & (1u << i)) && Clox_Inliner_Find(&inliner, name) == NULL && Clox_Hash_Table_Get(&vm->globals, name, &native)
+            && CLOX_VALUE_IS_OBJECT(native) && native.value.object->type == CLOX_OBJECT_TYPE_NATIVE
+            && (((Clox_Native*)native.value.object)->flags & flags) == flags) {
+            inliner.pure_intrinsics[i] = (Clox_Native*)native.value.object;
+        }
+    }
+
+    if (!inliner.has_lazy_functions) {
+        Clox_Inliner_Visit(&inliner, script, UINT32_MAX);
+    }
+
+    if (inliner.candidates != NULL) {
+        deallocate(inliner.candidates);
+    }
+}
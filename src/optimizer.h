@@ -0,0 +1,17 @@
+#ifndef CLOX_OPTIMIZER_H_INCLUDED
+#define CLOX_OPTIMIZER_H_INCLUDED
+
+#include "object.h"
+
+// NOTE(Al-Andrew): the compiler writes bytecode directly, so the optimizer lifts a finished chunk into a
+//                  list of instructions with resolved jump targets (the IR), runs its passes over that and
+//                  lowers it back into the chunk. Functions using opcodes the IR doesn't model are left alone.
+//                  The passes are constant and copy propagation with folding, block-local value numbering over the
+//                  pure arithmetic and comparisons, redundant load and dead store elimination and a peephole pass.
+bool Clox_Optimize_Function(Clox_VM* vm, Clox_Function* function);
+
+// NOTE(Al-Andrew): replaces calls to small top level functions with their bodies, across the whole script. Only
+//                  globals bound once by a `fun` and never assigned count, so it needs the full program up front.
+void Clox_Inline_Functions(Clox_VM* vm, Clox_Function* script);
+
+#endif // CLOX_OPTIMIZER_H_INCLUDED
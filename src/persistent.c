@@ -0,0 +1,458 @@
+#include "persistent.h"
+#include "common.h"
+#include "memory.h"
+#include <string.h>
+
+// NOTE(Al-Andrew): a level takes 5 bits, levels at shift 0 to 30 use them all up and the one below is a collision node
+#define CLOX_HAMT_HASH_BITS 32
+
+static inline uint32_t Clox_Hamt_Popcount(uint32_t bits) {
+#if defined(__GNUC__)
+    return (uint32_t)__builtin_popcount(bits);
+#else
+    bits = bits - ((bits >> 1) & 0x55555555u);
+    bits = (bits & 0x33333333u) + ((bits >> 2) & 0x33333333u);
+    return (((bits + (bits >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24;
+#endif
+}
+
+static inline uint32_t Clox_Hamt_Bit(uint32_t hash, uint32_t shift) {
+    return 1u << ((hash >> shift) & CLOX_PERSISTENT_MASK);
+}
+
+// NOTE(Al-Andrew): where the pair or child for `bit` sits among the ones `map` has
+static inline uint32_t Clox_Hamt_Index(uint32_t map, uint32_t bit) {
+    return Clox_Hamt_Popcount(map & (bit - 1));
+}
+
+static inline Clox_Hamt_Node* Clox_Hamt_Child(Clox_Hamt_Node const* node, uint32_t index) {
+    return (Clox_Hamt_Node*)node->items[2 * node->entry_count + index].value.object;
+}
+
+static Clox_Hamt_Node* Clox_Hamt_Node_Create(Clox_VM* vm, uint32_t entry_map, uint32_t child_map, uint32_t entry_count, uint32_t child_count) {
+    uint32_t size = (uint32_t)(sizeof(Clox_Hamt_Node) + sizeof(Clox_Value) * (2 * entry_count + child_count));
+    Clox_Hamt_Node* node = (Clox_Hamt_Node*)Clox_Object_Allocate(vm, CLOX_OBJECT_TYPE_HAMT_NODE, size);
+    node->entry_map = entry_map;
+    node->child_map = child_map;
+    node->entry_count = entry_count;
+    node->child_count = child_count;
+    return node;
+}
+
+static Clox_Hamt_Node* Clox_Hamt_Copy(Clox_VM* vm, Clox_Hamt_Node const* node) {
+    Clox_Hamt_Node* copy = Clox_Hamt_Node_Create(vm, node->entry_map, node->child_map, node->entry_count, node->child_count);
+    memcpy(copy->items, node->items, sizeof(Clox_Value) * (2 * node->entry_count + node->child_count));
+    return copy;
+}
+
+static Clox_Hamt_Node* Clox_Hamt_Insert_Entry(Clox_VM* vm, Clox_Hamt_Node const* node, uint32_t bit, Clox_Value key, Clox_Value value) {
+    uint32_t entry = Clox_Hamt_Index(node->entry_map, bit);
+    Clox_Hamt_Node* grown = Clox_Hamt_Node_Create(vm, node->entry_map | bit, node->child_map, node->entry_count + 1, node->child_count);
+    Clox_Value const* from = node->items;
+    Clox_Value* to = grown->items;
+    memcpy(to, from, sizeof(Clox_Value) * 2 * entry);
+    to[2 * entry] = key;
+    to[2 * entry + 1] = value;
+    memcpy(to + 2 * entry + 2, from + 2 * entry, sizeof(Clox_Value) * (2 * (node->entry_count - entry) + node->child_count));
+    return grown;
+}
+
+// NOTE(Al-Andrew): also takes pairs out of collision nodes, with a `bit` of 0
+static Clox_Hamt_Node* Clox_Hamt_Remove_Entry(Clox_VM* vm, Clox_Hamt_Node const* node, uint32_t bit, uint32_t entry) {
+    Clox_Hamt_Node* shrunk = Clox_Hamt_Node_Create(vm, node->entry_map & ~bit, node->child_map, node->entry_count - 1, node->child_count);
+    Clox_Value const* from = node->items;
+    Clox_Value* to = shrunk->items;
+    memcpy(to, from, sizeof(Clox_Value) * 2 * entry);
+    memcpy(to + 2 * entry, from + 2 * entry + 2, sizeof(Clox_Value) * (2 * (node->entry_count - entry - 1) + node->child_count));
+    return shrunk;
+}
+
+// NOTE(Al-Andrew): the pair at `bit` makes room for `child`, which holds it together with the key that collided
+static Clox_Hamt_Node* Clox_Hamt_Entry_To_Child(Clox_VM* vm, Clox_Hamt_Node const* node, uint32_t bit, Clox_Hamt_Node* child) {
+    uint32_t entry = Clox_Hamt_Index(node->entry_map, bit);
+    uint32_t slot = Clox_Hamt_Index(node->child_map, bit);
+    Clox_Hamt_Node* moved = Clox_Hamt_Node_Create(vm, node->entry_map & ~bit, node->child_map | bit, node->entry_count - 1, node->child_count + 1);
+    Clox_Value const* from = node->items;
+    Clox_Value* to = moved->items;
+    memcpy(to, from, sizeof(Clox_Value) * 2 * entry);
+    memcpy(to + 2 * entry, from + 2 * entry + 2, sizeof(Clox_Value) * 2 * (node->entry_count - entry - 1));
+    from += 2 * node->entry_count;
+    to += 2 * moved->entry_count;
+    memcpy(to, from, sizeof(Clox_Value) * slot);
+    to[slot] = CLOX_VALUE_OBJECT(child);
+    memcpy(to + slot + 1, from + slot, sizeof(Clox_Value) * (node->child_count - slot));
+    return moved;
+}
+
+// NOTE(Al-Andrew): the child at `bit` is down to one pair, which takes its place
+static Clox_Hamt_Node* Clox_Hamt_Child_To_Entry(Clox_VM* vm, Clox_Hamt_Node const* node, uint32_t bit, Clox_Value key, Clox_Value value) {
+    uint32_t entry = Clox_Hamt_Index(node->entry_map, bit);
+    uint32_t slot = Clox_Hamt_Index(node->child_map, bit);
+    Clox_Hamt_Node* moved = Clox_Hamt_Node_Create(vm, node->entry_map | bit, node->child_map & ~bit, node->entry_count + 1, node->child_count - 1);
+    Clox_Value const* from = node->items;
+    Clox_Value* to = moved->items;
+    memcpy(to, from, sizeof(Clox_Value) * 2 * entry);
+    to[2 * entry] = key;
+    to[2 * entry + 1] = value;
+    memcpy(to + 2 * entry + 2, from + 2 * entry, sizeof(Clox_Value) * 2 * (node->entry_count - entry));
+    from += 2 * node->entry_count;
+    to += 2 * moved->entry_count;
+    memcpy(to, from, sizeof(Clox_Value) * slot);
+    memcpy(to + slot, from + slot + 1, sizeof(Clox_Value) * (node->child_count - slot - 1));
+    return moved;
+}
+
+// NOTE(Al-Andrew): the node at `shift` holding two pairs whose hashes agree on every level above it
+static Clox_Hamt_Node* Clox_Hamt_Merge(
+    Clox_VM* vm, uint32_t shift,
+    Clox_Value key_a, uint32_t hash_a, Clox_Value value_a,
+    Clox_Value key_b, uint32_t hash_b, Clox_Value value_b
+) {
+    if (shift >= CLOX_HAMT_HASH_BITS) {
+        Clox_Hamt_Node* collision = Clox_Hamt_Node_Create(vm, 0, 0, 2, 0);
+        collision->items[0] = key_a;
+        collision->items[1] = value_a;
+        collision->items[2] = key_b;
+        collision->items[3] = value_b;
+        return collision;
+    }
+
+    uint32_t bit_a = Clox_Hamt_Bit(hash_a, shift);
+    uint32_t bit_b = Clox_Hamt_Bit(hash_b, shift);
+    if (bit_a == bit_b) {
+        Clox_Hamt_Node* child = Clox_Hamt_Merge(vm, shift + CLOX_PERSISTENT_BITS, key_a, hash_a, value_a, key_b, hash_b, value_b);
+        Clox_Hamt_Node* node = Clox_Hamt_Node_Create(vm, 0, bit_a, 0, 1);
+        node->items[0] = CLOX_VALUE_OBJECT(child);
+        return node;
+    }
+
+    Clox_Hamt_Node* node = Clox_Hamt_Node_Create(vm, bit_a | bit_b, 0, 2, 0);
+    uint32_t first = bit_a < bit_b ? 0 : 2;
+    node->items[first] = key_a;
+    node->items[first + 1] = value_a;
+    node->items[2 - first] = key_b;
+    node->items[3 - first] = value_b;
+    return node;
+}
+
+static Clox_Hamt_Node* Clox_Hamt_Set(
+    Clox_VM* vm, Clox_Hamt_Node const* node, uint32_t shift, Clox_Value key, uint32_t hash, Clox_Value value, bool* added
+) {
+    if (shift >= CLOX_HAMT_HASH_BITS) {
+        for (uint32_t i = 0; i < node->entry_count; i++) {
+            if (Clox_Map_Keys_Equal(node->items[2 * i], key)) {
+                Clox_Hamt_Node* copy = Clox_Hamt_Copy(vm, node);
+                copy->items[2 * i + 1] = value;
+                return copy;
+            }
+        }
+        *added = true;
+        return Clox_Hamt_Insert_Entry(vm, node, 0, key, value);
+    }
+
+    uint32_t bit = Clox_Hamt_Bit(hash, shift);
+    if (node->entry_map & bit) {
+        uint32_t entry = Clox_Hamt_Index(node->entry_map, bit);
+        Clox_Value existing = node->items[2 * entry];
+        if (Clox_Map_Keys_Equal(existing, key)) {
+            Clox_Hamt_Node* copy = Clox_Hamt_Copy(vm, node);
+            copy->items[2 * entry + 1] = value;
+            return copy;
+        }
+        Clox_Hamt_Node* child = Clox_Hamt_Merge(
+            vm, shift + CLOX_PERSISTENT_BITS,
+            existing, Clox_Map_Hash(existing), node->items[2 * entry + 1],
+            key, hash, value
+        );
+        *added = true;
+        return Clox_Hamt_Entry_To_Child(vm, node, bit, child);
+    }
+    if (node->child_map & bit) {
+        uint32_t slot = Clox_Hamt_Index(node->child_map, bit);
+        Clox_Hamt_Node* child = Clox_Hamt_Set(vm, Clox_Hamt_Child(node, slot), shift + CLOX_PERSISTENT_BITS, key, hash, value, added);
+        Clox_Hamt_Node* copy = Clox_Hamt_Copy(vm, node);
+        copy->items[2 * copy->entry_count + slot] = CLOX_VALUE_OBJECT(child);
+        return copy;
+    }
+    *added = true;
+    return Clox_Hamt_Insert_Entry(vm, node, bit, key, value);
+}
+
+// NOTE(Al-Andrew): `node` itself when it doesn't have `key`
+static Clox_Hamt_Node* Clox_Hamt_Remove(Clox_VM* vm, Clox_Hamt_Node* node, uint32_t shift, Clox_Value key, uint32_t hash) {
+    if (shift >= CLOX_HAMT_HASH_BITS) {
+        for (uint32_t i = 0; i < node->entry_count; i++) {
+            if (Clox_Map_Keys_Equal(node->items[2 * i], key)) {
+                return Clox_Hamt_Remove_Entry(vm, node, 0, i);
+            }
+        }
+        return node;
+    }
+
+    uint32_t bit = Clox_Hamt_Bit(hash, shift);
+    if (node->entry_map & bit) {
+        uint32_t entry = Clox_Hamt_Index(node->entry_map, bit);
+        if (!Clox_Map_Keys_Equal(node->items[2 * entry], key)) {
+            return node;
+        }
+        return Clox_Hamt_Remove_Entry(vm, node, bit, entry);
+    }
+    if (node->child_map & bit) {
+        uint32_t slot = Clox_Hamt_Index(node->child_map, bit);
+        Clox_Hamt_Node* child = Clox_Hamt_Child(node, slot);
+        Clox_Hamt_Node* updated = Clox_Hamt_Remove(vm, child, shift + CLOX_PERSISTENT_BITS, key, hash);
+        if (updated == child) {
+            return node;
+        }
+        // NOTE(Al-Andrew): a child below the root always has two pairs or a child of its own before the removal,
+        //                  so it can't come back empty
+        if (updated->entry_count == 1 && updated->child_count == 0) {
+            return Clox_Hamt_Child_To_Entry(vm, node, bit, updated->items[0], updated->items[1]);
+        }
+        Clox_Hamt_Node* copy = Clox_Hamt_Copy(vm, node);
+        copy->items[2 * copy->entry_count + slot] = CLOX_VALUE_OBJECT(updated);
+        return copy;
+    }
+    return node;
+}
+
+static Clox_Value* Clox_Hamt_Entries(Clox_Hamt_Node const* node, Clox_Value* out) {
+    memcpy(out, node->items, sizeof(Clox_Value) * 2 * node->entry_count);
+    out += 2 * node->entry_count;
+    for (uint32_t i = 0; i < node->child_count; i++) {
+        out = Clox_Hamt_Entries(Clox_Hamt_Child(node, i), out);
+    }
+    return out;
+}
+
+static Clox_Persistent_Map* Clox_Persistent_Map_Make(Clox_VM* vm, uint32_t count, Clox_Hamt_Node* root) {
+    Clox_Persistent_Map* map = (Clox_Persistent_Map*)Clox_Object_Allocate(vm, CLOX_OBJECT_TYPE_PERSISTENT_MAP, sizeof(Clox_Persistent_Map));
+    map->count = count;
+    map->root = root;
+    return map;
+}
+
+Clox_Persistent_Map* Clox_Persistent_Map_Create(Clox_VM* vm) {
+    return Clox_Persistent_Map_Make(vm, 0, Clox_Hamt_Node_Create(vm, 0, 0, 0, 0));
+}
+
+bool Clox_Persistent_Map_Get(Clox_Persistent_Map const* map, Clox_Value key, Clox_Value* value) {
+    uint32_t hash = Clox_Map_Hash(key);
+    Clox_Hamt_Node const* node = map->root;
+    for (uint32_t shift = 0; shift < CLOX_HAMT_HASH_BITS; shift += CLOX_PERSISTENT_BITS) {
+        uint32_t bit = Clox_Hamt_Bit(hash, shift);
+        if (node->entry_map & bit) {
+            uint32_t entry = Clox_Hamt_Index(node->entry_map, bit);
+            if (!Clox_Map_Keys_Equal(node->items[2 * entry], key)) {
+                return false;
+            }
+            *value = node->items[2 * entry + 1];
+            return true;
+        }
+        if (!(node->child_map & bit)) {
+            return false;
+        }
+        node = Clox_Hamt_Child(node, Clox_Hamt_Index(node->child_map, bit));
+    }
+
+    for (uint32_t i = 0; i < node->entry_count; i++) {
+        if (Clox_Map_Keys_Equal(node->items[2 * i], key)) {
+            *value = node->items[2 * i + 1];
+            return true;
+        }
+    }
+    return false;
+}
+
+Clox_Persistent_Map* Clox_Persistent_Map_Set(Clox_VM* vm, Clox_Persistent_Map* map, Clox_Value key, Clox_Value value) {
+    bool added = false;
+    Clox_Hamt_Node* root = Clox_Hamt_Set(vm, map->root, 0, key, Clox_Map_Hash(key), value, &added);
+    return Clox_Persistent_Map_Make(vm, added ? map->count + 1 : map->count, root);
+}
+
+Clox_Persistent_Map* Clox_Persistent_Map_Remove(Clox_VM* vm, Clox_Persistent_Map* map, Clox_Value key) {
+    Clox_Hamt_Node* root = Clox_Hamt_Remove(vm, map->root, 0, key, Clox_Map_Hash(key));
+    if (root == map->root) {
+        return map;
+    }
+    return Clox_Persistent_Map_Make(vm, map->count - 1, root);
+}
+
+void Clox_Persistent_Map_Entries(Clox_Persistent_Map const* map, Clox_Value* out) {
+    Clox_Hamt_Entries(map->root, out);
+}
+
+static inline Clox_Vector_Node* Clox_Vector_Child(Clox_Vector_Node const* node, uint32_t slot) {
+    return (Clox_Vector_Node*)node->items[slot].value.object;
+}
+
+// NOTE(Al-Andrew): a node with `size` slots, the first `count` copied from `from` and the rest nil
+static Clox_Vector_Node* Clox_Vector_Node_Create(Clox_VM* vm, Clox_Vector_Node const* from, uint32_t count, uint32_t size) {
+    uint32_t bytes = (uint32_t)(sizeof(Clox_Vector_Node) + sizeof(Clox_Value) * size);
+    Clox_Vector_Node* node = (Clox_Vector_Node*)Clox_Object_Allocate(vm, CLOX_OBJECT_TYPE_VECTOR_NODE, bytes);
+    if (count > 0) {
+        memcpy(node->items, from->items, sizeof(Clox_Value) * count);
+    }
+    for (uint32_t i = count; i < size; i++) {
+        node->items[i] = CLOX_VALUE_NIL;
+    }
+    return node;
+}
+
+// NOTE(Al-Andrew): index of the first value in the tail
+static inline uint32_t Clox_Vector_Tail_Offset(uint32_t count) {
+    return count == 0 ? 0 : ((count - 1) >> CLOX_PERSISTENT_BITS) << CLOX_PERSISTENT_BITS;
+}
+
+// NOTE(Al-Andrew): the leaf in the trie holding `index`, which has to be before the tail
+static Clox_Vector_Node* Clox_Vector_Leaf(Clox_Persistent_Vector const* vector, uint32_t index) {
+    Clox_Vector_Node* node = vector->root;
+    for (uint32_t level = vector->shift; level > 0; level -= CLOX_PERSISTENT_BITS) {
+        node = Clox_Vector_Child(node, (index >> level) & CLOX_PERSISTENT_MASK);
+    }
+    return node;
+}
+
+// NOTE(Al-Andrew): `leaf` under a chain of fresh branches reaching down from `level`
+static Clox_Vector_Node* Clox_Vector_Path(Clox_VM* vm, Clox_Vector_Node* leaf, uint32_t level) {
+    if (level == 0) {
+        return leaf;
+    }
+    Clox_Vector_Node* branch = Clox_Vector_Node_Create(vm, NULL, 0, CLOX_PERSISTENT_WIDTH);
+    branch->items[0] = CLOX_VALUE_OBJECT(Clox_Vector_Path(vm, leaf, level - CLOX_PERSISTENT_BITS));
+    return branch;
+}
+
+// NOTE(Al-Andrew): `node` with `leaf` added as the leaf for the values from `index` on, `node` has room for it
+static Clox_Vector_Node* Clox_Vector_Push_Tail(Clox_VM* vm, Clox_Vector_Node const* node, uint32_t level, uint32_t index, Clox_Vector_Node* leaf) {
+    Clox_Vector_Node* copy = Clox_Vector_Node_Create(vm, node, CLOX_PERSISTENT_WIDTH, CLOX_PERSISTENT_WIDTH);
+    uint32_t slot = (index >> level) & CLOX_PERSISTENT_MASK;
+    if (level == CLOX_PERSISTENT_BITS) {
+        copy->items[slot] = CLOX_VALUE_OBJECT(leaf);
+    } else if (CLOX_VALUE_IS_OBJECT(node->items[slot])) {
+        copy->items[slot] = CLOX_VALUE_OBJECT(Clox_Vector_Push_Tail(vm, Clox_Vector_Child(node, slot), level - CLOX_PERSISTENT_BITS, index, leaf));
+    } else {
+        copy->items[slot] = CLOX_VALUE_OBJECT(Clox_Vector_Path(vm, leaf, level - CLOX_PERSISTENT_BITS));
+    }
+    return copy;
+}
+
+// NOTE(Al-Andrew): `node` without the leaf holding `index`, the last one in the trie. NULL when nothing is left.
+static Clox_Vector_Node* Clox_Vector_Pop_Tail(Clox_VM* vm, Clox_Vector_Node const* node, uint32_t level, uint32_t index) {
+    uint32_t slot = (index >> level) & CLOX_PERSISTENT_MASK;
+    Clox_Vector_Node* child = NULL;
+    if (level > CLOX_PERSISTENT_BITS) {
+        child = Clox_Vector_Pop_Tail(vm, Clox_Vector_Child(node, slot), level - CLOX_PERSISTENT_BITS, index);
+    }
+    if (child == NULL && slot == 0) {
+        return NULL;
+    }
+    Clox_Vector_Node* copy = Clox_Vector_Node_Create(vm, node, CLOX_PERSISTENT_WIDTH, CLOX_PERSISTENT_WIDTH);
+    copy->items[slot] = child == NULL ? CLOX_VALUE_NIL : CLOX_VALUE_OBJECT(child);
+    return copy;
+}
+
+static Clox_Vector_Node* Clox_Vector_Assoc(Clox_VM* vm, Clox_Vector_Node const* node, uint32_t level, uint32_t index, Clox_Value value) {
+    Clox_Vector_Node* copy = Clox_Vector_Node_Create(vm, node, CLOX_PERSISTENT_WIDTH, CLOX_PERSISTENT_WIDTH);
+    if (level == 0) {
+        copy->items[index & CLOX_PERSISTENT_MASK] = value;
+    } else {
+        uint32_t slot = (index >> level) & CLOX_PERSISTENT_MASK;
+        copy->items[slot] = CLOX_VALUE_OBJECT(Clox_Vector_Assoc(vm, Clox_Vector_Child(node, slot), level - CLOX_PERSISTENT_BITS, index, value));
+    }
+    return copy;
+}
+
+static Clox_Persistent_Vector* Clox_Persistent_Vector_Make(
+    Clox_VM* vm, uint32_t count, uint32_t shift, Clox_Vector_Node* root, Clox_Vector_Node* tail
+) {
+    Clox_Persistent_Vector* vector = (Clox_Persistent_Vector*)Clox_Object_Allocate(vm, CLOX_OBJECT_TYPE_PERSISTENT_VECTOR, sizeof(Clox_Persistent_Vector));
+    vector->count = count;
+    vector->shift = shift;
+    vector->root = root;
+    vector->tail = tail;
+    return vector;
+}
+
+Clox_Persistent_Vector* Clox_Persistent_Vector_Create(Clox_VM* vm) {
+    return Clox_Persistent_Vector_Make(vm, 0, 0, NULL, NULL);
+}
+
+Clox_Value Clox_Persistent_Vector_Get(Clox_Persistent_Vector const* vector, uint32_t index) {
+    CLOX_DEV_ASSERT(index < vector->count);
+    uint32_t tail_offset = Clox_Vector_Tail_Offset(vector->count);
+    if (index >= tail_offset) {
+        return vector->tail->items[index - tail_offset];
+    }
+    return Clox_Vector_Leaf(vector, index)->items[index & CLOX_PERSISTENT_MASK];
+}
+
+Clox_Persistent_Vector* Clox_Persistent_Vector_Set(Clox_VM* vm, Clox_Persistent_Vector* vector, uint32_t index, Clox_Value value) {
+    CLOX_DEV_ASSERT(index < vector->count);
+    uint32_t tail_offset = Clox_Vector_Tail_Offset(vector->count);
+    if (index >= tail_offset) {
+        uint32_t tail_count = vector->count - tail_offset;
+        Clox_Vector_Node* tail = Clox_Vector_Node_Create(vm, vector->tail, tail_count, tail_count);
+        tail->items[index - tail_offset] = value;
+        return Clox_Persistent_Vector_Make(vm, vector->count, vector->shift, vector->root, tail);
+    }
+    Clox_Vector_Node* root = Clox_Vector_Assoc(vm, vector->root, vector->shift, index, value);
+    return Clox_Persistent_Vector_Make(vm, vector->count, vector->shift, root, vector->tail);
+}
+
+Clox_Persistent_Vector* Clox_Persistent_Vector_Push(Clox_VM* vm, Clox_Persistent_Vector* vector, Clox_Value value) {
+    uint32_t tail_offset = Clox_Vector_Tail_Offset(vector->count);
+    uint32_t tail_count = vector->count - tail_offset;
+    if (tail_count < CLOX_PERSISTENT_WIDTH) {
+        Clox_Vector_Node* tail = Clox_Vector_Node_Create(vm, vector->tail, tail_count, tail_count + 1);
+        tail->items[tail_count] = value;
+        return Clox_Persistent_Vector_Make(vm, vector->count + 1, vector->shift, vector->root, tail);
+    }
+
+    // NOTE(Al-Andrew): the full tail moves into the trie, which grows a level when the root has no room left. A root
+    //                  at `shift` has room for 1 << shift leaves.
+    Clox_Vector_Node* root = NULL;
+    uint32_t shift = vector->shift;
+    if (vector->root == NULL) {
+        root = vector->tail;
+    } else if ((tail_offset >> CLOX_PERSISTENT_BITS) == (1u << shift)) {
+        root = Clox_Vector_Node_Create(vm, NULL, 0, CLOX_PERSISTENT_WIDTH);
+        root->items[0] = CLOX_VALUE_OBJECT(vector->root);
+        root->items[1] = CLOX_VALUE_OBJECT(Clox_Vector_Path(vm, vector->tail, shift));
+        shift += CLOX_PERSISTENT_BITS;
+    } else {
+        root = Clox_Vector_Push_Tail(vm, vector->root, shift, tail_offset, vector->tail);
+    }
+
+    Clox_Vector_Node* tail = Clox_Vector_Node_Create(vm, NULL, 0, 1);
+    tail->items[0] = value;
+    return Clox_Persistent_Vector_Make(vm, vector->count + 1, shift, root, tail);
+}
+
+Clox_Persistent_Vector* Clox_Persistent_Vector_Pop(Clox_VM* vm, Clox_Persistent_Vector* vector) {
+    CLOX_DEV_ASSERT(vector->count > 0);
+    if (vector->count == 1) {
+        return Clox_Persistent_Vector_Create(vm);
+    }
+
+    uint32_t tail_offset = Clox_Vector_Tail_Offset(vector->count);
+    uint32_t tail_count = vector->count - tail_offset;
+    if (tail_count > 1) {
+        Clox_Vector_Node* tail = Clox_Vector_Node_Create(vm, vector->tail, tail_count - 1, tail_count - 1);
+        return Clox_Persistent_Vector_Make(vm, vector->count - 1, vector->shift, vector->root, tail);
+    }
+
+    // NOTE(Al-Andrew): the last leaf of the trie becomes the tail as it is, leaves in the trie are always full. A
+    //                  root left with a single child gives its place to that child.
+    Clox_Vector_Node* tail = Clox_Vector_Leaf(vector, vector->count - 2);
+    Clox_Vector_Node* root = NULL;
+    uint32_t shift = vector->shift;
+    if (shift > 0) {
+        root = Clox_Vector_Pop_Tail(vm, vector->root, shift, vector->count - 2);
+        if (!CLOX_VALUE_IS_OBJECT(root->items[1])) {
+            root = Clox_Vector_Child(root, 0);
+            shift -= CLOX_PERSISTENT_BITS;
+        }
+    }
+    return Clox_Persistent_Vector_Make(vm, vector->count - 1, shift, root, tail);
+}
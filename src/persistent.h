@@ -0,0 +1,79 @@
+#ifndef CLOX_PERSISTENT_H_INCLUDED
+#define CLOX_PERSISTENT_H_INCLUDED
+
+#include <stdint.h>
+#include "object.h"
+
+// NOTE(Al-Andrew): immutable maps and vectors. An update never touches the one it was made from, it copies the path
+//                  from the root down to the change and shares every other node with the old version, so each
+//                  version costs O(log32 n) nodes instead of a copy of the whole thing. Nodes are objects like any
+//                  other and live on the VM's list, a version keeps everything it can reach alive.
+
+#define CLOX_PERSISTENT_BITS 5
+#define CLOX_PERSISTENT_WIDTH (1u << CLOX_PERSISTENT_BITS)
+#define CLOX_PERSISTENT_MASK (CLOX_PERSISTENT_WIDTH - 1)
+
+// NOTE(Al-Andrew): hash array mapped trie node. Each level takes the next 5 bits of the key's hash (Clox_Map_Hash)
+//                  as a slot, `entry_map` has the slots holding a key/value pair and `child_map` the slots holding a
+//                  deeper node, a slot is never in both. `items` are the pairs in slot order followed by the children
+//                  in slot order, each child stored as an object value. Once all 32 bits are used up the node is a
+//                  collision node instead, both maps are 0 and the pairs are searched linearly.
+typedef struct Clox_Hamt_Node Clox_Hamt_Node;
+struct Clox_Hamt_Node {
+    Clox_Object obj;
+    uint32_t entry_map;
+    uint32_t child_map;
+    uint32_t entry_count;
+    uint32_t child_count;
+    Clox_Value items[];
+};
+
+// NOTE(Al-Andrew): made with PersistentMap(), keyed like Clox_Map. The trie is kept canonical, a removal that leaves
+//                  a node with a single pair moves the pair up into its parent.
+typedef struct {
+    Clox_Object obj;
+    uint32_t count;
+    Clox_Hamt_Node* root; // NOTE(Al-Andrew): never NULL, the empty map has an empty root
+} Clox_Persistent_Map;
+
+// NOTE(Al-Andrew): node of the vector's radix trie, branches hold their children as object values (nil past the
+//                  last one) and leaves the vector's values. Nodes in the trie always have 32 slots, the tail has
+//                  exactly as many as it holds.
+typedef struct Clox_Vector_Node Clox_Vector_Node;
+struct Clox_Vector_Node {
+    Clox_Object obj;
+    Clox_Value items[];
+};
+
+// NOTE(Al-Andrew): made with PersistentVector(). Value `i` sits in the leaf picked by the 5 bit digits of `i` from
+//                  `shift` down to 5, at slot `i & 31`. The last 1 to 32 values are kept out of the trie in `tail`, so
+//                  pushing only copies the tail and the trie takes a full leaf every 32 pushes. Only push and pop
+//                  change the length, so the trie is always filled from the left and never needs the size tables a
+//                  relaxed (RRB) trie keeps for concatenation.
+typedef struct {
+    Clox_Object obj;
+    uint32_t count;
+    uint32_t shift; // NOTE(Al-Andrew): 0 when `root` is a leaf itself
+    Clox_Vector_Node* root; // NOTE(Al-Andrew): NULL while everything fits in the tail
+    Clox_Vector_Node* tail; // NOTE(Al-Andrew): NULL for the empty vector
+} Clox_Persistent_Vector;
+
+Clox_Persistent_Map* Clox_Persistent_Map_Create(Clox_VM* vm);
+// NOTE(Al-Andrew): `key` has to pass Clox_Map_Is_Key for all of these
+bool Clox_Persistent_Map_Get(Clox_Persistent_Map const* map, Clox_Value key, Clox_Value* value);
+Clox_Persistent_Map* Clox_Persistent_Map_Set(Clox_VM* vm, Clox_Persistent_Map* map, Clox_Value key, Clox_Value value);
+// NOTE(Al-Andrew): `map` itself when it doesn't have `key`
+Clox_Persistent_Map* Clox_Persistent_Map_Remove(Clox_VM* vm, Clox_Persistent_Map* map, Clox_Value key);
+// NOTE(Al-Andrew): writes the keys and values alternating into `out`, which needs room for 2 * count of them. The
+//                  order follows the hashes and is the same for two maps with the same keys.
+void Clox_Persistent_Map_Entries(Clox_Persistent_Map const* map, Clox_Value* out);
+
+Clox_Persistent_Vector* Clox_Persistent_Vector_Create(Clox_VM* vm);
+// NOTE(Al-Andrew): `index` has to be below the count
+Clox_Value Clox_Persistent_Vector_Get(Clox_Persistent_Vector const* vector, uint32_t index);
+Clox_Persistent_Vector* Clox_Persistent_Vector_Set(Clox_VM* vm, Clox_Persistent_Vector* vector, uint32_t index, Clox_Value value);
+Clox_Persistent_Vector* Clox_Persistent_Vector_Push(Clox_VM* vm, Clox_Persistent_Vector* vector, Clox_Value value);
+// NOTE(Al-Andrew): `vector` can't be empty
+Clox_Persistent_Vector* Clox_Persistent_Vector_Pop(Clox_VM* vm, Clox_Persistent_Vector* vector);
+
+#endif // CLOX_PERSISTENT_H_INCLUDED
@@ -1,12 +1,18 @@
 #include "scanner.h"
+#include <string.h>
 
+#if defined(__SSE2__) && defined(__GNUC__)
+    #define CLOX_SCANNER_SSE2
+    #include <emmintrin.h>
+#endif // __SSE2__
 
-Clox_Scanner Clox_Scanner_New(const char* source) {
-    return (Clox_Scanner){.current = source, .start = source, .line = 1};
+
+Clox_Scanner Clox_Scanner_New(s8 source) {
+    return (Clox_Scanner){.current = source.string, .start = source.string, .end = source.string + source.len, .line = 1};
 }
 
 static inline bool Clox_Scanner_Is_EOF(Clox_Scanner* scanner) {
-    return *scanner->current == '\0';
+    return scanner->current >= scanner->end;
 }
 
 static inline Clox_Token Clox_Scanner_Make_Token(Clox_Scanner* scanner, Clox_Token_Type type) {
@@ -28,11 +34,12 @@ static inline Clox_Token Clox_Scanner_Make_Error(Clox_Scanner* scanner, const ch
 }
 
 static inline char Clox_Scanner_Peek(Clox_Scanner* scanner) {
+    if (Clox_Scanner_Is_EOF(scanner)) return '\0';
     return *scanner->current;
 }
 
 static inline char Clox_Scanner_Peek_Next(Clox_Scanner* scanner) {
-    if (Clox_Scanner_Is_EOF(scanner)) return '\0';
+    if (scanner->current + 1 >= scanner->end) return '\0';
     return *(scanner->current+1);
 }
 
@@ -40,6 +47,76 @@ static inline char Clox_Scanner_Advance(Clox_Scanner* scanner) {
     return *scanner->current++;
 }
 
+#ifdef CLOX_SCANNER_SSE2
+
+#define CLOX_SCANNER_LANES 16
+
+static inline __m128i Clox_Scanner_In_Range(__m128i chars, char low, char high) {
+    // NOTE(Al-Andrew): signed compares are fine, everything >= 0x80 is negative and never in an ASCII range
+    return _mm_and_si128(
+        _mm_cmpgt_epi8(chars, _mm_set1_epi8((char)(low - 1))),
+        _mm_cmplt_epi8(chars, _mm_set1_epi8((char)(high + 1)))
+    );
+}
+
+static inline uint32_t Clox_Scanner_Whitespace_Mask(__m128i chars) {
+    __m128i blank = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chars, _mm_set1_epi8('\t'))),
+        _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(chars, _mm_set1_epi8('\n')))
+    );
+    return (uint32_t)_mm_movemask_epi8(blank);
+}
+
+static inline uint32_t Clox_Scanner_Digit_Mask(__m128i chars) {
+    return (uint32_t)_mm_movemask_epi8(Clox_Scanner_In_Range(chars, '0', '9'));
+}
+
+static inline uint32_t Clox_Scanner_Identifier_Mask(__m128i chars) {
+    __m128i lowered = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+    __m128i identifier = _mm_or_si128(
+        _mm_or_si128(Clox_Scanner_In_Range(lowered, 'a', 'z'), Clox_Scanner_In_Range(chars, '0', '9')),
+        _mm_cmpeq_epi8(chars, _mm_set1_epi8('_'))
+    );
+    return (uint32_t)_mm_movemask_epi8(identifier);
+}
+
+// NOTE(Al-Andrew): skips 16 bytes at a time while every byte is in the class described by `mask_fn`,
+//                  stops at the first byte that isn't (or when less than 16 bytes are left)
+#define CLOX_SCANNER_SKIP_RUN(scanner, mask_fn)                                              \
+    while ((scanner)->end - (scanner)->current >= CLOX_SCANNER_LANES) {                     \
+        __m128i chars = _mm_loadu_si128((__m128i const*)(void const*)(scanner)->current);  \
+        uint32_t outside = ~mask_fn(chars) & 0xFFFFu;                                       \
+        if (outside != 0) {                                                                 \
+            (scanner)->current += __builtin_ctz(outside);                                   \
+            break;                                                                          \
+        }                                                                                   \
+        (scanner)->current += CLOX_SCANNER_LANES;                                           \
+    }
+
+#endif // CLOX_SCANNER_SSE2
+
+static inline void Clox_Scanner_Skip_Whitespace_Run(Clox_Scanner* scanner) {
+#ifdef CLOX_SCANNER_SSE2
+    if (Clox_Scanner_Is_EOF(scanner) || (*scanner->current != ' ' && *scanner->current != '\t' && *scanner->current != '\n')) {
+        return;
+    }
+    while (scanner->end - scanner->current >= CLOX_SCANNER_LANES) {
+        __m128i chars = _mm_loadu_si128((__m128i const*)(void const*)scanner->current);
+        uint32_t newlines = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chars, _mm_set1_epi8('\n')));
+        uint32_t outside = ~Clox_Scanner_Whitespace_Mask(chars) & 0xFFFFu;
+        if (outside != 0) {
+            int skipped = __builtin_ctz(outside);
+            scanner->line += __builtin_popcount(newlines & ((1u << skipped) - 1u));
+            scanner->current += skipped;
+            return;
+        }
+        scanner->line += __builtin_popcount(newlines);
+        scanner->current += CLOX_SCANNER_LANES;
+    }
+#endif // CLOX_SCANNER_SSE2
+    (void)scanner;
+}
+
 static inline void Clox_Scanner_Skip_Whitespace(Clox_Scanner* scanner) {
     for (;;) {
         char c = Clox_Scanner_Peek(scanner);
@@ -48,18 +125,21 @@ static inline void Clox_Scanner_Skip_Whitespace(Clox_Scanner* scanner) {
             case '\r': // falltrough
             case '\t': {
                 Clox_Scanner_Advance(scanner);
+                // NOTE(Al-Andrew): single blanks between tokens are the common case, only go wide for indentation
+                Clox_Scanner_Skip_Whitespace_Run(scanner);
             } break;
             case '\n': {
                 scanner->line++;
                 Clox_Scanner_Advance(scanner);
+                Clox_Scanner_Skip_Whitespace_Run(scanner);
             } break;
             case '/': {
 
                 if (Clox_Scanner_Peek_Next(scanner) == '/') {
                     // A comment goes until the end of the line.
-                    while (Clox_Scanner_Peek(scanner) != '\n' && !Clox_Scanner_Is_EOF(scanner)) {
-                        Clox_Scanner_Advance(scanner);   
-                    }
+                    // NOTE(Al-Andrew): memchr is already vectorized by every libc we care about
+                    const char* newline = memchr(scanner->current, '\n', (size_t)(scanner->end - scanner->current));
+                    scanner->current = newline != NULL ? newline : scanner->end;
                 } else {
                     return;
                 }
@@ -70,7 +150,6 @@ static inline void Clox_Scanner_Skip_Whitespace(Clox_Scanner* scanner) {
     }
 }
 
-
 static inline bool Clox_Scanner_Advance_If_Matches(Clox_Scanner* scanner, char target) {
     if (Clox_Scanner_Is_EOF(scanner)) return false;
     char peek = Clox_Scanner_Peek(scanner);
@@ -99,20 +178,25 @@ static inline bool Is_Number_Char(char c) {
     return c >= '0' && c <= '9'; 
 }
 
-static inline Clox_Token Clox_Scanner_Make_Number(Clox_Scanner* scanner) {
-    
+static inline void Clox_Scanner_Skip_Digits(Clox_Scanner* scanner) {
+#ifdef CLOX_SCANNER_SSE2
+    CLOX_SCANNER_SKIP_RUN(scanner, Clox_Scanner_Digit_Mask);
+#endif // CLOX_SCANNER_SSE2
     while (Is_Number_Char(Clox_Scanner_Peek(scanner))) {
         Clox_Scanner_Advance(scanner); 
     }
+}
+
+static inline Clox_Token Clox_Scanner_Make_Number(Clox_Scanner* scanner) {
+    
+    Clox_Scanner_Skip_Digits(scanner);
 
     // Look for a fractional part.
     if (Clox_Scanner_Peek(scanner) == '.' && Is_Number_Char(Clox_Scanner_Peek_Next(scanner))) {
         // Consume the ".".
         Clox_Scanner_Advance(scanner);
 
-        while (Is_Number_Char(Clox_Scanner_Peek(scanner))) {
-            Clox_Scanner_Advance(scanner);
-        }
+        Clox_Scanner_Skip_Digits(scanner);
     }
 
     return Clox_Scanner_Make_Token(scanner, CLOX_TOKEN_NUMBER);
@@ -124,47 +208,60 @@ static inline bool Is_Identifier_Char(char c) {
             c == '_';
 }
 
-static const s8 s_clox_keywords[] = {
-    {ls8$("and")},
-    {ls8$("class")},
-    {ls8$("else")},
-    {ls8$("false")},
-    {ls8$("for")},
-    {ls8$("fun")},
-    {ls8$("if")},
-    {ls8$("nil")},
-    {ls8$("or")},
-    {ls8$("print")},
-    {ls8$("return")},
-    {ls8$("super")},
-    {ls8$("this")},
-    {ls8$("true")},
-    {ls8$("var")},
-    {ls8$("while")},
+typedef struct {
+    s8 keyword;
+    Clox_Token_Type type;
+} Clox_Keyword;
+
+// NOTE(Al-Andrew): perfect hash over the keywords, see Clox_Scanner_Keyword_Hash. Re-check for collisions when adding one!
+#define CLOX_KEYWORD_TABLE_SIZE 64
+#define CLOX_KEYWORD_MIN_LENGTH 2
+#define CLOX_KEYWORD_MAX_LENGTH 7
+
+static const Clox_Keyword s_clox_keywords[CLOX_KEYWORD_TABLE_SIZE] = {
+    [59] = {{ls8$("and")},     CLOX_TOKEN_AND},
+    [41] = {{ls8$("case")},    CLOX_TOKEN_CASE},
+    [49] = {{ls8$("class")},   CLOX_TOKEN_CLASS},
+    [32] = {{ls8$("default")}, CLOX_TOKEN_DEFAULT},
+    [53] = {{ls8$("else")},    CLOX_TOKEN_ELSE},
+    [46] = {{ls8$("false")},   CLOX_TOKEN_FALSE},
+    [62] = {{ls8$("for")},     CLOX_TOKEN_FOR},
+    [10] = {{ls8$("fun")},     CLOX_TOKEN_FUN},
+    [33] = {{ls8$("if")},      CLOX_TOKEN_IF},
+    [58] = {{ls8$("nil")},     CLOX_TOKEN_NIL},
+    [15] = {{ls8$("or")},      CLOX_TOKEN_OR},
+    [30] = {{ls8$("print")},   CLOX_TOKEN_PRINT},
+    [52] = {{ls8$("return")},  CLOX_TOKEN_RETURN},
+    [19] = {{ls8$("super")},   CLOX_TOKEN_SUPER},
+    [17] = {{ls8$("switch")},  CLOX_TOKEN_SWITCH},
+    [44] = {{ls8$("this")},    CLOX_TOKEN_THIS},
+    [24] = {{ls8$("true")},    CLOX_TOKEN_TRUE},
+    [50] = {{ls8$("var")},     CLOX_TOKEN_VAR},
+    [45] = {{ls8$("while")},   CLOX_TOKEN_WHILE},
 };
 
-
-#define static_array_count$(arr) sizeof(arr)/sizeof(arr[0])
+static inline uint32_t Clox_Scanner_Keyword_Hash(const char* start, uint32_t length) {
+    return ((uint32_t)(uint8_t)start[0] ^ ((uint32_t)(uint8_t)start[1] << 1) ^ (length * 2u)) & (CLOX_KEYWORD_TABLE_SIZE - 1);
+}
 
 static inline Clox_Token_Type Clox_Scanner_Get_Identifier_Type(Clox_Scanner* scanner) {
-        
-    const s8 ident = {
-        .string = scanner->start,
-        .len = (uint32_t)((unsigned long long)scanner->current - (unsigned long long)scanner->start)
-    };
-
-    for(unsigned int i = 0; i < static_array_count$(s_clox_keywords); ++i) {
-        s8 potential = s_clox_keywords[i];
+    uint32_t length = (uint32_t)(scanner->current - scanner->start);
+    if (length < CLOX_KEYWORD_MIN_LENGTH || length > CLOX_KEYWORD_MAX_LENGTH) {
+        return CLOX_TOKEN_IDENTIFIER;
+    }
 
-        if(s8_compare(potential, ident) == 0) {
-            return CLOX_TOKEN_AND + i;
-        } 
+    const Clox_Keyword* candidate = &s_clox_keywords[Clox_Scanner_Keyword_Hash(scanner->start, length)];
+    if (candidate->keyword.len == length && memcmp(candidate->keyword.string, scanner->start, length) == 0) {
+        return candidate->type;
     }
     
     return CLOX_TOKEN_IDENTIFIER;
 }
 
 static inline Clox_Token Clox_Scanner_Make_Identifier(Clox_Scanner* scanner) {
+#ifdef CLOX_SCANNER_SSE2
+    CLOX_SCANNER_SKIP_RUN(scanner, Clox_Scanner_Identifier_Mask);
+#endif // CLOX_SCANNER_SSE2
     while (Is_Identifier_Char(Clox_Scanner_Peek(scanner)) || Is_Number_Char(Clox_Scanner_Peek(scanner))) {
         Clox_Scanner_Advance(scanner);
     }
@@ -192,7 +289,10 @@ Clox_Token Clox_Scanner_Get_Token(Clox_Scanner* scanner) {
         case ')': return Clox_Scanner_Make_Token(scanner, CLOX_TOKEN_RIGHT_PAREN);
         case '{': return Clox_Scanner_Make_Token(scanner, CLOX_TOKEN_LEFT_BRACE);
         case '}': return Clox_Scanner_Make_Token(scanner, CLOX_TOKEN_RIGHT_BRACE);
+        case '[': return Clox_Scanner_Make_Token(scanner, CLOX_TOKEN_LEFT_BRACKET);
+        case ']': return Clox_Scanner_Make_Token(scanner, CLOX_TOKEN_RIGHT_BRACKET);
         case ';': return Clox_Scanner_Make_Token(scanner, CLOX_TOKEN_SEMICOLON);
+        case ':': return Clox_Scanner_Make_Token(scanner, CLOX_TOKEN_COLON);
         case ',': return Clox_Scanner_Make_Token(scanner, CLOX_TOKEN_COMMA);
         case '.': return Clox_Scanner_Make_Token(scanner, CLOX_TOKEN_DOT);
         case '-': return Clox_Scanner_Make_Token(scanner, CLOX_TOKEN_MINUS);
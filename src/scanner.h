@@ -3,9 +3,11 @@
 
 #include "common.h"
 
+// NOTE(Al-Andrew): the source does not need to be NUL terminated, `end` bounds it
 typedef struct  {
     const char* start;
     const char* current;
+    const char* end;
     int line;
 } Clox_Scanner;
 
@@ -15,11 +17,14 @@ typedef enum {
     CLOX_TOKEN_RIGHT_PAREN,
     CLOX_TOKEN_LEFT_BRACE,
     CLOX_TOKEN_RIGHT_BRACE,
+    CLOX_TOKEN_LEFT_BRACKET,
+    CLOX_TOKEN_RIGHT_BRACKET,
     CLOX_TOKEN_COMMA,
     CLOX_TOKEN_DOT,
     CLOX_TOKEN_MINUS,
     CLOX_TOKEN_PLUS,
     CLOX_TOKEN_SEMICOLON,
+    CLOX_TOKEN_COLON,
     CLOX_TOKEN_SLASH,
     CLOX_TOKEN_STAR,
     // One or two character tokens.
@@ -37,7 +42,9 @@ typedef enum {
     CLOX_TOKEN_NUMBER,
     // Keywords.
     CLOX_TOKEN_AND,
+    CLOX_TOKEN_CASE,
     CLOX_TOKEN_CLASS,
+    CLOX_TOKEN_DEFAULT,
     CLOX_TOKEN_ELSE,
     CLOX_TOKEN_FALSE,
     CLOX_TOKEN_FOR,
@@ -48,6 +55,7 @@ typedef enum {
     CLOX_TOKEN_PRINT,
     CLOX_TOKEN_RETURN,
     CLOX_TOKEN_SUPER,
+    CLOX_TOKEN_SWITCH,
     CLOX_TOKEN_THIS,
     CLOX_TOKEN_TRUE,
     CLOX_TOKEN_VAR,
@@ -66,7 +74,7 @@ struct Clox_Token {
     int line;
 };
 
-Clox_Scanner Clox_Scanner_New(const char* source);
+Clox_Scanner Clox_Scanner_New(s8 source);
 Clox_Token Clox_Scanner_Get_Token(Clox_Scanner* scanner);
 
 #endif // CLOX_SCNANER_H_INCLUDED
\ No newline at end of file
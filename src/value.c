@@ -51,6 +51,14 @@ void Clox_Value_Print(Clox_Value value) {
         case CLOX_VALUE_TYPE_NUMBER: {
             printf("%g", value.value.number);
         } break;
+        case CLOX_VALUE_TYPE_INTEGER: {
+            // NOTE(Al-Andrew): %g prints up to 6 digits as they are, anything longer has to look like the double
+            if (value.value.integer > -1000000 && value.value.integer < 1000000) {
+                printf("%d", value.value.integer);
+            } else {
+                printf("%g", (double)value.value.integer);
+            }
+        } break;
         case CLOX_VALUE_TYPE_OBJECT: {
             Clox_Object_Print(value.value.object);
         } break;
@@ -65,6 +73,7 @@ bool Clox_Value_Is_Falsy(Clox_Value value) {
         case CLOX_VALUE_TYPE_NIL: return true;
         case CLOX_VALUE_TYPE_BOOL: return !value.value.boolean;
         case CLOX_VALUE_TYPE_NUMBER: /* fallthrough */ 
+        case CLOX_VALUE_TYPE_INTEGER: /* fallthrough */
         case CLOX_VALUE_TYPE_OBJECT: {
             return false;
         }
@@ -2,12 +2,16 @@
 #define CLOX_VALUE_H_INCLUDED
 
 #include "common.h"
+#include "value_array.h"
 
 typedef enum {
   CLOX_VALUE_TYPE_NIL,
   CLOX_VALUE_TYPE_BOOL,
   CLOX_VALUE_TYPE_NUMBER,
   CLOX_VALUE_TYPE_OBJECT,
+  // NOTE(Al-Andrew): a number that happens to be a whole int32. Only the interpreter makes these, it's the same
+  //                  number to the language: any result that wouldn't be an int32 (or would be -0) is a double.
+  CLOX_VALUE_TYPE_INTEGER,
 } Clox_Value_Type;
 
 struct Clox_Object;
@@ -17,6 +21,7 @@ struct Clox_Value {
   union {
     bool boolean;
     double number;
+    int32_t integer;
     struct Clox_Object* object;
   } value; 
 };
@@ -26,10 +31,60 @@ struct Clox_Value {
 #define CLOX_VALUE_IS_NIL(value)     ((value).type == CLOX_VALUE_TYPE_NIL)
 #define CLOX_VALUE_IS_NUMBER(value)  ((value).type == CLOX_VALUE_TYPE_NUMBER)
 #define CLOX_VALUE_IS_OBJECT(value)  ((value).type == CLOX_VALUE_TYPE_OBJECT)
+#define CLOX_VALUE_IS_INTEGER(value) ((value).type == CLOX_VALUE_TYPE_INTEGER)
+// NOTE(Al-Andrew): either representation of a number, read it with Clox_Value_As_Number
+#define CLOX_VALUE_IS_NUMERIC(value) (CLOX_VALUE_IS_NUMBER(value) || CLOX_VALUE_IS_INTEGER(value))
 
 #define CLOX_VALUE_BOOL(val)   ((Clox_Value){CLOX_VALUE_TYPE_BOOL, .value.boolean = val  })
 #define CLOX_VALUE_NIL           ((Clox_Value){CLOX_VALUE_TYPE_NIL, .value.number = 0})
 #define CLOX_VALUE_NUMBER(val) ((Clox_Value){CLOX_VALUE_TYPE_NUMBER, .value.number = val})
 #define CLOX_VALUE_OBJECT(obj)   ((Clox_Value){CLOX_VALUE_TYPE_OBJECT, .value.object = (Clox_Object*)(obj)})
+#define CLOX_VALUE_INTEGER(val) ((Clox_Value){CLOX_VALUE_TYPE_INTEGER, .value.integer = val})
+
+static inline double Clox_Value_As_Number(Clox_Value value) {
+    return CLOX_VALUE_IS_INTEGER(value) ? (double)value.value.integer : value.value.number;
+}
+
+// NOTE(Al-Andrew): the integer arithmetic has to give exactly what the double one would have. Every int32 result
+//                  does (they're far below 2^53), the rest is handed back as the double it would have been.
+static inline Clox_Value Clox_Value_Integer_Result(int64_t result) {
+    if (result < INT32_MIN || result > INT32_MAX) {
+        return CLOX_VALUE_NUMBER((double)result);
+    }
+    return CLOX_VALUE_INTEGER((int32_t)result);
+}
+
+static inline Clox_Value Clox_Value_Integer_Add(int32_t lhs, int32_t rhs) {
+    return Clox_Value_Integer_Result((int64_t)lhs + rhs);
+}
+
+static inline Clox_Value Clox_Value_Integer_Sub(int32_t lhs, int32_t rhs) {
+    return Clox_Value_Integer_Result((int64_t)lhs - rhs);
+}
+
+static inline Clox_Value Clox_Value_Integer_Mul(int32_t lhs, int32_t rhs) {
+    int64_t result = (int64_t)lhs * rhs;
+    if (result == 0 && (lhs < 0 || rhs < 0)) {
+        return CLOX_VALUE_NUMBER(-0.0);
+    }
+    return Clox_Value_Integer_Result(result);
+}
+
+// NOTE(Al-Andrew): the double quotient of two int32 is only whole when the division is exact, a fraction is at
+//                  least 1/rhs away from the next whole number which is far more than the rounding error
+static inline Clox_Value Clox_Value_Integer_Div(int32_t lhs, int32_t rhs) {
+    double result = (double)lhs / (double)rhs;
+    if (result >= INT32_MIN && result <= INT32_MAX && result == (double)(int32_t)result && !(lhs == 0 && rhs < 0)) {
+        return CLOX_VALUE_INTEGER((int32_t)result);
+    }
+    return CLOX_VALUE_NUMBER(result);
+}
+
+static inline Clox_Value Clox_Value_Integer_Negate(int32_t value) {
+    if (value == 0) {
+        return CLOX_VALUE_NUMBER(-0.0);
+    }
+    return Clox_Value_Integer_Result(-(int64_t)value);
+}
 
 #endif // CLOX_VALUE_H_INCLUDED
\ No newline at end of file
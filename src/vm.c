@@ -1,7 +1,11 @@
 #include "vm.h"
+#include "class.h"
 #include "common.h"
 #include "compiler.h"
+#include "jit.h"
+#include "persistent.h"
 #include <float.h>
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
@@ -11,28 +15,831 @@
 
 void Clox_VM_Reset_Stack(Clox_VM* vm) {
     vm->stack_top = vm->stack;
+    vm->closure_stack_used = 0;
     vm->call_frame_count = 0;
     vm->open_upvalues = NULL;
 }
 
 
-Clox_Value clock_native(int argc, Clox_Value* argv) {
+Clox_Native_Status clock_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)vm;
     (void)argc;
     (void)argv;
-    return CLOX_VALUE_NUMBER((double)clock() / CLOCKS_PER_SEC);
+    *result = CLOX_VALUE_NUMBER((double)clock() / CLOCKS_PER_SEC);
+    return CLOX_NATIVE_OK;
 }
 
+Clox_Native_Status sqrt_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!CLOX_VALUE_IS_NUMERIC(argv[0])) {
+        return Clox_VM_Native_Error(vm, "Sqrt expects a number.");
+    }
+    *result = CLOX_VALUE_NUMBER(sqrt(Clox_Value_As_Number(argv[0])));
+    return CLOX_NATIVE_OK;
+}
+
+Clox_Native_Status floor_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!CLOX_VALUE_IS_INTEGER(argv[0]) && !CLOX_VALUE_IS_NUMBER(argv[0])) {
+        return Clox_VM_Native_Error(vm, "Floor expects a number.");
+    }
+    *result = CLOX_VALUE_IS_INTEGER(argv[0]) ? argv[0] : CLOX_VALUE_NUMBER(floor(argv[0].value.number));
+    return CLOX_NATIVE_OK;
+}
+
+Clox_Native_Status string_length_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!CLOX_VALUE_IS_OBJECT(argv[0]) || argv[0].value.object->type != CLOX_OBJECT_TYPE_STRING) {
+        return Clox_VM_Native_Error(vm, "StringLength expects a string.");
+    }
+    *result = Clox_Value_Integer_Result(((Clox_String*)argv[0].value.object)->length);
+    return CLOX_NATIVE_OK;
+}
+
+static inline bool Clox_VM_Is_String(Clox_Value value) {
+    return CLOX_VALUE_IS_OBJECT(value) && value.value.object->type == CLOX_OBJECT_TYPE_STRING;
+}
+
+static inline bool Clox_VM_Is_List(Clox_Value value) {
+    return CLOX_VALUE_IS_OBJECT(value) && value.value.object->type == CLOX_OBJECT_TYPE_LIST;
+}
+
+static inline bool Clox_VM_Is_Float_Array(Clox_Value value) {
+    return CLOX_VALUE_IS_OBJECT(value) && value.value.object->type == CLOX_OBJECT_TYPE_FLOAT_ARRAY;
+}
+
+static inline bool Clox_VM_Is_Map(Clox_Value value) {
+    return CLOX_VALUE_IS_OBJECT(value) && value.value.object->type == CLOX_OBJECT_TYPE_MAP;
+}
+
+static inline bool Clox_VM_Is_Persistent_Map(Clox_Value value) {
+    return CLOX_VALUE_IS_OBJECT(value) && value.value.object->type == CLOX_OBJECT_TYPE_PERSISTENT_MAP;
+}
+
+static inline bool Clox_VM_Is_Persistent_Vector(Clox_Value value) {
+    return CLOX_VALUE_IS_OBJECT(value) && value.value.object->type == CLOX_OBJECT_TYPE_PERSISTENT_VECTOR;
+}
+
+static inline bool Clox_VM_Is_Class(Clox_Value value) {
+    return CLOX_VALUE_IS_OBJECT(value) && value.value.object->type == CLOX_OBJECT_TYPE_CLASS;
+}
+
+static inline bool Clox_VM_Is_Instance(Clox_Value value) {
+    return CLOX_VALUE_IS_OBJECT(value) && value.value.object->type == CLOX_OBJECT_TYPE_INSTANCE;
+}
+
+// NOTE(Al-Andrew): the one place maps and persistent maps report a key they can't take, as a native error
+static bool Clox_VM_Check_Map_Key(Clox_VM* vm, Clox_Value key) {
+    if (Clox_Map_Is_Key(key)) {
+        return true;
+    }
+    if (CLOX_VALUE_IS_NUMBER(key)) {
+        Clox_VM_Native_Error(vm, "NaN can't be a map key."); // NOTE(Al-Andrew): never equal to itself, so never found
+    } else {
+        Clox_VM_Native_Error(vm, "Map keys must be numbers, strings, booleans or nil.");
+    }
+    return false;
+}
+
+// NOTE(Al-Andrew): integer indices are the common case and take a single unsigned compare for both bounds,
+//                  doubles only get in here when they're whole
+static bool Clox_VM_Index_Slot(Clox_VM* vm, Clox_Value index, uint32_t count, uint32_t* slot) {
+    if (CLOX_VALUE_IS_INTEGER(index)) {
+        *slot = (uint32_t)index.value.integer;
+    } else if (CLOX_VALUE_IS_NUMBER(index) && index.value.number == floor(index.value.number)) {
+        *slot = index.value.number >= 0 && index.value.number < (double)count ? (uint32_t)index.value.number : count;
+    } else {
+        Clox_VM_Native_Error(vm, "Index must be a whole number.");
+        return false;
+    }
+    if (*slot >= count) {
+        Clox_VM_Native_Error(vm, "Index out of bounds.");
+        return false;
+    }
+    return true;
+}
+
+// NOTE(Al-Andrew): OP_INDEX_GET and OP_INDEX_SET on anything but a list, out of line so the list path is all the
+//                  dispatch loop carries. Reads into `value`, or stores it when `store` is set, false with the message
+//                  in vm->native_error when it can't. The stack is left to the caller.
+static CLOX_COLD bool Clox_VM_Index_Slow(Clox_VM* vm, Clox_Value container, Clox_Value index, Clox_Value* value, bool store) {
+    uint32_t slot = 0;
+    if (Clox_VM_Is_Float_Array(container)) {
+        Clox_Float_Array* array = (Clox_Float_Array*)container.value.object;
+        if (!Clox_VM_Index_Slot(vm, index, array->count, &slot)) {
+            return false;
+        }
+        if (!store) {
+            *value = CLOX_VALUE_NUMBER(array->values[slot]);
+        } else if (CLOX_VALUE_IS_NUMERIC(*value)) {
+            array->values[slot] = Clox_Value_As_Number(*value);
+        } else {
+            Clox_VM_Native_Error(vm, "Float64Array can only hold numbers.");
+            return false;
+        }
+    } else if (Clox_VM_Is_Map(container)) {
+        if (!Clox_VM_Check_Map_Key(vm, index)) {
+            return false;
+        }
+        if (store) {
+            Clox_Map_Set((Clox_Map*)container.value.object, index, *value);
+        } else {
+            // NOTE(Al-Andrew): a missing key reads as nil, MapHas tells the two apart
+            *value = CLOX_VALUE_NIL;
+            Clox_Map_Get((Clox_Map*)container.value.object, index, value);
+        }
+    } else if (store && (Clox_VM_Is_Persistent_Map(container) || Clox_VM_Is_Persistent_Vector(container))) {
+        Clox_VM_Native_Error(vm, "Persistent maps and vectors can't be changed in place.");
+        return false;
+    } else if (Clox_VM_Is_Persistent_Vector(container)) {
+        Clox_Persistent_Vector* vector = (Clox_Persistent_Vector*)container.value.object;
+        if (!Clox_VM_Index_Slot(vm, index, vector->count, &slot)) {
+            return false;
+        }
+        *value = Clox_Persistent_Vector_Get(vector, slot);
+    } else if (Clox_VM_Is_Persistent_Map(container)) {
+        if (!Clox_VM_Check_Map_Key(vm, index)) {
+            return false;
+        }
+        *value = CLOX_VALUE_NIL;
+        Clox_Persistent_Map_Get((Clox_Persistent_Map*)container.value.object, index, value);
+    } else {
+        Clox_VM_Native_Error(vm, "Only lists, arrays and maps can be indexed.");
+        return false;
+    }
+    return true;
+}
+
+Clox_Native_Status list_append_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_Is_List(argv[0])) {
+        return Clox_VM_Native_Error(vm, "ListAppend expects a list.");
+    }
+    Clox_Value_Array_Push_Back(&((Clox_List*)argv[0].value.object)->items, argv[1]);
+    *result = CLOX_VALUE_NIL;
+    return CLOX_NATIVE_OK;
+}
+
+Clox_Native_Status list_length_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_Is_List(argv[0])) {
+        return Clox_VM_Native_Error(vm, "ListLength expects a list.");
+    }
+    *result = Clox_Value_Integer_Result(((Clox_List*)argv[0].value.object)->items.used);
+    return CLOX_NATIVE_OK;
+}
+
+Clox_Native_Status float_array_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (CLOX_VALUE_IS_NUMBER(argv[0])) {
+        double count = argv[0].value.number;
+        if (count < 0 || count > UINT32_MAX / sizeof(double) || count != floor(count)) {
+            return Clox_VM_Native_Error(vm, "Float64Array size must be a whole number.");
+        }
+        *result = CLOX_VALUE_OBJECT(Clox_Float_Array_Create(vm, (uint32_t)count));
+        return CLOX_NATIVE_OK;
+    }
+    if (!Clox_VM_Is_List(argv[0])) {
+        return Clox_VM_Native_Error(vm, "Float64Array expects a size or a list of numbers.");
+    }
+    Clox_Value_Array* items = &((Clox_List*)argv[0].value.object)->items;
+    for (uint32_t i = 0; i < items->used; i++) {
+        if (!CLOX_VALUE_IS_NUMERIC(items->values[i])) {
+            return Clox_VM_Native_Error(vm, "Float64Array expects a size or a list of numbers.");
+        }
+    }
+    Clox_Float_Array* array = Clox_Float_Array_Create(vm, items->used);
+    for (uint32_t i = 0; i < items->used; i++) {
+        array->values[i] = Clox_Value_As_Number(items->values[i]);
+    }
+    *result = CLOX_VALUE_OBJECT(array);
+    return CLOX_NATIVE_OK;
+}
+
+// NOTE(Al-Andrew): checks that the first `argc` arguments are float arrays of the same length
+static bool Clox_VM_Float_Array_Args(Clox_VM* vm, char const* name, int argc, Clox_Value* argv) {
+    for (int i = 0; i < argc; i++) {
+        if (!Clox_VM_Is_Float_Array(argv[i])) {
+            Clox_VM_Native_Error(vm, "%s expects a Float64Array.", name);
+            return false;
+        }
+        if (((Clox_Float_Array*)argv[i].value.object)->count != ((Clox_Float_Array*)argv[0].value.object)->count) {
+            Clox_VM_Native_Error(vm, "%s expects arrays of the same length.", name);
+            return false;
+        }
+    }
+    return true;
+}
+
+Clox_Native_Status float_array_length_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_Float_Array_Args(vm, "Float64Length", 1, argv)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    *result = Clox_Value_Integer_Result(((Clox_Float_Array*)argv[0].value.object)->count);
+    return CLOX_NATIVE_OK;
+}
+
+Clox_Native_Status float_array_sum_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_Float_Array_Args(vm, "Float64Sum", 1, argv)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    Clox_Float_Array* array = (Clox_Float_Array*)argv[0].value.object;
+    *result = CLOX_VALUE_NUMBER(Clox_Float_Array_Sum(array->values, array->count));
+    return CLOX_NATIVE_OK;
+}
+
+Clox_Native_Status float_array_dot_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_Float_Array_Args(vm, "Float64Dot", 2, argv)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    Clox_Float_Array* lhs = (Clox_Float_Array*)argv[0].value.object;
+    Clox_Float_Array* rhs = (Clox_Float_Array*)argv[1].value.object;
+    *result = CLOX_VALUE_NUMBER(Clox_Float_Array_Dot(lhs->values, rhs->values, lhs->count));
+    return CLOX_NATIVE_OK;
+}
+
+Clox_Native_Status float_array_scale_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_Float_Array_Args(vm, "Float64Scale", 1, argv)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    if (!CLOX_VALUE_IS_NUMERIC(argv[1])) {
+        return Clox_VM_Native_Error(vm, "Float64Scale expects a number to scale by.");
+    }
+    Clox_Float_Array* array = (Clox_Float_Array*)argv[0].value.object;
+    Clox_Float_Array* scaled = Clox_Float_Array_Create(vm, array->count);
+    Clox_Float_Array_Scale(scaled->values, array->values, Clox_Value_As_Number(argv[1]), array->count);
+    *result = CLOX_VALUE_OBJECT(scaled);
+    return CLOX_NATIVE_OK;
+}
+
+Clox_Native_Status float_array_add_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_Float_Array_Args(vm, "Float64Add", 2, argv)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    Clox_Float_Array* lhs = (Clox_Float_Array*)argv[0].value.object;
+    Clox_Float_Array* rhs = (Clox_Float_Array*)argv[1].value.object;
+    Clox_Float_Array* sum = Clox_Float_Array_Create(vm, lhs->count);
+    Clox_Float_Array_Add(sum->values, lhs->values, rhs->values, lhs->count);
+    *result = CLOX_VALUE_OBJECT(sum);
+    return CLOX_NATIVE_OK;
+}
+
+Clox_Native_Status float_array_min_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_Float_Array_Args(vm, "Float64Min", 1, argv)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    Clox_Float_Array* array = (Clox_Float_Array*)argv[0].value.object;
+    if (array->count == 0) {
+        return Clox_VM_Native_Error(vm, "Float64Min expects a non-empty array.");
+    }
+    *result = CLOX_VALUE_NUMBER(Clox_Float_Array_Min(array->values, array->count));
+    return CLOX_NATIVE_OK;
+}
+
+Clox_Native_Status float_array_max_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_Float_Array_Args(vm, "Float64Max", 1, argv)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    Clox_Float_Array* array = (Clox_Float_Array*)argv[0].value.object;
+    if (array->count == 0) {
+        return Clox_VM_Native_Error(vm, "Float64Max expects a non-empty array.");
+    }
+    *result = CLOX_VALUE_NUMBER(Clox_Float_Array_Max(array->values, array->count));
+    return CLOX_NATIVE_OK;
+}
+
+// NOTE(Al-Andrew): sorts in place and hands the same array back
+Clox_Native_Status float_array_sort_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_Float_Array_Args(vm, "Float64Sort", 1, argv)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    Clox_Float_Array* array = (Clox_Float_Array*)argv[0].value.object;
+    Clox_Float_Array_Sort(array->values, array->count);
+    *result = argv[0];
+    return CLOX_NATIVE_OK;
+}
+
+// NOTE(Al-Andrew): checks the map and, when `has_key`, the key the map natives take
+static bool Clox_VM_Map_Args(Clox_VM* vm, char const* name, Clox_Value* argv, bool has_key) {
+    if (!Clox_VM_Is_Map(argv[0])) {
+        Clox_VM_Native_Error(vm, "%s expects a map.", name);
+        return false;
+    }
+    if (has_key && !Clox_VM_Check_Map_Key(vm, argv[1])) {
+        return false;
+    }
+    return true;
+}
+
+Clox_Native_Status map_size_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_Map_Args(vm, "MapSize", argv, false)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    *result = Clox_Value_Integer_Result(((Clox_Map*)argv[0].value.object)->count);
+    return CLOX_NATIVE_OK;
+}
+
+Clox_Native_Status map_has_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_Map_Args(vm, "MapHas", argv, true)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    Clox_Value value;
+    *result = CLOX_VALUE_BOOL(Clox_Map_Get((Clox_Map*)argv[0].value.object, argv[1], &value));
+    return CLOX_NATIVE_OK;
+}
+
+Clox_Native_Status map_remove_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_Map_Args(vm, "MapRemove", argv, true)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    *result = CLOX_VALUE_BOOL(Clox_Map_Remove((Clox_Map*)argv[0].value.object, argv[1]));
+    return CLOX_NATIVE_OK;
+}
+
+// NOTE(Al-Andrew): both come out in insertion order
+Clox_Native_Status map_keys_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_Map_Args(vm, "MapKeys", argv, false)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    Clox_Map* map = (Clox_Map*)argv[0].value.object;
+    Clox_List* keys = Clox_List_Create(vm, NULL, 0);
+    for (uint32_t i = 0; i < map->used; i++) {
+        if (!map->entries[i].removed) {
+            Clox_Value_Array_Push_Back(&keys->items, map->entries[i].key);
+        }
+    }
+    *result = CLOX_VALUE_OBJECT(keys);
+    return CLOX_NATIVE_OK;
+}
+
+Clox_Native_Status map_values_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_Map_Args(vm, "MapValues", argv, false)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    Clox_Map* map = (Clox_Map*)argv[0].value.object;
+    Clox_List* values = Clox_List_Create(vm, NULL, 0);
+    for (uint32_t i = 0; i < map->used; i++) {
+        if (!map->entries[i].removed) {
+            Clox_Value_Array_Push_Back(&values->items, map->entries[i].value);
+        }
+    }
+    *result = CLOX_VALUE_OBJECT(values);
+    return CLOX_NATIVE_OK;
+}
+
+// NOTE(Al-Andrew): a position between two characters, 0 to `length` both included
+static bool Clox_VM_String_Position(Clox_Value value, uint32_t length, uint32_t* position) {
+    double number = 0;
+    if (CLOX_VALUE_IS_INTEGER(value)) {
+        number = (double)value.value.integer;
+    } else if (CLOX_VALUE_IS_NUMBER(value) && value.value.number == floor(value.value.number)) {
+        number = value.value.number;
+    } else {
+        return false;
+    }
+    if (number < 0 || number > (double)length) {
+        return false;
+    }
+    *position = (uint32_t)number;
+    return true;
+}
+
+// NOTE(Al-Andrew): the characters from `start` up to but not including `end`, shared with the string they came from
+Clox_Native_Status string_slice_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_Is_String(argv[0])) {
+        return Clox_VM_Native_Error(vm, "StringSlice expects a string.");
+    }
+    Clox_String* string = (Clox_String*)argv[0].value.object;
+    uint32_t start = 0;
+    uint32_t end = 0;
+    if (!Clox_VM_String_Position(argv[1], string->length, &start) || !Clox_VM_String_Position(argv[2], string->length, &end) || end < start) {
+        return Clox_VM_Native_Error(vm, "StringSlice expects 0 <= start <= end <= length.");
+    }
+    *result = CLOX_VALUE_OBJECT(Clox_String_Slice(vm, string, start, end - start));
+    return CLOX_NATIVE_OK;
+}
+
+// NOTE(Al-Andrew): checks that the first `argc` arguments are strings
+static bool Clox_VM_String_Args(Clox_VM* vm, char const* name, int argc, Clox_Value* argv) {
+    for (int i = 0; i < argc; i++) {
+        if (!Clox_VM_Is_String(argv[i])) {
+            Clox_VM_Native_Error(vm, "%s expects a string.", name);
+            return false;
+        }
+    }
+    return true;
+}
+
+// NOTE(Al-Andrew): StringFind(string, needle) or StringFind(string, needle, from), -1 when it's not there
+Clox_Native_Status string_find_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    if (argc != 2 && argc != 3) {
+        return Clox_VM_Native_Error(vm, "StringFind expects a string, a needle and optionally where to start.");
+    }
+    if (!Clox_VM_String_Args(vm, "StringFind", 2, argv)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    Clox_String* string = (Clox_String*)argv[0].value.object;
+    Clox_String* needle = (Clox_String*)argv[1].value.object;
+    uint32_t from = 0;
+    if (argc == 3 && !Clox_VM_String_Position(argv[2], string->length, &from)) {
+        return Clox_VM_Native_Error(vm, "StringFind expects 0 <= from <= length.");
+    }
+    uint32_t at = 0;
+    bool found = Clox_String_Find(Clox_String_Characters(string), string->length, Clox_String_Characters(needle), needle->length, from, &at);
+    *result = Clox_Value_Integer_Result(found ? (int64_t)at : -1);
+    return CLOX_NATIVE_OK;
+}
+
+// NOTE(Al-Andrew): the pieces are slices of the string, nothing gets copied
+Clox_Native_Status string_split_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_String_Args(vm, "StringSplit", 2, argv)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    Clox_String* string = (Clox_String*)argv[0].value.object;
+    Clox_String* separator = (Clox_String*)argv[1].value.object;
+    if (separator->length == 0) {
+        return Clox_VM_Native_Error(vm, "StringSplit expects a non-empty separator.");
+    }
+    char const* characters = Clox_String_Characters(string);
+    char const* separator_characters = Clox_String_Characters(separator);
+    Clox_List* pieces = Clox_List_Create(vm, NULL, 0);
+    uint32_t start = 0;
+    uint32_t at = 0;
+    while (Clox_String_Find(characters, string->length, separator_characters, separator->length, start, &at)) {
+        Clox_Value_Array_Push_Back(&pieces->items, CLOX_VALUE_OBJECT(Clox_String_Slice(vm, string, start, at - start)));
+        start = at + separator->length;
+    }
+    Clox_Value_Array_Push_Back(&pieces->items, CLOX_VALUE_OBJECT(Clox_String_Slice(vm, string, start, string->length - start)));
+    *result = CLOX_VALUE_OBJECT(pieces);
+    return CLOX_NATIVE_OK;
+}
+
+// NOTE(Al-Andrew): replaces every occurrence, a string without any comes back as it is
+Clox_Native_Status string_replace_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_String_Args(vm, "StringReplace", 3, argv)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    Clox_String* string = (Clox_String*)argv[0].value.object;
+    Clox_String* from = (Clox_String*)argv[1].value.object;
+    Clox_String* to = (Clox_String*)argv[2].value.object;
+    if (from->length == 0) {
+        return Clox_VM_Native_Error(vm, "StringReplace expects a non-empty string to replace.");
+    }
+    char const* characters = Clox_String_Characters(string);
+    char const* from_characters = Clox_String_Characters(from);
+    uint32_t at = 0;
+    if (!Clox_String_Find(characters, string->length, from_characters, from->length, 0, &at)) {
+        *result = argv[0];
+        return CLOX_NATIVE_OK;
+    }
+
+    size_t capacity = (size_t)string->length + (to->length > from->length ? (size_t)string->length / from->length * (to->length - from->length) : 0);
+    if (capacity > UINT32_MAX) {
+        return Clox_VM_Native_Error(vm, "StringReplace result is too long.");
+    }
+    char* replaced = reallocate(NULL, 0, capacity + 1);
+    uint32_t used = 0;
+    uint32_t start = 0;
+    do {
+        memcpy(replaced + used, characters + start, at - start);
+        used += at - start;
+        memcpy(replaced + used, Clox_String_Characters(to), to->length);
+        used += to->length;
+        start = at + from->length;
+    } while (Clox_String_Find(characters, string->length, from_characters, from->length, start, &at));
+    memcpy(replaced + used, characters + start, string->length - start);
+    used += string->length - start;
+    *result = CLOX_VALUE_OBJECT(Clox_String_Create(vm, replaced, used));
+    deallocate(replaced);
+    return CLOX_NATIVE_OK;
+}
+
+static inline bool Clox_VM_Is_Blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// NOTE(Al-Andrew): a slice without the blanks on either end
+Clox_Native_Status string_trim_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_String_Args(vm, "StringTrim", 1, argv)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    Clox_String* string = (Clox_String*)argv[0].value.object;
+    char const* characters = Clox_String_Characters(string);
+    uint32_t start = 0;
+    uint32_t end = string->length;
+    while (start < end && Clox_VM_Is_Blank(characters[start])) {
+        start++;
+    }
+    while (end > start && Clox_VM_Is_Blank(characters[end - 1])) {
+        end--;
+    }
+    *result = CLOX_VALUE_OBJECT(Clox_String_Slice(vm, string, start, end - start));
+    return CLOX_NATIVE_OK;
+}
+
+Clox_Native_Status string_starts_with_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_String_Args(vm, "StringStartsWith", 2, argv)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    Clox_String* string = (Clox_String*)argv[0].value.object;
+    Clox_String* prefix = (Clox_String*)argv[1].value.object;
+    *result = CLOX_VALUE_BOOL(prefix->length <= string->length &&
+        memcmp(Clox_String_Characters(string), Clox_String_Characters(prefix), prefix->length) == 0);
+    return CLOX_NATIVE_OK;
+}
+
+Clox_Native_Status string_ends_with_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_String_Args(vm, "StringEndsWith", 2, argv)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    Clox_String* string = (Clox_String*)argv[0].value.object;
+    Clox_String* suffix = (Clox_String*)argv[1].value.object;
+    *result = CLOX_VALUE_BOOL(suffix->length <= string->length &&
+        memcmp(Clox_String_Characters(string) + string->length - suffix->length, Clox_String_Characters(suffix), suffix->length) == 0);
+    return CLOX_NATIVE_OK;
+}
+
+// NOTE(Al-Andrew): -1, 0 or 1 comparing bytes, a prefix comes before the longer string
+Clox_Native_Status string_compare_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_String_Args(vm, "StringCompare", 2, argv)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    Clox_String* lhs = (Clox_String*)argv[0].value.object;
+    Clox_String* rhs = (Clox_String*)argv[1].value.object;
+    int order = memcmp(Clox_String_Characters(lhs), Clox_String_Characters(rhs), lhs->length < rhs->length ? lhs->length : rhs->length);
+    if (order == 0) {
+        order = lhs->length < rhs->length ? -1 : lhs->length > rhs->length ? 1 : 0;
+    }
+    *result = Clox_Value_Integer_Result(order < 0 ? -1 : order > 0 ? 1 : 0);
+    return CLOX_NATIVE_OK;
+}
+
+static Clox_Native_Status Clox_VM_Fold_Case(Clox_VM* vm, char const* name, Clox_Value* argv, Clox_Value* result, bool upper) {
+    if (!Clox_VM_String_Args(vm, name, 1, argv)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    Clox_String* string = (Clox_String*)argv[0].value.object;
+    char* folded = reallocate(NULL, 0, (size_t)string->length + 1);
+    Clox_String_Fold_Case(folded, Clox_String_Characters(string), string->length, upper);
+    *result = CLOX_VALUE_OBJECT(Clox_String_Create(vm, folded, string->length));
+    deallocate(folded);
+    return CLOX_NATIVE_OK;
+}
+
+Clox_Native_Status string_lower_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    return Clox_VM_Fold_Case(vm, "StringLower", argv, result, false);
+}
+
+Clox_Native_Status string_upper_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    return Clox_VM_Fold_Case(vm, "StringUpper", argv, result, true);
+}
+
+Clox_Native_Status persistent_map_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    (void)argv;
+    *result = CLOX_VALUE_OBJECT(Clox_Persistent_Map_Create(vm));
+    return CLOX_NATIVE_OK;
+}
+
+// NOTE(Al-Andrew): checks the map and, when `has_key`, the key the persistent map natives take
+static bool Clox_VM_Persistent_Map_Args(Clox_VM* vm, char const* name, Clox_Value* argv, bool has_key) {
+    if (!Clox_VM_Is_Persistent_Map(argv[0])) {
+        Clox_VM_Native_Error(vm, "%s expects a persistent map.", name);
+        return false;
+    }
+    if (has_key && !Clox_VM_Check_Map_Key(vm, argv[1])) {
+        return false;
+    }
+    return true;
+}
+
+// NOTE(Al-Andrew): the updates return a new map and leave the one they got as it was
+Clox_Native_Status persistent_map_set_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_Persistent_Map_Args(vm, "PersistentMapSet", argv, true)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    *result = CLOX_VALUE_OBJECT(Clox_Persistent_Map_Set(vm, (Clox_Persistent_Map*)argv[0].value.object, argv[1], argv[2]));
+    return CLOX_NATIVE_OK;
+}
+
+Clox_Native_Status persistent_map_remove_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_Persistent_Map_Args(vm, "PersistentMapRemove", argv, true)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    *result = CLOX_VALUE_OBJECT(Clox_Persistent_Map_Remove(vm, (Clox_Persistent_Map*)argv[0].value.object, argv[1]));
+    return CLOX_NATIVE_OK;
+}
+
+Clox_Native_Status persistent_map_has_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_Persistent_Map_Args(vm, "PersistentMapHas", argv, true)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    Clox_Value value;
+    *result = CLOX_VALUE_BOOL(Clox_Persistent_Map_Get((Clox_Persistent_Map*)argv[0].value.object, argv[1], &value));
+    return CLOX_NATIVE_OK;
+}
+
+Clox_Native_Status persistent_map_size_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_Persistent_Map_Args(vm, "PersistentMapSize", argv, false)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    *result = Clox_Value_Integer_Result(((Clox_Persistent_Map*)argv[0].value.object)->count);
+    return CLOX_NATIVE_OK;
+}
+
+// NOTE(Al-Andrew): a list with every key, or every value, in the order the trie keeps them
+static Clox_Native_Status Clox_VM_Persistent_Map_List(Clox_VM* vm, char const* name, Clox_Value* argv, Clox_Value* result, uint32_t half) {
+    if (!Clox_VM_Persistent_Map_Args(vm, name, argv, false)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    Clox_Persistent_Map* map = (Clox_Persistent_Map*)argv[0].value.object;
+    Clox_List* list = Clox_List_Create(vm, NULL, 0);
+    if (map->count > 0) {
+        Clox_Value* entries = reallocate(NULL, 0, sizeof(Clox_Value) * 2 * map->count);
+        Clox_Persistent_Map_Entries(map, entries);
+        for (uint32_t i = 0; i < map->count; i++) {
+            Clox_Value_Array_Push_Back(&list->items, entries[2 * i + half]);
+        }
+        deallocate(entries);
+    }
+    *result = CLOX_VALUE_OBJECT(list);
+    return CLOX_NATIVE_OK;
+}
+
+Clox_Native_Status persistent_map_keys_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    return Clox_VM_Persistent_Map_List(vm, "PersistentMapKeys", argv, result, 0);
+}
+
+Clox_Native_Status persistent_map_values_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    return Clox_VM_Persistent_Map_List(vm, "PersistentMapValues", argv, result, 1);
+}
+
+Clox_Native_Status persistent_vector_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    (void)argv;
+    *result = CLOX_VALUE_OBJECT(Clox_Persistent_Vector_Create(vm));
+    return CLOX_NATIVE_OK;
+}
+
+static bool Clox_VM_Persistent_Vector_Args(Clox_VM* vm, char const* name, Clox_Value* argv) {
+    if (!Clox_VM_Is_Persistent_Vector(argv[0])) {
+        Clox_VM_Native_Error(vm, "%s expects a persistent vector.", name);
+        return false;
+    }
+    return true;
+}
+
+Clox_Native_Status persistent_vector_push_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_Persistent_Vector_Args(vm, "PersistentVectorPush", argv)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    *result = CLOX_VALUE_OBJECT(Clox_Persistent_Vector_Push(vm, (Clox_Persistent_Vector*)argv[0].value.object, argv[1]));
+    return CLOX_NATIVE_OK;
+}
+
+Clox_Native_Status persistent_vector_set_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_Persistent_Vector_Args(vm, "PersistentVectorSet", argv)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    Clox_Persistent_Vector* vector = (Clox_Persistent_Vector*)argv[0].value.object;
+    uint32_t slot = 0;
+    if (!Clox_VM_Index_Slot(vm, argv[1], vector->count, &slot)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    *result = CLOX_VALUE_OBJECT(Clox_Persistent_Vector_Set(vm, vector, slot, argv[2]));
+    return CLOX_NATIVE_OK;
+}
+
+Clox_Native_Status persistent_vector_pop_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_Persistent_Vector_Args(vm, "PersistentVectorPop", argv)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    Clox_Persistent_Vector* vector = (Clox_Persistent_Vector*)argv[0].value.object;
+    if (vector->count == 0) {
+        return Clox_VM_Native_Error(vm, "PersistentVectorPop expects a vector that isn't empty.");
+    }
+    *result = CLOX_VALUE_OBJECT(Clox_Persistent_Vector_Pop(vm, vector));
+    return CLOX_NATIVE_OK;
+}
+
+Clox_Native_Status persistent_vector_length_native(Clox_VM* vm, int argc, Clox_Value* argv, Clox_Value* result) {
+    (void)argc;
+    if (!Clox_VM_Persistent_Vector_Args(vm, "PersistentVectorLength", argv)) {
+        return CLOX_NATIVE_ERROR;
+    }
+    *result = Clox_Value_Integer_Result(((Clox_Persistent_Vector*)argv[0].value.object)->count);
+    return CLOX_NATIVE_OK;
+}
+
+// NOTE(Al-Andrew): natives that do enough work per call that going through OP_INTRINSIC wouldn't pay off
+static Clox_Native_Definition const Clox_VM_Library_Natives[] = {
+    {.name = "Float64Array", .call = float_array_native, .arity = 1, .flags = 0},
+    {.name = "Float64Length", .call = float_array_length_native, .arity = 1, .flags = CLOX_NATIVE_FLAG_NO_ALLOC},
+    {.name = "Float64Sum", .call = float_array_sum_native, .arity = 1, .flags = CLOX_NATIVE_FLAG_NO_ALLOC},
+    {.name = "Float64Dot", .call = float_array_dot_native, .arity = 2, .flags = CLOX_NATIVE_FLAG_NO_ALLOC},
+    {.name = "Float64Scale", .call = float_array_scale_native, .arity = 2, .flags = 0},
+    {.name = "Float64Add", .call = float_array_add_native, .arity = 2, .flags = 0},
+    {.name = "Float64Min", .call = float_array_min_native, .arity = 1, .flags = CLOX_NATIVE_FLAG_NO_ALLOC},
+    {.name = "Float64Max", .call = float_array_max_native, .arity = 1, .flags = CLOX_NATIVE_FLAG_NO_ALLOC},
+    {.name = "Float64Sort", .call = float_array_sort_native, .arity = 1, .flags = CLOX_NATIVE_FLAG_NO_ALLOC},
+    {.name = "MapSize", .call = map_size_native, .arity = 1, .flags = CLOX_NATIVE_FLAG_NO_ALLOC},
+    {.name = "MapHas", .call = map_has_native, .arity = 2, .flags = CLOX_NATIVE_FLAG_NO_ALLOC},
+    {.name = "MapRemove", .call = map_remove_native, .arity = 2, .flags = CLOX_NATIVE_FLAG_NO_ALLOC},
+    {.name = "MapKeys", .call = map_keys_native, .arity = 1, .flags = 0},
+    {.name = "MapValues", .call = map_values_native, .arity = 1, .flags = 0},
+    {.name = "StringSlice", .call = string_slice_native, .arity = 3, .flags = 0},
+    {.name = "StringFind", .call = string_find_native, .arity = CLOX_NATIVE_VARIADIC, .flags = CLOX_NATIVE_FLAG_PURE | CLOX_NATIVE_FLAG_NO_ALLOC},
+    {.name = "StringSplit", .call = string_split_native, .arity = 2, .flags = 0},
+    {.name = "StringReplace", .call = string_replace_native, .arity = 3, .flags = 0},
+    {.name = "StringTrim", .call = string_trim_native, .arity = 1, .flags = 0},
+    {.name = "StringStartsWith", .call = string_starts_with_native, .arity = 2, .flags = CLOX_NATIVE_FLAG_PURE | CLOX_NATIVE_FLAG_NO_ALLOC},
+    {.name = "StringEndsWith", .call = string_ends_with_native, .arity = 2, .flags = CLOX_NATIVE_FLAG_PURE | CLOX_NATIVE_FLAG_NO_ALLOC},
+    {.name = "StringCompare", .call = string_compare_native, .arity = 2, .flags = CLOX_NATIVE_FLAG_PURE | CLOX_NATIVE_FLAG_NO_ALLOC},
+    {.name = "StringLower", .call = string_lower_native, .arity = 1, .flags = 0},
+    {.name = "StringUpper", .call = string_upper_native, .arity = 1, .flags = 0},
+    {.name = "PersistentMap", .call = persistent_map_native, .arity = 0, .flags = 0},
+    {.name = "PersistentMapSet", .call = persistent_map_set_native, .arity = 3, .flags = 0},
+    {.name = "PersistentMapRemove", .call = persistent_map_remove_native, .arity = 2, .flags = 0},
+    {.name = "PersistentMapHas", .call = persistent_map_has_native, .arity = 2, .flags = CLOX_NATIVE_FLAG_PURE | CLOX_NATIVE_FLAG_NO_ALLOC},
+    {.name = "PersistentMapSize", .call = persistent_map_size_native, .arity = 1, .flags = CLOX_NATIVE_FLAG_PURE | CLOX_NATIVE_FLAG_NO_ALLOC},
+    {.name = "PersistentMapKeys", .call = persistent_map_keys_native, .arity = 1, .flags = 0},
+    {.name = "PersistentMapValues", .call = persistent_map_values_native, .arity = 1, .flags = 0},
+    {.name = "PersistentVector", .call = persistent_vector_native, .arity = 0, .flags = 0},
+    {.name = "PersistentVectorPush", .call = persistent_vector_push_native, .arity = 2, .flags = 0},
+    {.name = "PersistentVectorSet", .call = persistent_vector_set_native, .arity = 3, .flags = 0},
+    {.name = "PersistentVectorPop", .call = persistent_vector_pop_native, .arity = 1, .flags = 0},
+    {.name = "PersistentVectorLength", .call = persistent_vector_length_native, .arity = 1, .flags = CLOX_NATIVE_FLAG_PURE | CLOX_NATIVE_FLAG_NO_ALLOC},
+};
+
+// NOTE(Al-Andrew): the natives behind Clox_Intrinsics, OP_INTRINSIC calls the same functions directly
+static struct {
+    Clox_Native_Call call;
+    uint32_t flags;
+} const Clox_VM_Intrinsic_Natives[CLOX_INTRINSIC_COUNT] = {
+    [CLOX_INTRINSIC_CLOCK] = {.call = clock_native, .flags = CLOX_NATIVE_FLAG_NO_ALLOC},
+    [CLOX_INTRINSIC_SQRT] = {.call = sqrt_native, .flags = CLOX_NATIVE_FLAG_PURE | CLOX_NATIVE_FLAG_NO_ALLOC},
+    [CLOX_INTRINSIC_FLOOR] = {.call = floor_native, .flags = CLOX_NATIVE_FLAG_PURE | CLOX_NATIVE_FLAG_NO_ALLOC},
+    [CLOX_INTRINSIC_STRING_LENGTH] = {.call = string_length_native, .flags = CLOX_NATIVE_FLAG_PURE | CLOX_NATIVE_FLAG_NO_ALLOC},
+    [CLOX_INTRINSIC_LIST_APPEND] = {.call = list_append_native, .flags = CLOX_NATIVE_FLAG_NO_ALLOC},
+    [CLOX_INTRINSIC_LIST_LENGTH] = {.call = list_length_native, .flags = CLOX_NATIVE_FLAG_NO_ALLOC},
+};
+
 Clox_VM Clox_VM_New_Empty() {
     Clox_VM vm = {0};
     Clox_VM_Reset_Stack(&vm);
 
-    Clox_VM_Define_Native(&vm, "GetSystemTimeInSeconds", clock_native);
+    for (uint32_t i = 0; i < CLOX_INTRINSIC_COUNT; ++i) {
+        Clox_VM_Define_Native_Call(&vm, (Clox_Native_Definition){
+            .name = Clox_Intrinsics[i].name,
+            .call = Clox_VM_Intrinsic_Natives[i].call,
+            .arity = Clox_Intrinsics[i].arity,
+            .flags = Clox_VM_Intrinsic_Natives[i].flags,
+        });
+        Clox_String* name = Clox_String_Create(&vm, Clox_Intrinsics[i].name, (uint32_t)strlen(Clox_Intrinsics[i].name));
+        name->names_intrinsic = true;
+        vm.intrinsic_names[i] = name;
+    }
+    for (uint32_t i = 0; i < sizeof(Clox_VM_Library_Natives) / sizeof(Clox_VM_Library_Natives[0]); ++i) {
+        Clox_VM_Define_Native_Call(&vm, Clox_VM_Library_Natives[i]);
+    }
 
     return vm;
 }
 void Clox_VM_Delete(Clox_VM* const vm) {
     // NOTE(Al-Andrew, Leak): do we own the chunk?
 
+    Clox_Jit_Stop_Recording(vm);
     Clox_Hash_Table_Destory(&vm->strings);
     Clox_Hash_Table_Destory(&vm->globals);
     Clox_Object* it = vm->objects;
@@ -73,6 +880,7 @@ static void Clox_VM_Close_Upvalues(Clox_VM* vm, Clox_Value* last) {
 // TODO(Al-Andrew, Diagnostics): better diagnostics 
 #define CLOX_VM_ASSURE_STACK_TYPE_0(T) { if(Clox_VM_Stack_Peek(vm, 0).type != T) { return (Clox_Interpret_Result){.status = INTERPRET_RUNTIME_ERROR}; } }
 #define CLOX_VM_ASSURE_STACK_TYPE_1(T) { if(Clox_VM_Stack_Peek(vm, 1).type != T) { return (Clox_Interpret_Result){.status = INTERPRET_RUNTIME_ERROR}; } }
+#define CLOX_VM_ASSURE_STACK_NUMERIC_0() { if(!CLOX_VALUE_IS_NUMERIC(Clox_VM_Stack_Peek(vm, 0))) { return (Clox_Interpret_Result){.status = INTERPRET_RUNTIME_ERROR}; } }
 
 static Clox_Interpret_Result Clox_VM_Runtime_Error(Clox_VM* vm, char const* const fmt, ...) {
     va_list args;
@@ -98,19 +906,74 @@ static Clox_Interpret_Result Clox_VM_Runtime_Error(Clox_VM* vm, char const* cons
 }
 
 static bool Clox_VM_Call(Clox_VM* vm, Clox_Closure* callee, int argCount) {
-
-    if (argCount != callee->function->arity) {
-        Clox_VM_Runtime_Error(vm, "Expected %d arguments but got %d.", callee->function->arity, argCount);
-        return false;
-    }
-    if (vm->call_frame_count == CLOX_MAX_CALL_FRAMES) {
-        Clox_VM_Runtime_Error(vm, "Stack overflow.");
-        return false;
+    Clox_Function* function = callee->function;
+    // NOTE(Al-Andrew): one branch on the way into the frame, it's only taken for an error or the first lazy call
+    if (argCount != function->arity || vm->call_frame_count == CLOX_MAX_CALL_FRAMES || function->lazy_source.string != NULL) {
+        if (argCount != function->arity) {
+            Clox_VM_Runtime_Error(vm, "Expected %d arguments but got %d.", function->arity, argCount);
+            return false;
+        }
+        if (vm->call_frame_count == CLOX_MAX_CALL_FRAMES) {
+            Clox_VM_Runtime_Error(vm, "Stack overflow.");
+            return false;
+        }
+        if (!Clox_Compile_Lazy_Function(vm, function)) {
+            Clox_VM_Runtime_Error(vm, "Could not compile '%s'.", function->name->characters);
+            return false;
+        }
     }
     Clox_Call_Frame* frame = &vm->frames[vm->call_frame_count++];
     frame->closure = callee;
     frame->instruction_pointer = callee->function->chunk.code;
     frame->slots = vm->stack_top - argCount - 1;
+    frame->closure_stack_used = vm->closure_stack_used;
+    return true;
+}
+
+static inline bool Clox_VM_Is_Stack_Closure(Clox_VM* vm, Clox_Object* object) {
+    uintptr_t address = (uintptr_t)object;
+    return address >= (uintptr_t)vm->closure_stack && address < (uintptr_t)(vm->closure_stack + CLOX_MAX_CLOSURE_STACK);
+}
+
+static Clox_Closure* Clox_VM_Stack_Closure_Create(Clox_VM* vm, Clox_Function* function) {
+    uint32_t size = (uint32_t)((sizeof(Clox_Closure) + sizeof(Clox_Capture) * (size_t)function->upvalue_count + sizeof(Clox_Value) - 1) / sizeof(Clox_Value));
+    if (vm->closure_stack_used + size > CLOX_MAX_CLOSURE_STACK) {
+        return Clox_Closure_Create(vm, function);
+    }
+    // NOTE(Al-Andrew): not linked into vm->objects, nothing but its local ever points at it
+    Clox_Closure* closure = (Clox_Closure*)(void*)(vm->closure_stack + vm->closure_stack_used);
+    vm->closure_stack_used += size;
+    closure->obj = (Clox_Object){.type = CLOX_OBJECT_TYPE_CLOSURE, .next_object = NULL};
+    closure->function = function;
+    closure->upvalue_count = function->upvalue_count;
+    return closure;
+}
+
+// NOTE(Al-Andrew): a stack closure that didn't fit is on the heap, it just stays there
+static void Clox_VM_Stack_Closure_Free(Clox_VM* vm, Clox_Object* closure) {
+    if (Clox_VM_Is_Stack_Closure(vm, closure)) {
+        vm->closure_stack_used = (uint32_t)((Clox_Value*)(void*)closure - vm->closure_stack);
+    }
+}
+
+// NOTE(Al-Andrew): the arity was checked already
+static bool Clox_VM_Call_Native(Clox_VM* vm, Clox_Native* native, int argCount) {
+    Clox_Value* args = vm->stack_top - argCount;
+    Clox_Value result = CLOX_VALUE_NIL;
+    // NOTE(Al-Andrew): natives only ever see doubles, CLOX_VALUE_TYPE_INTEGER stays inside the interpreter
+    for (int i = 0; i < argCount; i++) {
+        if (CLOX_VALUE_IS_INTEGER(args[i])) {
+            args[i] = CLOX_VALUE_NUMBER((double)args[i].value.integer);
+        }
+    }
+    if (native->function != NULL) {
+        result = native->function(argCount, args);
+    } else if (native->call(vm, argCount, args, &result) != CLOX_NATIVE_OK) {
+        Clox_VM_Runtime_Error(vm, "%s", vm->native_error);
+        return false;
+    }
+    vm->stack_top -= argCount + 1;
+    Clox_VM_Stack_Push(vm, result);
     return true;
 }
 
@@ -122,11 +985,29 @@ static bool Clox_VM_Call_Value(Clox_VM* vm, Clox_Value callee, int argCount) {
         } break;
         case CLOX_OBJECT_TYPE_NATIVE: {
             Clox_Native* native = (Clox_Native*)callee.value.object;
-            Clox_Value result = native->function(argCount, vm->stack_top - argCount); // TODO(Al-Andrew): native functons can error out right?
-            vm->stack_top -= argCount + 1;
-            Clox_VM_Stack_Push(vm, result);
+            if (native->arity != CLOX_NATIVE_VARIADIC && argCount != native->arity) {
+                Clox_VM_Runtime_Error(vm, "Expected %d arguments but got %d.", native->arity, argCount);
+                return false;
+            }
+            return Clox_VM_Call_Native(vm, native, argCount);
+        } break;
+        case CLOX_OBJECT_TYPE_CLASS: {
+            Clox_Class* klass = (Clox_Class*)callee.value.object;
+            vm->stack_top[-argCount - 1] = CLOX_VALUE_OBJECT(Clox_Instance_Create(vm, klass));
+            if (klass->initializer != NULL) {
+                return Clox_VM_Call(vm, klass->initializer, argCount);
+            }
+            if (argCount != 0) {
+                Clox_VM_Runtime_Error(vm, "Expected 0 arguments but got %d.", argCount);
+                return false;
+            }
             return true;
         } break;
+        case CLOX_OBJECT_TYPE_BOUND_METHOD: {
+            Clox_Bound_Method* bound = (Clox_Bound_Method*)callee.value.object;
+            vm->stack_top[-argCount - 1] = bound->receiver;
+            return Clox_VM_Call(vm, bound->method, argCount);
+        } break;
         default:
             break; // Non-callable object type.
     }
@@ -135,12 +1016,129 @@ static bool Clox_VM_Call_Value(Clox_VM* vm, Clox_Value callee, int argCount) {
   return false;
 }
 
-void Clox_VM_Define_Native(Clox_VM* vm, const char* name, Clox_Native_Fn function) {
-    Clox_VM_Stack_Push(vm, CLOX_VALUE_OBJECT(Clox_String_Create(vm, name, (uint32_t)strlen(name))));
+// NOTE(Al-Andrew): remembers what the call at `call` just called successfully, so the arity and lazy compile
+//                  checks don't run again for the same callee. Classes and bound methods put something else in
+//                  the callee's slot first, they always take the slow path.
+static void Clox_VM_Fill_Call_Cache(Clox_Function* caller, uint8_t const* call, Clox_Value callee) {
+    Clox_Object_Type kind = callee.value.object->type;
+    if (kind != CLOX_OBJECT_TYPE_CLOSURE && kind != CLOX_OBJECT_TYPE_NATIVE) {
+        return;
+    }
+    if (caller->call_caches == NULL) {
+        caller->call_caches = reallocate(NULL, 0, sizeof(Clox_Call_Cache) * caller->chunk.used);
+        memset(caller->call_caches, 0, sizeof(Clox_Call_Cache) * caller->chunk.used);
+    }
+    Clox_Call_Cache* cache = &caller->call_caches[call - caller->chunk.code];
+    cache->callee = callee.value.object;
+    cache->kind = kind;
+}
+
+// NOTE(Al-Andrew): the cache of the OP_GET_PROPERTY or OP_INVOKE at `site`, filled for the instance's shape on a miss.
+//                  NULL when the instance has neither a field nor a method called `name`.
+static Clox_Property_Cache* Clox_VM_Find_Property(Clox_Function* function, uint8_t const* site, Clox_Instance* instance, Clox_String* name) {
+    uint32_t offset = (uint32_t)(site - function->chunk.code);
+    Clox_Property_Cache* cache = function->property_caches != NULL ? &function->property_caches[offset] : NULL;
+    if (cache != NULL && cache->shape == instance->shape) {
+        return cache;
+    }
+
+    // NOTE(Al-Andrew): fields shadow methods, a field added later changes the shape so a cached method never hides it
+    cache = Clox_Property_Cache_At(function, offset);
+    int32_t slot = Clox_Shape_Find_Field(instance->shape, name);
+    Clox_Value method = CLOX_VALUE_NIL;
+    if (slot != -1) {
+        *cache = (Clox_Property_Cache){.shape = instance->shape, .slot = (uint32_t)slot};
+    } else if (Clox_Hash_Table_Get(&instance->shape->klass->methods, name, &method)) {
+        *cache = (Clox_Property_Cache){.shape = instance->shape, .method = (Clox_Closure*)method.value.object};
+    } else {
+        return NULL;
+    }
+    return cache;
+}
+
+uint32_t Clox_VM_Switch_Entry(Clox_Value table, uint32_t count, Clox_Value value) {
+    if (CLOX_VALUE_IS_NUMBER(table)) {
+        if (!CLOX_VALUE_IS_NUMERIC(value)) {
+            return count;
+        }
+        double entry = Clox_Value_As_Number(value) - table.value.number;
+        // NOTE(Al-Andrew): NaN fails both comparisons
+        if (entry >= 0 && entry < (double)count && entry == (double)(uint32_t)entry) {
+            return (uint32_t)entry;
+        }
+        return count;
+    }
+
+    Clox_Value entry = CLOX_VALUE_NIL;
+    if (Clox_Map_Is_Key(value) && Clox_Map_Get((Clox_Map*)table.value.object, value, &entry)) {
+        return (uint32_t)entry.value.number;
+    }
+    return count;
+}
+
+Clox_Intrinsic Clox_VM_Find_Intrinsic(Clox_VM* vm, Clox_String* name) {
+    if (!name->names_intrinsic) {
+        return CLOX_INTRINSIC_COUNT;
+    }
+    uint32_t intrinsic = 0;
+    while (intrinsic < CLOX_INTRINSIC_COUNT && vm->intrinsic_names[intrinsic] != name) {
+        intrinsic++;
+    }
+    return (Clox_Intrinsic)intrinsic;
+}
+
+void Clox_VM_Note_Global_Write(Clox_VM* vm, Clox_String* name) {
+    if (name->names_intrinsic) {
+        vm->intrinsics_rebound |= 1u << Clox_VM_Find_Intrinsic(vm, name);
+    }
+}
+
+// NOTE(Al-Andrew): OP_INTRINSIC of a rebound name, calls whatever the global holds now like OP_CALL would
+static bool Clox_VM_Call_Rebound_Intrinsic(Clox_VM* vm, Clox_Intrinsic intrinsic) {
+    Clox_String* name = vm->intrinsic_names[intrinsic];
+    Clox_Value callee = {0};
+    if (!Clox_Hash_Table_Get(&vm->globals, name, &callee)) {
+        Clox_VM_Runtime_Error(vm, "Undefined variable '%s'.", name->characters);
+        return false;
+    }
+    uint8_t argCount = Clox_Intrinsics[intrinsic].arity;
+    Clox_Value* args = vm->stack_top - argCount;
+    memmove(args + 1, args, sizeof(Clox_Value) * argCount);
+    args[0] = callee;
+    vm->stack_top++;
+    return Clox_VM_Call_Value(vm, callee, argCount);
+}
+
+static Clox_Native* Clox_VM_Define_Native_Object(Clox_VM* vm, const char* name, Clox_Native_Fn function) {
+    Clox_String* native_name = Clox_String_Create(vm, name, (uint32_t)strlen(name));
+    Clox_VM_Note_Global_Write(vm, native_name);
+    Clox_VM_Stack_Push(vm, CLOX_VALUE_OBJECT(native_name));
     Clox_VM_Stack_Push(vm, CLOX_VALUE_OBJECT(Clox_Native_Create(vm, function)));
+    Clox_Native* native = (Clox_Native*)vm->stack[1].value.object;
+    native->name = native_name;
     Clox_Hash_Table_Set(&vm->globals, (Clox_String*)vm->stack[0].value.object, vm->stack[1]);
     Clox_VM_Stack_Pop(vm);
     Clox_VM_Stack_Pop(vm);
+    return native;
+}
+
+void Clox_VM_Define_Native(Clox_VM* vm, const char* name, Clox_Native_Fn function) {
+    Clox_VM_Define_Native_Object(vm, name, function);
+}
+
+void Clox_VM_Define_Native_Call(Clox_VM* vm, Clox_Native_Definition definition) {
+    Clox_Native* native = Clox_VM_Define_Native_Object(vm, definition.name, NULL);
+    native->call = definition.call;
+    native->arity = definition.arity;
+    native->flags = definition.flags;
+}
+
+Clox_Native_Status Clox_VM_Native_Error(Clox_VM* vm, char const* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(vm->native_error, sizeof(vm->native_error), fmt, args);
+    va_end(args);
+    return CLOX_NATIVE_ERROR;
 }
 
 Clox_Interpret_Result Clox_VM_Interpret_Function(Clox_VM* const vm, Clox_Function* function) {
@@ -148,6 +1146,8 @@ Clox_Interpret_Result Clox_VM_Interpret_Function(Clox_VM* const vm, Clox_Functio
     (void)function; //NOTE(AAL): why the fuck do we have this param if we don't use it at all?
 
     Clox_Call_Frame* frame = &vm->frames[vm->call_frame_count - 1];
+    bool const jit = vm->config.jit;
+    bool recording = false;
     #define READ_BYTE() (*frame->instruction_pointer++)
 
     #define READ_SHORT() \
@@ -160,7 +1160,14 @@ Clox_Interpret_Result Clox_VM_Interpret_Function(Clox_VM* const vm, Clox_Functio
     #define READ_STRING() ((Clox_String*)READ_CONSTANT().value.object)
 
     for (;;) {
-        
+        if (recording) {
+            // NOTE(Al-Andrew): a hot loop is being traced, it runs here one instruction at a time until it's back
+            recording = Clox_Jit_Record(vm, frame);
+        } else if (jit) {
+            // NOTE(Al-Andrew): native code runs up to the next instruction it leaves to us, usually a call or return
+            Clox_Jit_Enter(vm, frame);
+        }
+
         #ifdef CLOX_DEBUG_TRACE_STACK
         printf("[");
         for(Clox_Value* stack_ptr = vm->stack; stack_ptr < vm->stack_top; ++stack_ptr)
@@ -183,6 +1190,7 @@ Clox_Interpret_Result Clox_VM_Interpret_Function(Clox_VM* const vm, Clox_Functio
                 
                 Clox_Value result = Clox_VM_Stack_Pop(vm);
                 Clox_VM_Close_Upvalues(vm, frame->slots);
+                vm->closure_stack_used = frame->closure_stack_used;
                 vm->call_frame_count--;
                 if (vm->call_frame_count == 0) {
                     Clox_VM_Stack_Pop(vm); //this pops the <script> function off the stack
@@ -208,10 +1216,14 @@ Clox_Interpret_Result Clox_VM_Interpret_Function(Clox_VM* const vm, Clox_Functio
             } break;
             case OP_ARITHMETIC_NEGATION: {
                 CLOX_VM_ASSURE_STACK_CONTAINS_AT_LEAST(1);
-                CLOX_VM_ASSURE_STACK_TYPE_0(CLOX_VALUE_TYPE_NUMBER);
+                CLOX_VM_ASSURE_STACK_NUMERIC_0();
 
-                double value = Clox_VM_Stack_Pop(vm).value.number;
-                Clox_VM_Stack_Push(vm, CLOX_VALUE_NUMBER(-value));
+                Clox_Value value = Clox_VM_Stack_Pop(vm);
+                if (CLOX_VALUE_IS_INTEGER(value)) {
+                    Clox_VM_Stack_Push(vm, Clox_Value_Integer_Negate(value.value.integer));
+                } else {
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_NUMBER(-value.value.number));
+                }
             }break;
             case OP_BOOLEAN_NEGATION: {
                 CLOX_VM_ASSURE_STACK_CONTAINS_AT_LEAST(1);
@@ -233,13 +1245,15 @@ Clox_Interpret_Result Clox_VM_Interpret_Function(Clox_VM* const vm, Clox_Functio
                 Clox_Value rhs = Clox_VM_Stack_Pop(vm);
                 Clox_Value lhs = Clox_VM_Stack_Pop(vm);
 
-                if(lhs.type != rhs.type) {
-                    return (Clox_Interpret_Result){.status = INTERPRET_RUNTIME_ERROR};
-                }
-
                 if(CLOX_VALUE_IS_NUMBER(lhs) && CLOX_VALUE_IS_NUMBER(rhs)) {
                     Clox_VM_Stack_Push(vm, CLOX_VALUE_NUMBER(lhs.value.number + rhs.value.number));
                 }
+                else if(CLOX_VALUE_IS_INTEGER(lhs) && CLOX_VALUE_IS_INTEGER(rhs)) {
+                    Clox_VM_Stack_Push(vm, Clox_Value_Integer_Add(lhs.value.integer, rhs.value.integer));
+                }
+                else if(CLOX_VALUE_IS_NUMERIC(lhs) && CLOX_VALUE_IS_NUMERIC(rhs)) {
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_NUMBER(Clox_Value_As_Number(lhs) + Clox_Value_As_Number(rhs)));
+                }
                 else if((lhs.type == CLOX_VALUE_TYPE_OBJECT && lhs.value.object->type == CLOX_OBJECT_TYPE_STRING) && (rhs.type == CLOX_VALUE_TYPE_OBJECT && rhs.value.object->type == CLOX_OBJECT_TYPE_STRING)) {
                     Clox_String* lhs_string = (Clox_String*)lhs.value.object;
                     Clox_String* rhs_string = (Clox_String*)rhs.value.object;
@@ -247,8 +1261,8 @@ Clox_Interpret_Result Clox_VM_Interpret_Function(Clox_VM* const vm, Clox_Functio
                     // FIXME(Al-Andrwe): this is stupid
                     char* concat = reallocate(NULL, 0, lhs_string->length + rhs_string->length + 1);
                     unsigned int concat_length = lhs_string->length + rhs_string->length;
-                    memcpy(concat, lhs_string->characters, lhs_string->length);
-                    memcpy(concat + lhs_string->length, rhs_string->characters, rhs_string->length);
+                    memcpy(concat, Clox_String_Characters(lhs_string), lhs_string->length);
+                    memcpy(concat + lhs_string->length, Clox_String_Characters(rhs_string), rhs_string->length);
                     concat[rhs_string->length + lhs_string->length] = '\0';
                     Clox_String* concat_string = Clox_String_Create(vm, concat, concat_length);
                     deallocate(concat);
@@ -260,39 +1274,56 @@ Clox_Interpret_Result Clox_VM_Interpret_Function(Clox_VM* const vm, Clox_Functio
             }break;
             case OP_SUB: {
                 CLOX_VM_ASSURE_STACK_CONTAINS_AT_LEAST(2);
-                CLOX_VM_ASSURE_STACK_TYPE_0(CLOX_VALUE_TYPE_NUMBER);
-                CLOX_VM_ASSURE_STACK_TYPE_1(CLOX_VALUE_TYPE_NUMBER);
-
-
-                double rhs = Clox_VM_Stack_Pop(vm).value.number;
-                double lhs = Clox_VM_Stack_Pop(vm).value.number;
-                Clox_VM_Stack_Push(vm, CLOX_VALUE_NUMBER(lhs - rhs));
+                Clox_Value rhs = Clox_VM_Stack_Pop(vm);
+                Clox_Value lhs = Clox_VM_Stack_Pop(vm);
+                if (CLOX_VALUE_IS_NUMBER(lhs) && CLOX_VALUE_IS_NUMBER(rhs)) {
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_NUMBER(lhs.value.number - rhs.value.number));
+                } else if (CLOX_VALUE_IS_INTEGER(lhs) && CLOX_VALUE_IS_INTEGER(rhs)) {
+                    Clox_VM_Stack_Push(vm, Clox_Value_Integer_Sub(lhs.value.integer, rhs.value.integer));
+                } else if (CLOX_VALUE_IS_NUMERIC(lhs) && CLOX_VALUE_IS_NUMERIC(rhs)) {
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_NUMBER(Clox_Value_As_Number(lhs) - Clox_Value_As_Number(rhs)));
+                } else {
+                    return (Clox_Interpret_Result){.status = INTERPRET_RUNTIME_ERROR};
+                }
             }break;
             case OP_MUL: {
                 CLOX_VM_ASSURE_STACK_CONTAINS_AT_LEAST(2);
-                CLOX_VM_ASSURE_STACK_TYPE_0(CLOX_VALUE_TYPE_NUMBER);
-                CLOX_VM_ASSURE_STACK_TYPE_1(CLOX_VALUE_TYPE_NUMBER);
-
-
-                double lhs = Clox_VM_Stack_Pop(vm).value.number;
-                double rhs = Clox_VM_Stack_Pop(vm).value.number;
-                Clox_VM_Stack_Push(vm, CLOX_VALUE_NUMBER(lhs * rhs));
+                Clox_Value rhs = Clox_VM_Stack_Pop(vm);
+                Clox_Value lhs = Clox_VM_Stack_Pop(vm);
+                if (CLOX_VALUE_IS_NUMBER(lhs) && CLOX_VALUE_IS_NUMBER(rhs)) {
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_NUMBER(lhs.value.number * rhs.value.number));
+                } else if (CLOX_VALUE_IS_INTEGER(lhs) && CLOX_VALUE_IS_INTEGER(rhs)) {
+                    Clox_VM_Stack_Push(vm, Clox_Value_Integer_Mul(lhs.value.integer, rhs.value.integer));
+                } else if (CLOX_VALUE_IS_NUMERIC(lhs) && CLOX_VALUE_IS_NUMERIC(rhs)) {
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_NUMBER(Clox_Value_As_Number(lhs) * Clox_Value_As_Number(rhs)));
+                } else {
+                    return (Clox_Interpret_Result){.status = INTERPRET_RUNTIME_ERROR};
+                }
             }break;
             case OP_DIV: {
                 CLOX_VM_ASSURE_STACK_CONTAINS_AT_LEAST(2);
-                CLOX_VM_ASSURE_STACK_TYPE_0(CLOX_VALUE_TYPE_NUMBER);
-                CLOX_VM_ASSURE_STACK_TYPE_1(CLOX_VALUE_TYPE_NUMBER);
-
-
-                double rhs = Clox_VM_Stack_Pop(vm).value.number;
-                double lhs = Clox_VM_Stack_Pop(vm).value.number;
-                Clox_VM_Stack_Push(vm, CLOX_VALUE_NUMBER(lhs / rhs));
+                Clox_Value rhs = Clox_VM_Stack_Pop(vm);
+                Clox_Value lhs = Clox_VM_Stack_Pop(vm);
+                if (CLOX_VALUE_IS_NUMBER(lhs) && CLOX_VALUE_IS_NUMBER(rhs)) {
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_NUMBER(lhs.value.number / rhs.value.number));
+                } else if (CLOX_VALUE_IS_INTEGER(lhs) && CLOX_VALUE_IS_INTEGER(rhs)) {
+                    Clox_VM_Stack_Push(vm, Clox_Value_Integer_Div(lhs.value.integer, rhs.value.integer));
+                } else if (CLOX_VALUE_IS_NUMERIC(lhs) && CLOX_VALUE_IS_NUMERIC(rhs)) {
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_NUMBER(Clox_Value_As_Number(lhs) / Clox_Value_As_Number(rhs)));
+                } else {
+                    return (Clox_Interpret_Result){.status = INTERPRET_RUNTIME_ERROR};
+                }
             }break;
             case OP_EQUAL: {
                 CLOX_VM_ASSURE_STACK_CONTAINS_AT_LEAST(2);
                 Clox_Value lhs = Clox_VM_Stack_Pop(vm);
                 Clox_Value rhs = Clox_VM_Stack_Pop(vm);
 
+                if(CLOX_VALUE_IS_NUMERIC(lhs) && CLOX_VALUE_IS_NUMERIC(rhs)) {
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(Clox_Value_As_Number(lhs) == Clox_Value_As_Number(rhs)));
+                    break;
+                }
+
                 if(lhs.type != rhs.type) {
                     Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(false));
                     break;
@@ -305,30 +1336,21 @@ Clox_Interpret_Result Clox_VM_Interpret_Function(Clox_VM* const vm, Clox_Functio
                     case CLOX_VALUE_TYPE_BOOL: {
                         Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(lhs.value.boolean == rhs.value.boolean));
                     } break;
-                    case CLOX_VALUE_TYPE_NUMBER: {
-                        Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(lhs.value.number == rhs.value.number));
+                    case CLOX_VALUE_TYPE_NUMBER: /* fallthrough */
+                    case CLOX_VALUE_TYPE_INTEGER: {
+                        CLOX_UNREACHABLE(); // NOTE(Al-Andrew): compared above
                     } break;
                     case CLOX_VALUE_TYPE_OBJECT: {
                         
                         switch (lhs.value.object->type) {
                             case CLOX_OBJECT_TYPE_STRING: {
-                                Clox_String* lhs_string = (Clox_String*)lhs.value.object;
-                                Clox_String* rhs_string = (Clox_String*)rhs.value.object;
-
-                                bool result = s8_compare(
-                                    (s8){
-                                        .len = lhs_string->length,
-                                        .string = lhs_string->characters
-                                    },
-                                    (s8){
-                                        .len = rhs_string->length,
-                                        .string = rhs_string->characters
-                                    }
-                                ) == 0;
+                                bool result = rhs.value.object->type == CLOX_OBJECT_TYPE_STRING &&
+                                    Clox_String_Equal((Clox_String*)lhs.value.object, (Clox_String*)rhs.value.object);
                                 Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(result));
                             }break;
                             default: {
-                                CLOX_UNREACHABLE(); // TODO(Al-Andrew): 
+                                // NOTE(Al-Andrew): everything else is only ever equal to itself
+                                Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(lhs.value.object == rhs.value.object));
                             } break;
                         }
 
@@ -338,23 +1360,31 @@ Clox_Interpret_Result Clox_VM_Interpret_Function(Clox_VM* const vm, Clox_Functio
             }break;
             case OP_GREATER: {
                 CLOX_VM_ASSURE_STACK_CONTAINS_AT_LEAST(2);
-                CLOX_VM_ASSURE_STACK_TYPE_0(CLOX_VALUE_TYPE_NUMBER);
-                CLOX_VM_ASSURE_STACK_TYPE_1(CLOX_VALUE_TYPE_NUMBER);
-
-
-                double rhs = Clox_VM_Stack_Pop(vm).value.number;
-                double lhs = Clox_VM_Stack_Pop(vm).value.number;
-                Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(lhs > rhs));
+                Clox_Value rhs = Clox_VM_Stack_Pop(vm);
+                Clox_Value lhs = Clox_VM_Stack_Pop(vm);
+                if (CLOX_VALUE_IS_NUMBER(lhs) && CLOX_VALUE_IS_NUMBER(rhs)) {
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(lhs.value.number > rhs.value.number));
+                } else if (CLOX_VALUE_IS_INTEGER(lhs) && CLOX_VALUE_IS_INTEGER(rhs)) {
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(lhs.value.integer > rhs.value.integer));
+                } else if (CLOX_VALUE_IS_NUMERIC(lhs) && CLOX_VALUE_IS_NUMERIC(rhs)) {
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(Clox_Value_As_Number(lhs) > Clox_Value_As_Number(rhs)));
+                } else {
+                    return (Clox_Interpret_Result){.status = INTERPRET_RUNTIME_ERROR};
+                }
             }break;
             case OP_LESS: {
                 CLOX_VM_ASSURE_STACK_CONTAINS_AT_LEAST(2);
-                CLOX_VM_ASSURE_STACK_TYPE_0(CLOX_VALUE_TYPE_NUMBER);
-                CLOX_VM_ASSURE_STACK_TYPE_1(CLOX_VALUE_TYPE_NUMBER);
-
-
-                double rhs = Clox_VM_Stack_Pop(vm).value.number;
-                double lhs = Clox_VM_Stack_Pop(vm).value.number;
-                Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(lhs < rhs));
+                Clox_Value rhs = Clox_VM_Stack_Pop(vm);
+                Clox_Value lhs = Clox_VM_Stack_Pop(vm);
+                if (CLOX_VALUE_IS_NUMBER(lhs) && CLOX_VALUE_IS_NUMBER(rhs)) {
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(lhs.value.number < rhs.value.number));
+                } else if (CLOX_VALUE_IS_INTEGER(lhs) && CLOX_VALUE_IS_INTEGER(rhs)) {
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(lhs.value.integer < rhs.value.integer));
+                } else if (CLOX_VALUE_IS_NUMERIC(lhs) && CLOX_VALUE_IS_NUMERIC(rhs)) {
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(Clox_Value_As_Number(lhs) < Clox_Value_As_Number(rhs)));
+                } else {
+                    return (Clox_Interpret_Result){.status = INTERPRET_RUNTIME_ERROR};
+                }
             }break;
             case OP_PRINT: {
                 CLOX_VM_ASSURE_STACK_CONTAINS_AT_LEAST(1);
@@ -371,6 +1401,7 @@ Clox_Interpret_Result Clox_VM_Interpret_Function(Clox_VM* const vm, Clox_Functio
                 Clox_String* name = READ_STRING();
                 Clox_Value value = Clox_VM_Stack_Pop(vm);
                 Clox_Hash_Table_Set(&vm->globals, name, value);
+                Clox_VM_Note_Global_Write(vm, name);
             } break;
             case OP_GET_GLOBAL: {
                 Clox_String* name = READ_STRING();
@@ -386,6 +1417,7 @@ Clox_Interpret_Result Clox_VM_Interpret_Function(Clox_VM* const vm, Clox_Functio
                     Clox_Hash_Table_Remove(&vm->globals, name); 
                     return Clox_VM_Runtime_Error(vm, "Undefined variable '%s'.", name->characters);
                 }
+                Clox_VM_Note_Global_Write(vm, name);
             } break;
             case OP_GET_LOCAL: {
                 uint8_t variable_index = READ_BYTE();
@@ -399,11 +1431,15 @@ Clox_Interpret_Result Clox_VM_Interpret_Function(Clox_VM* const vm, Clox_Functio
             } break;
             case OP_GET_UPVALUE: {
                 uint8_t slot = READ_BYTE();
-                Clox_VM_Stack_Push(vm, *frame->closure->upvalues[slot]->location);
+                Clox_VM_Stack_Push(vm, *frame->closure->upvalues[slot].upvalue->location);
+            } break;
+            case OP_GET_CAPTURE: {
+                uint8_t slot = READ_BYTE();
+                Clox_VM_Stack_Push(vm, frame->closure->upvalues[slot].value);
             } break;
             case OP_SET_UPVALUE: {
                 uint8_t slot = READ_BYTE();
-                *frame->closure->upvalues[slot]->location = Clox_VM_Stack_Peek(vm, 0);
+                *frame->closure->upvalues[slot].upvalue->location = Clox_VM_Stack_Peek(vm, 0);
             } break;
             case OP_JUMP: {
                 uint16_t offset = READ_SHORT();
@@ -419,26 +1455,87 @@ Clox_Interpret_Result Clox_VM_Interpret_Function(Clox_VM* const vm, Clox_Functio
             case OP_LOOP: {
                 uint16_t offset = READ_SHORT();
                 frame->instruction_pointer -= offset;
+                if (jit && !recording) {
+                    recording = Clox_Jit_Loop(vm, frame, frame->instruction_pointer);
+                }
             } break;
-            case OP_CALL: {
-                uint32_t argCount = (uint32_t)READ_BYTE();
-                if (!Clox_VM_Call_Value(vm, Clox_VM_Stack_Peek(vm, argCount), (int)argCount)) {
+            case OP_FOR_LOOP: {
+                Clox_Value* counter = &frame->slots[READ_BYTE()];
+                uint16_t offset = READ_SHORT();
+                CLOX_DEV_ASSERT(CLOX_VALUE_IS_NUMERIC(counter[0]) && CLOX_VALUE_IS_NUMERIC(counter[1]) && CLOX_VALUE_IS_NUMERIC(counter[2]));
+
+                // NOTE(Al-Andrew): the same OP_ADD and OP_LESS would do
+                if (CLOX_VALUE_IS_INTEGER(counter[0]) && CLOX_VALUE_IS_INTEGER(counter[2])) {
+                    counter[0] = Clox_Value_Integer_Add(counter[0].value.integer, counter[2].value.integer);
+                } else {
+                    counter[0] = CLOX_VALUE_NUMBER(Clox_Value_As_Number(counter[0]) + Clox_Value_As_Number(counter[2]));
+                }
+                bool again = CLOX_VALUE_IS_INTEGER(counter[0]) && CLOX_VALUE_IS_INTEGER(counter[1])
+                    ? counter[0].value.integer < counter[1].value.integer
+                    : Clox_Value_As_Number(counter[0]) < Clox_Value_As_Number(counter[1]);
+                if (again) {
+                    frame->instruction_pointer -= offset;
+                    if (jit && !recording) {
+                        recording = Clox_Jit_Loop(vm, frame, frame->instruction_pointer);
+                    }
+                }
+            } break;
+            case OP_CALL: /* fallthrough */
+            case OP_CALL_0: /* fallthrough */
+            case OP_CALL_1: /* fallthrough */
+            case OP_CALL_2: /* fallthrough */
+            case OP_CALL_3: {
+                uint8_t const* call = frame->instruction_pointer - 1;
+                uint32_t argCount = opcode == OP_CALL ? (uint32_t)READ_BYTE() : (uint32_t)(opcode - OP_CALL_0);
+                Clox_Value callee = Clox_VM_Stack_Peek(vm, argCount);
+                Clox_Function* caller = frame->closure->function;
+                Clox_Call_Cache const* cache = caller->call_caches != NULL ? &caller->call_caches[call - caller->chunk.code] : NULL;
+
+                if (cache != NULL && CLOX_VALUE_IS_OBJECT(callee) && callee.value.object == cache->callee) {
+                    if (cache->kind == CLOX_OBJECT_TYPE_NATIVE) {
+                        if (!Clox_VM_Call_Native(vm, (Clox_Native*)cache->callee, (int)argCount)) {
+                            return Clox_VM_Runtime_Error(vm, "Error while trying to call.");
+                        }
+                        break;
+                    }
+                    if (vm->call_frame_count < CLOX_MAX_CALL_FRAMES) {
+                        frame = &vm->frames[vm->call_frame_count++];
+                        frame->closure = (Clox_Closure*)cache->callee;
+                        frame->instruction_pointer = frame->closure->function->chunk.code;
+                        frame->slots = vm->stack_top - argCount - 1;
+                        frame->closure_stack_used = vm->closure_stack_used;
+                        break;
+                    }
+                }
+
+                if (!Clox_VM_Call_Value(vm, callee, (int)argCount)) {
                     return Clox_VM_Runtime_Error(vm, "Error while trying to call.");
                 }
+                // NOTE(Al-Andrew): a stack closure reusing an address is fine here, only its own local ever calls it
+                //                  so the call site always finds the same function behind that address
+                Clox_VM_Fill_Call_Cache(caller, call, callee);
                 frame = &vm->frames[vm->call_frame_count - 1];
             } break;
-            case OP_CLOSURE: {
+            case OP_CLOSURE: /* fallthrough */
+            case OP_STACK_CLOSURE: {
                 Clox_Function* function = (Clox_Function*)(READ_CONSTANT().value.object);
-                Clox_Closure* closure = Clox_Closure_Create(vm, function);
+                Clox_Closure* closure = NULL;
+                if (opcode == OP_STACK_CLOSURE && function->upvalue_count > 0) {
+                    closure = Clox_VM_Stack_Closure_Create(vm, function);
+                } else {
+                    closure = Clox_Closure_Of(vm, function);
+                }
                 Clox_VM_Stack_Push(vm, CLOX_VALUE_OBJECT(closure));
 
                 {
                     int i = 0;
                     for (i = 0; i < closure->upvalue_count; i++) {
-                        uint8_t isLocal = READ_BYTE();
+                        uint8_t capture = READ_BYTE();
                         uint8_t index = READ_BYTE();
-                        if (isLocal) {
-                            closure->upvalues[i] = Clox_Closure_Capture_Upvalue(vm, frame->slots + index);
+                        if (capture == (CLOX_CAPTURE_LOCAL | CLOX_CAPTURE_FLAT)) {
+                            closure->upvalues[i].value = frame->slots[index];
+                        } else if (capture & CLOX_CAPTURE_LOCAL) {
+                            closure->upvalues[i].upvalue = Clox_Closure_Capture_Upvalue(vm, frame->slots + index);
                         } else {
                             closure->upvalues[i] = frame->closure->upvalues[index];
                         }
@@ -446,10 +1543,244 @@ Clox_Interpret_Result Clox_VM_Interpret_Function(Clox_VM* const vm, Clox_Functio
                 }
 
             } break;
+            case OP_LIST: {
+                uint8_t count = READ_BYTE();
+                Clox_List* list = Clox_List_Create(vm, vm->stack_top - count, count);
+                vm->stack_top -= count;
+                Clox_VM_Stack_Push(vm, CLOX_VALUE_OBJECT(list));
+            } break;
+            case OP_MAP: {
+                uint8_t count = READ_BYTE();
+                Clox_Map* map = Clox_Map_Create(vm);
+                for (Clox_Value* pair = vm->stack_top - 2 * count; pair < vm->stack_top; pair += 2) {
+                    if (!Clox_VM_Check_Map_Key(vm, pair[0])) {
+                        return Clox_VM_Runtime_Error(vm, "%s", vm->native_error);
+                    }
+                    Clox_Map_Set(map, pair[0], pair[1]);
+                }
+                vm->stack_top -= 2 * count;
+                Clox_VM_Stack_Push(vm, CLOX_VALUE_OBJECT(map));
+            } break;
+            case OP_INDEX_GET: {
+                Clox_Value container = Clox_VM_Stack_Peek(vm, 1);
+                if (Clox_VM_Is_List(container)) {
+                    Clox_Value_Array* items = &((Clox_List*)container.value.object)->items;
+                    uint32_t slot = 0;
+                    if (!Clox_VM_Index_Slot(vm, Clox_VM_Stack_Peek(vm, 0), items->used, &slot)) {
+                        return Clox_VM_Runtime_Error(vm, "%s", vm->native_error);
+                    }
+                    vm->stack_top--;
+                    vm->stack_top[-1] = items->values[slot];
+                } else {
+                    Clox_Value value = CLOX_VALUE_NIL;
+                    if (!Clox_VM_Index_Slow(vm, container, Clox_VM_Stack_Peek(vm, 0), &value, false)) {
+                        return Clox_VM_Runtime_Error(vm, "%s", vm->native_error);
+                    }
+                    vm->stack_top--;
+                    vm->stack_top[-1] = value;
+                }
+            } break;
+            case OP_INDEX_SET: {
+                Clox_Value container = Clox_VM_Stack_Peek(vm, 2);
+                Clox_Value value = Clox_VM_Stack_Peek(vm, 0);
+                if (Clox_VM_Is_List(container)) {
+                    Clox_Value_Array* items = &((Clox_List*)container.value.object)->items;
+                    uint32_t slot = 0;
+                    if (!Clox_VM_Index_Slot(vm, Clox_VM_Stack_Peek(vm, 1), items->used, &slot)) {
+                        return Clox_VM_Runtime_Error(vm, "%s", vm->native_error);
+                    }
+                    items->values[slot] = value;
+                } else if (!Clox_VM_Index_Slow(vm, container, Clox_VM_Stack_Peek(vm, 1), &value, true)) {
+                    return Clox_VM_Runtime_Error(vm, "%s", vm->native_error);
+                }
+                vm->stack_top -= 2;
+                vm->stack_top[-1] = value;
+            } break;
+            case OP_CLASS: {
+                Clox_VM_Stack_Push(vm, CLOX_VALUE_OBJECT(Clox_Class_Create(vm, READ_STRING())));
+            } break;
+            case OP_INHERIT: {
+                Clox_Value superclass = Clox_VM_Stack_Peek(vm, 1);
+                if (!Clox_VM_Is_Class(superclass)) {
+                    return Clox_VM_Runtime_Error(vm, "Superclass must be a class.");
+                }
+                Clox_Class* subclass = (Clox_Class*)Clox_VM_Stack_Peek(vm, 0).value.object;
+                // NOTE(Al-Andrew): copied down once, the subclass's own methods overwrite them right after
+                Clox_Hash_Table_Set_All(&((Clox_Class*)superclass.value.object)->methods, &subclass->methods);
+                subclass->initializer = ((Clox_Class*)superclass.value.object)->initializer;
+                Clox_VM_Stack_Pop(vm);
+            } break;
+            case OP_METHOD: {
+                Clox_String* name = READ_STRING();
+                Clox_Value method = Clox_VM_Stack_Peek(vm, 0);
+                Clox_Class* klass = (Clox_Class*)Clox_VM_Stack_Peek(vm, 1).value.object;
+                Clox_Hash_Table_Set(&klass->methods, name, method);
+                if (name->length == 4 && memcmp(name->characters, "init", 4) == 0) {
+                    klass->initializer = (Clox_Closure*)method.value.object;
+                }
+                Clox_VM_Stack_Pop(vm);
+            } break;
+            case OP_GET_PROPERTY: {
+                uint8_t const* site = frame->instruction_pointer - 1;
+                Clox_String* name = READ_STRING();
+                Clox_Value receiver = Clox_VM_Stack_Peek(vm, 0);
+                if (!Clox_VM_Is_Instance(receiver)) {
+                    return Clox_VM_Runtime_Error(vm, "Only instances have properties.");
+                }
+                Clox_Instance* instance = (Clox_Instance*)receiver.value.object;
+                Clox_Property_Cache const* cache = Clox_VM_Find_Property(frame->closure->function, site, instance, name);
+                if (cache == NULL) {
+                    return Clox_VM_Runtime_Error(vm, "Undefined property '%s'.", name->characters);
+                }
+
+                if (cache->method != NULL) {
+                    vm->stack_top[-1] = CLOX_VALUE_OBJECT(Clox_Bound_Method_Create(vm, receiver, cache->method));
+                } else {
+                    vm->stack_top[-1] = instance->fields[cache->slot];
+                }
+            } break;
+            case OP_SET_PROPERTY: {
+                uint8_t const* site = frame->instruction_pointer - 1;
+                Clox_String* name = READ_STRING();
+                Clox_Value target = Clox_VM_Stack_Peek(vm, 1);
+                Clox_Value value = Clox_VM_Stack_Peek(vm, 0);
+                if (!Clox_VM_Is_Instance(target)) {
+                    return Clox_VM_Runtime_Error(vm, "Only instances have fields.");
+                }
+                Clox_Instance* instance = (Clox_Instance*)target.value.object;
+                Clox_Function* function = frame->closure->function;
+                Clox_Property_Cache* cache = function->property_caches != NULL ? &function->property_caches[site - function->chunk.code] : NULL;
+
+                if (cache == NULL || cache->shape != instance->shape) {
+                    cache = Clox_Property_Cache_At(function, (uint32_t)(site - function->chunk.code));
+                    int32_t slot = Clox_Shape_Find_Field(instance->shape, name);
+                    if (slot != -1) {
+                        *cache = (Clox_Property_Cache){.shape = instance->shape, .slot = (uint32_t)slot};
+                    } else {
+                        Clox_Shape* transition = Clox_Shape_Add_Field(vm, instance->shape, name);
+                        *cache = (Clox_Property_Cache){.shape = instance->shape, .transition = transition, .slot = transition->field_count - 1};
+                    }
+                }
+
+                if (cache->transition != NULL) {
+                    Clox_Instance_Add_Field(instance, cache->transition, value);
+                } else {
+                    instance->fields[cache->slot] = value;
+                }
+                vm->stack_top--;
+                vm->stack_top[-1] = value;
+            } break;
+            case OP_GET_SUPER: {
+                Clox_String* name = READ_STRING();
+                Clox_Class* superclass = (Clox_Class*)Clox_VM_Stack_Pop(vm).value.object;
+                Clox_Value method = CLOX_VALUE_NIL;
+                if (!Clox_Hash_Table_Get(&superclass->methods, name, &method)) {
+                    return Clox_VM_Runtime_Error(vm, "Undefined property '%s'.", name->characters);
+                }
+                vm->stack_top[-1] = CLOX_VALUE_OBJECT(Clox_Bound_Method_Create(vm, vm->stack_top[-1], (Clox_Closure*)method.value.object));
+            } break;
+            case OP_INVOKE: {
+                uint8_t const* site = frame->instruction_pointer - 1;
+                Clox_String* name = READ_STRING();
+                uint32_t argCount = (uint32_t)READ_BYTE();
+                Clox_Value receiver = Clox_VM_Stack_Peek(vm, argCount);
+                if (!Clox_VM_Is_Instance(receiver)) {
+                    return Clox_VM_Runtime_Error(vm, "Only instances have methods.");
+                }
+                Clox_Instance* instance = (Clox_Instance*)receiver.value.object;
+                Clox_Property_Cache const* cache = Clox_VM_Find_Property(frame->closure->function, site, instance, name);
+                if (cache == NULL) {
+                    return Clox_VM_Runtime_Error(vm, "Undefined property '%s'.", name->characters);
+                }
+
+                // NOTE(Al-Andrew): the receiver already sits where the method's `this` goes, a field holding something
+                //                  callable replaces it like OP_GET_PROPERTY would have
+                bool called = false;
+                if (cache->method != NULL) {
+                    called = Clox_VM_Call(vm, cache->method, (int)argCount);
+                } else {
+                    Clox_Value callee = instance->fields[cache->slot];
+                    vm->stack_top[-(int32_t)argCount - 1] = callee;
+                    called = Clox_VM_Call_Value(vm, callee, (int)argCount);
+                }
+                if (!called) {
+                    return Clox_VM_Runtime_Error(vm, "Error while trying to call.");
+                }
+                frame = &vm->frames[vm->call_frame_count - 1];
+            } break;
+            case OP_SWITCH: {
+                Clox_Value table = READ_CONSTANT();
+                uint32_t count = (uint32_t)READ_BYTE();
+                Clox_Value value = Clox_VM_Stack_Pop(vm);
+                frame->instruction_pointer += 3 * Clox_VM_Switch_Entry(table, count, value);
+            } break;
+            case OP_SUPER_INVOKE: {
+                Clox_String* name = READ_STRING();
+                int argCount = READ_BYTE();
+                Clox_Class* superclass = (Clox_Class*)Clox_VM_Stack_Pop(vm).value.object;
+                Clox_Value method = CLOX_VALUE_NIL;
+                if (!Clox_Hash_Table_Get(&superclass->methods, name, &method)) {
+                    return Clox_VM_Runtime_Error(vm, "Undefined property '%s'.", name->characters);
+                }
+                if (!Clox_VM_Call(vm, (Clox_Closure*)method.value.object, argCount)) {
+                    return Clox_VM_Runtime_Error(vm, "Error while trying to call.");
+                }
+                frame = &vm->frames[vm->call_frame_count - 1];
+            } break;
+            case OP_POP_STACK_CLOSURE: {
+                Clox_VM_Stack_Closure_Free(vm, Clox_VM_Stack_Pop(vm).value.object);
+            } break;
             case OP_CLOSE_UPVALUE: {
                 Clox_VM_Close_Upvalues(vm, vm->stack_top - 1);
                 Clox_VM_Stack_Pop(vm);
             } break;
+            case OP_DUP: {
+                Clox_VM_Stack_Push(vm, Clox_VM_Stack_Peek(vm, 0));
+            } break;
+            case OP_INTRINSIC: {
+                Clox_Intrinsic intrinsic = (Clox_Intrinsic)READ_BYTE();
+                if (vm->intrinsics_rebound & (1u << intrinsic)) {
+                    if (!Clox_VM_Call_Rebound_Intrinsic(vm, intrinsic)) {
+                        return Clox_VM_Runtime_Error(vm, "Error while trying to call.");
+                    }
+                    frame = &vm->frames[vm->call_frame_count - 1];
+                    break;
+                }
+
+                int argCount = Clox_Intrinsics[intrinsic].arity;
+                Clox_Value* args = vm->stack_top - argCount;
+                Clox_Value result = CLOX_VALUE_NIL;
+                Clox_Native_Status status = CLOX_NATIVE_OK;
+                switch (intrinsic) {
+                    case CLOX_INTRINSIC_CLOCK: {
+                        status = clock_native(vm, argCount, args, &result);
+                    } break;
+                    case CLOX_INTRINSIC_SQRT: {
+                        status = sqrt_native(vm, argCount, args, &result);
+                    } break;
+                    case CLOX_INTRINSIC_FLOOR: {
+                        status = floor_native(vm, argCount, args, &result);
+                    } break;
+                    case CLOX_INTRINSIC_STRING_LENGTH: {
+                        status = string_length_native(vm, argCount, args, &result);
+                    } break;
+                    case CLOX_INTRINSIC_LIST_APPEND: {
+                        status = list_append_native(vm, argCount, args, &result);
+                    } break;
+                    case CLOX_INTRINSIC_LIST_LENGTH: {
+                        status = list_length_native(vm, argCount, args, &result);
+                    } break;
+                    case CLOX_INTRINSIC_COUNT: {
+                        CLOX_UNREACHABLE();
+                    } break;
+                }
+                if (status != CLOX_NATIVE_OK) {
+                    Clox_VM_Runtime_Error(vm, "%s", vm->native_error);
+                    return Clox_VM_Runtime_Error(vm, "Error while trying to call.");
+                }
+                vm->stack_top = args;
+                Clox_VM_Stack_Push(vm, result);
+            } break;
             default: {
 
                 return (Clox_Interpret_Result){.return_value = Clox_VM_Stack_Pop(vm), .status = INTERPRET_COMPILE_ERROR, .message = "Unknown instruction."};
@@ -460,7 +1791,7 @@ Clox_Interpret_Result Clox_VM_Interpret_Function(Clox_VM* const vm, Clox_Functio
     CLOX_UNREACHABLE();
 }
 
-Clox_Interpret_Result Clox_VM_Interpret_Source(Clox_VM* vm, const char* source) {
+Clox_Interpret_Result Clox_VM_Interpret_Source(Clox_VM* vm, s8 source) {
     Clox_Interpret_Result result = {0};
     Clox_VM_Reset_Stack(vm);
 
@@ -472,7 +1803,7 @@ Clox_Interpret_Result Clox_VM_Interpret_Source(Clox_VM* vm, const char* source)
             break;
         }
 
-        Clox_Closure* top_level_closure = Clox_Closure_Create(vm, top_level_function);
+        Clox_Closure* top_level_closure = Clox_Closure_Of(vm, top_level_function);
         Clox_VM_Stack_Push(vm, CLOX_VALUE_OBJECT(top_level_closure));
         Clox_VM_Call(vm, top_level_closure, 0);
 
@@ -12,24 +12,48 @@
 
 #define CLOX_MAX_CALL_FRAMES 64
 #define CLOX_MAX_STACK (CLOX_MAX_CALL_FRAMES * (UINT8_MAX + 1))
+// NOTE(Al-Andrew): in Clox_Values. Closures the compiler proved never leave their local (OP_STACK_CLOSURE) are
+//                  bump allocated here instead of the heap and given back when the local is popped or its frame
+//                  returns. Once it's full they go to the heap like any other closure.
+#define CLOX_MAX_CLOSURE_STACK (CLOX_MAX_CALL_FRAMES * 64)
 
 typedef struct {
   Clox_Closure* closure;
   uint8_t* instruction_pointer;
   Clox_Value* slots;
+  uint32_t closure_stack_used; // NOTE(Al-Andrew): vm->closure_stack_used when the frame was entered
 } Clox_Call_Frame;
 
+typedef struct {
+  // NOTE(Al-Andrew): only pre-parse function bodies, compile them on their first call.
+  //                  the source buffer has to outlive every call into the VM.
+  bool lazy_compile;
+  // NOTE(Al-Andrew): run every function through the optimizer (optimizer.c) once it's compiled
+  bool optimize;
+  // NOTE(Al-Andrew): inline small functions across the script, only sound when it's compiled all at once
+  bool inline_functions;
+  // NOTE(Al-Andrew): run functions as native code where the platform has a JIT (jit.c), checked on every interpret
+  bool jit;
+} Clox_VM_Config;
+
 struct Clox_VM{
+  Clox_VM_Config config;
   Clox_Chunk* chunk;
   uint8_t* instruction_pointer;
   Clox_Call_Frame frames[CLOX_MAX_CALL_FRAMES];
   int call_frame_count;
   Clox_Value stack[CLOX_MAX_STACK];
   Clox_Value* stack_top;
+  Clox_Value closure_stack[CLOX_MAX_CLOSURE_STACK];
+  uint32_t closure_stack_used;
   Clox_Object* objects;
   Clox_Hash_Table strings;
   Clox_Hash_Table globals;
   Clox_UpvalueObj* open_upvalues;
+  struct Clox_Jit_Recorder* jit_recorder; // NOTE(Al-Andrew): the loop being traced, see jit.h
+  char native_error[256];
+  Clox_String* intrinsic_names[CLOX_INTRINSIC_COUNT];
+  uint32_t intrinsics_rebound; // NOTE(Al-Andrew): bit per Clox_Intrinsic whose global was written to since it was defined
 };
 
 
@@ -50,7 +74,18 @@ Clox_VM Clox_VM_New_Empty();
 void Clox_VM_Delete(Clox_VM* const vm);
 
 Clox_Interpret_Result Clox_VM_Interpret_Chunk(Clox_VM* const vm, Clox_Chunk* const chunk);
-Clox_Interpret_Result Clox_VM_Interpret_Source(Clox_VM* const vm, const char* source);
+Clox_Interpret_Result Clox_VM_Interpret_Source(Clox_VM* const vm, s8 source);
+// NOTE(Al-Andrew): takes any number of arguments and can't report errors, Clox_VM_Define_Native_Call can
 void Clox_VM_Define_Native(Clox_VM* vm, const char* name, Clox_Native_Fn function);
+void Clox_VM_Define_Native_Call(Clox_VM* vm, Clox_Native_Definition definition);
+// NOTE(Al-Andrew): for natives to `return Clox_VM_Native_Error(vm, ...);`, the VM reports it as a runtime error
+Clox_Native_Status Clox_VM_Native_Error(Clox_VM* vm, char const* fmt, ...);
+// NOTE(Al-Andrew): the intrinsic a call through the global `name` can compile to, CLOX_INTRINSIC_COUNT for none
+Clox_Intrinsic Clox_VM_Find_Intrinsic(Clox_VM* vm, Clox_String* name);
+// NOTE(Al-Andrew): everything that writes a global has to tell the VM, OP_INTRINSIC stops trusting a rebound name
+void Clox_VM_Note_Global_Write(Clox_VM* vm, Clox_String* name);
+// NOTE(Al-Andrew): the OP_SWITCH table entry `value` takes, `count` when no case matches. A number `table` is the
+//                  smallest case of a direct table, otherwise it's a Clox_Map from the cases to their entries.
+uint32_t Clox_VM_Switch_Entry(Clox_Value table, uint32_t count, Clox_Value value);
 
 #endif // CLOX_VM_H_INCLUDED
\ No newline at end of file